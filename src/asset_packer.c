@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "language/asset_pack.h"
+
+//
+// Reads the build ID, written in hex, from the file at path.
+//
+static bool read_build_id(const char *path, uint64_t *build_id) {
+    size_t size;
+    uint8_t *data = try_read_binary_file_FREE(path, &size);
+    if (data == NULL) {
+        log_error("Could not read the build ID from %s\n", path);
+        return false;
+    }
+    char text[32] = { 0 };
+    memcpy(text, data, size < sizeof(text) - 1 ? size : sizeof(text) - 1);
+    free(data);
+
+    char *end;
+    *build_id = strtoull(text, &end, 16);
+    if (end == text) {
+        log_error("%s does not hold a build ID\n", path);
+        return false;
+    }
+    return true;
+}
+
+//
+// Packs the files given as NAME=PATH into one asset pack (see
+// language/asset_pack.h) for the build whose ID is in BUILD_ID_FILE, then
+// reopens it and checks every entry. Run by the assets target at build
+// time.
+//
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("Usage: %s OUTPUT BUILD_ID_FILE [NAME=PATH]...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint64_t build_id;
+    if (!read_build_id(argv[2], &build_id)) {
+        return EXIT_FAILURE;
+    }
+
+    uint32_t count = (uint32_t)(argc - 3);
+    const char **names = malloc(sizeof(const char *) * (count > 0 ? count : 1));
+    const char **paths = malloc(sizeof(const char *) * (count > 0 ? count : 1));
+    if (names == NULL || paths == NULL) {
+        log_fatal("Could not malloc asset list\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        char *separator = strchr(argv[i + 3], '=');
+        if (separator == NULL || separator == argv[i + 3]) {
+            log_error("%s should be NAME=PATH\n", argv[i + 3]);
+            return EXIT_FAILURE;
+        }
+        *separator = '\0';
+        names[i] = argv[i + 3];
+        paths[i] = separator + 1;
+    }
+
+    bool packed = asset_pack_write(argv[1], build_id, names, paths, count);
+    free(names);
+    free(paths);
+    if (!packed) {
+        return EXIT_FAILURE;
+    }
+
+    struct AssetPack pack;
+    if (!asset_pack_open(argv[1], build_id, &pack)) {
+        return EXIT_FAILURE;
+    }
+    bool valid = asset_pack_verify(&pack);
+    log_info("Packed %u assets into %s (%lu bytes)\n", count, argv[1], (unsigned long)pack.file.size);
+    asset_pack_close(&pack);
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
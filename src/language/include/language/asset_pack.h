@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "language/fileops.h"
+
+//
+// Many assets in one file, laid out to be mapped rather than parsed: a
+// header, a table with the name hash, offset, size and content hash of
+// every entry, sorted by name hash, and the entries themselves, each on its
+// own ASSET_PACK_ALIGNMENT boundary. Names are hashed with hash_fnv1a_64
+// and are not stored; two names with the same hash cannot be packed
+// together. The header carries the build ID of the build the pack was
+// made for; a pack is only opened by that build, so its entries can be
+// used as they are.
+//
+#define ASSET_PACK_MAGIC     0x4b415041u
+#define ASSET_PACK_VERSION   2
+#define ASSET_PACK_ALIGNMENT 64
+
+struct AssetPackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t alignment;
+    uint64_t table_offset;
+    uint64_t build_id;
+};
+
+struct AssetPackEntry {
+    uint64_t name_hash;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t content_hash;
+};
+
+struct AssetPack {
+    struct MappedFile file;
+    const struct AssetPackHeader *header;
+    const struct AssetPackEntry *entries;
+};
+
+bool asset_pack_write(
+    const char *filename, uint64_t build_id, const char *const *names, const char *const *paths, uint32_t count);
+bool asset_pack_open(const char *filename, uint64_t build_id, struct AssetPack *pack);
+void asset_pack_close(struct AssetPack *pack);
+const struct AssetPackEntry *asset_pack_entry(const struct AssetPack *pack, const char *name);
+const uint8_t *asset_pack_find(const struct AssetPack *pack, const char *name, size_t *size);
+bool asset_pack_verify(const struct AssetPack *pack);
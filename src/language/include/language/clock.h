@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+uint64_t clock_now_ns();
+double clock_ns_to_ms(uint64_t ns);
+double clock_ns_to_seconds(uint64_t ns);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Same as VK_UUID_SIZE, so this needs no Vulkan headers
+//
+#define DEVICE_UUID_SIZE 16
+
+//
+// Devices compare by type first (discrete, integrated, virtual, CPU), then
+// by benchmark result if both were measured, then by device local memory
+// and finally by the largest 2D image they support.
+//
+struct DeviceScore {
+    uint32_t type_rank;
+    double copy_gb_per_s;
+    uint64_t device_local_bytes;
+    uint32_t max_image_dimension_2d;
+};
+
+int device_score_compare(const struct DeviceScore *a, const struct DeviceScore *b);
+bool device_uuid_parse(const char *text, uint8_t uuid[DEVICE_UUID_SIZE]);
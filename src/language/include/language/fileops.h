@@ -1,5 +1,23 @@
+#pragma once
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+uint8_t *read_binary_file_FREE(const char *filename, size_t * size); 
+uint8_t *try_read_binary_file_FREE(const char *filename, size_t *size);
+bool write_binary_file_atomic(const char *filename, const uint8_t *data, size_t size);
+bool executable_relative_path(const char *filename, char *path, size_t path_size);
+
+//
+// A whole file mapped read-only into memory. Pages are read from disk the
+// first time they are touched, not when the file is mapped.
+//
+struct MappedFile {
+    const uint8_t *data;
+    size_t size;
+};
 
-uint8_t *read_binary_file_FREE(const char *filename, size_t * size); 
\ No newline at end of file
+bool map_file(const char *filename, struct MappedFile *file);
+void unmap_file(struct MappedFile *file);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_FNV1A_64_SEED 0xcbf29ce484222325ull
+
+uint64_t hash_fnv1a_64(const void *data, size_t size);
+uint64_t hash_fnv1a_64_extend(uint64_t hash, const void *data, size_t size);
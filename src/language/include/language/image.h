@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMAGE_RGBA8_PIXEL_SIZE 4
+
+//
+// Decodes a binary PPM (P6, 8 bits per channel) into tightly packed RGBA8
+// pixels, fully opaque. Returns NULL if data is not a PPM we understand or
+// is truncated.
+//
+uint8_t *image_decode_ppm_FREE(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height);
+
+//
+// Copies the width x height region at (x, y) of an RGBA8 image src_width
+// pixels wide into dst, tightly packed.
+//
+void image_copy_rgba8_region(
+    const uint8_t *src,
+    uint32_t src_width,
+    uint32_t x,
+    uint32_t y,
+    uint32_t width,
+    uint32_t height,
+    uint8_t *dst);
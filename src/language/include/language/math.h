@@ -1,3 +1,4 @@
+#pragma once
 
  #define MAX(a,b) \
    ({ __typeof__ (a) _a = (a); \
@@ -7,5 +8,5 @@
  #define MIN(a,b) \
    ({ __typeof__ (a) _a = (a); \
        __typeof__ (b) _b = (b); \
-     _a > _b ? _a : _b; })
+     _a < _b ? _a : _b; })
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "language/raw_vector.h"
+
+//
+// A free range of a RangeAllocator.
+//
+struct Range {
+    uint64_t offset;
+    uint64_t size;
+};
+
+//
+// Places aligned sub-ranges inside a fixed size range, e.g. resources inside
+// a block of device memory. Free ranges are kept sorted by offset and
+// neighbours are merged when a range is freed, placement is first fit.
+//
+struct RangeAllocator {
+    uint64_t size;
+    uint64_t used;
+    uint32_t allocation_count;
+    struct RawVector free_Range;
+};
+
+struct RangeAllocator range_allocator_create(uint64_t size);
+void range_allocator_destroy(struct RangeAllocator *allocator);
+
+bool range_allocator_alloc(struct RangeAllocator *allocator, uint64_t size, uint64_t alignment, uint64_t *offset);
+void range_allocator_free(struct RangeAllocator *allocator, uint64_t offset, uint64_t size);
+
+uint64_t range_allocator_largest_free(struct RangeAllocator *allocator);
+size_t range_allocator_free_range_count(struct RangeAllocator *allocator);
@@ -19,5 +19,7 @@ size_t raw_vector_size(struct RawVector *vector);
 void raw_vector_set(struct RawVector *vector, size_t index, void *value);
 void raw_vector_push_back(struct RawVector *vector, void *value);
 void raw_vector_extend_back(struct RawVector *vector, void *value, size_t n);
+void raw_vector_insert(struct RawVector *vector, size_t index, void *value);
+void raw_vector_erase(struct RawVector *vector, size_t index);
 void raw_vector_pop_back(struct RawVector *vector);
 void raw_vector_clear(struct RawVector *vector);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+
+double stats_mean(const double *samples, size_t count);
+double stats_max(const double *samples, size_t count);
+double stats_percentile(double *samples, size_t count, double percentile);
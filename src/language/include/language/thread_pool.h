@@ -0,0 +1,50 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// A job is a function and an argument. The function is also told the
+// index of the worker running it, in [0, thread_count), so callers can
+// keep per-worker state (scratch memory, command pools, ...) without locks.
+//
+struct ThreadPoolJob {
+    void (*fn)(void *arg, uint32_t worker_index);
+    void *arg;
+};
+
+struct ThreadPoolWorker {
+    struct ThreadPool *pool;
+    uint32_t index;
+};
+
+//
+// A fixed set of worker threads pulling jobs from a FIFO ring.
+// The pool holds a mutex, so it must not be copied after thread_pool_init.
+//
+struct ThreadPool {
+    pthread_t *threads;
+    struct ThreadPoolWorker *workers;
+    uint32_t thread_count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_available;
+    pthread_cond_t work_done;
+
+    struct ThreadPoolJob *jobs;
+    size_t job_capacity;
+    size_t job_head;
+    size_t job_count;
+
+    uint32_t jobs_running;
+    bool shutting_down;
+};
+
+uint32_t thread_pool_default_thread_count();
+void thread_pool_init(struct ThreadPool *pool, uint32_t thread_count);
+void thread_pool_submit(struct ThreadPool *pool, void (*fn)(void *arg, uint32_t worker_index), void *arg);
+size_t thread_pool_pending(struct ThreadPool *pool);
+void thread_pool_wait_idle(struct ThreadPool *pool);
+void thread_pool_destroy(struct ThreadPool *pool);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// A byte codec for grids of tile IDs, which are mostly runs of one ID (empty
+// stretches of sparse layers) or small IDs. The stream is a sequence of
+// tokens, each a varint header (count << 1 | is_run). A run is followed by
+// one varint value repeated count times, a literal by count varint values.
+// Values are stored as ID + 1, so UINT32_MAX (an empty tile) takes one byte.
+//
+#define TILE_CODEC_MIN_RUN 3
+
+size_t tile_codec_max_encoded_size(size_t count);
+size_t tile_codec_encode(const uint32_t *tiles, size_t count, uint8_t *out);
+bool tile_codec_decode(const uint8_t *data, size_t size, uint32_t *tiles, size_t count);
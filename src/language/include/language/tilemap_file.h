@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "language/fileops.h"
+
+//
+// A tile map on disk, laid out to be mapped rather than parsed: a header,
+// a table with the offset, size and encoding of every chunk, and the chunk
+// payloads. A payload holds layer_count grids of chunk_size x chunk_size
+// tile IDs, row by row, with TILEMAP_FILE_EMPTY_TILE where a layer has no
+// tile. Raw payloads are stored as is, each on its own
+// TILEMAP_FILE_ALIGNMENT boundary, so they can be used straight from the
+// mapping; RLE payloads are packed back to back, encoded with tile_codec.h.
+// The table is ordered row by row of chunks. layer_modes is not
+// interpreted here.
+//
+#define TILEMAP_FILE_MAGIC      0x50414d54u
+#define TILEMAP_FILE_VERSION    1
+#define TILEMAP_FILE_MAX_LAYERS 4
+#define TILEMAP_FILE_ALIGNMENT  4096
+#define TILEMAP_FILE_EMPTY_TILE UINT32_MAX
+
+#define TILEMAP_FILE_ENCODING_RAW 0
+#define TILEMAP_FILE_ENCODING_RLE 1
+
+struct TilemapFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t chunk_size;
+    uint32_t layer_count;
+    uint32_t chunks_x;
+    uint32_t chunks_y;
+    uint32_t layer_modes[TILEMAP_FILE_MAX_LAYERS];
+    uint64_t table_offset;
+};
+
+struct TilemapFileChunk {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t encoding;
+};
+
+//
+// What tilemap_file_benchmark measured: raw_bytes is the size of every
+// chunk decoded, stored_bytes the size of their payloads, and decode_ns the
+// time spent decoding rounds x raw_bytes.
+//
+struct TilemapFileStats {
+    uint64_t chunk_count;
+    uint64_t raw_bytes;
+    uint64_t stored_bytes;
+    uint32_t rounds;
+    uint64_t decode_ns;
+};
+
+struct TilemapFile {
+    struct MappedFile file;
+    const struct TilemapFileHeader *header;
+    const struct TilemapFileChunk *chunks;
+};
+
+size_t tilemap_file_chunk_tiles(const struct TilemapFileHeader *header);
+bool tilemap_file_write(
+    const char *filename,
+    const struct TilemapFileHeader *header,
+    uint32_t encoding,
+    void (*fill_chunk)(void *user, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles),
+    void *user);
+bool tilemap_file_open(const char *filename, struct TilemapFile *map);
+void tilemap_file_close(struct TilemapFile *map);
+const uint32_t *tilemap_file_chunk(const struct TilemapFile *map, uint32_t chunk_x, uint32_t chunk_y);
+bool tilemap_file_read_chunk(const struct TilemapFile *map, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles);
+struct TilemapFileStats tilemap_file_benchmark(const struct TilemapFile *map, uint32_t rounds);
@@ -0,0 +1,208 @@
+#include "language/asset_pack.h"
+#include <string.h>
+#include "language/hash.h"
+#include "log.h"
+
+#define ASSET_PACK_ALIGN(x) (((x) + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT)
+
+static bool asset_pack_write_at(FILE *file, uint64_t offset, const void *data, size_t size) {
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+}
+
+static int asset_pack_entry_compare(const void *a, const void *b) {
+    uint64_t hash_a = ((const struct AssetPackEntry *)a)->name_hash;
+    uint64_t hash_b = ((const struct AssetPackEntry *)b)->name_hash;
+    return hash_a < hash_b ? -1 : hash_a > hash_b ? 1 : 0;
+}
+
+static uint64_t asset_pack_name_hash(const char *name) {
+    return hash_fnv1a_64(name, strlen(name));
+}
+
+//
+// Packs the count files at paths into filename for build build_id, each
+// looked up by the name at the same index. Files are read one at a time, so only the
+// biggest is ever in memory. The file is padded to a whole number of
+// ASSET_PACK_ALIGNMENT, so every entry, even an empty one, lies inside it.
+// Returns false, removing the partial file, if a file cannot be read, two
+// names hash the same or writing fails.
+//
+bool asset_pack_write(
+    const char *filename, uint64_t build_id, const char *const *names, const char *const *paths, uint32_t count) {
+
+    struct AssetPackEntry *entries = calloc(count > 0 ? count : 1, sizeof(struct AssetPackEntry));
+    if (entries == NULL) {
+        log_fatal("Could not malloc asset pack table\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        entries[i].name_hash = asset_pack_name_hash(names[i]);
+        for (uint32_t j = 0; j < i; j++) {
+            if (entries[j].name_hash == entries[i].name_hash) {
+                log_error("Assets %s and %s cannot both be packed, their names hash the same\n", names[j], names[i]);
+                free(entries);
+                return false;
+            }
+        }
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        log_error("Could not open %s for writing\n", filename);
+        free(entries);
+        return false;
+    }
+
+    struct AssetPackHeader header = {
+        .magic = ASSET_PACK_MAGIC,
+        .version = ASSET_PACK_VERSION,
+        .entry_count = count,
+        .alignment = ASSET_PACK_ALIGNMENT,
+        .table_offset = sizeof(struct AssetPackHeader),
+        .build_id = build_id,
+    };
+    uint64_t end = header.table_offset + (uint64_t)count * sizeof(struct AssetPackEntry);
+
+    bool written = true;
+    for (uint32_t i = 0; written && i < count; i++) {
+        size_t size;
+        uint8_t *data = try_read_binary_file_FREE(paths[i], &size);
+        if (data == NULL) {
+            log_error("Could not read asset %s from %s\n", names[i], paths[i]);
+            written = false;
+            break;
+        }
+        entries[i].offset = ASSET_PACK_ALIGN(end);
+        entries[i].size = size;
+        entries[i].content_hash = hash_fnv1a_64(data, size);
+        written = asset_pack_write_at(file, entries[i].offset, data, size);
+        end = entries[i].offset + size;
+        free(data);
+    }
+
+    //
+    // Lookups binary search the table, so it is written sorted
+    //
+    qsort(entries, count, sizeof(struct AssetPackEntry), asset_pack_entry_compare);
+    uint8_t padding[ASSET_PACK_ALIGNMENT] = { 0 };
+    written = written &&
+        asset_pack_write_at(file, 0, &header, sizeof(header)) &&
+        asset_pack_write_at(file, header.table_offset, entries, count * sizeof(struct AssetPackEntry)) &&
+        asset_pack_write_at(file, end, padding, ASSET_PACK_ALIGN(end) - end);
+    free(entries);
+
+    if (fclose(file) != 0 || !written) {
+        log_error("Could not write %s\n", filename);
+        remove(filename);
+        return false;
+    }
+    return true;
+}
+
+//
+// Maps filename and checks that its header and table describe a well
+// formed pack, without touching any entry. This is the only time the file
+// is opened; entry pages are read from disk when first looked at. Every
+// check is written so that no field of a corrupt file can make it wrap
+// around. Returns false if the file is missing, not a valid pack, or was
+// packed for a build other than build_id.
+//
+bool asset_pack_open(const char *filename, uint64_t build_id, struct AssetPack *pack) {
+    if (!map_file(filename, &pack->file)) {
+        return false;
+    }
+
+    const struct AssetPackHeader *header = (const struct AssetPackHeader *)pack->file.data;
+    if (pack->file.size >= sizeof(*header) && header->magic == ASSET_PACK_MAGIC &&
+        header->version == ASSET_PACK_VERSION && header->build_id != build_id) {
+        log_error("%s was packed for build %016llx, not this one (%016llx)\n",
+            filename, (unsigned long long)header->build_id, (unsigned long long)build_id);
+        unmap_file(&pack->file);
+        return false;
+    }
+    bool valid = pack->file.size >= sizeof(*header) &&
+        header->magic == ASSET_PACK_MAGIC &&
+        header->version == ASSET_PACK_VERSION &&
+        header->alignment == ASSET_PACK_ALIGNMENT &&
+        header->table_offset % sizeof(uint64_t) == 0 &&
+        header->table_offset <= pack->file.size &&
+        (uint64_t)header->entry_count * sizeof(struct AssetPackEntry) <= pack->file.size - header->table_offset;
+
+    if (valid) {
+        pack->header = header;
+        pack->entries = (const struct AssetPackEntry *)(pack->file.data + header->table_offset);
+        for (uint32_t i = 0; valid && i < header->entry_count; i++) {
+            const struct AssetPackEntry *entry = &pack->entries[i];
+            valid = entry->offset % ASSET_PACK_ALIGNMENT == 0 &&
+                entry->offset <= pack->file.size &&
+                entry->size <= pack->file.size - entry->offset &&
+                (i == 0 || pack->entries[i - 1].name_hash < entry->name_hash);
+        }
+    }
+    if (!valid) {
+        log_error("%s is not a valid asset pack\n", filename);
+        unmap_file(&pack->file);
+        return false;
+    }
+    return true;
+}
+
+void asset_pack_close(struct AssetPack *pack) {
+    unmap_file(&pack->file);
+    pack->header = NULL;
+    pack->entries = NULL;
+}
+
+//
+// The table entry of name, or NULL if the pack has no such entry. Safe to
+// call from several threads at once.
+//
+const struct AssetPackEntry *asset_pack_entry(const struct AssetPack *pack, const char *name) {
+    uint64_t name_hash = asset_pack_name_hash(name);
+    uint32_t first = 0;
+    uint32_t last = pack->header->entry_count;
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+        const struct AssetPackEntry *entry = &pack->entries[middle];
+        if (entry->name_hash == name_hash) {
+            return entry;
+        }
+        if (entry->name_hash < name_hash) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return NULL;
+}
+
+//
+// The entry named name, pointing straight into the mapping, with its size
+// in bytes in size, or NULL if the pack has no such entry. Entries start
+// on an ASSET_PACK_ALIGNMENT boundary and stay valid until the pack is
+// closed. Safe to call from several threads at once.
+//
+const uint8_t *asset_pack_find(const struct AssetPack *pack, const char *name, size_t *size) {
+    const struct AssetPackEntry *entry = asset_pack_entry(pack, name);
+    if (entry == NULL) {
+        return NULL;
+    }
+    *size = (size_t)entry->size;
+    return pack->file.data + entry->offset;
+}
+
+//
+// Hashes every entry and checks it against the table. This reads the whole
+// pack, so it is meant for tools rather than startup.
+//
+bool asset_pack_verify(const struct AssetPack *pack) {
+    bool valid = true;
+    for (uint32_t i = 0; i < pack->header->entry_count; i++) {
+        const struct AssetPackEntry *entry = &pack->entries[i];
+        if (hash_fnv1a_64(pack->file.data + entry->offset, (size_t)entry->size) != entry->content_hash) {
+            log_error("Asset %016llx does not match its hash\n", (unsigned long long)entry->name_hash);
+            valid = false;
+        }
+    }
+    return valid;
+}
@@ -0,0 +1,20 @@
+#include <time.h>
+#include "language/clock.h"
+
+//
+// Returns a monotonic timestamp in nanoseconds. Only differences
+// between two timestamps are meaningful.
+//
+uint64_t clock_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+double clock_ns_to_ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+double clock_ns_to_seconds(uint64_t ns) {
+    return (double)ns / 1e9;
+}
@@ -0,0 +1,49 @@
+#include "language/device_score.h"
+
+//
+// Returns a positive number if a is the better device, a negative one if b
+// is, and 0 if they are indistinguishable.
+//
+int device_score_compare(const struct DeviceScore *a, const struct DeviceScore *b) {
+    if (a->type_rank != b->type_rank) {
+        return a->type_rank > b->type_rank ? 1 : -1;
+    }
+    if (a->copy_gb_per_s > 0.0 && b->copy_gb_per_s > 0.0 && a->copy_gb_per_s != b->copy_gb_per_s) {
+        return a->copy_gb_per_s > b->copy_gb_per_s ? 1 : -1;
+    }
+    if (a->device_local_bytes != b->device_local_bytes) {
+        return a->device_local_bytes > b->device_local_bytes ? 1 : -1;
+    }
+    if (a->max_image_dimension_2d != b->max_image_dimension_2d) {
+        return a->max_image_dimension_2d > b->max_image_dimension_2d ? 1 : -1;
+    }
+    return 0;
+}
+
+static int hex_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+//
+// Parses a UUID written as 32 hex digits, with or without dashes.
+//
+bool device_uuid_parse(const char *text, uint8_t uuid[DEVICE_UUID_SIZE]) {
+    uint32_t digits = 0;
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '-') continue;
+        int value = hex_digit_value(*c);
+        if (value < 0 || digits == DEVICE_UUID_SIZE * 2) {
+            return false;
+        }
+        if (digits % 2 == 0) {
+            uuid[digits / 2] = (uint8_t)(value << 4);
+        } else {
+            uuid[digits / 2] |= (uint8_t)value;
+        }
+        digits++;
+    }
+    return digits == DEVICE_UUID_SIZE * 2;
+}
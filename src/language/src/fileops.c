@@ -1,7 +1,13 @@
 #include "language/fileops.h"
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "log.h"
 
+#define FILEOPS_TMP_SUFFIX ".tmp"
+
 //
 // Reads bytes of file filename into a malloc'd buffer
 // and returns it.
@@ -27,6 +33,143 @@ uint8_t *read_binary_file_FREE(const char *filename, size_t *size) {
     }
     fseek(file, 0, SEEK_SET);
     fread(buffer, sizeof(uint8_t), *size, file);
+    fclose(file);
+
+    return buffer;
+}
+
+//
+// Reads the whole of file filename into a malloc'd buffer and returns it,
+// or returns NULL if the file does not exist or cannot be read. Unlike
+// read_binary_file_FREE the size is not rounded to a multiple of 4.
+//
+uint8_t *try_read_binary_file_FREE(const char *filename, size_t *size) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    if (length < 0) {
+        fclose(file);
+        return NULL;
+    }
+    *size = (size_t)length;
+
+    uint8_t *buffer = malloc(*size > 0 ? *size : 1);
+    if (buffer == NULL) {
+        log_fatal("Could not malloc buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+    fseek(file, 0, SEEK_SET);
+    if (fread(buffer, sizeof(uint8_t), *size, file) != *size) {
+        log_error("Could not read all of %s\n", filename);
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
 
     return buffer;
-}
\ No newline at end of file
+}
+
+//
+// Writes size bytes of data to filename so that readers only ever see the
+// old or the new contents: the data goes to a temporary file next to it,
+// which is flushed to disk and then renamed over filename. Returns false
+// (leaving filename untouched) if any step fails.
+//
+bool write_binary_file_atomic(const char *filename, const uint8_t *data, size_t size) {
+    size_t tmp_length = strlen(filename) + sizeof(FILEOPS_TMP_SUFFIX);
+    char tmp_filename[tmp_length];
+    snprintf(tmp_filename, tmp_length, "%s%s", filename, FILEOPS_TMP_SUFFIX);
+
+    FILE *file = fopen(tmp_filename, "wb");
+    if (file == NULL) {
+        log_error("Could not open %s for writing\n", tmp_filename);
+        return false;
+    }
+    bool written = fwrite(data, sizeof(uint8_t), size, file) == size;
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written) {
+        log_error("Could not write %s\n", tmp_filename);
+        remove(tmp_filename);
+        return false;
+    }
+
+    if (rename(tmp_filename, filename) != 0) {
+        log_error("Could not rename %s to %s\n", tmp_filename, filename);
+        remove(tmp_filename);
+        return false;
+    }
+    return true;
+}
+
+//
+// Maps the whole of filename read-only. Returns false if it does not exist
+// or cannot be mapped. An empty file maps to data NULL and size 0. The
+// mapping outlives the descriptor, so nothing but the mapping is held open.
+//
+bool map_file(const char *filename, struct MappedFile *file) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    file->size = (size_t)st.st_size;
+    file->data = NULL;
+    if (file->size > 0) {
+        void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            log_error("Could not map %s\n", filename);
+            close(fd);
+            return false;
+        }
+        file->data = data;
+    }
+    close(fd);
+    return true;
+}
+
+//
+// Writes to path the path of filename in the directory of the running
+// executable, so files installed next to it are found whatever the working
+// directory. Absolute filenames are copied as they are. Returns false, with
+// filename copied, if the executable cannot be found or path_size is too
+// small.
+//
+bool executable_relative_path(const char *filename, char *path, size_t path_size) {
+    size_t filename_length = strlen(filename);
+    if (path_size <= filename_length) {
+        log_error("No room for the path of %s\n", filename);
+        return false;
+    }
+    memcpy(path, filename, filename_length + 1);
+    if (filename[0] == '/') {
+        return true;
+    }
+
+    ssize_t length = readlink("/proc/self/exe", path, path_size - 1);
+    while (length > 0 && path[length - 1] != '/') {
+        length--;
+    }
+    if (length <= 0 || (size_t)length + filename_length >= path_size) {
+        memcpy(path, filename, filename_length + 1);
+        return false;
+    }
+    memcpy(path + length, filename, filename_length + 1);
+    return true;
+}
+
+void unmap_file(struct MappedFile *file) {
+    if (file->data != NULL) {
+        munmap((void *)file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
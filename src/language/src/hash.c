@@ -0,0 +1,23 @@
+#include "language/hash.h"
+
+#define HASH_FNV1A_64_PRIME 0x100000001b3ull
+
+//
+// Returns the 64-bit FNV-1a hash of size bytes of data.
+//
+uint64_t hash_fnv1a_64(const void *data, size_t size) {
+    return hash_fnv1a_64_extend(HASH_FNV1A_64_SEED, data, size);
+}
+
+//
+// Continues hash over size more bytes of data, so a hash can be built up
+// from several pieces without first copying them together.
+//
+uint64_t hash_fnv1a_64_extend(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_FNV1A_64_PRIME;
+    }
+    return hash;
+}
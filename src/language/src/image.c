@@ -0,0 +1,98 @@
+#include "language/image.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+
+//
+// Reads the next whitespace separated decimal field of a PPM header,
+// skipping '#' comments. Returns false at the end of data or on anything
+// which is not a digit.
+//
+static bool ppm_read_field(const uint8_t *data, size_t size, size_t *cursor, uint32_t *value) {
+    while (*cursor < size) {
+        if (data[*cursor] == '#') {
+            while (*cursor < size && data[*cursor] != '\n') {
+                (*cursor)++;
+            }
+        } else if (isspace(data[*cursor])) {
+            (*cursor)++;
+        } else {
+            break;
+        }
+    }
+    if (*cursor >= size || !isdigit(data[*cursor])) {
+        return false;
+    }
+
+    uint64_t parsed = 0;
+    while (*cursor < size && isdigit(data[*cursor])) {
+        parsed = parsed * 10 + (data[*cursor] - '0');
+        if (parsed > UINT32_MAX) {
+            return false;
+        }
+        (*cursor)++;
+    }
+    *value = (uint32_t)parsed;
+    return true;
+}
+
+uint8_t *image_decode_ppm_FREE(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height) {
+    if (size < 2 || data[0] != 'P' || data[1] != '6') {
+        return NULL;
+    }
+
+    size_t cursor = 2;
+    uint32_t max_value;
+    if (!ppm_read_field(data, size, &cursor, width)
+        || !ppm_read_field(data, size, &cursor, height)
+        || !ppm_read_field(data, size, &cursor, &max_value)) {
+        return NULL;
+    }
+    if (*width == 0 || *height == 0 || max_value != 255) {
+        return NULL;
+    }
+
+    //
+    // Exactly one whitespace character separates the header from the pixels
+    //
+    if (cursor >= size || !isspace(data[cursor])) {
+        return NULL;
+    }
+    cursor++;
+
+    size_t pixel_count = (size_t)*width * *height;
+    if ((size - cursor) / 3 < pixel_count) {
+        return NULL;
+    }
+
+    uint8_t *pixels = malloc(pixel_count * IMAGE_RGBA8_PIXEL_SIZE);
+    if (pixels == NULL) {
+        log_fatal("Could not malloc image pixels\n");
+        exit(EXIT_FAILURE);
+    }
+    const uint8_t *rgb = data + cursor;
+    for (size_t i = 0; i < pixel_count; i++) {
+        pixels[i * 4 + 0] = rgb[i * 3 + 0];
+        pixels[i * 4 + 1] = rgb[i * 3 + 1];
+        pixels[i * 4 + 2] = rgb[i * 3 + 2];
+        pixels[i * 4 + 3] = 255;
+    }
+    return pixels;
+}
+
+void image_copy_rgba8_region(
+    const uint8_t *src,
+    uint32_t src_width,
+    uint32_t x,
+    uint32_t y,
+    uint32_t width,
+    uint32_t height,
+    uint8_t *dst) {
+
+    size_t row_size = (size_t)width * IMAGE_RGBA8_PIXEL_SIZE;
+    for (uint32_t row = 0; row < height; row++) {
+        const uint8_t *src_row = src + ((size_t)(y + row) * src_width + x) * IMAGE_RGBA8_PIXEL_SIZE;
+        memcpy(dst + row * row_size, src_row, row_size);
+    }
+}
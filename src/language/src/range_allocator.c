@@ -0,0 +1,117 @@
+#include "language/range_allocator.h"
+
+struct RangeAllocator range_allocator_create(uint64_t size) {
+    struct RangeAllocator allocator = {
+        .size = size,
+        .used = 0,
+        .allocation_count = 0,
+        .free_Range = raw_vector_create(sizeof(struct Range), 16),
+    };
+    struct Range everything = { .offset = 0, .size = size };
+    raw_vector_push_back(&allocator.free_Range, &everything);
+    return allocator;
+}
+
+void range_allocator_destroy(struct RangeAllocator *allocator) {
+    raw_vector_destroy(&allocator->free_Range);
+}
+
+//
+// Finds the first free range which can hold size bytes starting at a multiple
+// of alignment (which must be a power of two) and carves them out of it. Any
+// padding skipped to reach alignment stays free. Returns false if no free
+// range is large enough.
+//
+bool range_allocator_alloc(struct RangeAllocator *allocator, uint64_t size, uint64_t alignment, uint64_t *offset) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment == 0) {
+        alignment = 1;
+    }
+
+    for (size_t i = 0; i < raw_vector_size(&allocator->free_Range); i++) {
+        struct Range range = *(struct Range *)raw_vector_get_ptr(&allocator->free_Range, i);
+
+        uint64_t aligned = (range.offset + alignment - 1) & ~(alignment - 1);
+        uint64_t padding = aligned - range.offset;
+        if (padding > range.size || range.size - padding < size) {
+            continue;
+        }
+
+        struct Range before = { .offset = range.offset, .size = padding };
+        struct Range after = { .offset = aligned + size, .size = range.size - padding - size };
+
+        raw_vector_erase(&allocator->free_Range, i);
+        if (after.size > 0) {
+            raw_vector_insert(&allocator->free_Range, i, &after);
+        }
+        if (before.size > 0) {
+            raw_vector_insert(&allocator->free_Range, i, &before);
+        }
+
+        allocator->used += size;
+        allocator->allocation_count += 1;
+        *offset = aligned;
+        return true;
+    }
+
+    return false;
+}
+
+//
+// Returns [offset, offset + size) to the free list, merging it with the
+// free ranges on either side. size must be the size it was allocated with.
+//
+void range_allocator_free(struct RangeAllocator *allocator, uint64_t offset, uint64_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+
+    //
+    // Free ranges are sorted, so find the first one after the freed range
+    //
+    size_t count = raw_vector_size(&allocator->free_Range);
+    size_t index = 0;
+    while (index < count && ((struct Range *)raw_vector_get_ptr(&allocator->free_Range, index))->offset < offset) {
+        index++;
+    }
+
+    struct Range freed = { .offset = offset, .size = size };
+
+    if (index < count) {
+        struct Range *next = (struct Range *)raw_vector_get_ptr(&allocator->free_Range, index);
+        if (freed.offset + freed.size == next->offset) {
+            freed.size += next->size;
+            raw_vector_erase(&allocator->free_Range, index);
+        }
+    }
+    if (index > 0) {
+        struct Range *previous = (struct Range *)raw_vector_get_ptr(&allocator->free_Range, index - 1);
+        if (previous->offset + previous->size == freed.offset) {
+            previous->size += freed.size;
+            freed.size = 0;
+        }
+    }
+    if (freed.size > 0) {
+        raw_vector_insert(&allocator->free_Range, index, &freed);
+    }
+
+    allocator->used -= size;
+    allocator->allocation_count -= 1;
+}
+
+uint64_t range_allocator_largest_free(struct RangeAllocator *allocator) {
+    uint64_t largest = 0;
+    for (size_t i = 0; i < raw_vector_size(&allocator->free_Range); i++) {
+        struct Range *range = (struct Range *)raw_vector_get_ptr(&allocator->free_Range, i);
+        if (range->size > largest) {
+            largest = range->size;
+        }
+    }
+    return largest;
+}
+
+size_t range_allocator_free_range_count(struct RangeAllocator *allocator) {
+    return raw_vector_size(&allocator->free_Range);
+}
@@ -114,6 +114,52 @@ void raw_vector_extend_back(struct RawVector *vector, void *value, size_t n) {
     vector->count_in_elements += n;
 }
 
+//
+// Inserts value before the element at index, shifting the elements after it
+// back by one. index may equal the size of the vector to append.
+//
+void raw_vector_insert(struct RawVector *vector, size_t index, void *value) {
+    if (vector->data == NULL) {
+        log_fatal("Cannot insert on destroyed vector\n");
+        exit(EXIT_FAILURE);
+    }
+    if (index > vector->count_in_elements) {
+        log_fatal("Attempted to insert into raw_vector past its end.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t desired_size = (vector->count_in_elements + 1) * vector->element_size_in_bytes;
+    if (desired_size > vector->data_size_in_bytes) {
+        resize(vector, vector->data_size_in_bytes * 2);
+    }
+    size_t element_size = vector->element_size_in_bytes;
+    memmove(
+        vector->data + (index + 1) * element_size,
+        vector->data + index * element_size,
+        (vector->count_in_elements - index) * element_size);
+    memcpy(vector->data + index * element_size, value, element_size);
+    vector->count_in_elements += 1;
+}
+
+//
+// Removes the element at index, shifting the elements after it forward by one.
+//
+void raw_vector_erase(struct RawVector *vector, size_t index) {
+    if (vector->data == NULL) {
+        log_fatal("Cannot erase on destroyed vector\n");
+        exit(EXIT_FAILURE);
+    }
+    if (index >= vector->count_in_elements) {
+        log_fatal("Attempted to erase index of raw_vector greater than its count.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t element_size = vector->element_size_in_bytes;
+    memmove(
+        vector->data + index * element_size,
+        vector->data + (index + 1) * element_size,
+        (vector->count_in_elements - index - 1) * element_size);
+    vector->count_in_elements -= 1;
+}
+
 //
 // Pops the back element of the vector.
 //
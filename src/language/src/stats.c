@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include "language/stats.h"
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+//
+// Returns the arithmetic mean of the samples, or 0 if there are none.
+//
+double stats_mean(const double *samples, size_t count) {
+    if (count == 0) return 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    return sum / count;
+}
+
+//
+// Returns the largest sample, or 0 if there are none.
+//
+double stats_max(const double *samples, size_t count) {
+    double max = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || samples[i] > max) max = samples[i];
+    }
+    return max;
+}
+
+//
+// Returns the nearest-rank percentile (0 to 100) of the samples.
+// WARNING: sorts the samples in place.
+//
+double stats_percentile(double *samples, size_t count, double percentile) {
+    if (count == 0) return 0.0;
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    size_t rank = (size_t)(percentile / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return samples[rank - 1];
+}
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include "language/thread_pool.h"
+#include "log.h"
+
+//
+// Returns the number of online cores, which is the number of
+// workers a CPU bound pool should usually have.
+//
+uint32_t thread_pool_default_thread_count() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (uint32_t)cores : 1;
+}
+
+//
+// Worker thread body. Pops jobs until the pool is shut down and
+// the queue has been drained.
+//
+static void *thread_pool_worker_main(void *arg) {
+    struct ThreadPoolWorker *worker = arg;
+    struct ThreadPool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->job_count == 0 && !pool->shutting_down) {
+            pthread_cond_wait(&pool->work_available, &pool->mutex);
+        }
+        if (pool->job_count == 0 && pool->shutting_down) {
+            break;
+        }
+
+        struct ThreadPoolJob job = pool->jobs[pool->job_head];
+        pool->job_head = (pool->job_head + 1) % pool->job_capacity;
+        pool->job_count--;
+        pool->jobs_running++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        job.fn(job.arg, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->jobs_running--;
+        if (pool->job_count == 0 && pool->jobs_running == 0) {
+            pthread_cond_broadcast(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+//
+// Starts thread_count workers. Passing 0 uses one worker per core.
+//
+void thread_pool_init(struct ThreadPool *pool, uint32_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = thread_pool_default_thread_count();
+    }
+
+    pool->thread_count = thread_count;
+    pool->job_capacity = 64;
+    pool->job_head = 0;
+    pool->job_count = 0;
+    pool->jobs_running = 0;
+    pool->shutting_down = false;
+    pool->jobs = malloc(sizeof(struct ThreadPoolJob) * pool->job_capacity);
+    pool->threads = malloc(sizeof(pthread_t) * thread_count);
+    pool->workers = malloc(sizeof(struct ThreadPoolWorker) * thread_count);
+    if (pool->jobs == NULL || pool->threads == NULL || pool->workers == NULL) {
+        log_fatal("Could not malloc thread pool\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+        pool->workers[i] = (struct ThreadPoolWorker) { .pool = pool, .index = i };
+        if (pthread_create(&pool->threads[i], NULL, thread_pool_worker_main, &pool->workers[i]) != 0) {
+            log_fatal("Could not create thread pool worker %u\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    log_trace("Started thread pool with %u workers\n", thread_count);
+}
+
+//
+// Queues fn(arg, worker_index) to run on some worker. The ring of
+// queued jobs doubles in size whenever it fills up.
+//
+void thread_pool_submit(struct ThreadPool *pool, void (*fn)(void *arg, uint32_t worker_index), void *arg) {
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->job_count == pool->job_capacity) {
+        size_t new_capacity = pool->job_capacity * 2;
+        struct ThreadPoolJob *new_jobs = malloc(sizeof(struct ThreadPoolJob) * new_capacity);
+        if (new_jobs == NULL) {
+            log_fatal("Could not grow thread pool job queue\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < pool->job_count; i++) {
+            new_jobs[i] = pool->jobs[(pool->job_head + i) % pool->job_capacity];
+        }
+        free(pool->jobs);
+        pool->jobs = new_jobs;
+        pool->job_capacity = new_capacity;
+        pool->job_head = 0;
+    }
+
+    pool->jobs[(pool->job_head + pool->job_count) % pool->job_capacity] = (struct ThreadPoolJob) {
+        .fn = fn,
+        .arg = arg,
+    };
+    pool->job_count++;
+
+    pthread_cond_signal(&pool->work_available);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+//
+// Returns the number of jobs queued or running.
+//
+size_t thread_pool_pending(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    size_t pending = pool->job_count + pool->jobs_running;
+    pthread_mutex_unlock(&pool->mutex);
+    return pending;
+}
+
+//
+// Blocks until every submitted job has finished.
+//
+void thread_pool_wait_idle(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->job_count > 0 || pool->jobs_running > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+//
+// Finishes all queued jobs, then joins and frees the workers.
+//
+void thread_pool_destroy(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (uint32_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->jobs);
+    free(pool->threads);
+    free(pool->workers);
+    pool->jobs = NULL;
+    pool->threads = NULL;
+    pool->workers = NULL;
+}
@@ -0,0 +1,119 @@
+#include "language/tile_codec.h"
+
+#define TILE_CODEC_VARINT_MAX 5
+
+static uint8_t *tile_codec_put_varint(uint8_t *out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+//
+// Reads one varint at *data, advancing it. Returns false if the varint runs
+// past end or is longer than a uint32_t.
+//
+static bool tile_codec_get_varint(const uint8_t **data, const uint8_t *end, uint32_t *value) {
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < TILE_CODEC_VARINT_MAX; i++) {
+        if (*data == end) {
+            return false;
+        }
+        uint8_t byte = *(*data)++;
+        result |= (uint32_t)(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// The most bytes count tiles can encode to: every tile a one tile literal.
+//
+size_t tile_codec_max_encoded_size(size_t count) {
+    return count * 2 * TILE_CODEC_VARINT_MAX;
+}
+
+static size_t tile_codec_run_length(const uint32_t *tiles, size_t count, size_t start) {
+    size_t end = start + 1;
+    while (end < count && tiles[end] == tiles[start]) {
+        end++;
+    }
+    return end - start;
+}
+
+//
+// Encodes count tiles into out, which must hold
+// tile_codec_max_encoded_size(count) bytes. Runs of at least
+// TILE_CODEC_MIN_RUN equal tiles become run tokens, everything between
+// them literals. Returns the number of bytes written.
+//
+size_t tile_codec_encode(const uint32_t *tiles, size_t count, uint8_t *out) {
+    uint8_t *start = out;
+    size_t i = 0;
+    while (i < count) {
+        size_t run = tile_codec_run_length(tiles, count, i);
+        if (run >= TILE_CODEC_MIN_RUN) {
+            out = tile_codec_put_varint(out, (uint32_t)(run << 1 | 1));
+            out = tile_codec_put_varint(out, tiles[i] + 1);
+            i += run;
+            continue;
+        }
+
+        size_t literal_end = i + run;
+        while (literal_end < count) {
+            size_t next = tile_codec_run_length(tiles, count, literal_end);
+            if (next >= TILE_CODEC_MIN_RUN) {
+                break;
+            }
+            literal_end += next;
+        }
+        out = tile_codec_put_varint(out, (uint32_t)((literal_end - i) << 1));
+        for (; i < literal_end; i++) {
+            out = tile_codec_put_varint(out, tiles[i] + 1);
+        }
+    }
+    return (size_t)(out - start);
+}
+
+//
+// Decodes size bytes of data into exactly count tiles. Returns false if
+// the data is malformed or does not decode to count tiles.
+//
+bool tile_codec_decode(const uint8_t *data, size_t size, uint32_t *tiles, size_t count) {
+    const uint8_t *end = data + size;
+    size_t i = 0;
+    while (data < end) {
+        uint32_t header;
+        if (!tile_codec_get_varint(&data, end, &header)) {
+            return false;
+        }
+        size_t token_count = header >> 1;
+        if (token_count > count - i) {
+            return false;
+        }
+
+        if (header & 1) {
+            uint32_t value;
+            if (!tile_codec_get_varint(&data, end, &value)) {
+                return false;
+            }
+            for (size_t j = 0; j < token_count; j++) {
+                tiles[i++] = value - 1;
+            }
+        } else {
+            for (size_t j = 0; j < token_count; j++) {
+                uint32_t value;
+                if (!tile_codec_get_varint(&data, end, &value)) {
+                    return false;
+                }
+                tiles[i++] = value - 1;
+            }
+        }
+    }
+    return i == count;
+}
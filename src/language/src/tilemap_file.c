@@ -0,0 +1,261 @@
+#include "language/tilemap_file.h"
+#include <string.h>
+#include <sys/mman.h>
+#include "language/clock.h"
+#include "language/tile_codec.h"
+#include "log.h"
+
+#define TILEMAP_FILE_ALIGN(x) (((x) + TILEMAP_FILE_ALIGNMENT - 1) / TILEMAP_FILE_ALIGNMENT * TILEMAP_FILE_ALIGNMENT)
+
+//
+// Tile IDs in one chunk's payload, over all of its layers.
+//
+size_t tilemap_file_chunk_tiles(const struct TilemapFileHeader *header) {
+    return (size_t)header->chunk_size * header->chunk_size * header->layer_count;
+}
+
+//
+// Whether header has a chunk size and a supported layer count, and one raw
+// chunk payload fits in the uint32_t size of a chunk table entry. The
+// chunk size is bounded before multiplying, so nothing can wrap.
+//
+static bool tilemap_file_chunk_shape_valid(const struct TilemapFileHeader *header) {
+    return header->chunk_size > 0 && header->chunk_size <= UINT16_MAX &&
+        header->layer_count > 0 && header->layer_count <= TILEMAP_FILE_MAX_LAYERS &&
+        (uint64_t)header->chunk_size * header->chunk_size * header->layer_count * sizeof(uint32_t) <= UINT32_MAX;
+}
+
+static bool tilemap_file_write_at(FILE *file, uint64_t offset, const void *data, size_t size) {
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+}
+
+//
+// Writes a map of header's width, height, chunk_size, layer_count and
+// layer_modes to filename, filling in the rest of the header. Chunks are
+// produced one at a time by fill_chunk, which is handed the chunk's tiles
+// all set to TILEMAP_FILE_EMPTY_TILE, so the whole map is never in memory,
+// and stored with encoding. Returns false, removing the partial file, if
+// anything fails.
+//
+bool tilemap_file_write(
+    const char *filename,
+    const struct TilemapFileHeader *header,
+    uint32_t encoding,
+    void (*fill_chunk)(void *user, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles),
+    void *user) {
+
+    if (!tilemap_file_chunk_shape_valid(header)) {
+        log_error("Tilemap %s needs 1 to %u layers and a chunk size whose payload fits in 4 GiB\n",
+            filename, TILEMAP_FILE_MAX_LAYERS);
+        return false;
+    }
+    if (encoding != TILEMAP_FILE_ENCODING_RAW && encoding != TILEMAP_FILE_ENCODING_RLE) {
+        log_error("Unknown tilemap encoding %u\n", encoding);
+        return false;
+    }
+
+    struct TilemapFileHeader out = *header;
+    out.magic = TILEMAP_FILE_MAGIC;
+    out.version = TILEMAP_FILE_VERSION;
+    out.chunks_x = (header->width + header->chunk_size - 1) / header->chunk_size;
+    out.chunks_y = (header->height + header->chunk_size - 1) / header->chunk_size;
+    out.table_offset = sizeof(struct TilemapFileHeader);
+
+    uint64_t chunk_count = (uint64_t)out.chunks_x * out.chunks_y;
+    size_t chunk_tiles = tilemap_file_chunk_tiles(&out);
+    uint32_t payload_size = (uint32_t)(chunk_tiles * sizeof(uint32_t));
+    uint64_t payload_offset = out.table_offset + chunk_count * sizeof(struct TilemapFileChunk);
+    if (encoding == TILEMAP_FILE_ENCODING_RAW) {
+        payload_offset = TILEMAP_FILE_ALIGN(payload_offset);
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        log_error("Could not open %s for writing\n", filename);
+        return false;
+    }
+    uint32_t *tiles = malloc(payload_size);
+    uint8_t *encoded = malloc(tile_codec_max_encoded_size(chunk_tiles));
+    if (tiles == NULL || encoded == NULL) {
+        log_fatal("Could not malloc tilemap chunk\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool written = tilemap_file_write_at(file, 0, &out, sizeof(out));
+    for (uint32_t chunk_y = 0; written && chunk_y < out.chunks_y; chunk_y++) {
+        for (uint32_t chunk_x = 0; written && chunk_x < out.chunks_x; chunk_x++) {
+            for (size_t i = 0; i < chunk_tiles; i++) {
+                tiles[i] = TILEMAP_FILE_EMPTY_TILE;
+            }
+            fill_chunk(user, chunk_x, chunk_y, tiles);
+
+            struct TilemapFileChunk entry = {
+                .offset = payload_offset,
+                .size = payload_size,
+                .encoding = encoding,
+            };
+            const void *payload = tiles;
+            if (encoding == TILEMAP_FILE_ENCODING_RLE) {
+                size_t encoded_size = tile_codec_encode(tiles, chunk_tiles, encoded);
+                if (encoded_size > UINT32_MAX) {
+                    log_error("Tilemap %s chunk (%u, %u) encodes to more than 4 GiB\n", filename, chunk_x, chunk_y);
+                    written = false;
+                    break;
+                }
+                entry.size = (uint32_t)encoded_size;
+                payload = encoded;
+            }
+            uint64_t index = (uint64_t)chunk_y * out.chunks_x + chunk_x;
+            written = tilemap_file_write_at(file, payload_offset, payload, entry.size) &&
+                tilemap_file_write_at(file, out.table_offset + index * sizeof(entry), &entry, sizeof(entry));
+            payload_offset += entry.size;
+            if (encoding == TILEMAP_FILE_ENCODING_RAW) {
+                payload_offset = TILEMAP_FILE_ALIGN(payload_offset);
+            }
+        }
+    }
+    free(tiles);
+    free(encoded);
+
+    if (fclose(file) != 0 || !written) {
+        log_error("Could not write %s\n", filename);
+        remove(filename);
+        return false;
+    }
+    return true;
+}
+
+//
+// Maps filename and checks that its header and chunk table describe a
+// well formed map, without touching any payload. Payload pages are only
+// read from disk when a chunk is first looked at. Every check is written
+// so that no field of a corrupt file can make it wrap around. Returns
+// false if the file is missing or not a valid map.
+//
+bool tilemap_file_open(const char *filename, struct TilemapFile *map) {
+    if (!map_file(filename, &map->file)) {
+        return false;
+    }
+
+    const struct TilemapFileHeader *header = (const struct TilemapFileHeader *)map->file.data;
+    uint64_t size = map->file.size;
+    bool valid = size >= sizeof(*header) &&
+        header->magic == TILEMAP_FILE_MAGIC &&
+        header->version == TILEMAP_FILE_VERSION &&
+        tilemap_file_chunk_shape_valid(header) &&
+        header->chunks_x == ((uint64_t)header->width + header->chunk_size - 1) / header->chunk_size &&
+        header->chunks_y == ((uint64_t)header->height + header->chunk_size - 1) / header->chunk_size &&
+        header->table_offset % sizeof(uint64_t) == 0 &&
+        header->table_offset <= size;
+
+    //
+    // chunks_x * chunks_y cannot overflow 64 bits, but the table size can,
+    // so the count is checked against the room left instead
+    //
+    uint64_t chunk_count = valid ? (uint64_t)header->chunks_x * header->chunks_y : 0;
+    valid = valid && chunk_count <= (size - header->table_offset) / sizeof(struct TilemapFileChunk);
+
+    if (valid) {
+        map->header = header;
+        map->chunks = (const struct TilemapFileChunk *)(map->file.data + header->table_offset);
+        size_t raw_size = tilemap_file_chunk_tiles(header) * sizeof(uint32_t);
+        for (uint64_t i = 0; valid && i < chunk_count; i++) {
+            const struct TilemapFileChunk *chunk = &map->chunks[i];
+            bool raw = chunk->encoding == TILEMAP_FILE_ENCODING_RAW;
+            valid = chunk->offset <= size && chunk->size <= size - chunk->offset &&
+                (raw ? chunk->offset % sizeof(uint32_t) == 0 && chunk->size == raw_size
+                     : chunk->encoding == TILEMAP_FILE_ENCODING_RLE);
+        }
+    }
+    if (!valid) {
+        log_error("%s is not a valid tilemap\n", filename);
+        unmap_file(&map->file);
+        return false;
+    }
+
+    //
+    // Chunks are looked at in whatever order the camera wants them, so
+    // reading ahead of the page that faulted is mostly wasted
+    //
+    madvise((void *)map->file.data, map->file.size, MADV_RANDOM);
+    return true;
+}
+
+void tilemap_file_close(struct TilemapFile *map) {
+    unmap_file(&map->file);
+    map->header = NULL;
+    map->chunks = NULL;
+}
+
+//
+// The tiles of chunk (chunk_x, chunk_y), pointing straight into the
+// mapping, or NULL if the chunk is outside the map or its payload is not
+// stored raw.
+//
+const uint32_t *tilemap_file_chunk(const struct TilemapFile *map, uint32_t chunk_x, uint32_t chunk_y) {
+    if (chunk_x >= map->header->chunks_x || chunk_y >= map->header->chunks_y) {
+        return NULL;
+    }
+    const struct TilemapFileChunk *chunk = &map->chunks[(uint64_t)chunk_y * map->header->chunks_x + chunk_x];
+    if (chunk->encoding != TILEMAP_FILE_ENCODING_RAW) {
+        return NULL;
+    }
+    return (const uint32_t *)(map->file.data + chunk->offset);
+}
+
+//
+// Decodes chunk (chunk_x, chunk_y) into tiles, which must hold
+// tilemap_file_chunk_tiles of them. Safe to call from several threads at
+// once. Returns false if the chunk is outside the map or its payload is
+// corrupt.
+//
+bool tilemap_file_read_chunk(const struct TilemapFile *map, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles) {
+    if (chunk_x >= map->header->chunks_x || chunk_y >= map->header->chunks_y) {
+        return false;
+    }
+    const struct TilemapFileChunk *chunk = &map->chunks[(uint64_t)chunk_y * map->header->chunks_x + chunk_x];
+    const uint8_t *payload = map->file.data + chunk->offset;
+    size_t chunk_tiles = tilemap_file_chunk_tiles(map->header);
+    if (chunk->encoding == TILEMAP_FILE_ENCODING_RAW) {
+        memcpy(tiles, payload, chunk_tiles * sizeof(uint32_t));
+        return true;
+    }
+    return tile_codec_decode(payload, chunk->size, tiles, chunk_tiles);
+}
+
+//
+// Decodes every chunk of map rounds times, the first round paging the
+// payloads in, and reports how much smaller they are stored and how long
+// decoding took. Corrupt chunks are skipped.
+//
+struct TilemapFileStats tilemap_file_benchmark(const struct TilemapFile *map, uint32_t rounds) {
+    size_t chunk_tiles = tilemap_file_chunk_tiles(map->header);
+    uint32_t *tiles = malloc(chunk_tiles * sizeof(uint32_t));
+    if (tiles == NULL) {
+        log_fatal("Could not malloc tilemap chunk\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct TilemapFileStats stats = {
+        .chunk_count = (uint64_t)map->header->chunks_x * map->header->chunks_y,
+        .rounds = rounds,
+    };
+    for (uint64_t i = 0; i < stats.chunk_count; i++) {
+        stats.raw_bytes += chunk_tiles * sizeof(uint32_t);
+        stats.stored_bytes += map->chunks[i].size;
+    }
+
+    for (uint32_t round = 0; round <= rounds; round++) {
+        uint64_t start_ns = clock_now_ns();
+        for (uint32_t chunk_y = 0; chunk_y < map->header->chunks_y; chunk_y++) {
+            for (uint32_t chunk_x = 0; chunk_x < map->header->chunks_x; chunk_x++) {
+                tilemap_file_read_chunk(map, chunk_x, chunk_y, tiles);
+            }
+        }
+        if (round > 0) {
+            stats.decode_ns += clock_now_ns() - start_ns;
+        }
+    }
+    free(tiles);
+    return stats;
+}
@@ -1,5 +1,15 @@
 #include "unity.h"
+#include "language/asset_pack.h"
+#include "language/device_score.h"
+#include "language/fileops.h"
+#include "language/hash.h"
+#include "language/image.h"
 #include "language/raw_vector.h"
+#include "language/range_allocator.h"
+#include "language/stats.h"
+#include "language/thread_pool.h"
+#include "language/tile_codec.h"
+#include "language/tilemap_file.h"
 #include <stdbool.h>
 
 void setUp() {
@@ -74,9 +84,430 @@ void test_Raw_Vector_Of_Int() {
 void test_Raw_Vector_Of_String() {
 }
 
+void test_Raw_Vector_Insert_Erase() {
+    struct RawVector vec = raw_vector_create(sizeof(uint32_t), 1);
+    uint32_t values[] = {1, 2, 4};
+    raw_vector_extend_back(&vec, values, 3);
+
+    uint32_t x = 3;
+    raw_vector_insert(&vec, 2, &x);
+    x = 0;
+    raw_vector_insert(&vec, 0, &x);
+    x = 5;
+    raw_vector_insert(&vec, 5, &x);
+    uint32_t inserted[] = {0, 1, 2, 3, 4, 5};
+    TEST_ASSERT_EQUAL_MESSAGE(6, raw_vector_size(&vec), "Vector should have 6 elements after 3 inserts");
+    TEST_ASSERT_EQUAL_INT_ARRAY_MESSAGE(inserted, (uint32_t *)vec.data, 6, "Vector should be [0,1,2,3,4,5]");
+
+    raw_vector_erase(&vec, 0);
+    raw_vector_erase(&vec, 2);
+    raw_vector_erase(&vec, 3);
+    uint32_t erased[] = {1, 2, 4};
+    TEST_ASSERT_EQUAL_MESSAGE(3, raw_vector_size(&vec), "Vector should have 3 elements after 3 erases");
+    TEST_ASSERT_EQUAL_INT_ARRAY_MESSAGE(erased, (uint32_t *)vec.data, 3, "Vector should be [1,2,4]");
+
+    raw_vector_destroy(&vec);
+}
+
+void test_Range_Allocator_Alignment_And_Coalescing() {
+    struct RangeAllocator allocator = range_allocator_create(1024);
+    uint64_t a, b, c;
+
+    TEST_ASSERT_TRUE_MESSAGE(range_allocator_alloc(&allocator, 100, 1, &a), "First allocation should fit");
+    TEST_ASSERT_TRUE_MESSAGE(range_allocator_alloc(&allocator, 100, 256, &b), "Aligned allocation should fit");
+    TEST_ASSERT_EQUAL_MESSAGE(0, a, "First allocation should be placed at 0");
+    TEST_ASSERT_EQUAL_MESSAGE(256, b, "Aligned allocation should be placed at the next multiple of 256");
+    TEST_ASSERT_EQUAL_MESSAGE(2, range_allocator_free_range_count(&allocator), "Padding and the tail should both be free");
+
+    TEST_ASSERT_TRUE_MESSAGE(range_allocator_alloc(&allocator, 100, 4, &c), "Small allocation should fit in the padding");
+    TEST_ASSERT_EQUAL_MESSAGE(100, c, "Small allocation should reuse the padding before the aligned one");
+    TEST_ASSERT_FALSE_MESSAGE(range_allocator_alloc(&allocator, 1024, 1, &a), "Oversized allocation should fail");
+    TEST_ASSERT_EQUAL_MESSAGE(300, allocator.used, "Three allocations of 100 should use 300 bytes");
+
+    range_allocator_free(&allocator, 0, 100);
+    range_allocator_free(&allocator, 256, 100);
+    range_allocator_free(&allocator, 100, 100);
+    TEST_ASSERT_EQUAL_MESSAGE(1, range_allocator_free_range_count(&allocator), "Freeing everything should merge back to one range");
+    TEST_ASSERT_EQUAL_MESSAGE(1024, range_allocator_largest_free(&allocator), "The merged range should cover the whole allocator");
+    TEST_ASSERT_EQUAL_MESSAGE(0, allocator.allocation_count, "No allocations should remain");
+
+    range_allocator_destroy(&allocator);
+}
+
+void test_Fileops_Atomic_Write_Round_Trip() {
+    const char *filename = "fileops_test.bin";
+    uint8_t data[] = {1, 2, 3, 4, 5, 6, 7};
+
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, sizeof(data)), "Atomic write should succeed");
+
+    size_t size = 0;
+    uint8_t *read = try_read_binary_file_FREE(filename, &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(read, "File should be readable after writing it");
+    TEST_ASSERT_EQUAL_MESSAGE(sizeof(data), size, "Read should return every byte, even when not a multiple of 4");
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(data, read, sizeof(data), "Read bytes should match the written ones");
+    free(read);
+
+    remove(filename);
+    TEST_ASSERT_NULL_MESSAGE(try_read_binary_file_FREE(filename, &size), "Reading a missing file should return NULL");
+}
+
+void test_Hash_Fnv1a_64() {
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0xcbf29ce484222325ull, hash_fnv1a_64("", 0), "Hash of nothing should be the offset basis");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0xaf63dc4c8601ec8cull, hash_fnv1a_64("a", 1), "Hash of \"a\" should match the reference");
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0x85944171f73967e8ull, hash_fnv1a_64("foobar", 6), "Hash of \"foobar\" should match the reference");
+
+    uint64_t pieces = hash_fnv1a_64_extend(hash_fnv1a_64("foo", 3), "bar", 3);
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(hash_fnv1a_64("foobar", 6), pieces, "Hashing in pieces should match hashing at once");
+}
+
+void test_Image_Decode_Ppm() {
+    const uint8_t ppm[] = "P6\n# two by one\n2 1\n255\n\x10\x20\x30\xff\x00\x80";
+    uint32_t width, height;
+    uint8_t *pixels = image_decode_ppm_FREE(ppm, sizeof(ppm) - 1, &width, &height);
+    TEST_ASSERT_NOT_NULL_MESSAGE(pixels, "A valid PPM should decode");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, width, "Width should come from the header");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, height, "Height should come from the header");
+    const uint8_t expected[] = { 0x10, 0x20, 0x30, 0xff, 0xff, 0x00, 0x80, 0xff };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(expected, pixels, sizeof(expected), "Pixels should be expanded to opaque RGBA");
+    free(pixels);
+
+    TEST_ASSERT_NULL_MESSAGE(image_decode_ppm_FREE(ppm, sizeof(ppm) - 2, &width, &height), "A truncated PPM should be rejected");
+    const uint8_t ascii[] = "P3\n1 1\n255\n0 0 0\n";
+    TEST_ASSERT_NULL_MESSAGE(image_decode_ppm_FREE(ascii, sizeof(ascii) - 1, &width, &height), "Only binary PPMs are supported");
+
+    uint8_t sheet[4 * 2 * IMAGE_RGBA8_PIXEL_SIZE];
+    for (size_t i = 0; i < sizeof(sheet); i++) {
+        sheet[i] = (uint8_t)i;
+    }
+    uint8_t region[2 * 2 * IMAGE_RGBA8_PIXEL_SIZE];
+    image_copy_rgba8_region(sheet, 4, 2, 0, 2, 2, region);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(sheet + 8, region, 8, "First row of the region should come from column 2");
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(sheet + 24, region + 8, 8, "Second row of the region should come from the next row");
+}
+
+void test_Stats_Percentile() {
+    double samples[] = {5.0, 1.0, 4.0, 2.0, 3.0, 10.0, 9.0, 8.0, 7.0, 6.0};
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.0001, 5.5, stats_mean(samples, 10), "Mean of 1..10 should be 5.5");
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.0001, 10.0, stats_max(samples, 10), "Max of 1..10 should be 10");
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.0001, 5.0, stats_percentile(samples, 10, 50.0), "p50 of 1..10 should be 5");
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.0001, 10.0, stats_percentile(samples, 10, 99.0), "p99 of 1..10 should be 10");
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.0001, 1.0, stats_percentile(samples, 10, 0.0), "p0 should be the smallest sample");
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.0001, 0.0, stats_percentile(samples, 0, 99.0), "Percentile of no samples should be 0");
+}
+
+static void thread_pool_test_job(void *arg, uint32_t worker_index) {
+    uint32_t *slot = arg;
+    *slot = worker_index + 1;
+}
+
+void test_Thread_Pool_Runs_All_Jobs() {
+    struct ThreadPool pool;
+    thread_pool_init(&pool, 4);
+
+    //
+    // More jobs than the initial queue capacity, so the ring has to grow
+    //
+    uint32_t results[1000] = {0};
+    for (int i = 0; i < 1000; i++) {
+        thread_pool_submit(&pool, thread_pool_test_job, &results[i]);
+    }
+    thread_pool_wait_idle(&pool);
+    TEST_ASSERT_EQUAL_MESSAGE(0, thread_pool_pending(&pool), "No jobs should be pending after waiting for idle");
+
+    bool all_ran = true;
+    for (int i = 0; i < 1000; i++) {
+        if (results[i] < 1 || results[i] > 4) all_ran = false;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(all_ran, "Every job should run once on a worker with index < 4");
+
+    thread_pool_destroy(&pool);
+    TEST_ASSERT_NULL_MESSAGE(pool.threads, "Threads should be freed after destroying the pool");
+}
+
+void test_Device_Score_Compare_And_Uuid() {
+    struct DeviceScore discrete = { .type_rank = 4, .device_local_bytes = 1024, .max_image_dimension_2d = 8192 };
+    struct DeviceScore integrated = { .type_rank = 3, .device_local_bytes = 4096, .max_image_dimension_2d = 16384 };
+    TEST_ASSERT_TRUE_MESSAGE(device_score_compare(&discrete, &integrated) > 0, "A discrete GPU should beat an integrated one");
+    TEST_ASSERT_TRUE_MESSAGE(device_score_compare(&integrated, &discrete) < 0, "The comparison should be antisymmetric");
+
+    struct DeviceScore fast = discrete;
+    fast.copy_gb_per_s = 200.0;
+    fast.device_local_bytes = 512;
+    struct DeviceScore slow = discrete;
+    slow.copy_gb_per_s = 100.0;
+    TEST_ASSERT_TRUE_MESSAGE(device_score_compare(&fast, &slow) > 0, "The benchmark should rank before memory");
+    slow.copy_gb_per_s = 0.0;
+    TEST_ASSERT_TRUE_MESSAGE(device_score_compare(&fast, &slow) < 0, "Memory should decide when one device was not measured");
+    TEST_ASSERT_EQUAL_MESSAGE(0, device_score_compare(&discrete, &discrete), "Equal scores should compare equal");
+
+    uint8_t uuid[DEVICE_UUID_SIZE];
+    uint8_t expected[DEVICE_UUID_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+    TEST_ASSERT_TRUE_MESSAGE(device_uuid_parse("01234567-89ab-CDEF-fedc-ba9876543210", uuid), "A dashed UUID should parse");
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(expected, uuid, DEVICE_UUID_SIZE, "Every byte of the UUID should be read");
+    TEST_ASSERT_TRUE_MESSAGE(device_uuid_parse("0123456789abcdeffedcba9876543210", uuid), "A UUID without dashes should parse");
+    TEST_ASSERT_FALSE_MESSAGE(device_uuid_parse("0123456789abcdeffedcba987654321", uuid), "A short UUID should not parse");
+    TEST_ASSERT_FALSE_MESSAGE(device_uuid_parse("0123456789abcdeffedcba98765432100", uuid), "A long UUID should not parse");
+    TEST_ASSERT_FALSE_MESSAGE(device_uuid_parse("0123456789abcdeffedcba987654321g", uuid), "Non hex digits should not parse");
+    TEST_ASSERT_FALSE_MESSAGE(device_uuid_parse("GeForce", uuid), "A device name should not parse");
+}
+
+void test_Tile_Codec_Round_Trip() {
+    uint32_t tiles[64];
+    for (uint32_t i = 0; i < 64; i++) {
+        tiles[i] = i < 40 ? UINT32_MAX : (i % 3 == 0 ? 7 : i * 1000);
+    }
+    uint8_t encoded[640];
+    TEST_ASSERT_TRUE_MESSAGE(tile_codec_max_encoded_size(64) <= sizeof(encoded), "The bound should fit the test buffer");
+    size_t size = tile_codec_encode(tiles, 64, encoded);
+    TEST_ASSERT_TRUE_MESSAGE(size < 64, "A long run of empty tiles should encode to less than a byte per tile");
+
+    uint32_t decoded[64];
+    TEST_ASSERT_TRUE_MESSAGE(tile_codec_decode(encoded, size, decoded, 64), "Encoded tiles should decode");
+    TEST_ASSERT_EQUAL_UINT32_ARRAY_MESSAGE(tiles, decoded, 64, "Decoded tiles should match the encoded ones");
+    TEST_ASSERT_FALSE_MESSAGE(tile_codec_decode(encoded, size, decoded, 63), "Decoding to too few tiles should fail");
+    TEST_ASSERT_FALSE_MESSAGE(tile_codec_decode(encoded, size - 1, decoded, 64), "Truncated data should not decode");
+}
+
+//
+// Layer l of tile (x, y) is x + 100 * y + 1000 * l
+//
+static void fill_test_tilemap_chunk(void *user, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles) {
+    const struct TilemapFileHeader *header = user;
+    uint32_t size = header->chunk_size;
+    for (uint32_t l = 0; l < header->layer_count; l++) {
+        for (uint32_t y = 0; y < size && chunk_y * size + y < header->height; y++) {
+            for (uint32_t x = 0; x < size && chunk_x * size + x < header->width; x++) {
+                tiles[(l * size + y) * size + x] = (chunk_x * size + x) + 100 * (chunk_y * size + y) + 1000 * l;
+            }
+        }
+    }
+}
+
+void test_Tilemap_File_Round_Trip() {
+    const char *filename = "tilemap_test.bin";
+    struct TilemapFileHeader header = {
+        .width = 5,
+        .height = 3,
+        .chunk_size = 4,
+        .layer_count = 2,
+        .layer_modes = { 0, 2 },
+    };
+    TEST_ASSERT_TRUE_MESSAGE(tilemap_file_write(filename, &header, TILEMAP_FILE_ENCODING_RAW, fill_test_tilemap_chunk, &header), "Writing the map should succeed");
+
+    struct TilemapFile map;
+    TEST_ASSERT_TRUE_MESSAGE(tilemap_file_open(filename, &map), "The written map should open");
+    TEST_ASSERT_EQUAL_MESSAGE(2, map.header->chunks_x, "5 tiles should take 2 chunks of 4");
+    TEST_ASSERT_EQUAL_MESSAGE(1, map.header->chunks_y, "3 tiles should take 1 chunk of 4");
+    TEST_ASSERT_EQUAL_MESSAGE(2, map.header->layer_modes[1], "Layer modes should be kept");
+    TEST_ASSERT_EQUAL_MESSAGE(0, map.chunks[1].offset % TILEMAP_FILE_ALIGNMENT, "Payloads should be aligned");
+
+    const uint32_t *tiles = tilemap_file_chunk(&map, 1, 0);
+    TEST_ASSERT_NOT_NULL_MESSAGE(tiles, "The second chunk should be in the map");
+    TEST_ASSERT_EQUAL_MESSAGE(204, tiles[2 * 4 + 0], "Tile (4, 2) should be read back");
+    TEST_ASSERT_EQUAL_MESSAGE(1004, tiles[16], "Layer 1 of tile (4, 0) should be read back");
+    TEST_ASSERT_EQUAL_MESSAGE(TILEMAP_FILE_EMPTY_TILE, tiles[1], "Tiles past the map edge should be empty");
+    TEST_ASSERT_NULL_MESSAGE(tilemap_file_chunk(&map, 2, 0), "Chunks outside the map should not be found");
+    tilemap_file_close(&map);
+
+    TEST_ASSERT_TRUE_MESSAGE(
+        tilemap_file_write(filename, &header, TILEMAP_FILE_ENCODING_RLE, fill_test_tilemap_chunk, &header),
+        "Writing the map encoded should succeed");
+    TEST_ASSERT_TRUE_MESSAGE(tilemap_file_open(filename, &map), "The encoded map should open");
+    TEST_ASSERT_NULL_MESSAGE(tilemap_file_chunk(&map, 1, 0), "Encoded chunks should not be handed out raw");
+    uint32_t decoded[32];
+    TEST_ASSERT_TRUE_MESSAGE(tilemap_file_read_chunk(&map, 1, 0, decoded), "The encoded chunk should decode");
+    TEST_ASSERT_EQUAL_MESSAGE(204, decoded[2 * 4 + 0], "Tile (4, 2) should be decoded");
+    TEST_ASSERT_EQUAL_MESSAGE(TILEMAP_FILE_EMPTY_TILE, decoded[1], "Empty tiles should be decoded");
+    tilemap_file_close(&map);
+
+    uint32_t garbage[4] = { 1, 2, 3, 4 };
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, (uint8_t *)garbage, sizeof(garbage)), "Overwriting the map should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_open(filename, &map), "A file without a header should not open");
+    remove(filename);
+}
+
+//
+// Writes a valid map, then copies of it with one field broken, each of
+// which would once have wrapped around the bounds checks
+//
+void test_Tilemap_File_Rejects_Corrupt() {
+    const char *filename = "tilemap_corrupt_test.bin";
+    struct TilemapFileHeader header = {
+        .width = 5,
+        .height = 3,
+        .chunk_size = 4,
+        .layer_count = 2,
+    };
+    TEST_ASSERT_TRUE_MESSAGE(tilemap_file_write(filename, &header, TILEMAP_FILE_ENCODING_RAW, fill_test_tilemap_chunk, &header), "Writing the map should succeed");
+    size_t size;
+    uint8_t *original = try_read_binary_file_FREE(filename, &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(original, "The written map should be readable");
+    uint8_t *data = malloc(size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(data, "Could not malloc the map copy");
+    struct TilemapFile map;
+
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, original, size / 2), "Truncating the map should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_open(filename, &map), "A truncated map should not open");
+
+    memcpy(data, original, size);
+    struct TilemapFileHeader *corrupt = (struct TilemapFileHeader *)data;
+    corrupt->table_offset = UINT64_MAX - 7;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt map should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_open(filename, &map), "A table past the end of the file should not open");
+
+    memcpy(data, original, size);
+    corrupt->width = UINT32_MAX;
+    corrupt->chunks_x = UINT32_MAX / 4 + 1;
+    corrupt->height = UINT32_MAX;
+    corrupt->chunks_y = UINT32_MAX / 4 + 1;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt map should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_open(filename, &map), "A table too big for the file should not open");
+
+    memcpy(data, original, size);
+    struct TilemapFileChunk *chunks = (struct TilemapFileChunk *)(data + corrupt->table_offset);
+    chunks[1].offset = UINT64_MAX - 3;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt map should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_open(filename, &map), "A payload past the end of the file should not open");
+
+    memcpy(data, original, size);
+    corrupt->chunk_size = 1u << 31;
+    corrupt->chunks_x = 1;
+    corrupt->chunks_y = 1;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt map should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_open(filename, &map), "A chunk payload too big for 32 bits should not open");
+
+    struct TilemapFileHeader huge = header;
+    huge.chunk_size = 1u << 15;
+    TEST_ASSERT_FALSE_MESSAGE(tilemap_file_write(filename, &huge, TILEMAP_FILE_ENCODING_RAW, fill_test_tilemap_chunk, &huge), "A chunk payload too big for 32 bits should not be written");
+
+    free(data);
+    free(original);
+    remove(filename);
+}
+
+void test_Asset_Pack_Round_Trip() {
+    const char *filename = "asset_pack_test.bin";
+    const char *first_path = "asset_pack_test_first.bin";
+    const char *second_path = "asset_pack_test_second.bin";
+    uint8_t first[5] = { 1, 2, 3, 4, 5 };
+    uint8_t second[70];
+    for (size_t i = 0; i < sizeof(second); i++) {
+        second[i] = (uint8_t)(i * 7);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(first_path, first, sizeof(first)), "Writing the first asset should succeed");
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(second_path, second, sizeof(second)), "Writing the second asset should succeed");
+
+    const char *names[] = { "shaders/first.spv", "second.ppm" };
+    const char *paths[] = { first_path, second_path };
+    TEST_ASSERT_TRUE_MESSAGE(asset_pack_write(filename, 42, names, paths, 2), "Packing the assets should succeed");
+
+    struct AssetPack pack;
+    TEST_ASSERT_TRUE_MESSAGE(asset_pack_open(filename, 42, &pack), "The written pack should open");
+    TEST_ASSERT_EQUAL_MESSAGE(2, pack.header->entry_count, "Both assets should be in the pack");
+
+    size_t size = 0;
+    const uint8_t *data = asset_pack_find(&pack, "second.ppm", &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(data, "The second asset should be found");
+    TEST_ASSERT_EQUAL_MESSAGE(sizeof(second), size, "The second asset should keep its size");
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(second, data, sizeof(second), "The second asset should be read back");
+    TEST_ASSERT_EQUAL_MESSAGE(0, (data - pack.file.data) % ASSET_PACK_ALIGNMENT, "Entries should be aligned");
+
+    data = asset_pack_find(&pack, "shaders/first.spv", &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(data, "The first asset should be found");
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(first, data, sizeof(first), "The first asset should be read back");
+    TEST_ASSERT_NULL_MESSAGE(asset_pack_find(&pack, "missing", &size), "Missing assets should not be found");
+    TEST_ASSERT_TRUE_MESSAGE(asset_pack_verify(&pack), "Every entry should match its hash");
+    asset_pack_close(&pack);
+
+    const char *missing_paths[] = { first_path, "asset_pack_test_missing.bin" };
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_write(filename, 42, names, missing_paths, 2), "Packing a missing file should fail");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "A failed pack should not be left behind");
+    remove(first_path);
+    remove(second_path);
+}
+
+void test_Asset_Pack_Rejects_Corrupt() {
+    const char *filename = "asset_pack_corrupt_test.bin";
+    const char *asset_path = "asset_pack_corrupt_test_asset.bin";
+    uint8_t asset[100];
+    for (size_t i = 0; i < sizeof(asset); i++) {
+        asset[i] = (uint8_t)(i * 3);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(asset_path, asset, sizeof(asset)), "Writing the asset should succeed");
+    const char *names[] = { "first", "second" };
+    const char *paths[] = { asset_path, asset_path };
+    TEST_ASSERT_TRUE_MESSAGE(asset_pack_write(filename, 42, names, paths, 2), "Packing the assets should succeed");
+    size_t size;
+    uint8_t *original = try_read_binary_file_FREE(filename, &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(original, "The written pack should be readable");
+    uint8_t *data = malloc(size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(data, "Could not malloc the pack copy");
+    struct AssetPack pack;
+
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 43, &pack), "A pack for another build should not open");
+
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, original, sizeof(struct AssetPackHeader) - 1), "Truncating the pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "A truncated header should not open");
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, original, size / 2), "Truncating the pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "A truncated pack should not open");
+
+    memcpy(data, original, size);
+    struct AssetPackHeader *corrupt = (struct AssetPackHeader *)data;
+    corrupt->table_offset = UINT64_MAX - 7;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "A table past the end of the file should not open");
+
+    memcpy(data, original, size);
+    corrupt->entry_count = UINT32_MAX;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "A table too big for the file should not open");
+
+    memcpy(data, original, size);
+    struct AssetPackEntry *entries = (struct AssetPackEntry *)(data + corrupt->table_offset);
+    entries[1].offset = UINT64_MAX - (ASSET_PACK_ALIGNMENT - 1);
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "An entry past the end of the file should not open");
+
+    memcpy(data, original, size);
+    entries[0].size = UINT64_MAX;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "An entry running off the end of the file should not open");
+
+    memcpy(data, original, size);
+    entries[0].offset += 1;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "A misaligned entry should not open");
+
+    memcpy(data, original, size);
+    struct AssetPackEntry swapped = entries[0];
+    entries[0] = entries[1];
+    entries[1] = swapped;
+    TEST_ASSERT_TRUE_MESSAGE(write_binary_file_atomic(filename, data, size), "Writing the corrupt pack should succeed");
+    TEST_ASSERT_FALSE_MESSAGE(asset_pack_open(filename, 42, &pack), "An unsorted table should not open");
+
+    free(data);
+    free(original);
+    remove(filename);
+    remove(asset_path);
+}
+
 int main() {
     UNITY_BEGIN();
     RUN_TEST(test_Raw_Vector_Of_Int);
     RUN_TEST(test_Raw_Vector_Of_String);
+    RUN_TEST(test_Raw_Vector_Insert_Erase);
+    RUN_TEST(test_Range_Allocator_Alignment_And_Coalescing);
+    RUN_TEST(test_Fileops_Atomic_Write_Round_Trip);
+    RUN_TEST(test_Hash_Fnv1a_64);
+    RUN_TEST(test_Image_Decode_Ppm);
+    RUN_TEST(test_Stats_Percentile);
+    RUN_TEST(test_Thread_Pool_Runs_All_Jobs);
+    RUN_TEST(test_Device_Score_Compare_And_Uuid);
+    RUN_TEST(test_Tile_Codec_Round_Trip);
+    RUN_TEST(test_Tilemap_File_Round_Trip);
+    RUN_TEST(test_Tilemap_File_Rejects_Corrupt);
+    RUN_TEST(test_Asset_Pack_Round_Trip);
+    RUN_TEST(test_Asset_Pack_Rejects_Corrupt);
     return UNITY_END();
 }
\ No newline at end of file
@@ -2,16 +2,203 @@
 //#define GLM_FORCE_DEPTH_ZERO_TO_ONE //TODO : 0-1 depth! 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "log.h"
+#include "language/clock.h"
 #include "vulkan-interface/interface-vk.h"
+#include "vulkan-interface/tile_batch.h"
 
+//
+// Options which select what main does, as opposed to how the
+// Vulkan state is set up.
+//
+struct Options {
+    const char *tile_list;
+    const char *output_directory;
+    uint32_t worker_count;
+    const char *write_map;
+    bool raw_map;
+    const char *bench_map;
+};
 
-int main() {
+//
+// Decodes every chunk of the tilemap file at path a few times over and
+// reports how well its chunks compress and how fast they decode.
+//
+static bool benchmark_map(const char *path) {
+    struct TilemapFile map;
+    if (!tilemap_file_open(path, &map)) {
+        return false;
+    }
+    struct TilemapFileStats stats = tilemap_file_benchmark(&map, 10);
+    double seconds = clock_ns_to_seconds(stats.decode_ns);
+    log_info("%s: %lu chunks, %.1f MB raw, %.1f MB stored (%.2fx), %.1f MB file\n",
+        path,
+        (unsigned long)stats.chunk_count,
+        stats.raw_bytes / 1e6,
+        stats.stored_bytes / 1e6,
+        stats.stored_bytes > 0 ? (double)stats.raw_bytes / stats.stored_bytes : 0.0,
+        map.file.size / 1e6);
+    log_info("Decoded %u rounds at %.2f GB/s\n",
+        stats.rounds,
+        seconds > 0.0 ? stats.raw_bytes * (double)stats.rounds / seconds / 1e9 : 0.0);
+    tilemap_file_close(&map);
+    return true;
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --map WxH           size of the tile map drawn each frame\n");
+    printf("  --headless          render offscreen without a window\n");
+    printf("  --resize-stress N   resize the window every frame, N times, and report timings\n");
+    printf("  --pipeline-cache F  file the pipeline cache is kept in (default: pipeline_cache.bin)\n");
+    printf("  --no-pipeline-cache start cold and do not save the pipeline cache\n");
+    printf("  --record-threads N  threads recording each frame (default: one per core)\n");
+    printf("  --pacing PROFILE    low-latency, balanced (default) or max-throughput\n");
+    printf("  --device NAME|UUID  use the device whose name contains NAME, or with UUID\n");
+    printf("  --device-benchmark  rank devices by a copy benchmark, cached in device_benchmark.bin\n");
+    printf("  --tile-sheet FILE   PPM sheet of 32x32 tiles to draw with (default: packed or generated tiles)\n");
+    printf("  --assets FILE       asset pack to load shaders and the tile sheet from (default: assets.pak next to this program)\n");
+    printf("  --no-assets         use the embedded shaders, without loading an asset pack\n");
+    printf("  --no-fullscreen-tilemap  draw dense layers as instanced quads, not one fullscreen pass\n");
+    printf("  --no-gpu-culling    draw every tile chunk, without culling them in a compute pass\n");
+    printf("  --stream            stream the map in chunks near the camera instead of building it whole\n");
+    printf("  --resident-chunks N chunks of a streamed map kept on the GPU (default: 512)\n");
+    printf("  --map-file FILE     stream the map from tilemap FILE (implies --stream)\n");
+    printf("  --write-map FILE    write the generated --map WxH map to tilemap FILE and exit\n");
+    printf("  --raw-map           store the chunks written by --write-map uncompressed\n");
+    printf("  --bench-map FILE    report how the chunks of tilemap FILE compress and decode, and exit\n");
+    printf("  --frames N          number of frames to render when headless\n");
+    printf("  --size WxH          offscreen image size when headless\n");
+    printf("  --images N          offscreen images (tiles in flight) when headless\n");
+    printf("  --tiles FILE        render every \"z x y\" tile in FILE (implies --headless)\n");
+    printf("  --out DIR           directory tiles are written to (default: tiles)\n");
+    printf("  --workers N         tile encoder threads (default: one per core)\n");
+}
+
+//
+// Fills config from the command line. Returns false if the arguments
+// could not be understood.
+//
+static bool parse_args(int argc, char **argv, struct VulkanConfig *config, struct Options *options) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--headless")) {
+            config->headless = true;
+        } else if (!strcmp(argv[i], "--map") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &config->map_width, &config->map_height) != 2) {
+                return false;
+            }
+        } else if (!strcmp(argv[i], "--resize-stress") && i + 1 < argc) {
+            config->resize_stress_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--pipeline-cache") && i + 1 < argc) {
+            config->pipeline_cache_path = argv[++i];
+        } else if (!strcmp(argv[i], "--no-pipeline-cache")) {
+            config->pipeline_cache_path = NULL;
+        } else if (!strcmp(argv[i], "--record-threads") && i + 1 < argc) {
+            config->record_thread_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--pacing") && i + 1 < argc) {
+            if (!frame_pacing_profile_from_name(argv[++i], &config->frame_pacing)) {
+                return false;
+            }
+        } else if (!strcmp(argv[i], "--device") && i + 1 < argc) {
+            config->device_override = argv[++i];
+        } else if (!strcmp(argv[i], "--device-benchmark")) {
+            config->device_benchmark = true;
+        } else if (!strcmp(argv[i], "--tile-sheet") && i + 1 < argc) {
+            config->tile_sheet_path = argv[++i];
+        } else if (!strcmp(argv[i], "--assets") && i + 1 < argc) {
+            config->asset_pack_path = argv[++i];
+        } else if (!strcmp(argv[i], "--no-assets")) {
+            config->asset_pack_path = NULL;
+        } else if (!strcmp(argv[i], "--no-fullscreen-tilemap")) {
+            config->fullscreen_dense_layers = false;
+        } else if (!strcmp(argv[i], "--no-gpu-culling")) {
+            config->gpu_culling = false;
+        } else if (!strcmp(argv[i], "--stream")) {
+            config->stream_chunks = true;
+        } else if (!strcmp(argv[i], "--resident-chunks") && i + 1 < argc) {
+            config->resident_chunks = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--map-file") && i + 1 < argc) {
+            config->map_path = argv[++i];
+            config->stream_chunks = true;
+        } else if (!strcmp(argv[i], "--write-map") && i + 1 < argc) {
+            options->write_map = argv[++i];
+        } else if (!strcmp(argv[i], "--raw-map")) {
+            options->raw_map = true;
+        } else if (!strcmp(argv[i], "--bench-map") && i + 1 < argc) {
+            options->bench_map = argv[++i];
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            config->headless_frame_limit = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &config->headless_width, &config->headless_height) != 2) {
+                return false;
+            }
+        } else if (!strcmp(argv[i], "--images") && i + 1 < argc) {
+            config->headless_image_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--tiles") && i + 1 < argc) {
+            options->tile_list = argv[++i];
+            config->headless = true;
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            options->output_directory = argv[++i];
+        } else if (!strcmp(argv[i], "--workers") && i + 1 < argc) {
+            options->worker_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
     init_log();
 
-    struct VulkanState vulkan_state = vulkan_state_create();
-    main_loop(&vulkan_state);
+    struct VulkanConfig config = vulkan_config_default();
+    struct Options options = {
+        .tile_list = NULL,
+        .output_directory = "tiles",
+        .worker_count = 0,
+        .write_map = NULL,
+        .raw_map = false,
+        .bench_map = NULL,
+    };
+    if (!parse_args(argc, argv, &config, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (config.headless && config.resize_stress_count > 0) {
+        log_error("--resize-stress needs a window and cannot be combined with --headless\n");
+        return EXIT_FAILURE;
+    }
+    if (config.stream_chunks && options.tile_list != NULL) {
+        log_error("--tiles renders from the whole map and cannot be combined with --stream\n");
+        return EXIT_FAILURE;
+    }
+
+    //
+    // Writing or benchmarking a map needs no GPU at all
+    //
+    if (options.write_map != NULL) {
+        uint32_t encoding = options.raw_map ? TILEMAP_FILE_ENCODING_RAW : TILEMAP_FILE_ENCODING_RLE;
+        if (!chunk_manager_write_generated_map(options.write_map, config.map_width, config.map_height, encoding)) {
+            return EXIT_FAILURE;
+        }
+        log_info("Wrote a %ux%u tilemap to %s\n", config.map_width, config.map_height, options.write_map);
+        return EXIT_SUCCESS;
+    }
+    if (options.bench_map != NULL) {
+        return benchmark_map(options.bench_map) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    struct VulkanState vulkan_state = vulkan_state_create(&config);
+    if (options.tile_list != NULL) {
+        struct RawVector tiles = read_tile_list_FREE(options.tile_list);
+        render_tile_batch(&vulkan_state, &tiles, options.output_directory, options.worker_count);
+        raw_vector_destroy(&tiles);
+    } else {
+        main_loop(&vulkan_state);
+    }
     vulkan_state_destroy(&vulkan_state);
 
     return EXIT_SUCCESS;
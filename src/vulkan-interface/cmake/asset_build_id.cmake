@@ -0,0 +1,30 @@
+#
+# Derives the asset build ID from the SPIR-V of every embedded shader and
+# writes it both as a C source file defining `const uint64_t
+# asset_build_id` and as hex text for asset-packer. Run in script mode:
+#
+#   cmake -DSPIRV_FILES=<a.spv|b.spv|...> -DOUTPUT=<out.c> -DID_FILE=<out.txt> -P asset_build_id.cmake
+#
+# The ID only changes when a shader does, so a pack is usable by exactly
+# the builds whose shaders it holds.
+#
+
+string(REPLACE "|" ";" spirv_files "${SPIRV_FILES}")
+set(contents "")
+foreach(spirv_file IN LISTS spirv_files)
+    file(READ "${spirv_file}" spirv HEX)
+    get_filename_component(spirv_name "${spirv_file}" NAME)
+    string(APPEND contents "${spirv_name}:${spirv}\n")
+endforeach()
+string(SHA256 digest "${contents}")
+string(SUBSTRING "${digest}" 0 16 build_id)
+
+file(WRITE "${OUTPUT}"
+"//
+// Generated from the embedded shaders by asset_build_id.cmake. Do not edit.
+//
+#include <stdint.h>
+
+const uint64_t asset_build_id = 0x${build_id}ull;
+")
+file(WRITE "${ID_FILE}" "${build_id}\n")
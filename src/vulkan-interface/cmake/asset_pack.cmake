@@ -0,0 +1,36 @@
+#
+# add_asset_pack(<target> <output> <build_id_file> [<name> <file>]...)
+#
+# Adds <target>, built by default, which packs every <file> into the asset
+# pack <output> under <name> with asset-packer (see language/asset_pack.h),
+# for the build whose ID is in <build_id_file>. The pack is rewritten
+# whenever one of the files, the build ID or asset-packer changes.
+#
+function(add_asset_pack target output build_id_file)
+    set(entries ${ARGN})
+    list(LENGTH entries entry_length)
+    math(EXPR odd_length "${entry_length} % 2")
+    if(NOT odd_length EQUAL 0)
+        message(FATAL_ERROR "add_asset_pack(${target}) needs a file for every name")
+    endif()
+
+    set(arguments)
+    set(files)
+    while(entries)
+        list(GET entries 0 name)
+        list(GET entries 1 file)
+        list(REMOVE_AT entries 0 1)
+        get_filename_component(file "${file}" ABSOLUTE)
+        list(APPEND arguments "${name}=${file}")
+        list(APPEND files "${file}")
+    endwhile()
+
+    add_custom_command(
+        OUTPUT "${output}"
+        COMMAND asset-packer "${output}" "${build_id_file}" ${arguments}
+        DEPENDS asset-packer "${build_id_file}" ${files}
+        COMMENT "Packing ${output}"
+        VERBATIM)
+
+    add_custom_target(${target} ALL DEPENDS "${output}")
+endfunction()
@@ -0,0 +1,73 @@
+#
+# embed_shader(<target> <shader> <symbol>)
+#
+# Compiles the GLSL file <shader> to SPIR-V with glslc and links the words
+# into <target> as `const uint32_t <symbol>[]`, with `<symbol>_size` holding
+# the size in bytes. Declare both in vulkan-interface/shaders.h. The
+# SPIR-V file is also appended to EMBEDDED_SHADER_ASSETS, as the name
+# shaders/<shader>.spv followed by its path, ready for add_asset_pack.
+#
+# embed_asset_build_id(<target>)
+#
+# Links into <target> the build ID derived from every shader embedded so
+# far (see asset_build_id.cmake), declared in vulkan-interface/shaders.h,
+# and sets ASSET_BUILD_ID_FILE to the file holding it for add_asset_pack.
+#
+
+set(EMBED_SPIRV_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/embed_spirv.cmake")
+set(ASSET_BUILD_ID_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/asset_build_id.cmake")
+
+find_program(GLSLC glslc HINTS "${PROJECT_SOURCE_DIR}/vulkansdk/x86_64/bin")
+if(NOT GLSLC)
+    message(FATAL_ERROR "glslc was not found; it is needed to compile the shaders")
+endif()
+
+function(embed_shader target shader symbol)
+    get_filename_component(shader_path "${shader}" ABSOLUTE)
+    get_filename_component(shader_name "${shader}" NAME)
+    set(spirv_file "${CMAKE_CURRENT_BINARY_DIR}/shaders/${shader_name}.spv")
+    set(source_file "${CMAKE_CURRENT_BINARY_DIR}/shaders/${symbol}.c")
+
+    add_custom_command(
+        OUTPUT "${spirv_file}"
+        COMMAND ${CMAKE_COMMAND} -E make_directory "${CMAKE_CURRENT_BINARY_DIR}/shaders"
+        COMMAND ${GLSLC} "${shader_path}" -o "${spirv_file}"
+        DEPENDS "${shader_path}"
+        COMMENT "Compiling ${shader_name}"
+        VERBATIM)
+
+    add_custom_command(
+        OUTPUT "${source_file}"
+        COMMAND ${CMAKE_COMMAND}
+            -DSPIRV_FILE=${spirv_file}
+            -DVAR_NAME=${symbol}
+            -DOUTPUT=${source_file}
+            -P "${EMBED_SPIRV_SCRIPT}"
+        DEPENDS "${spirv_file}" "${EMBED_SPIRV_SCRIPT}"
+        COMMENT "Embedding ${shader_name}"
+        VERBATIM)
+
+    target_sources(${target} PRIVATE "${source_file}")
+    set(EMBEDDED_SHADER_ASSETS ${EMBEDDED_SHADER_ASSETS} "shaders/${shader_name}.spv" "${spirv_file}" PARENT_SCOPE)
+    set(EMBEDDED_SHADER_SPIRV ${EMBEDDED_SHADER_SPIRV} "${spirv_file}" PARENT_SCOPE)
+endfunction()
+
+function(embed_asset_build_id target)
+    set(source_file "${CMAKE_CURRENT_BINARY_DIR}/shaders/asset_build_id.c")
+    set(id_file "${CMAKE_CURRENT_BINARY_DIR}/shaders/asset_build_id.txt")
+    string(REPLACE ";" "|" spirv_files "${EMBEDDED_SHADER_SPIRV}")
+
+    add_custom_command(
+        OUTPUT "${source_file}" "${id_file}"
+        COMMAND ${CMAKE_COMMAND}
+            -DSPIRV_FILES=${spirv_files}
+            -DOUTPUT=${source_file}
+            -DID_FILE=${id_file}
+            -P "${ASSET_BUILD_ID_SCRIPT}"
+        DEPENDS ${EMBEDDED_SHADER_SPIRV} "${ASSET_BUILD_ID_SCRIPT}"
+        COMMENT "Deriving the asset build ID"
+        VERBATIM)
+
+    target_sources(${target} PRIVATE "${source_file}")
+    set(ASSET_BUILD_ID_FILE "${id_file}" PARENT_SCOPE)
+endfunction()
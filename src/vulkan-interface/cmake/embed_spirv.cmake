@@ -0,0 +1,41 @@
+#
+# Turns a SPIR-V binary into a C source file holding it as an array of
+# 32-bit words, so shaders are linked into the library instead of being
+# read from disk. Run in script mode:
+#
+#   cmake -DSPIRV_FILE=<in.spv> -DVAR_NAME=<symbol> -DOUTPUT=<out.c> -P embed_spirv.cmake
+#
+# The array is named VAR_NAME and VAR_NAME_size holds its size in bytes.
+#
+
+file(READ "${SPIRV_FILE}" contents HEX)
+string(LENGTH "${contents}" hex_length)
+math(EXPR byte_count "${hex_length} / 2")
+math(EXPR trailing_bytes "${byte_count} % 4")
+if(byte_count EQUAL 0 OR NOT trailing_bytes EQUAL 0)
+    message(FATAL_ERROR "${SPIRV_FILE} is not a whole number of SPIR-V words (${byte_count} bytes)")
+endif()
+
+#
+# SPIR-V words are little endian in the file; swap each group of four
+# bytes into a hex literal, eight words per line.
+#
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1, " words "${contents}")
+string(REPEAT "0x[0-9a-f]+, " 8 line_pattern)
+string(REGEX REPLACE "(${line_pattern})" "\\1\n    " words "${words}")
+string(REPLACE ", \n" ",\n" words "${words}")
+string(STRIP "${words}" words)
+
+get_filename_component(source_name "${SPIRV_FILE}" NAME)
+file(WRITE "${OUTPUT}"
+"//
+// Generated from ${source_name} by embed_spirv.cmake. Do not edit.
+//
+#include <stddef.h>
+#include <stdint.h>
+
+const uint32_t ${VAR_NAME}[] = {
+    ${words}
+};
+const size_t ${VAR_NAME}_size = sizeof(${VAR_NAME});
+")
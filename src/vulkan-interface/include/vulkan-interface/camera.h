@@ -0,0 +1,43 @@
+//
+// A 2D camera over the tile map. The view-projection matrix it produces is
+// pushed as a push constant every frame, so panning and zooming only ever
+// costs those 64 bytes; no vertex or instance data is touched.
+//
+#ifndef VULKAN_CAMERA_H
+#define VULKAN_CAMERA_H
+
+#include <vulkan/vulkan.h>
+#include <cglm/cglm.h>
+
+//
+// Tiles visible from top to bottom of the viewport by default, and the
+// limits zooming is clamped to.
+//
+#define CAMERA_DEFAULT_VIEW_TILES 16.0f
+#define CAMERA_MIN_VIEW_TILES     2.0f
+#define CAMERA_MAX_VIEW_TILES     4096.0f
+
+//
+// center is the map position, in tiles, at the middle of the viewport.
+// view_tiles is how many tiles fit vertically; the horizontal span follows
+// from the aspect ratio.
+//
+struct Camera {
+    vec2 center;
+    float view_tiles;
+};
+
+//
+// Must match the push_constant block of shader.vert
+//
+struct CameraPushConstants {
+    mat4 view_projection;
+};
+
+struct Camera camera_default();
+struct Camera camera_for_region(float left, float top, float size);
+void camera_pan(struct Camera *camera, float dx_viewports, float dy_viewports);
+void camera_zoom(struct Camera *camera, float factor);
+struct CameraPushConstants camera_push_constants(const struct Camera *camera, VkExtent2D extent);
+
+#endif
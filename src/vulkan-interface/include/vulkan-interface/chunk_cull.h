@@ -0,0 +1,133 @@
+//
+// Decides on the GPU which chunks of tile instances the camera can see. The
+// instanced layers are split into chunks of consecutive instances, whose
+// bounds are uploaded once. Every frame a compute pass tests each chunk
+// against the camera and writes one indexed indirect draw per visible chunk,
+// compacted to the front of its batch's region with a per-batch count. A
+// batch is a run of at most maxDrawIndirectCount chunks of one layer, so
+// each is a single indirect draw whose count the GPU supplies, and a layer
+// is usually one batch. The CPU cost of a frame does not depend on how many
+// chunks the map has.
+//
+// Without drawIndirectCount nothing is compacted: every chunk keeps its own
+// draw, with no instances when it is culled, and each batch is drawn with
+// one multi-draw of all of them.
+//
+#ifndef VULKAN_CHUNK_CULL_H
+#define VULKAN_CHUNK_CULL_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <cglm/cglm.h>
+#include <language/asset_pack.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/camera.h"
+#include "vulkan-interface/descriptor.h"
+#include "vulkan-interface/frame_pacing.h"
+#include "vulkan-interface/memory.h"
+#include "vulkan-interface/upload.h"
+#include "vulkan-interface/vertex.h"
+
+//
+// Instances per culled chunk. Instances are laid out in TILE_BLOCK_SIZE
+// blocks, so a chunk of one block's worth has tight bounds.
+//
+#define CHUNK_CULL_INSTANCES (TILE_BLOCK_SIZE * TILE_BLOCK_SIZE)
+
+//
+// Must match local_size_x of chunk_cull.comp
+//
+#define CHUNK_CULL_WORKGROUP_SIZE 64
+
+#define CHUNK_CULL_CHUNKS_BINDING   0
+#define CHUNK_CULL_COMMANDS_BINDING 1
+#define CHUNK_CULL_COUNTS_BINDING   2
+
+//
+// The bounds and instances of one chunk, in tiles. command_base is the
+// first indirect draw of the chunk's batch, and batch the draw count it
+// adds to. Laid out as std430, and must match struct CullChunk of
+// chunk_cull.comp.
+//
+struct CullChunk {
+    vec2 min;
+    vec2 max;
+    uint32_t first_instance;
+    uint32_t instance_count;
+    uint32_t command_base;
+    uint32_t batch;
+};
+
+//
+// Must match the push constants of chunk_cull.comp
+//
+struct ChunkCullPushConstants {
+    mat4 view_projection;
+    uint32_t chunk_count;
+    uint32_t compact;
+};
+
+//
+// The layer's chunks are split into batches of max_draw_count, counted from
+// first_batch.
+//
+struct ChunkCullLayer {
+    uint32_t first_chunk;
+    uint32_t chunk_count;
+    uint32_t first_batch;
+};
+
+//
+// What one frame in flight writes: a VkDrawIndexedIndirectCommand per chunk
+// and a draw count per batch.
+//
+struct ChunkCullFrame {
+    VkBuffer commands;
+    struct MemoryAllocation commands_allocation;
+    VkBuffer counts;
+    struct MemoryAllocation counts_allocation;
+};
+
+struct ChunkCuller {
+    VkDevice device;
+    struct MemoryAllocator *allocator;
+    struct DescriptorAllocator *descriptors;
+    bool draw_indirect_count;
+
+    VkBuffer chunks;
+    struct MemoryAllocation chunks_allocation;
+    uint32_t chunk_count;
+    uint32_t batch_count;
+    uint32_t max_draw_count;
+    struct ChunkCullLayer layers[MAX_TILE_LAYERS];
+
+    struct ChunkCullFrame frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t frame_count;
+
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkShaderModule module;
+    VkPipeline pipeline;
+};
+
+void chunk_culler_init(
+    struct ChunkCuller *culler,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    struct UploadContext *upload,
+    VkPipelineCache cache,
+    const struct AssetPack *assets,
+    uint32_t frame_count,
+    bool draw_indirect_count,
+    struct RawVector *rvec_TileInstance,
+    const struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t layer_count);
+void chunk_culler_destroy(struct ChunkCuller *culler);
+void chunk_culler_record(
+    struct ChunkCuller *culler,
+    VkCommandBuffer command_buffer,
+    uint32_t frame_index,
+    const struct CameraPushConstants *camera);
+void chunk_culler_draw_layer(struct ChunkCuller *culler, VkCommandBuffer command_buffer, uint32_t frame_index, uint32_t layer);
+
+#endif
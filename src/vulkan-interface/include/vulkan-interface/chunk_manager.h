@@ -0,0 +1,216 @@
+//
+// Streams a tile map too big to keep on the GPU in fixed size chunks.
+// Only a bounded number of chunks are resident at once, each in its own
+// slot of one device local instance buffer. Every frame the chunks under
+// the camera are looked up in a small grid which wraps around the map, the
+// missing ones are handed to stream jobs, and the least recently seen
+// chunks give up their slots to make room. Jobs run on the stream threads
+// while frames go on; each frame uploads the chunks whose jobs have
+// finished, and a chunk is drawn from the frame after its upload is
+// queued. The GPU memory used is set by the slot count alone, however big
+// the map is.
+//
+// Chunks come either from the generated map or from a tilemap file (see
+// language/tilemap_file.h), which is mapped rather than read, so only the
+// chunks which are streamed in are ever paged in from disk. Encoded chunks
+// stay encoded in the page cache and are decoded on the stream threads.
+// Generated chunks are encoded with tile_codec.h when first built and kept
+// in a CPU cache of CHUNK_CACHE_BYTES, least recently used first out, so
+// streaming one back in is a decode.
+//
+#ifndef VULKAN_CHUNK_MANAGER_H
+#define VULKAN_CHUNK_MANAGER_H
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <language/raw_vector.h>
+#include <language/thread_pool.h>
+#include <language/tilemap_file.h>
+#include "vulkan-interface/camera.h"
+#include "vulkan-interface/frame_sync.h"
+#include "vulkan-interface/memory.h"
+#include "vulkan-interface/upload.h"
+#include "vulkan-interface/vertex.h"
+
+//
+// Tiles along each side of a chunk. A slot holds a full chunk on every
+// layer the map has, each layer at its own fixed offset.
+//
+#define CHUNK_SIZE  32
+#define CHUNK_TILES (CHUNK_SIZE * CHUNK_SIZE)
+
+//
+// Chunks along each side of the lookup grid. Must be a power of two. The
+// chunks drawn in one frame span at most this many per side, so no two of
+// them ever share a grid cell.
+//
+#define CHUNK_GRID_SIZE 128
+
+#define CHUNK_DEFAULT_RESIDENT 512
+
+//
+// Stream jobs in flight at most, so crossing into an unseen part of the
+// map spreads its cost over several frames.
+//
+#define CHUNK_STREAM_BUDGET 16
+
+//
+// Encoded bytes of generated chunks kept in the CPU cache
+//
+#define CHUNK_CACHE_BYTES (4 * 1024 * 1024)
+
+#define CHUNK_SLOT_NONE UINT32_MAX
+#define CHUNK_CACHE_NONE UINT32_MAX
+
+//
+// One slot of the instance buffer. streaming is set while the chunk's
+// stream job has not been uploaded, and generation counts the chunks the
+// slot has been given, so a job finishing for a chunk since evicted is
+// dropped. visible_update is the last update the chunk in it was under the
+// camera in, and last_used_value the timeline value of the last frame
+// which drew it; the slot can only be given to another chunk once that
+// value is complete. prev and next link the slots from most to least
+// recently visible.
+//
+struct ChunkSlot {
+    uint32_t chunk_x;
+    uint32_t chunk_y;
+    bool resident;
+    bool streaming;
+    uint32_t generation;
+    uint32_t layer_counts[MAX_TILE_LAYERS];
+    uint64_t visible_update;
+    uint64_t last_used_value;
+    uint32_t prev;
+    uint32_t next;
+};
+
+struct ChunkManagerStats {
+    uint64_t updates;
+    uint64_t streamed;
+    uint64_t build_ns;
+    uint64_t evicted;
+    uint64_t deferred;
+    uint64_t cache_hits;
+    uint64_t cache_evicted;
+    uint32_t peak_visible;
+};
+
+//
+// One chunk being streamed in: the slot and slot generation it was given
+// and the scratch memory its tiles are decoded and its instances built
+// into. slot is CHUNK_SLOT_NONE while the job is free. encoded holds the
+// cached chunk to decode when cached is set, and otherwise receives a
+// generated chunk's encoding. done is written by the stream thread under
+// the manager's mutex; everything else the thread writes is only read
+// once done is seen.
+//
+struct ChunkStreamJob {
+    struct ChunkManager *manager;
+    uint32_t slot;
+    uint32_t generation;
+    uint32_t chunk_x;
+    uint32_t chunk_y;
+    struct TileInstance *instances;
+    uint32_t *tiles;
+    uint8_t *encoded;
+    size_t encoded_size;
+    bool cached;
+    bool done;
+    uint32_t layer_counts[MAX_TILE_LAYERS];
+    uint64_t build_ns;
+};
+
+//
+// A generated chunk in the CPU cache, encoded with tile_codec.h. Entries
+// are addressed by index, which stays the same while they are cached.
+// bucket_next links the entries whose chunks share a grid cell, and, while
+// the entry is free, the free entries. prev and next link the cached
+// entries from most to least recently used.
+//
+struct ChunkCacheEntry {
+    uint32_t chunk_x;
+    uint32_t chunk_y;
+    uint8_t *encoded;
+    size_t size;
+    uint32_t bucket_next;
+    uint32_t prev;
+    uint32_t next;
+};
+
+//
+// Used from the render thread only, and must not be copied once
+// initialised since its stream jobs point back at it and it holds a mutex.
+// slot_instances is CHUNK_TILES for each of the map's layers. grid holds
+// the slot of the chunk each cell last received, or CHUNK_SLOT_NONE; a slot
+// is only a hit if it still holds that very chunk. cache_grid uses the same
+// cells to head the list of cache entries whose chunks land on each, so
+// finding, storing and evicting a cached chunk never scans the cache.
+//
+struct ChunkManager {
+    struct MemoryAllocator *allocator;
+    struct FrameSync *sync;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t chunks_x;
+    uint32_t chunks_y;
+    struct TileLayerRange layers[MAX_TILE_LAYERS];
+    uint32_t layer_count;
+    bool from_file;
+    struct TilemapFile map;
+
+    VkBuffer instance_buffer;
+    struct MemoryAllocation instance_allocation;
+
+    struct ChunkSlot *slots;
+    uint32_t slot_count;
+    uint32_t slot_instances;
+    uint32_t lru_head;
+    uint32_t lru_tail;
+    uint32_t *grid;
+
+    struct ThreadPool workers;
+    pthread_mutex_t mutex;
+    struct ChunkStreamJob jobs[CHUNK_STREAM_BUDGET];
+    struct TileInstance *instances_scratch;
+    uint32_t *tiles_scratch;
+    uint8_t *encoded_scratch;
+    size_t encoded_capacity;
+
+    struct RawVector cache_ChunkCacheEntry;
+    uint32_t *cache_grid;
+    uint32_t cache_lru_head;
+    uint32_t cache_lru_tail;
+    uint32_t cache_free;
+    size_t cache_bytes;
+
+    struct RawVector visible_uint32;
+    struct RawVector draws_TileLayerRange;
+    uint32_t first_draw[MAX_TILE_LAYERS];
+    uint32_t draw_count[MAX_TILE_LAYERS];
+    uint32_t layer_instance_count[MAX_TILE_LAYERS];
+
+    struct ChunkManagerStats stats;
+};
+
+void chunk_manager_init(
+    struct ChunkManager *manager,
+    struct MemoryAllocator *allocator,
+    struct FrameSync *sync,
+    const char *map_path,
+    uint32_t width,
+    uint32_t height,
+    uint32_t resident_chunks);
+void chunk_manager_destroy(struct ChunkManager *manager);
+void chunk_manager_update(
+    struct ChunkManager *manager,
+    struct UploadContext *upload,
+    const struct Camera *camera,
+    VkExtent2D extent);
+void chunk_manager_submitted(struct ChunkManager *manager, uint64_t value);
+bool chunk_manager_write_generated_map(const char *filename, uint32_t width, uint32_t height, uint32_t encoding);
+void chunk_manager_fill_draw_buffers(struct ChunkManager *manager, struct TileDrawBuffers *draw_buffers);
+
+#endif
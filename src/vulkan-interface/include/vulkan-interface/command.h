@@ -1,12 +1,35 @@
+#ifndef VULKAN_COMMAND_H
+#define VULKAN_COMMAND_H
+
 #include <language/raw_vector.h>
 #include <vulkan/vulkan.h>
+#include "vulkan-interface/pipeline_registry.h"
+#include "vulkan-interface/uniform_ring.h"
+#include "vulkan-interface/vertex.h"
+
+void begin_tile_render_pass(
+    VkCommandBuffer command_buffer,
+    VkRenderPass renderpass,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent,
+    VkSubpassContents contents);
+void record_tile_draw_setup(
+    VkCommandBuffer command_buffer,
+    VkExtent2D extent,
+    const struct TileDrawBuffers *draw_buffers,
+    const struct TileDrawUniforms *uniforms);
+void record_tile_layer_draw(VkCommandBuffer command_buffer, bool fullscreen, uint32_t first_instance, uint32_t instance_count);
+void record_draw_commands(
+    VkCommandBuffer command_buffer,
+    VkRenderPass renderpass,
+    struct PipelineRegistry *pipelines,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent,
+    const struct TileDrawBuffers *draw_buffers,
+    const struct TileDrawUniforms *uniforms);
+void record_image_readback(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, VkBuffer buffer);
+VkCommandPool create_command_pool(VkDevice device, uint32_t qf_idx);
+VkCommandPool create_resettable_command_pool(VkDevice device, uint32_t qf_idx);
+VkCommandPool create_transient_command_pool(VkDevice device, uint32_t qf_idx);
 
-struct RawVector create_command_buffers(
-    VkDevice device, 
-    VkCommandPool pool, 
-    VkRenderPass renderpass, 
-    VkPipeline pipeline,
-    struct RawVector *rvec_VkFramebuffer, 
-    VkExtent2D extent, 
-    VkBuffer vertex_buffer);
-VkCommandPool create_command_pool(VkDevice device, uint32_t qf_idx);
\ No newline at end of file
+#endif
@@ -16,7 +16,7 @@
 #define LOG_LEVEL LOG_TRACE
 
 #define NUM_VALIDATION_LAYERS 1
-const char *debug_requested_validation_layers[NUM_VALIDATION_LAYERS];
+extern const char *debug_requested_validation_layers[NUM_VALIDATION_LAYERS];
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -0,0 +1,69 @@
+//
+// Defers destroying GPU resources until the GPU is done with them. A
+// resource is retired together with the timeline value of the last
+// submission which used it, and is destroyed by a later collect once the
+// timeline has passed that value. Nothing ever needs the device to idle.
+//
+#ifndef VULKAN_DELETION_QUEUE_H
+#define VULKAN_DELETION_QUEUE_H
+
+#include <vulkan/vulkan.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/frame_sync.h"
+#include "vulkan-interface/memory.h"
+
+enum DeferredDeletionType {
+    DEFERRED_DELETION_BUFFER,
+    DEFERRED_DELETION_IMAGE,
+    DEFERRED_DELETION_IMAGE_VIEW,
+    DEFERRED_DELETION_FRAMEBUFFER,
+    DEFERRED_DELETION_PIPELINE,
+    DEFERRED_DELETION_RENDER_PASS,
+    DEFERRED_DELETION_SWAPCHAIN,
+};
+
+//
+// allocation is only used by buffers and images, and is freed along with them.
+//
+struct DeferredDeletion {
+    enum DeferredDeletionType type;
+    uint64_t last_use;
+    union {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView image_view;
+        VkFramebuffer framebuffer;
+        VkPipeline pipeline;
+        VkRenderPass renderpass;
+        VkSwapchainKHR swapchain;
+    };
+    struct MemoryAllocation allocation;
+};
+
+//
+// Used from the render thread only, like the FrameSync it reads.
+//
+struct DeletionQueue {
+    VkDevice device;
+    struct MemoryAllocator *allocator;
+    struct FrameSync *sync;
+    struct RawVector pending_DeferredDeletion;
+
+    uint64_t retired;
+    uint64_t destroyed;
+    size_t pending_peak;
+};
+
+void deletion_queue_init(struct DeletionQueue *queue, VkDevice device, struct MemoryAllocator *allocator, struct FrameSync *sync);
+void deletion_queue_destroy(struct DeletionQueue *queue);
+void deletion_queue_retire_buffer(struct DeletionQueue *queue, VkBuffer buffer, struct MemoryAllocation *allocation, uint64_t last_use);
+void deletion_queue_retire_image(struct DeletionQueue *queue, VkImage image, struct MemoryAllocation *allocation, uint64_t last_use);
+void deletion_queue_retire_image_view(struct DeletionQueue *queue, VkImageView image_view, uint64_t last_use);
+void deletion_queue_retire_framebuffer(struct DeletionQueue *queue, VkFramebuffer framebuffer, uint64_t last_use);
+void deletion_queue_retire_pipeline(struct DeletionQueue *queue, VkPipeline pipeline, uint64_t last_use);
+void deletion_queue_retire_renderpass(struct DeletionQueue *queue, VkRenderPass renderpass, uint64_t last_use);
+void deletion_queue_retire_swapchain(struct DeletionQueue *queue, VkSwapchainKHR swapchain, uint64_t last_use);
+uint32_t deletion_queue_collect(struct DeletionQueue *queue);
+void deletion_queue_flush(struct DeletionQueue *queue);
+
+#endif
@@ -0,0 +1,124 @@
+//
+// Allocates descriptor sets from pools which are created on demand and
+// recycled rather than destroyed. Transient sets live for one frame: each
+// frame in flight owns the pools its sets came from, and they are reset
+// wholesale when the frame comes round again. Persistent sets are cached by
+// their layout and what they bind, so asking twice for the same set returns
+// the same one. They live until a resource they bind is forgotten, when
+// they are kept to be rewritten for the next set of the same layout. Set
+// layouts are cached by their bindings in the same way. Cache entries keep
+// a copy of their key, so two keys whose hashes collide are told apart.
+//
+#ifndef VULKAN_DESCRIPTOR_H
+#define VULKAN_DESCRIPTOR_H
+
+#include <vulkan/vulkan.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/frame_pacing.h"
+
+#define DESCRIPTOR_POOL_MAX_SETS 256
+
+//
+// Descriptors of each type a pool holds, per set it can allocate
+//
+#define DESCRIPTOR_POOL_UNIFORM_BUFFERS_PER_SET         1
+#define DESCRIPTOR_POOL_UNIFORM_BUFFERS_DYNAMIC_PER_SET 1
+#define DESCRIPTOR_POOL_STORAGE_BUFFERS_PER_SET         2
+#define DESCRIPTOR_POOL_COMBINED_IMAGE_SAMPLERS_PER_SET 2
+
+//
+// One resource bound by a persistent set. Buffers use buffer, offset and
+// range; images use image_view, sampler and image_layout.
+//
+struct DescriptorBinding {
+    uint32_t binding;
+    VkDescriptorType type;
+
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize range;
+
+    VkImageView image_view;
+    VkSampler sampler;
+    VkImageLayout image_layout;
+};
+
+//
+// bindings and immutable_samplers are copies owned by the entry; the
+// pImmutableSamplers of bindings point into immutable_samplers.
+//
+struct DescriptorLayoutCacheEntry {
+    uint64_t hash;
+    uint32_t binding_count;
+    VkDescriptorSetLayoutBinding *bindings;
+    VkSampler *immutable_samplers;
+    VkDescriptorSetLayout layout;
+};
+
+//
+// bindings is a copy owned by the entry, or NULL for a forgotten set kept
+// to be rewritten.
+//
+struct DescriptorSetCacheEntry {
+    uint64_t hash;
+    VkDescriptorSetLayout layout;
+    uint32_t binding_count;
+    struct DescriptorBinding *bindings;
+    VkDescriptorSet set;
+};
+
+//
+// A run of pools handing out sets. current is the pool sets are allocated
+// from until it is exhausted; used_VkDescriptorPool holds every pool the
+// run has taken, current included.
+//
+struct DescriptorPoolChain {
+    VkDescriptorPool current;
+    struct RawVector used_VkDescriptorPool;
+};
+
+struct DescriptorAllocatorStats {
+    uint64_t transient_allocations;
+    uint64_t persistent_allocations;
+    uint64_t persistent_cache_hits;
+    uint64_t persistent_evictions;
+    uint64_t layout_cache_hits;
+    uint32_t pools_created;
+    uint64_t pool_resets;
+};
+
+//
+// Used from the render thread only.
+//
+struct DescriptorAllocator {
+    VkDevice device;
+    uint32_t frame_count;
+    uint32_t frame_index;
+
+    struct DescriptorPoolChain frames[MAX_FRAMES_IN_FLIGHT];
+    struct DescriptorPoolChain persistent;
+    struct RawVector spare_VkDescriptorPool;
+
+    struct RawVector layouts_DescriptorLayoutCacheEntry;
+    struct RawVector sets_DescriptorSetCacheEntry;
+    struct RawVector spare_DescriptorSetCacheEntry;
+
+    struct DescriptorAllocatorStats stats;
+};
+
+void descriptor_allocator_init(struct DescriptorAllocator *allocator, VkDevice device, uint32_t frame_count);
+void descriptor_allocator_destroy(struct DescriptorAllocator *allocator);
+VkDescriptorSetLayout descriptor_allocator_layout(
+    struct DescriptorAllocator *allocator, const VkDescriptorSetLayoutBinding *bindings, uint32_t binding_count);
+void descriptor_allocator_begin_frame(struct DescriptorAllocator *allocator, uint32_t frame_index);
+VkDescriptorSet descriptor_allocator_transient(struct DescriptorAllocator *allocator, VkDescriptorSetLayout layout);
+VkDescriptorSet descriptor_allocator_persistent(
+    struct DescriptorAllocator *allocator,
+    VkDescriptorSetLayout layout,
+    const struct DescriptorBinding *bindings,
+    uint32_t binding_count);
+void descriptor_allocator_forget_buffer(struct DescriptorAllocator *allocator, VkBuffer buffer);
+void descriptor_allocator_forget_image_view(struct DescriptorAllocator *allocator, VkImageView image_view);
+void descriptor_write(VkDevice device, VkDescriptorSet set, const struct DescriptorBinding *bindings, uint32_t binding_count);
+
+#endif
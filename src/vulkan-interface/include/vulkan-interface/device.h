@@ -7,22 +7,38 @@
 #include "log.h"
 #include <language/optional.h>
 #include "vulkan-interface/debug.h"
+#include "vulkan-interface/device_select.h"
 
 #define NUM_DEVICE_EXTENSIONS 1
-const char* required_device_extensions[NUM_DEVICE_EXTENSIONS];
+extern const char* required_device_extensions[NUM_DEVICE_EXTENSIONS];
 
+//
+// transfer_family_index is only set when the device has a queue family
+// which can transfer but not draw. It is not required for completeness.
+// The feature flags say which optional features create_logical_device
+// enabled; multi_draw_indirect includes drawIndirectFirstInstance,
+// present_wait means both VK_KHR_present_id and VK_KHR_present_wait, and
+// swapchain_maintenance1 means VK_EXT_swapchain_maintenance1.
+//
 struct InterfacePhysicalDevice {
    VkPhysicalDevice physical_device;
    struct OptionalIndex graphics_family_index; 
    struct OptionalIndex presentation_family_index;
+   struct OptionalIndex transfer_family_index;
+   bool multi_draw_indirect;
+   bool draw_indirect_count;
+   bool present_wait;
+   bool swapchain_maintenance1;
 };
 
 void interface_physical_device_fill_indices(struct InterfacePhysicalDevice *device, VkSurfaceKHR surface); 
 
-struct InterfacePhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR surface); 
+struct InterfacePhysicalDevice pick_physical_device(
+    VkInstance instance, VkSurfaceKHR surface, const struct DeviceSelection *selection);
 bool interface_physical_device_is_device_suitable(struct InterfacePhysicalDevice *device, VkSurfaceKHR surface);
 bool interface_physical_device_is_complete(struct InterfacePhysicalDevice *indices);
 bool device_supports_required_extensions(struct InterfacePhysicalDevice *ipdev); 
-VkDevice create_logical_device(struct InterfacePhysicalDevice *pdev);
+VkDevice create_logical_device(struct InterfacePhysicalDevice *pdev, bool headless, bool surface_maintenance1);
+uint32_t interface_physical_device_transfer_family(struct InterfacePhysicalDevice *pdev);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+//
+// Ranks the suitable physical devices so the best one is picked rather
+// than the first one enumerated, which on multi-GPU machines is often an
+// integrated GPU or a software rasterizer. A device can also be forced by
+// name or UUID, and an optional copy benchmark breaks ties between devices
+// of the same type. Benchmark results are cached on disk per device and
+// driver so they are only measured once.
+//
+#ifndef VULKAN_DEVICE_SELECT_H
+#define VULKAN_DEVICE_SELECT_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <language/device_score.h>
+
+#define DEVICE_BENCHMARK_FILE "device_benchmark.bin"
+
+#define DEVICE_BENCHMARK_MAGIC 0x48424456u /* "VDBH" */
+
+//
+// Bytes copied device local to device local by the benchmark, after one
+// untimed warm up copy of the same size.
+//
+#define DEVICE_BENCHMARK_BYTES (64ull * 1024 * 1024)
+#define DEVICE_BENCHMARK_COPIES 4
+
+//
+// How pick_physical_device chooses. override matches a device whose name
+// contains it, or whose UUID it spells out in hex (dashes optional); NULL
+// picks the best ranked device. benchmark_path may be NULL to measure
+// without caching.
+//
+struct DeviceSelection {
+    const char *override;
+    bool benchmark;
+    const char *benchmark_path;
+};
+
+struct DeviceBenchmarkFileHeader {
+    uint32_t magic;
+    uint32_t record_count;
+};
+
+struct DeviceBenchmarkRecord {
+    uint8_t device_uuid[VK_UUID_SIZE];
+    uint32_t driver_version;
+    uint32_t reserved;
+    double copy_gb_per_s;
+};
+
+struct DeviceScore physical_device_score(VkPhysicalDevice physical_device);
+bool physical_device_matches(VkPhysicalDevice physical_device, const char *name_or_uuid);
+double physical_device_benchmark(VkPhysicalDevice physical_device, uint32_t queue_family_index, const char *cache_path);
+
+#endif
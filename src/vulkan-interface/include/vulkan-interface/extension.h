@@ -6,6 +6,7 @@
 #define VULKAN_EXT_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
@@ -23,6 +24,6 @@ void DestroyDebugUtilsMessengerEXT(
         VkDebugUtilsMessengerEXT debugMessenger, 
         const VkAllocationCallbacks* pAllocator); 
 
-struct RawVector get_required_extension_names_FREE();
+struct RawVector get_required_extension_names_FREE(bool headless);
 
 #endif
@@ -0,0 +1,43 @@
+//
+// Frame pacing profiles: how many frames the CPU may run ahead of the GPU,
+// how many swapchain images to ask for and which present modes to prefer.
+// Fewer frames and images mean lower latency, more mean higher throughput.
+//
+#ifndef VULKAN_FRAME_PACING_H
+#define VULKAN_FRAME_PACING_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Upper bound on frames_in_flight over every profile, for sizing arrays
+//
+#define MAX_FRAMES_IN_FLIGHT 3
+#define MAX_PREFERRED_PRESENT_MODES 2
+
+enum FramePacingProfile {
+    FRAME_PACING_LOW_LATENCY = 0,
+    FRAME_PACING_BALANCED = 1,
+    FRAME_PACING_MAX_THROUGHPUT = 2,
+    FRAME_PACING_PROFILE_COUNT,
+};
+
+//
+// preferred_present_modes are tried in order; FIFO is always available and
+// is used if none of them are supported. extra_swapchain_images is added to
+// the surface's minImageCount.
+//
+struct FramePacing {
+    const char *name;
+    uint32_t frames_in_flight;
+    uint32_t extra_swapchain_images;
+    uint32_t preferred_present_mode_count;
+    VkPresentModeKHR preferred_present_modes[MAX_PREFERRED_PRESENT_MODES];
+};
+
+const struct FramePacing *frame_pacing_profile(enum FramePacingProfile profile);
+bool frame_pacing_profile_from_name(const char *name, enum FramePacingProfile *profile);
+const char *present_mode_name(VkPresentModeKHR present_mode);
+
+#endif
@@ -0,0 +1,97 @@
+//
+// Records the scene afresh every frame. Each frame in flight owns a command
+// pool for its primary command buffer, plus one pool per recording thread
+// for the secondary command buffers that thread records tile chunks into.
+// Pools are reset wholesale at the start of their frame, so nothing is
+// freed or reallocated while rendering.
+//
+#ifndef VULKAN_FRAME_RECORDER_H
+#define VULKAN_FRAME_RECORDER_H
+
+#include <vulkan/vulkan.h>
+#include <language/raw_vector.h>
+#include <language/thread_pool.h>
+#include "vulkan-interface/chunk_cull.h"
+#include "vulkan-interface/pipeline_registry.h"
+#include "vulkan-interface/uniform_ring.h"
+#include "vulkan-interface/vertex.h"
+
+//
+// Instances per tile chunk. A chunk is the unit of work handed to a
+// recording thread and becomes one secondary command buffer.
+//
+#define TILE_CHUNK_INSTANCES 16384
+
+//
+// A run of instances on one layer, drawn with one pipeline. A fullscreen
+// chunk is a whole fullscreen layer (see TileLayerRange). An indirect chunk
+// is a whole instanced layer, drawn from the commands the chunk culler
+// wrote for layer_index. A chunk with draws is draw_count chunk draws of a
+// streamed map (see TileDrawBuffers), instance_count being their total.
+//
+struct TileChunk {
+    uint32_t first_instance;
+    uint32_t instance_count;
+    VkPipeline pipeline;
+    bool fullscreen;
+    bool indirect;
+    uint32_t layer_index;
+    const struct TileLayerRange *draws;
+    uint32_t draw_count;
+};
+
+//
+// The secondary command buffers one thread has recorded into this frame.
+// used counts how many of secondaries_VkCommandBuffer have been handed out
+// since the pool was last reset.
+//
+struct FrameRecorderThread {
+    VkCommandPool pool;
+    struct RawVector secondaries_VkCommandBuffer;
+    uint32_t used;
+};
+
+struct FrameRecorderFrame {
+    VkCommandPool pool;
+    VkCommandBuffer primary;
+    struct FrameRecorderThread *threads;
+};
+
+//
+// The recorder owns a thread pool, so it must not be copied after
+// frame_recorder_init.
+//
+struct FrameRecorder {
+    VkDevice device;
+    uint32_t frame_count;
+    uint32_t thread_count;
+    struct FrameRecorderFrame *frames;
+    struct ThreadPool threads;
+
+    struct RawVector chunks_TileChunk;
+    struct RawVector secondaries_VkCommandBuffer;
+
+    uint64_t frames_recorded;
+    uint64_t chunks_recorded;
+    uint64_t record_ns;
+};
+
+void frame_recorder_init(
+    struct FrameRecorder *recorder,
+    VkDevice device,
+    uint32_t qf_idx,
+    uint32_t frame_count,
+    uint32_t thread_count);
+void frame_recorder_destroy(struct FrameRecorder *recorder);
+VkCommandBuffer frame_recorder_record(
+    struct FrameRecorder *recorder,
+    uint32_t frame_index,
+    VkRenderPass renderpass,
+    struct PipelineRegistry *pipelines,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent,
+    const struct TileDrawBuffers *draw_buffers,
+    const struct TileDrawUniforms *uniforms,
+    struct ChunkCuller *culler);
+
+#endif
@@ -0,0 +1,46 @@
+//
+// Frame synchronization built on one timeline semaphore. Every submission
+// to the GPU signals the next value of the timeline, so "is this resource
+// still in use" becomes "has the timeline reached the value of its last
+// use". One counter replaces the per-frame and per-image fences, and the
+// last value seen complete is cached so most checks make no call at all.
+// The binary semaphores the swapchain requires for acquire and present
+// live here too, one pair per frame in flight.
+//
+#ifndef VULKAN_FRAME_SYNC_H
+#define VULKAN_FRAME_SYNC_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/frame_pacing.h"
+
+//
+// Used from the render thread only.
+//
+struct FrameSync {
+    VkDevice device;
+    VkSemaphore timeline;
+    uint64_t last_signalled;
+    uint64_t completed;
+
+    uint32_t frames_in_flight;
+    uint64_t frame_values[MAX_FRAMES_IN_FLIGHT];
+    struct RawVector image_values_uint64;
+
+    VkSemaphore image_available[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore render_finished[MAX_FRAMES_IN_FLIGHT];
+
+    uint64_t queries;
+    uint64_t waits;
+};
+
+void frame_sync_init(struct FrameSync *sync, VkDevice device, uint32_t frames_in_flight, uint32_t image_count);
+void frame_sync_destroy(struct FrameSync *sync);
+uint64_t frame_sync_next_value(struct FrameSync *sync);
+bool frame_sync_is_complete(struct FrameSync *sync, uint64_t value);
+void frame_sync_wait(struct FrameSync *sync, uint64_t value);
+void frame_sync_submitted(struct FrameSync *sync, uint32_t frame_index, uint32_t image_index, uint64_t value);
+void frame_sync_reset_images(struct FrameSync *sync, uint32_t image_count);
+
+#endif
@@ -0,0 +1,65 @@
+//
+// Dense layers of the map kept on the GPU as grids of tile IDs in a
+// storage buffer, and drawn with one fullscreen triangle each: the fragment
+// shader finds the tile under every pixel and samples its atlas layer. The
+// cost of such a layer depends on the number of pixels drawn, not on the
+// number of tiles in it, so it replaces the instanced quads for layers
+// which cover the whole map.
+//
+#ifndef VULKAN_FULLSCREEN_TILEMAP_H
+#define VULKAN_FULLSCREEN_TILEMAP_H
+
+#include <vulkan/vulkan.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/descriptor.h"
+#include "vulkan-interface/memory.h"
+#include "vulkan-interface/upload.h"
+#include "vulkan-interface/vertex.h"
+
+#define FULLSCREEN_TILEMAP_BINDING 0
+
+//
+// Start of the storage buffer, followed by layer_count grids of width x
+// height uint32_t tile IDs, row by row. Must match the TileMap block of
+// tilemap.frag.
+//
+struct FullscreenTilemapHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t layer_count;
+    uint32_t padding;
+};
+
+struct FullscreenTilemap {
+    struct MemoryAllocator *allocator;
+    struct DescriptorAllocator *descriptors;
+
+    VkBuffer buffer;
+    struct MemoryAllocation allocation;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layer_count;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorSet descriptor_set;
+};
+
+VkDescriptorSetLayout fullscreen_tilemap_set_layout(struct DescriptorAllocator *descriptors);
+uint32_t fullscreen_tilemap_extract_dense_layers(
+    struct RawVector *rvec_TileInstance,
+    struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t layer_count,
+    uint32_t width,
+    uint32_t height,
+    struct RawVector *tiles_uint32);
+void fullscreen_tilemap_init(
+    struct FullscreenTilemap *tilemap,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    struct UploadContext *upload,
+    uint32_t width,
+    uint32_t height,
+    struct RawVector *tiles_uint32);
+void fullscreen_tilemap_destroy(struct FullscreenTilemap *tilemap);
+
+#endif
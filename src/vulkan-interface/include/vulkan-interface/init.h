@@ -25,11 +25,11 @@ static VkApplicationInfo app_info = {
     .applicationVersion   = VK_MAKE_VERSION(1, 0, 0),
     .pEngineName          = "Tiling Engine",
     .engineVersion        = VK_MAKE_VERSION(1, 0, 0),
-    .apiVersion           = VK_API_VERSION_1_0,
+    .apiVersion           = VK_API_VERSION_1_2,
 };
 
 GLFWwindow *init_window();
-VkInstance init_vulkan(); 
+VkInstance init_vulkan(bool headless, bool *surface_maintenance1); 
 VkSurfaceKHR create_surface(VkInstance instance, GLFWwindow *window);
 
 #endif
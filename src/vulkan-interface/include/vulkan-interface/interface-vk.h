@@ -8,12 +8,79 @@
 #include "vulkan-interface/extension.h"
 #include "vulkan-interface/init.h"
 #include "vulkan-interface/swapchain.h"
+#include "vulkan-interface/tile_atlas.h"
+#include "vulkan-interface/chunk_cull.h"
+#include "vulkan-interface/chunk_manager.h"
 #include "vulkan-interface/command.h"
+#include "vulkan-interface/deletion_queue.h"
+#include "vulkan-interface/descriptor.h"
+#include "vulkan-interface/frame_pacing.h"
+#include "vulkan-interface/frame_recorder.h"
+#include "vulkan-interface/frame_sync.h"
+#include "vulkan-interface/fullscreen_tilemap.h"
+#include "vulkan-interface/pipeline_registry.h"
+#include "vulkan-interface/present_timer.h"
+#include "vulkan-interface/retired_swapchains.h"
 #include "vulkan-interface/vertex.h"
+#include "vulkan-interface/memory.h"
+#include "vulkan-interface/offscreen.h"
+#include "vulkan-interface/uniform_ring.h"
+#include "vulkan-interface/upload.h"
+#include "language/asset_pack.h"
 #include "language/optional.h"
 #include "language/raw_vector.h"
 
+//
+// Options controlling how the Vulkan state is created. When headless is
+// set no window, surface or swapchain is created; frames are rendered into
+// a ring of headless_image_count offscreen images instead, and main_loop
+// exits after headless_frame_limit frames. map_width x map_height tiles
+// are drawn each frame. A non-zero resize_stress_count makes a windowed
+// main_loop resize the window every frame and exit after that many
+// swapchain recreations, logging how long they took. Pipelines are cached
+// in pipeline_cache_path between runs; NULL disables the cache file.
+// Each frame is recorded on record_thread_count threads, 0 meaning one per
+// core. frame_pacing trades latency against throughput (see frame_pacing.h).
+// The best ranked device is used unless device_override names one; with
+// device_benchmark set, devices are also benchmarked, with the results
+// cached in device_benchmark_path (see device_select.h). With
+// stream_chunks set the map is never built whole; at most resident_chunks
+// chunks of it are on the GPU at once (see chunk_manager.h). A streamed map
+// is read from the tilemap file at map_path, if set, instead of generated.
+// Shaders and the tile sheet are taken from the asset pack at
+// asset_pack_path when there is one (see cmake/asset_pack.cmake), and
+// otherwise from the library and tile_sheet_path. The default pack is the
+// one next to the executable.
+//
+struct VulkanConfig {
+    bool headless;
+    uint32_t map_width;
+    uint32_t map_height;
+    uint32_t headless_width;
+    uint32_t headless_height;
+    uint32_t headless_image_count;
+    uint32_t headless_frame_limit;
+    uint32_t resize_stress_count;
+    const char *pipeline_cache_path;
+    uint32_t record_thread_count;
+    enum FramePacingProfile frame_pacing;
+    const char *device_override;
+    bool device_benchmark;
+    const char *device_benchmark_path;
+    const char *tile_sheet_path;
+    bool fullscreen_dense_layers;
+    bool gpu_culling;
+    bool stream_chunks;
+    const char *map_path;
+    uint32_t resident_chunks;
+    const char *asset_pack_path;
+};
+
 struct VulkanState {
+    bool headless;
+    uint32_t headless_frame_limit;
+    uint32_t resize_stress_count;
+
     GLFWwindow *window;
     VkInstance instance;
     VkDebugUtilsMessengerEXT debug_messenger;
@@ -25,31 +92,89 @@ struct VulkanState {
 
     VkQueue graphics_queue;
     VkQueue presentation_queue;
+    VkQueue transfer_queue;
+
+    const struct FramePacing *pacing;
+    VkPresentModeKHR present_mode;
+    struct FrameSync *sync;
+    struct DeletionQueue *deletions;
+    struct RetiredSwapchains *retired_swapchains;
+    struct DescriptorAllocator *descriptors;
+
+    //
+    // NULL unless presents can be waited on (see present_timer.h), in which
+    // case frame latency is measured up to the present
+    //
+    struct PresentTimer *present_timer;
+
+    //
+    // NULL when no asset pack was loaded. Entries point into its mapping,
+    // which stays open until the state is destroyed.
+    //
+    struct AssetPack *assets;
 
     VkSwapchainKHR swapchain;
     VkFormat swapchain_format;
     VkExtent2D swapchain_extent;
 
+    //
+    // When headless, these hold the offscreen images and their views, and
+    // offscreen_allocations_MemoryAllocation holds the memory backing each image.
+    //
     struct RawVector swapchain_images_VkImage;
     struct RawVector swapchain_image_views_VkImageView;
+    struct RawVector offscreen_allocations_MemoryAllocation;
 
     VkRenderPass renderpass;
 
-    VkPipeline pipeline;
-    VkPipelineLayout pipeline_layout;
+    struct PipelineRegistry *pipelines;
+    VkPipelineCache pipeline_cache;
+    const char *pipeline_cache_path;
 
     struct RawVector framebuffers_VkFramebuffer;
 
-    VkCommandPool command_pool;
-    struct RawVector command_buffers;
+    struct FrameRecorder *recorder;
+
+    //
+    // NULL when chunks are not culled on the GPU
+    //
+    struct ChunkCuller *culler;
+
+    //
+    // NULL unless the map is streamed in chunks, in which case the instance
+    // buffer is the world's and instance_buffer is VK_NULL_HANDLE
+    //
+    struct ChunkManager *world;
 
     VkBuffer vertex_buffer;
-    VkDeviceMemory vertex_buffer_memory;
+    struct MemoryAllocation vertex_buffer_allocation;
+
+    VkBuffer index_buffer;
+    struct MemoryAllocation index_buffer_allocation;
+
+    VkBuffer instance_buffer;
+    struct MemoryAllocation instance_buffer_allocation;
+    uint32_t instance_count;
+    struct TileLayerRange layers[MAX_TILE_LAYERS];
+    uint32_t layer_count;
+
+    struct MemoryAllocator *allocator;
+    struct UploadContext upload;
+
+    struct UniformRing uniforms;
+    struct TileAtlas atlas;
+    struct FullscreenTilemap tilemap;
+    struct Camera camera;
 };
 
-struct VulkanState vulkan_state_create(); 
+struct VulkanConfig vulkan_config_default();
+struct VulkanState vulkan_state_create(struct VulkanConfig *config); 
 void vulkan_swapchain_recreate(struct VulkanState *state);
-void main_loop();
+struct TileDrawBuffers vulkan_state_draw_buffers(struct VulkanState *state);
+struct TileDrawUniforms vulkan_state_frame_uniforms(
+    struct VulkanState *state, uint32_t frame_index, const struct Camera *camera, float time_seconds);
+struct PipelineCompileStats vulkan_state_pipeline_compile_stats(struct VulkanState *state);
+void main_loop(struct VulkanState *state);
 void vulkan_state_destroy(struct VulkanState *state);
 
 
@@ -0,0 +1,116 @@
+//
+// Helpers for choosing and allocating device memory.
+//
+#ifndef VULKAN_MEMORY_H
+#define VULKAN_MEMORY_H
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <language/range_allocator.h>
+#include <language/raw_vector.h>
+
+//
+// Size of each block of device memory the allocator sub-allocates from.
+// Requests of at least MEMORY_DEDICATED_THRESHOLD get their own allocation.
+//
+#define MEMORY_BLOCK_SIZE          (64ull * 1024 * 1024)
+#define MEMORY_DEDICATED_THRESHOLD (MEMORY_BLOCK_SIZE / 2)
+
+#define MEMORY_DEDICATED_BLOCK UINT32_MAX
+
+//
+// One vkAllocateMemory which resources are placed inside. Buffers (linear)
+// and optimally tiled images never share a block, so bufferImageGranularity
+// never has to be considered between neighbours. Host visible blocks stay
+// mapped for their whole lifetime.
+//
+struct MemoryBlock {
+    VkDeviceMemory memory;
+    uint32_t memory_type_index;
+    bool linear;
+    uint8_t *mapped;
+    struct RangeAllocator ranges;
+};
+
+//
+// Where a resource's memory lives. block_index is MEMORY_DEDICATED_BLOCK
+// when the resource has a vkAllocateMemory of its own. mapped is NULL
+// unless the memory is host visible.
+//
+struct MemoryAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint8_t *mapped;
+    uint32_t block_index;
+};
+
+struct MemoryAllocatorStats {
+    uint32_t block_count;
+    uint32_t dedicated_count;
+    uint32_t allocation_count;
+    VkDeviceSize bytes_reserved;
+    VkDeviceSize bytes_used;
+    VkDeviceSize bytes_free;
+    VkDeviceSize largest_free_range;
+    size_t free_range_count;
+    //
+    // 0 when all free space in the blocks is one range, approaching 1 as
+    // it is split into many small ones.
+    //
+    double fragmentation;
+};
+
+//
+// Sub-allocates resources from large blocks of device memory. Safe to use
+// from several threads. Must not be copied after memory_allocator_init.
+//
+struct MemoryAllocator {
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+
+    pthread_mutex_t mutex;
+    struct RawVector blocks_MemoryBlock;
+
+    uint32_t dedicated_count;
+    VkDeviceSize dedicated_bytes;
+};
+
+bool try_find_memory_type_index(VkPhysicalDevice physical_device, uint32_t type_bits, VkMemoryPropertyFlags desired_properties, uint32_t *index);
+uint32_t find_memory_type_index(VkPhysicalDevice physical_device, uint32_t type_bits, VkMemoryPropertyFlags desired_properties);
+
+void memory_allocator_init(struct MemoryAllocator *allocator, VkPhysicalDevice physical_device, VkDevice device);
+void memory_allocator_destroy(struct MemoryAllocator *allocator);
+
+struct MemoryAllocation memory_allocate(
+    struct MemoryAllocator *allocator,
+    const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags required_properties,
+    VkMemoryPropertyFlags preferred_properties,
+    bool linear);
+void memory_free(struct MemoryAllocator *allocator, struct MemoryAllocation *allocation);
+
+VkBuffer create_buffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage);
+VkBuffer create_buffer_with_memory(
+    struct MemoryAllocator *allocator,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags required_properties,
+    VkMemoryPropertyFlags preferred_properties,
+    struct MemoryAllocation *allocation);
+void destroy_buffer_with_memory(struct MemoryAllocator *allocator, VkBuffer buffer, struct MemoryAllocation *allocation);
+
+VkImage create_image_with_memory(
+    struct MemoryAllocator *allocator,
+    const VkImageCreateInfo *image_ci,
+    VkMemoryPropertyFlags required_properties,
+    struct MemoryAllocation *allocation);
+void destroy_image_with_memory(struct MemoryAllocator *allocator, VkImage image, struct MemoryAllocation *allocation);
+
+struct MemoryAllocatorStats memory_allocator_stats(struct MemoryAllocator *allocator);
+void memory_allocator_log_stats(struct MemoryAllocator *allocator);
+
+#endif
@@ -0,0 +1,23 @@
+//
+// Offscreen render targets used in place of a swapchain when the
+// engine runs headless (no window, no surface, no presentation).
+//
+#ifndef VULKAN_OFFSCREEN_H
+#define VULKAN_OFFSCREEN_H
+
+#include <vulkan/vulkan.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/memory.h"
+
+#define OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+struct RawVector create_offscreen_images(
+    struct MemoryAllocator *allocator,
+    VkExtent2D extent,
+    VkFormat format,
+    uint32_t count,
+    struct RawVector *rvec_MemoryAllocation);
+void destroy_offscreen_images(
+    struct MemoryAllocator *allocator, struct RawVector *rvec_VkImage, struct RawVector *rvec_MemoryAllocation);
+
+#endif
@@ -1,6 +1,68 @@
+#ifndef VULKAN_PIPELINE_H
+#define VULKAN_PIPELINE_H
+
 #include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <language/asset_pack.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/camera.h"
+
+//
+// Specialization constant ids shared with the shaders
+//
+#define SPECIALIZATION_LAYER_MODE 0
+
+//
+// Descriptor sets of the tile pipeline layout: the uniform ring's per-frame
+// parameters, the tile atlas and the tile IDs of the fullscreen tilemap.
+//
+#define TILE_SET_FRAME   0
+#define TILE_SET_ATLAS   1
+#define TILE_SET_TILEMAP 2
+#define TILE_SET_COUNT   3
+
+//
+// The shaders a pipeline runs. Tiles draws one instanced quad per tile;
+// tilemap draws a single fullscreen triangle which looks up the tile under
+// each pixel, with no vertex input.
+//
+enum PipelineProgram {
+    PIPELINE_PROGRAM_TILES = 0,
+    PIPELINE_PROGRAM_TILEMAP = 1,
+};
+
+enum BlendMode {
+    BLEND_MODE_OPAQUE = 0,
+    BLEND_MODE_ALPHA = 1,
+    BLEND_MODE_ADDITIVE = 2,
+};
+
+//
+// Everything which distinguishes one graphics pipeline variant from another.
+// layer_mode is a TileLayerMode, passed to the fragment shader as a
+// specialization constant.
+//
+struct PipelineKey {
+    VkRenderPass renderpass;
+    uint32_t program;
+    uint32_t topology;
+    uint32_t blend_mode;
+    uint32_t layer_mode;
+};
+
+bool pipeline_key_equal(const struct PipelineKey *a, const struct PipelineKey *b);
+VkPipelineLayout create_pipeline_layout(VkDevice device, const VkDescriptorSetLayout set_layouts[TILE_SET_COUNT]);
+VkPipeline create_graphics_pipeline(
+    VkDevice device,
+    VkPipelineCache cache,
+    VkPipelineLayout layout,
+    VkShaderModule vertex_module,
+    VkShaderModule fragment_module,
+    const struct PipelineKey *key);
+VkShaderModule create_shader_module(VkDevice device, const uint32_t *code, size_t code_size); 
+VkShaderModule create_asset_shader_module(
+    VkDevice device, const struct AssetPack *assets, const char *name, const uint32_t *code, size_t code_size);
+VkRenderPass create_render_pass(VkDevice device, VkFormat image_format, VkImageLayout final_layout); 
+struct RawVector create_framebuffers(VkDevice device, VkRenderPass renderpass, VkExtent2D extent, struct RawVector *rvec_VkImageView); 
 
-VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D sc_extent, VkRenderPass renderpass, VkPipelineLayout *layout);
-VkShaderModule create_shader_module(VkDevice device, uint8_t *bytecode_buffer, size_t buffer_size); 
-VkRenderPass create_render_pass(VkDevice device, VkFormat image_format); 
-struct RawVector create_framebuffers(VkDevice device, VkRenderPass renderpass, VkExtent2D extent, struct RawVector *rvec_VkImageView); 
\ No newline at end of file
+#endif
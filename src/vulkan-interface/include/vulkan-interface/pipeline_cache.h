@@ -0,0 +1,32 @@
+//
+// A VkPipelineCache persisted to disk between runs, so pipelines compiled
+// by one launch are reused by the next.
+//
+#ifndef VULKAN_PIPELINE_CACHE_H
+#define VULKAN_PIPELINE_CACHE_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+
+#define PIPELINE_CACHE_MAGIC 0x48435050u /* "PPCH" */
+
+//
+// Written in front of the driver's cache data. The driver's own header
+// identifies the device but not the driver build, so a driver update would
+// otherwise hand it data it may reject or, worse, misread.
+//
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+};
+
+VkPipelineCache pipeline_cache_load(VkPhysicalDevice physical_device, VkDevice device, const char *filename, bool *warm);
+void pipeline_cache_save(VkPhysicalDevice physical_device, VkDevice device, VkPipelineCache cache, const char *filename);
+
+#endif
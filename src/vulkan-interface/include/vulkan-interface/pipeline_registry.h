@@ -0,0 +1,89 @@
+//
+// Builds graphics pipeline variants on demand and hands out cached handles.
+// Every variant shares one pipeline layout, and the shader modules of its
+// program; they differ only in what their PipelineKey describes. Variants
+// can be built on the calling thread or requested from a pool of compile
+// threads, in which case a fallback variant is drawn with until they are
+// ready.
+//
+#ifndef VULKAN_PIPELINE_REGISTRY_H
+#define VULKAN_PIPELINE_REGISTRY_H
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include <language/raw_vector.h>
+#include <language/thread_pool.h>
+#include "vulkan-interface/deletion_queue.h"
+#include "vulkan-interface/pipeline.h"
+#include "vulkan-interface/vertex.h"
+
+#define PIPELINE_COMPILE_THREADS 2
+
+//
+// A variant whose pipeline is VK_NULL_HANDLE is still being compiled.
+//
+struct PipelineRegistryEntry {
+    struct PipelineKey key;
+    VkPipeline pipeline;
+    uint64_t request_ns;
+};
+
+//
+// How the background compiles are doing: how many requested variants are
+// not built yet, and how long the finished ones took from request to ready.
+//
+struct PipelineCompileStats {
+    uint32_t queue_depth;
+    uint32_t completed;
+    double mean_latency_ms;
+    double max_latency_ms;
+};
+
+//
+// The registry holds a mutex, so it must not be copied after
+// pipeline_registry_init. Lookups and requests are made from the render
+// thread; the compile threads only ever complete entries.
+//
+struct PipelineRegistry {
+    VkDevice device;
+    VkPipelineCache cache;
+    VkPipelineLayout layout;
+    VkShaderModule vertex_module;
+    VkShaderModule fragment_module;
+    VkShaderModule tilemap_vertex_module;
+    VkShaderModule tilemap_fragment_module;
+
+    pthread_mutex_t mutex;
+    struct ThreadPool compile_threads;
+    struct RawVector entries_PipelineRegistryEntry;
+
+    uint32_t hits;
+    uint32_t misses;
+    uint64_t build_ns;
+
+    uint32_t compile_queue_depth;
+    uint32_t compiles_completed;
+    uint64_t compile_latency_total_ns;
+    uint64_t compile_latency_max_ns;
+};
+
+void pipeline_registry_init(
+    struct PipelineRegistry *registry,
+    VkDevice device,
+    VkPipelineCache cache,
+    const VkDescriptorSetLayout set_layouts[TILE_SET_COUNT],
+    const struct AssetPack *assets,
+    uint32_t thread_count);
+void pipeline_registry_destroy(struct PipelineRegistry *registry);
+VkPipeline pipeline_registry_get(struct PipelineRegistry *registry, const struct PipelineKey *key);
+VkPipeline pipeline_registry_request(struct PipelineRegistry *registry, const struct PipelineKey *key);
+void pipeline_registry_wait_idle(struct PipelineRegistry *registry);
+struct PipelineCompileStats pipeline_registry_compile_stats(struct PipelineRegistry *registry);
+void pipeline_registry_forget_renderpass(
+    struct PipelineRegistry *registry, VkRenderPass renderpass, struct DeletionQueue *deletions, uint64_t last_use);
+struct PipelineKey pipeline_key_for_layer(VkRenderPass renderpass, uint32_t layer_mode);
+struct PipelineKey pipeline_key_for_tilemap(VkRenderPass renderpass);
+struct PipelineKey pipeline_key_for_layer_range(VkRenderPass renderpass, const struct TileLayerRange *layer);
+bool pipeline_key_fallback(const struct PipelineKey *key, struct PipelineKey *fallback);
+
+#endif
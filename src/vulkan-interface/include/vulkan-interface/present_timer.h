@@ -0,0 +1,67 @@
+//
+// Measures how long frames take from the CPU starting them to the
+// presentation engine showing them, with VK_KHR_present_id and
+// VK_KHR_present_wait. Every present is given the next present ID and
+// handed to a thread of the timer's own, which waits for each in turn with
+// vkWaitForPresentKHR and records the latency as soon as the wait returns.
+// The render thread never blocks on a present.
+//
+#ifndef VULKAN_PRESENT_TIMER_H
+#define VULKAN_PRESENT_TIMER_H
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <language/raw_vector.h>
+
+//
+// Presents waiting to be timed at most. If the presentation engine falls
+// further behind than this, the oldest are dropped untimed.
+//
+#define PRESENT_TIMER_CAPACITY 64
+
+//
+// How long one vkWaitForPresentKHR may block, so the timer thread notices
+// forgotten swapchains and shutdown promptly. It does not limit how long a
+// present can take to be timed.
+//
+#define PRESENT_TIMER_WAIT_NS 2000000ull
+
+struct PresentTimerEntry {
+    VkSwapchainKHR swapchain;
+    uint64_t present_id;
+    uint64_t start_ns;
+};
+
+//
+// Presents are queued by the render thread and timed by the timer thread;
+// everything below the mutex is shared and only touched with it held. The
+// timer holds a mutex and a thread, so it must not be copied once
+// initialised.
+//
+struct PresentTimer {
+    VkDevice device;
+    PFN_vkWaitForPresentKHR wait_for_present;
+    pthread_t thread;
+    uint64_t next_present_id;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    struct PresentTimerEntry pending[PRESENT_TIMER_CAPACITY];
+    uint32_t pending_head;
+    uint32_t pending_count;
+    VkSwapchainKHR waiting_on;
+    bool stopping;
+    struct RawVector latency_ms_double;
+    uint64_t timed;
+    uint64_t dropped;
+};
+
+void present_timer_init(struct PresentTimer *timer, VkDevice device);
+void present_timer_destroy(struct PresentTimer *timer);
+uint64_t present_timer_next_id(struct PresentTimer *timer);
+void present_timer_presented(struct PresentTimer *timer, VkSwapchainKHR swapchain, uint64_t present_id, uint64_t start_ns);
+void present_timer_forget_swapchain(struct PresentTimer *timer, VkSwapchainKHR swapchain);
+void present_timer_collect(struct PresentTimer *timer, struct RawVector *latency_ms_double);
+
+#endif
@@ -0,0 +1,68 @@
+//
+// Holds on to swapchains replaced by a recreation until the presentation
+// engine is done with them, then hands them to the deletion queue. The
+// timeline only says the GPU has finished rendering into a swapchain's
+// images, not that the presents queued to it have been processed.
+//
+// With VK_EXT_swapchain_maintenance1 every present carries a fence from a
+// small pool, and an old swapchain is let go once none of its present
+// fences are still unsignalled. Without it there is no way to ask, so an
+// old swapchain is kept until MAX_FRAMES_IN_FLIGHT further frames have
+// been presented to its replacements. Either way the render thread only
+// polls; it never waits on the presentation queue.
+//
+#ifndef VULKAN_RETIRED_SWAPCHAINS_H
+#define VULKAN_RETIRED_SWAPCHAINS_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/deletion_queue.h"
+#include "vulkan-interface/frame_sync.h"
+#include "vulkan-interface/present_timer.h"
+
+//
+// presents_left only counts down without present fences.
+//
+struct RetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    uint32_t presents_left;
+};
+
+struct PresentFence {
+    VkFence fence;
+    VkSwapchainKHR swapchain;
+};
+
+//
+// Used from the render thread only. present_timer may be NULL.
+//
+struct RetiredSwapchains {
+    VkDevice device;
+    struct FrameSync *sync;
+    struct DeletionQueue *deletions;
+    struct PresentTimer *present_timer;
+    bool present_fences;
+
+    struct RawVector retired_RetiredSwapchain;
+    struct RawVector pending_PresentFence;
+    struct RawVector free_VkFence;
+
+    uint64_t retired;
+    uint64_t fences_created;
+};
+
+void retired_swapchains_init(
+    struct RetiredSwapchains *retired,
+    VkDevice device,
+    struct FrameSync *sync,
+    struct DeletionQueue *deletions,
+    struct PresentTimer *present_timer,
+    bool present_fences);
+void retired_swapchains_destroy(struct RetiredSwapchains *retired);
+void retired_swapchains_add(struct RetiredSwapchains *retired, VkSwapchainKHR swapchain);
+VkFence retired_swapchains_present_fence(struct RetiredSwapchains *retired, VkSwapchainKHR swapchain);
+void retired_swapchains_presented(struct RetiredSwapchains *retired);
+uint32_t retired_swapchains_collect(struct RetiredSwapchains *retired);
+
+#endif
@@ -0,0 +1,39 @@
+//
+// SPIR-V for every shader, compiled from shaders/ and linked into the
+// library at build time (see cmake/embed_shaders.cmake). Sizes are in bytes.
+// The same SPIR-V is also packed into the asset pack under the *_ASSET
+// names, and is taken from there instead when a pack is loaded. A pack is
+// only loaded by the build whose asset_build_id it was packed with, which
+// changes whenever a shader does, so packed shaders always match the code
+// around them.
+//
+#ifndef VULKAN_SHADERS_H
+#define VULKAN_SHADERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHADER_VERT_ASSET     "shaders/shader.vert.spv"
+#define SHADER_FRAG_ASSET     "shaders/shader.frag.spv"
+#define TILEMAP_VERT_ASSET    "shaders/tilemap.vert.spv"
+#define TILEMAP_FRAG_ASSET    "shaders/tilemap.frag.spv"
+#define CHUNK_CULL_COMP_ASSET "shaders/chunk_cull.comp.spv"
+
+extern const uint32_t shader_vert_spv[];
+extern const size_t shader_vert_spv_size;
+
+extern const uint32_t shader_frag_spv[];
+extern const size_t shader_frag_spv_size;
+
+extern const uint32_t tilemap_vert_spv[];
+extern const size_t tilemap_vert_spv_size;
+
+extern const uint32_t tilemap_frag_spv[];
+extern const size_t tilemap_frag_spv_size;
+
+extern const uint32_t chunk_cull_comp_spv[];
+extern const size_t chunk_cull_comp_spv_size;
+
+extern const uint64_t asset_build_id;
+
+#endif
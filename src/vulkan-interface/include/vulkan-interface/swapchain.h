@@ -1,6 +1,7 @@
 #include <vulkan/vulkan.h>
 #include <stdbool.h>
 #include <language/raw_vector.h>
+#include "vulkan-interface/frame_pacing.h"
 
 bool is_swapchain_adequate(VkPhysicalDevice device, VkSurfaceKHR surface); 
 
@@ -12,7 +13,10 @@ VkSwapchainKHR create_swapchain(
     uint32_t window_height,
     uint32_t graphics_qfidx,
     uint32_t present_qfidx,
+    VkSwapchainKHR old_swapchain,
+    const struct FramePacing *pacing,
     VkFormat *fill_format,
-    VkExtent2D *fill_extent); 
+    VkExtent2D *fill_extent,
+    VkPresentModeKHR *fill_present_mode); 
 
 struct RawVector create_swapchain_image_views(VkDevice device, struct RawVector rvec_VkImage, VkFormat format);
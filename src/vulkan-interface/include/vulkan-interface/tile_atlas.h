@@ -0,0 +1,73 @@
+//
+// The images tiles are drawn with, one per layer of a 2D texture array so
+// that an instance's atlas_index selects its layer directly. Every tile type
+// lives in the one image behind one descriptor set, so any number of them
+// draw without rebinding anything. Tiles are cut from a PPM tile sheet, or
+// generated when there is none, and uploaded with a single staging copy
+// covering every layer; the mip chain is then generated on the GPU.
+//
+#ifndef VULKAN_TILE_ATLAS_H
+#define VULKAN_TILE_ATLAS_H
+
+#include <vulkan/vulkan.h>
+#include <language/asset_pack.h>
+#include "vulkan-interface/deletion_queue.h"
+#include "vulkan-interface/descriptor.h"
+#include "vulkan-interface/frame_sync.h"
+#include "vulkan-interface/memory.h"
+
+//
+// Width and height of one tile, in pixels. Tile sheets must be a whole
+// number of tiles in each direction; tiles are read left to right, then
+// top to bottom.
+//
+#define TILE_ATLAS_TILE_SIZE 32
+
+//
+// Tiles generated when no tile sheet is given
+//
+#define TILE_ATLAS_GENERATED_TILES 1024
+
+//
+// Name of the tile sheet in the asset pack, drawn when no other is given
+//
+#define TILE_ATLAS_SHEET_ASSET "tile_sheet.ppm"
+
+#define TILE_ATLAS_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+
+#define TILE_ATLAS_BINDING 0
+
+//
+// command_pool holds the upload's command buffer, which must outlive it.
+//
+struct TileAtlas {
+    VkDevice device;
+    struct MemoryAllocator *allocator;
+    struct DescriptorAllocator *descriptors;
+
+    VkImage image;
+    struct MemoryAllocation allocation;
+    VkImageView view;
+    VkSampler sampler;
+    uint32_t layer_count;
+    uint32_t mip_levels;
+
+    VkCommandPool command_pool;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorSet descriptor_set;
+};
+
+void tile_atlas_init(
+    struct TileAtlas *atlas,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    struct DeletionQueue *deletions,
+    struct FrameSync *sync,
+    VkQueue graphics_queue,
+    uint32_t graphics_family_index,
+    const struct AssetPack *assets,
+    const char *tile_sheet_path);
+void tile_atlas_destroy(struct TileAtlas *atlas);
+
+#endif
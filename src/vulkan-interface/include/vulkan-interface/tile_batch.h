@@ -0,0 +1,40 @@
+//
+// Batch rendering of map tiles: every tile in a list is rendered
+// offscreen through a camera framing its z/x/y region of the map, read
+// back through a ring of host visible staging buffers, and encoded to an
+// image file on a pool of worker threads.
+//
+#ifndef VULKAN_TILE_BATCH_H
+#define VULKAN_TILE_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/interface-vk.h"
+
+#define TILE_BATCH_PATH_LENGTH 512
+
+struct TileCoord {
+    uint32_t z;
+    uint32_t x;
+    uint32_t y;
+};
+
+struct TileBatchStats {
+    size_t tile_count;
+    double seconds;
+    double tiles_per_second;
+    double mean_latency_ms;
+    double p50_latency_ms;
+    double p99_latency_ms;
+    double max_latency_ms;
+};
+
+struct RawVector read_tile_list_FREE(const char *filename);
+struct TileBatchStats render_tile_batch(
+    struct VulkanState *state,
+    struct RawVector *rvec_TileCoord,
+    const char *output_directory,
+    uint32_t worker_count);
+
+#endif
@@ -0,0 +1,81 @@
+//
+// A persistently mapped ring buffer for uniform data which changes every
+// frame. The buffer is split into one region per frame in flight; each
+// frame bump allocates from its own region, and the region is reset once
+// the GPU has finished the frame which last used it. Allocations are bound
+// through a single dynamic uniform buffer descriptor at their offset, so
+// nothing is ever written to a descriptor set after startup.
+//
+#ifndef VULKAN_UNIFORM_RING_H
+#define VULKAN_UNIFORM_RING_H
+
+#include <vulkan/vulkan.h>
+#include <cglm/cglm.h>
+#include "vulkan-interface/camera.h"
+#include "vulkan-interface/descriptor.h"
+#include "vulkan-interface/memory.h"
+
+#define UNIFORM_RING_FRAME_SIZE (64 * 1024)
+
+#define UNIFORM_RING_BINDING 0
+
+//
+// Per-frame shading parameters of the tile shaders. Laid out as std140,
+// and must match the TileFrameParams block of shader.frag.
+//
+struct TileFrameParams {
+    vec4 overlay_color;
+    float atlas_mix;
+    float time_seconds;
+    float padding[2];
+};
+
+//
+// Everything a tile draw binds besides its buffers: the pipeline layout,
+// the ring's descriptor set at this frame's params, the tile atlas, the
+// fullscreen tilemap and the camera.
+//
+struct TileDrawUniforms {
+    VkPipelineLayout layout;
+    VkDescriptorSet descriptor_set;
+    uint32_t dynamic_offset;
+    VkDescriptorSet atlas_set;
+    VkDescriptorSet tilemap_set;
+    struct CameraPushConstants camera;
+};
+
+//
+// frame_offset is where the current frame's region starts, and used how
+// much of it has been handed out. set_layout and descriptor_set belong to
+// the descriptor allocator the ring was created with.
+//
+struct UniformRing {
+    VkDevice device;
+    struct MemoryAllocator *allocator;
+    struct DescriptorAllocator *descriptors;
+
+    VkBuffer buffer;
+    struct MemoryAllocation allocation;
+    VkDeviceSize frame_size;
+    VkDeviceSize alignment;
+    uint32_t frame_count;
+
+    VkDeviceSize frame_offset;
+    VkDeviceSize used;
+    VkDeviceSize peak_used;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorSet descriptor_set;
+};
+
+void uniform_ring_init(
+    struct UniformRing *ring,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    uint32_t frame_count,
+    VkDeviceSize frame_size);
+void uniform_ring_destroy(struct UniformRing *ring);
+void uniform_ring_begin_frame(struct UniformRing *ring, uint32_t frame_index);
+void *uniform_ring_push(struct UniformRing *ring, VkDeviceSize size, uint32_t *dynamic_offset);
+
+#endif
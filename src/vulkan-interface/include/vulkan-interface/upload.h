@@ -0,0 +1,120 @@
+//
+// Uploads data into device local buffers through reusable host visible
+// staging buffers. Copies are queued with upload_buffer and submitted
+// together by upload_context_flush. Each upload names the stage and access
+// which first read its destination, and the copies are made visible to
+// those. When the device has a transfer-only
+// queue family the copies run on it, overlapping rendering; ownership of
+// each destination is then released to the graphics family, which
+// acquires it in a submission waiting on the transfer queue's semaphore.
+//
+#ifndef VULKAN_UPLOAD_H
+#define VULKAN_UPLOAD_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <language/raw_vector.h>
+#include "vulkan-interface/frame_sync.h"
+#include "vulkan-interface/memory.h"
+
+#define UPLOAD_STAGING_SIZE (8 * 1024 * 1024)
+
+//
+// Staging buffers are used round robin, so the CPU can fill one while the
+// copies out of the others are still running.
+//
+#define UPLOAD_SLOT_COUNT 2
+
+//
+// A pending copy out of the staging buffer. dst_stage and dst_access are
+// where the destination is first read after the copy.
+//
+struct UploadCopy {
+    VkBuffer dst_buffer;
+    VkDeviceSize dst_offset;
+    VkDeviceSize staging_offset;
+    VkDeviceSize size;
+    VkPipelineStageFlags dst_stage;
+    VkAccessFlags dst_access;
+};
+
+//
+// One staging buffer and the command buffers which copy out of it.
+// acquire_command_buffer is VK_NULL_HANDLE unless ownership is transferred.
+// timeline_value is the frame timeline value after which the slot's
+// copies are complete and visible to the graphics queue.
+//
+struct UploadSlot {
+    VkBuffer staging_buffer;
+    struct MemoryAllocation staging_allocation;
+
+    VkCommandBuffer transfer_command_buffer;
+    VkCommandBuffer acquire_command_buffer;
+    uint64_t timeline_value;
+};
+
+//
+// queue is the transfer queue, which is the graphics queue when the device
+// has no transfer-only family. In that case no ownership is transferred,
+// no acquire submission is made and transfer_timeline is VK_NULL_HANDLE.
+// submitted_value is the frame timeline value of the last flush.
+//
+struct UploadContext {
+    VkDevice device;
+    struct MemoryAllocator *allocator;
+    struct FrameSync *sync;
+
+    VkQueue queue;
+    uint32_t queue_family_index;
+    VkQueue graphics_queue;
+    uint32_t graphics_family_index;
+    bool ownership_transfer;
+
+    VkSemaphore transfer_timeline;
+    uint64_t transfer_value;
+
+    VkCommandPool command_pool;
+    VkCommandPool acquire_command_pool;
+    struct UploadSlot slots[UPLOAD_SLOT_COUNT];
+    uint32_t slot_index;
+    uint64_t submitted_value;
+
+    VkDeviceSize staging_size;
+    VkDeviceSize staging_used;
+
+    struct RawVector pending_UploadCopy;
+    VkPipelineStageFlags pending_dst_stages;
+    VkAccessFlags pending_dst_access;
+
+    uint64_t flushes;
+    uint64_t stalls;
+    uint64_t bytes_uploaded;
+};
+
+struct UploadContext upload_context_create(
+    struct MemoryAllocator *allocator,
+    struct FrameSync *sync,
+    VkQueue graphics_queue,
+    uint32_t graphics_family_index,
+    VkQueue transfer_queue,
+    uint32_t transfer_family_index,
+    VkDeviceSize staging_size);
+void upload_context_destroy(struct UploadContext *context);
+
+VkBuffer create_device_local_buffer(
+    struct MemoryAllocator *allocator,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    struct MemoryAllocation *allocation);
+void upload_buffer(
+    struct UploadContext *context,
+    VkBuffer dst_buffer,
+    VkDeviceSize dst_offset,
+    const void *data,
+    VkDeviceSize size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags dst_access);
+void upload_context_flush(struct UploadContext *context);
+void upload_context_wait(struct UploadContext *context);
+
+#endif
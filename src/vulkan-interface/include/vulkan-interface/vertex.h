@@ -1,4 +1,8 @@
+#ifndef VULKAN_VERTEX_H
+#define VULKAN_VERTEX_H
+
 #include <vulkan/vulkan.h>
+#include <stdbool.h>
 #include <cglm/vec3.h>
 #include <language/raw_vector.h>
 
@@ -7,11 +11,90 @@ struct Vertex {
     vec3 color;
 };
 
-#define NUM_QUAD_VERTICES 6
-struct Vertex quad_vertices[NUM_QUAD_VERTICES];
+//
+// Per-instance data for one tile. Every tile is drawn with the same quad;
+// position (in tiles) moves it into place, layer selects the map layer it
+// belongs to and atlas_index selects what it looks like.
+//
+struct TileInstance {
+    vec2 position;
+    uint32_t layer;
+    uint32_t atlas_index;
+};
+
+//
+// How the tiles of a layer are shaded. Each mode is its own specialization
+// of the fragment shader (see SPECIALIZATION_LAYER_MODE), not a runtime
+// branch, so the values must match shader.frag.
+//
+enum TileLayerMode {
+    TILE_LAYER_MODE_ATLAS = 0,
+    TILE_LAYER_MODE_TINTED = 1,
+    TILE_LAYER_MODE_OVERLAY = 2,
+    TILE_LAYER_MODE_COUNT,
+};
+
+#define MAX_TILE_LAYERS 4
+
+//
+// Tiles along each side of the square blocks a layer's instances are
+// ordered by, see create_tile_instance_grid.
+//
+#define TILE_BLOCK_SIZE 16
+
+//
+// The contiguous run of instances on one layer. Instances are sorted by
+// layer, so each layer is a single instanced draw with its own pipeline.
+// A fullscreen layer has no instances: it is drawn by the tilemap program
+// as one triangle covering the screen, first_instance is its layer of the
+// fullscreen tilemap and instance_count is 1.
+//
+struct TileLayerRange {
+    uint32_t first_instance;
+    uint32_t instance_count;
+    uint32_t mode;
+    bool fullscreen;
+};
+
+//
+// The buffers a tile draw reads from: the shared quad, its indices and one
+// TileInstance per tile, plus where each layer's instances start.
+//
+// When the map is streamed in chunks (see chunk_manager.h) a layer's
+// instances are not contiguous: layer i is drawn as the chunk_draw_count[i]
+// ranges of chunk_draws starting at first_chunk_draw[i], and its
+// instance_count is their total. chunk_draws is NULL otherwise.
+//
+struct TileDrawBuffers {
+    VkBuffer vertex_buffer;
+    VkBuffer index_buffer;
+    VkBuffer instance_buffer;
+    uint32_t instance_count;
+    struct TileLayerRange layers[MAX_TILE_LAYERS];
+    uint32_t layer_count;
+
+    const struct TileLayerRange *chunk_draws;
+    uint32_t first_chunk_draw[MAX_TILE_LAYERS];
+    uint32_t chunk_draw_count[MAX_TILE_LAYERS];
+};
+
+#define VERTEX_BINDING   0
+#define INSTANCE_BINDING 1
+
+#define NUM_QUAD_VERTICES 4
+#define NUM_QUAD_INDICES  6
+#define QUAD_INDEX_TYPE   VK_INDEX_TYPE_UINT16
+extern struct Vertex quad_vertices[NUM_QUAD_VERTICES];
+extern uint16_t quad_indices[NUM_QUAD_INDICES];
 
-VkVertexInputBindingDescription get_binding_description(); 
+struct RawVector get_binding_description(); 
 struct RawVector get_attribute_description(); 
-VkBuffer create_vertex_buffer(VkDevice device); 
+uint32_t tile_grid_layers(struct TileLayerRange layers[MAX_TILE_LAYERS]);
+bool tile_grid_instance(uint32_t x, uint32_t y, uint32_t layer, struct TileInstance *instance);
+struct RawVector create_tile_instance_grid(
+    uint32_t width,
+    uint32_t height,
+    struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t *layer_count);
 
-VkDeviceMemory allocate_and_bind_and_fill_vertex_buffer_memory(VkPhysicalDevice physical_device, VkDevice device, VkBuffer vertex_buffer); 
+#endif
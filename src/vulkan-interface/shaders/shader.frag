@@ -1,10 +1,55 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+//
+// TileLayerMode of the layer being drawn, supplied as a specialization
+// constant when the pipeline is built. The branches below on it are folded
+// away by the compiler, so every mode gets its own straight-line shader.
+//
+#define TILE_LAYER_MODE_ATLAS   0
+#define TILE_LAYER_MODE_TINTED  1
+#define TILE_LAYER_MODE_OVERLAY 2
+layout(constant_id = 0) const uint LAYER_MODE = TILE_LAYER_MODE_ATLAS;
+
+//
+// Width of the overlay outline, in tiles
+//
+#define OVERLAY_BORDER 0.08
+
+//
+// Per-frame parameters from the uniform ring, bound with a dynamic offset.
+// Must match struct TileFrameParams.
+//
+layout(set = 0, binding = 0) uniform TileFrameParams {
+    vec4 overlay_color;
+    float atlas_mix;
+    float time_seconds;
+} params;
+
+//
+// Every tile type, one per array layer, indexed by the instance's atlas index
+//
+layout(set = 1, binding = 0) uniform sampler2DArray atlas;
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTileUV;
+layout(location = 2) flat in uint fragAtlasIndex;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    if (LAYER_MODE == TILE_LAYER_MODE_ATLAS) {
+        vec3 texel = texture(atlas, vec3(fragTileUV, float(fragAtlasIndex))).rgb;
+        outColor = vec4(mix(fragColor, texel, params.atlas_mix), 1.0);
+    } else if (LAYER_MODE == TILE_LAYER_MODE_TINTED) {
+        vec3 texel = texture(atlas, vec3(fragTileUV, float(fragAtlasIndex))).rgb;
+        float luminance = dot(texel, vec3(0.299, 0.587, 0.114));
+        outColor = vec4(luminance * fragColor, 1.0);
+    } else {
+        vec2 edge = min(fragTileUV, 1.0 - fragTileUV);
+        if (min(edge.x, edge.y) > OVERLAY_BORDER) {
+            discard;
+        }
+        outColor = params.overlay_color;
+    }
+}
@@ -1,12 +1,29 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+//
+// The camera's view-projection, which maps tile positions (in tiles) onto
+// clip space. Must match struct CameraPushConstants.
+//
+layout(push_constant) uniform Camera {
+    mat4 view_projection;
+} camera;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
+layout(location = 2) in vec2 inTilePosition;
+layout(location = 3) in uint inLayer;
+layout(location = 4) in uint inAtlasIndex;
+
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTileUV;
+layout(location = 2) flat out uint fragAtlasIndex;
 
 void main() {
-    gl_Position = vec4(inPosition, 1.0);
+    vec2 tile = inPosition.xy + inTilePosition;
+    gl_Position = camera.view_projection * vec4(tile, inPosition.z, 1.0);
     fragColor = inColor;
-}
\ No newline at end of file
+    fragTileUV = inPosition.xy;
+    fragAtlasIndex = inAtlasIndex;
+}
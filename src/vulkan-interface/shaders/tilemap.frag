@@ -0,0 +1,41 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//
+// Every tile type, one per array layer, indexed by tile ID
+//
+layout(set = 1, binding = 0) uniform sampler2DArray atlas;
+
+//
+// The dense layers of the map as grids of tile IDs. Must match struct
+// FullscreenTilemapHeader.
+//
+layout(set = 2, binding = 0) readonly buffer TileMap {
+    uint width;
+    uint height;
+    uint layer_count;
+    uint padding;
+    uint tiles[];
+} map;
+
+layout(location = 0) in vec2 fragTilePosition;
+layout(location = 1) flat in uint fragMapLayer;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    ivec2 tile = ivec2(floor(fragTilePosition));
+    if (tile.x < 0 || tile.y < 0 || tile.x >= int(map.width) || tile.y >= int(map.height)) {
+        discard;
+    }
+    uint tile_id = map.tiles[(fragMapLayer * map.height + uint(tile.y)) * map.width + uint(tile.x)];
+
+    //
+    // The UV jumps back to 0 at every tile edge, so the mip level is chosen
+    // from the derivatives of the continuous map position instead
+    //
+    vec2 uv = fract(fragTilePosition);
+    vec3 texel = textureGrad(
+        atlas, vec3(uv, float(tile_id)), dFdx(fragTilePosition), dFdy(fragTilePosition)).rgb;
+    outColor = vec4(texel, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//
+// The camera's view-projection, which maps tile positions (in tiles) onto
+// clip space. Must match struct CameraPushConstants.
+//
+layout(push_constant) uniform Camera {
+    mat4 view_projection;
+} camera;
+
+layout(location = 0) out vec2 fragTilePosition;
+layout(location = 1) flat out uint fragMapLayer;
+
+//
+// One triangle covering the whole screen, made from the vertex index. Each
+// corner is taken back through the camera to the map position it shows;
+// the projection is orthographic, so interpolating those is exact. The
+// instance index is the tilemap layer to draw.
+//
+void main() {
+    vec2 clip = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+    gl_Position = vec4(clip, 0.0, 1.0);
+
+    vec4 map_position = inverse(camera.view_projection) * vec4(clip, 0.0, 1.0);
+    fragTilePosition = map_position.xy / map_position.w;
+    fragMapLayer = gl_InstanceIndex;
+}
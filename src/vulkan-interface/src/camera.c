@@ -0,0 +1,63 @@
+#include "vulkan-interface/camera.h"
+
+//
+// Centers the default view on the top-left CAMERA_DEFAULT_VIEW_TILES tiles
+// of the map.
+//
+struct Camera camera_default() {
+    return (struct Camera) {
+        .center = { CAMERA_DEFAULT_VIEW_TILES / 2.0f, CAMERA_DEFAULT_VIEW_TILES / 2.0f },
+        .view_tiles = CAMERA_DEFAULT_VIEW_TILES,
+    };
+}
+
+//
+// A camera which frames the size x size tiles whose top-left corner is at
+// (left, top), on a square viewport.
+//
+struct Camera camera_for_region(float left, float top, float size) {
+    return (struct Camera) {
+        .center = { left + size / 2.0f, top + size / 2.0f },
+        .view_tiles = size,
+    };
+}
+
+//
+// Moves the camera by a fraction of the visible span, so panning feels the
+// same at every zoom level.
+//
+void camera_pan(struct Camera *camera, float dx_viewports, float dy_viewports) {
+    camera->center[0] += dx_viewports * camera->view_tiles;
+    camera->center[1] += dy_viewports * camera->view_tiles;
+}
+
+//
+// Zooms out by factor (in by 1 / factor), keeping the center in place.
+//
+void camera_zoom(struct Camera *camera, float factor) {
+    camera->view_tiles *= factor;
+    if (camera->view_tiles < CAMERA_MIN_VIEW_TILES) camera->view_tiles = CAMERA_MIN_VIEW_TILES;
+    if (camera->view_tiles > CAMERA_MAX_VIEW_TILES) camera->view_tiles = CAMERA_MAX_VIEW_TILES;
+}
+
+//
+// Builds the orthographic view-projection for an extent sized viewport.
+// Map y grows downwards, as does Vulkan's clip space y, so the top of the
+// view is passed as glm_ortho's bottom.
+//
+struct CameraPushConstants camera_push_constants(const struct Camera *camera, VkExtent2D extent) {
+    float aspect = extent.height > 0 ? (float)extent.width / (float)extent.height : 1.0f;
+    float half_height = camera->view_tiles / 2.0f;
+    float half_width = half_height * aspect;
+
+    struct CameraPushConstants push;
+    glm_ortho(
+        camera->center[0] - half_width,
+        camera->center[0] + half_width,
+        camera->center[1] - half_height,
+        camera->center[1] + half_height,
+        -1.0f,
+        1.0f,
+        push.view_projection);
+    return push;
+}
@@ -0,0 +1,288 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vulkan-interface/chunk_cull.h"
+#include "vulkan-interface/pipeline.h"
+#include "vulkan-interface/shaders.h"
+#include "language/math.h"
+#include "log.h"
+
+//
+// Splits every instanced layer into chunks of at most CHUNK_CULL_INSTANCES
+// consecutive instances and bounds each one, and the chunks of each layer
+// into batches of at most max_draw_count. Fullscreen layers have no
+// instances and get no chunks.
+//
+static struct RawVector build_cull_chunks(
+    struct ChunkCuller *culler,
+    struct RawVector *rvec_TileInstance,
+    const struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t layer_count) {
+
+    struct RawVector rvec_CullChunk = raw_vector_create(sizeof(struct CullChunk), 64);
+    for (uint32_t i = 0; i < layer_count; i++) {
+        const struct TileLayerRange *layer = &layers[i];
+        uint32_t first_chunk = raw_vector_size(&rvec_CullChunk);
+        culler->layers[i] = (struct ChunkCullLayer) {
+            .first_chunk = first_chunk,
+            .chunk_count = 0,
+            .first_batch = culler->batch_count,
+        };
+        if (layer->fullscreen) {
+            continue;
+        }
+
+        for (uint32_t first = 0; first < layer->instance_count; first += CHUNK_CULL_INSTANCES) {
+            uint32_t batch = (uint32_t)(raw_vector_size(&rvec_CullChunk) - first_chunk) / culler->max_draw_count;
+            struct CullChunk chunk = {
+                .min = { INFINITY, INFINITY },
+                .max = { -INFINITY, -INFINITY },
+                .first_instance = layer->first_instance + first,
+                .instance_count = MIN(CHUNK_CULL_INSTANCES, layer->instance_count - first),
+                .command_base = first_chunk + batch * culler->max_draw_count,
+                .batch = culler->layers[i].first_batch + batch,
+            };
+            for (uint32_t j = 0; j < chunk.instance_count; j++) {
+                const struct TileInstance *instance =
+                    (struct TileInstance *)raw_vector_get_ptr(rvec_TileInstance, chunk.first_instance + j);
+                chunk.min[0] = MIN(chunk.min[0], instance->position[0]);
+                chunk.min[1] = MIN(chunk.min[1], instance->position[1]);
+                chunk.max[0] = MAX(chunk.max[0], instance->position[0] + 1.0f);
+                chunk.max[1] = MAX(chunk.max[1], instance->position[1] + 1.0f);
+            }
+            raw_vector_push_back(&rvec_CullChunk, &chunk);
+        }
+        culler->layers[i].chunk_count = raw_vector_size(&rvec_CullChunk) - first_chunk;
+        culler->batch_count += (culler->layers[i].chunk_count + culler->max_draw_count - 1) / culler->max_draw_count;
+    }
+    return rvec_CullChunk;
+}
+
+static void create_cull_pipeline(struct ChunkCuller *culler, VkPipelineCache cache, const struct AssetPack *assets) {
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(struct ChunkCullPushConstants);
+
+    VkPipelineLayoutCreateInfo layout_ci = {};
+    layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_ci.setLayoutCount = 1;
+    layout_ci.pSetLayouts = &culler->set_layout;
+    layout_ci.pushConstantRangeCount = 1;
+    layout_ci.pPushConstantRanges = &push_range;
+    if (vkCreatePipelineLayout(culler->device, &layout_ci, NULL, &culler->pipeline_layout) != VK_SUCCESS) {
+        log_fatal("Could not create chunk cull pipeline layout\n");
+        exit(EXIT_FAILURE);
+    }
+
+    culler->module = create_asset_shader_module(
+        culler->device, assets, CHUNK_CULL_COMP_ASSET, chunk_cull_comp_spv, chunk_cull_comp_spv_size);
+
+    VkComputePipelineCreateInfo pipeline_ci = {};
+    pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_ci.stage.module = culler->module;
+    pipeline_ci.stage.pName = "main";
+    pipeline_ci.layout = culler->pipeline_layout;
+    if (vkCreateComputePipelines(culler->device, cache, 1, &pipeline_ci, NULL, &culler->pipeline) != VK_SUCCESS) {
+        log_fatal("Could not create chunk cull pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+// Bounds the chunks of every instanced layer and uploads them through
+// upload, which the caller flushes. draw_indirect_count says whether the
+// device can take draw counts from a buffer; the device must support
+// multiDrawIndirect either way, and no draw is ever given more than its
+// maxDrawIndirectCount. The compute shader comes from assets when it is
+// not NULL and holds it.
+//
+void chunk_culler_init(
+    struct ChunkCuller *culler,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    struct UploadContext *upload,
+    VkPipelineCache cache,
+    const struct AssetPack *assets,
+    uint32_t frame_count,
+    bool draw_indirect_count,
+    struct RawVector *rvec_TileInstance,
+    const struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t layer_count) {
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+
+    *culler = (struct ChunkCuller) {
+        .device = allocator->device,
+        .allocator = allocator,
+        .descriptors = descriptors,
+        .draw_indirect_count = draw_indirect_count,
+        .frame_count = frame_count,
+        .batch_count = 0,
+        .max_draw_count = MAX(properties.limits.maxDrawIndirectCount, 1),
+    };
+
+    struct RawVector rvec_CullChunk = build_cull_chunks(culler, rvec_TileInstance, layers, layer_count);
+    culler->chunk_count = raw_vector_size(&rvec_CullChunk);
+
+    //
+    // Buffers are never empty, so the set can always be written
+    //
+    uint32_t slots = MAX(culler->chunk_count, 1);
+    VkDeviceSize chunks_size = sizeof(struct CullChunk) * (VkDeviceSize)slots;
+    culler->chunks = create_device_local_buffer(
+        allocator, chunks_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler->chunks_allocation);
+    if (culler->chunk_count > 0) {
+        upload_buffer(
+            upload, culler->chunks, 0, raw_vector_get_ptr(&rvec_CullChunk, 0), sizeof(struct CullChunk) * culler->chunk_count,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    raw_vector_destroy(&rvec_CullChunk);
+
+    VkDescriptorSetLayoutBinding layout_bindings[3] = {};
+    uint32_t binding_indices[3] = { CHUNK_CULL_CHUNKS_BINDING, CHUNK_CULL_COMMANDS_BINDING, CHUNK_CULL_COUNTS_BINDING };
+    for (uint32_t i = 0; i < 3; i++) {
+        layout_bindings[i].binding = binding_indices[i];
+        layout_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layout_bindings[i].descriptorCount = 1;
+        layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    culler->set_layout = descriptor_allocator_layout(descriptors, layout_bindings, 3);
+
+    for (uint32_t i = 0; i < frame_count; i++) {
+        struct ChunkCullFrame *frame = &culler->frames[i];
+        frame->commands = create_device_local_buffer(
+            allocator,
+            sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)slots,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            &frame->commands_allocation);
+        frame->counts = create_device_local_buffer(
+            allocator,
+            sizeof(uint32_t) * (VkDeviceSize)MAX(culler->batch_count, 1),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            &frame->counts_allocation);
+    }
+
+    create_cull_pipeline(culler, cache, assets);
+
+    log_info("Culling %u chunks of up to %u instances on the GPU in %u draws, %s\n",
+        culler->chunk_count,
+        CHUNK_CULL_INSTANCES,
+        culler->batch_count,
+        draw_indirect_count ? "with compacted indirect draws" : "without draw counts");
+}
+
+void chunk_culler_destroy(struct ChunkCuller *culler) {
+    vkDestroyPipeline(culler->device, culler->pipeline, NULL);
+    vkDestroyShaderModule(culler->device, culler->module, NULL);
+    vkDestroyPipelineLayout(culler->device, culler->pipeline_layout, NULL);
+    for (uint32_t i = 0; i < culler->frame_count; i++) {
+        struct ChunkCullFrame *frame = &culler->frames[i];
+        destroy_buffer_with_memory(culler->allocator, frame->commands, &frame->commands_allocation);
+        destroy_buffer_with_memory(culler->allocator, frame->counts, &frame->counts_allocation);
+    }
+    destroy_buffer_with_memory(culler->allocator, culler->chunks, &culler->chunks_allocation);
+}
+
+//
+// Records the cull pass of frame_index's draws, seen through camera. Must be
+// recorded outside the render pass, before any chunk_culler_draw_layer of
+// the same frame. The caller must know the GPU is done with frame_index's
+// previous submission, and must have begun frame_index on the descriptor
+// allocator, since the pass binds a transient set written here.
+//
+void chunk_culler_record(
+    struct ChunkCuller *culler,
+    VkCommandBuffer command_buffer,
+    uint32_t frame_index,
+    const struct CameraPushConstants *camera) {
+
+    if (culler->chunk_count == 0) {
+        return;
+    }
+    struct ChunkCullFrame *frame = &culler->frames[frame_index];
+
+    vkCmdFillBuffer(command_buffer, frame->counts, 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier counts_cleared = {};
+    counts_cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    counts_cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    counts_cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &counts_cleared, 0, NULL, 0, NULL);
+
+    struct ChunkCullPushConstants push = {
+        .chunk_count = culler->chunk_count,
+        .compact = culler->draw_indirect_count ? 1 : 0,
+    };
+    memcpy(push.view_projection, camera->view_projection, sizeof(push.view_projection));
+
+    struct DescriptorBinding bindings[3] = {
+        { .binding = CHUNK_CULL_CHUNKS_BINDING, .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .buffer = culler->chunks, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .binding = CHUNK_CULL_COMMANDS_BINDING, .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .buffer = frame->commands, .offset = 0, .range = VK_WHOLE_SIZE },
+        { .binding = CHUNK_CULL_COUNTS_BINDING, .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .buffer = frame->counts, .offset = 0, .range = VK_WHOLE_SIZE },
+    };
+    VkDescriptorSet descriptor_set = descriptor_allocator_transient(culler->descriptors, culler->set_layout);
+    descriptor_write(culler->device, descriptor_set, bindings, 3);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline);
+    vkCmdBindDescriptorSets(
+        command_buffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        culler->pipeline_layout,
+        0, 1, &descriptor_set,
+        0, NULL);
+    vkCmdPushConstants(command_buffer, culler->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(command_buffer, (culler->chunk_count + CHUNK_CULL_WORKGROUP_SIZE - 1) / CHUNK_CULL_WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier draws_written = {};
+    draws_written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    draws_written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    draws_written.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 1, &draws_written, 0, NULL, 0, NULL);
+}
+
+//
+// Draws what the cull pass left of layer, one indirect draw per batch. The
+// tile pipeline, buffers and sets must already be bound.
+//
+void chunk_culler_draw_layer(struct ChunkCuller *culler, VkCommandBuffer command_buffer, uint32_t frame_index, uint32_t layer) {
+    const struct ChunkCullLayer *range = &culler->layers[layer];
+    if (range->chunk_count == 0) {
+        return;
+    }
+    struct ChunkCullFrame *frame = &culler->frames[frame_index];
+
+    uint32_t batch = range->first_batch;
+    for (uint32_t first = 0; first < range->chunk_count; first += culler->max_draw_count, batch++) {
+        VkDeviceSize offset = sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)(range->first_chunk + first);
+        uint32_t draw_count = MIN(culler->max_draw_count, range->chunk_count - first);
+
+        if (culler->draw_indirect_count) {
+            vkCmdDrawIndexedIndirectCount(
+                command_buffer,
+                frame->commands, offset,
+                frame->counts, sizeof(uint32_t) * (VkDeviceSize)batch,
+                draw_count,
+                sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            vkCmdDrawIndexedIndirect(
+                command_buffer,
+                frame->commands, offset,
+                draw_count,
+                sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
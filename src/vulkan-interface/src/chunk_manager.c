@@ -0,0 +1,788 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "language/clock.h"
+#include "language/math.h"
+#include "language/tile_codec.h"
+#include "vulkan-interface/chunk_manager.h"
+#include "log.h"
+
+//
+// Unlinks slot from the recency list.
+//
+static void chunk_lru_unlink(struct ChunkManager *manager, uint32_t slot) {
+    struct ChunkSlot *s = &manager->slots[slot];
+    if (s->prev != CHUNK_SLOT_NONE) {
+        manager->slots[s->prev].next = s->next;
+    } else {
+        manager->lru_head = s->next;
+    }
+    if (s->next != CHUNK_SLOT_NONE) {
+        manager->slots[s->next].prev = s->prev;
+    } else {
+        manager->lru_tail = s->prev;
+    }
+    s->prev = CHUNK_SLOT_NONE;
+    s->next = CHUNK_SLOT_NONE;
+}
+
+static void chunk_lru_push_front(struct ChunkManager *manager, uint32_t slot) {
+    struct ChunkSlot *s = &manager->slots[slot];
+    s->prev = CHUNK_SLOT_NONE;
+    s->next = manager->lru_head;
+    if (manager->lru_head != CHUNK_SLOT_NONE) {
+        manager->slots[manager->lru_head].prev = slot;
+    } else {
+        manager->lru_tail = slot;
+    }
+    manager->lru_head = slot;
+}
+
+static void chunk_lru_push_back(struct ChunkManager *manager, uint32_t slot) {
+    struct ChunkSlot *s = &manager->slots[slot];
+    s->next = CHUNK_SLOT_NONE;
+    s->prev = manager->lru_tail;
+    if (manager->lru_tail != CHUNK_SLOT_NONE) {
+        manager->slots[manager->lru_tail].next = slot;
+    } else {
+        manager->lru_head = slot;
+    }
+    manager->lru_tail = slot;
+}
+
+static uint32_t chunk_grid_index(uint32_t chunk_x, uint32_t chunk_y) {
+    return (chunk_y & (CHUNK_GRID_SIZE - 1)) * CHUNK_GRID_SIZE + (chunk_x & (CHUNK_GRID_SIZE - 1));
+}
+
+static uint32_t *chunk_grid_cell(struct ChunkManager *manager, uint32_t chunk_x, uint32_t chunk_y) {
+    return &manager->grid[chunk_grid_index(chunk_x, chunk_y)];
+}
+
+//
+// The resident slot holding chunk (chunk_x, chunk_y), or CHUNK_SLOT_NONE.
+//
+static uint32_t chunk_manager_find(struct ChunkManager *manager, uint32_t chunk_x, uint32_t chunk_y) {
+    uint32_t slot = *chunk_grid_cell(manager, chunk_x, chunk_y);
+    if (slot == CHUNK_SLOT_NONE) {
+        return CHUNK_SLOT_NONE;
+    }
+    const struct ChunkSlot *s = &manager->slots[slot];
+    if (!s->resident || s->chunk_x != chunk_x || s->chunk_y != chunk_y) {
+        return CHUNK_SLOT_NONE;
+    }
+    return slot;
+}
+
+//
+// Drops the chunk in slot, leaving the slot least recently used so it is
+// the next one handed out.
+//
+static void chunk_manager_evict(struct ChunkManager *manager, uint32_t slot) {
+    struct ChunkSlot *s = &manager->slots[slot];
+    uint32_t *cell = chunk_grid_cell(manager, s->chunk_x, s->chunk_y);
+    if (*cell == slot) {
+        *cell = CHUNK_SLOT_NONE;
+    }
+    s->resident = false;
+    chunk_lru_unlink(manager, slot);
+    chunk_lru_push_back(manager, slot);
+    manager->stats.evicted++;
+}
+
+//
+// Takes the least recently visible slot for a new chunk, or returns
+// CHUNK_SLOT_NONE if it is visible this update or still being drawn by a
+// frame in flight. Either way everything else is more recent, so no other
+// slot could do better.
+//
+static uint32_t chunk_manager_take_slot(struct ChunkManager *manager) {
+    uint32_t slot = manager->lru_tail;
+    struct ChunkSlot *s = &manager->slots[slot];
+    if (s->resident && s->visible_update == manager->stats.updates) {
+        return CHUNK_SLOT_NONE;
+    }
+    if (!frame_sync_is_complete(manager->sync, s->last_used_value)) {
+        return CHUNK_SLOT_NONE;
+    }
+    if (s->resident) {
+        chunk_manager_evict(manager, slot);
+    }
+    return slot;
+}
+
+//
+// Gives slot to chunk (chunk_x, chunk_y), whose instances are then built
+// by a stream job. The slot is not drawn until that job is uploaded.
+//
+static void chunk_manager_assign(struct ChunkManager *manager, uint32_t slot, uint32_t chunk_x, uint32_t chunk_y) {
+    //
+    // The cell may still point at a chunk which lands on the same cell and
+    // is no longer visible; it can never be found again, so it goes first
+    //
+    uint32_t *cell = chunk_grid_cell(manager, chunk_x, chunk_y);
+    if (*cell != CHUNK_SLOT_NONE && *cell != slot && manager->slots[*cell].resident) {
+        chunk_manager_evict(manager, *cell);
+    }
+
+    struct ChunkSlot *s = &manager->slots[slot];
+    s->chunk_x = chunk_x;
+    s->chunk_y = chunk_y;
+    s->resident = true;
+    s->streaming = true;
+    s->generation++;
+    *cell = slot;
+}
+
+//
+// Fills tiles with layer_count grids of the generated map's chunk
+// (chunk_x, chunk_y), in the layout of a tilemap file payload.
+//
+static void generate_chunk_tiles(
+    uint32_t width, uint32_t height, uint32_t layer_count, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles) {
+
+    uint32_t x0 = chunk_x * CHUNK_SIZE;
+    uint32_t y0 = chunk_y * CHUNK_SIZE;
+    for (uint32_t layer = 0; layer < layer_count; layer++) {
+        for (uint32_t y = 0; y < CHUNK_SIZE; y++) {
+            for (uint32_t x = 0; x < CHUNK_SIZE; x++) {
+                struct TileInstance instance;
+                bool inside = x0 + x < width && y0 + y < height;
+                bool present = inside && tile_grid_instance(x0 + x, y0 + y, layer, &instance);
+                tiles[layer * CHUNK_TILES + y * CHUNK_SIZE + x] = present ? instance.atlas_index : TILEMAP_FILE_EMPTY_TILE;
+            }
+        }
+    }
+}
+
+static struct ChunkCacheEntry *chunk_cache_entry(struct ChunkManager *manager, uint32_t index) {
+    return (struct ChunkCacheEntry *)raw_vector_get_ptr(&manager->cache_ChunkCacheEntry, index);
+}
+
+//
+// Unlinks cache entry index from the recency list.
+//
+static void chunk_cache_lru_unlink(struct ChunkManager *manager, uint32_t index) {
+    struct ChunkCacheEntry *entry = chunk_cache_entry(manager, index);
+    if (entry->prev != CHUNK_CACHE_NONE) {
+        chunk_cache_entry(manager, entry->prev)->next = entry->next;
+    } else {
+        manager->cache_lru_head = entry->next;
+    }
+    if (entry->next != CHUNK_CACHE_NONE) {
+        chunk_cache_entry(manager, entry->next)->prev = entry->prev;
+    } else {
+        manager->cache_lru_tail = entry->prev;
+    }
+    entry->prev = CHUNK_CACHE_NONE;
+    entry->next = CHUNK_CACHE_NONE;
+}
+
+static void chunk_cache_lru_push_front(struct ChunkManager *manager, uint32_t index) {
+    struct ChunkCacheEntry *entry = chunk_cache_entry(manager, index);
+    entry->prev = CHUNK_CACHE_NONE;
+    entry->next = manager->cache_lru_head;
+    if (manager->cache_lru_head != CHUNK_CACHE_NONE) {
+        chunk_cache_entry(manager, manager->cache_lru_head)->prev = index;
+    } else {
+        manager->cache_lru_tail = index;
+    }
+    manager->cache_lru_head = index;
+}
+
+//
+// The cache entry holding generated chunk (chunk_x, chunk_y), or
+// CHUNK_CACHE_NONE. Only the entries sharing the chunk's grid cell are
+// looked at.
+//
+static uint32_t chunk_cache_find(struct ChunkManager *manager, uint32_t chunk_x, uint32_t chunk_y) {
+    uint32_t index = manager->cache_grid[chunk_grid_index(chunk_x, chunk_y)];
+    while (index != CHUNK_CACHE_NONE) {
+        struct ChunkCacheEntry *entry = chunk_cache_entry(manager, index);
+        if (entry->chunk_x == chunk_x && entry->chunk_y == chunk_y) {
+            return index;
+        }
+        index = entry->bucket_next;
+    }
+    return CHUNK_CACHE_NONE;
+}
+
+//
+// Drops the least recently used cache entry, freeing its encoding and
+// putting the entry on the free list.
+//
+static void chunk_cache_evict_oldest(struct ChunkManager *manager) {
+    uint32_t index = manager->cache_lru_tail;
+    struct ChunkCacheEntry *entry = chunk_cache_entry(manager, index);
+    chunk_cache_lru_unlink(manager, index);
+
+    uint32_t *link = &manager->cache_grid[chunk_grid_index(entry->chunk_x, entry->chunk_y)];
+    while (*link != index) {
+        link = &chunk_cache_entry(manager, *link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+
+    manager->cache_bytes -= entry->size;
+    free(entry->encoded);
+    entry->encoded = NULL;
+    entry->bucket_next = manager->cache_free;
+    manager->cache_free = index;
+    manager->stats.cache_evicted++;
+}
+
+//
+// Keeps a copy of the size bytes of encoded as chunk (chunk_x, chunk_y),
+// dropping the least recently used entries until it fits in
+// CHUNK_CACHE_BYTES.
+//
+static void chunk_cache_store(
+    struct ChunkManager *manager, uint32_t chunk_x, uint32_t chunk_y, const uint8_t *encoded, size_t size) {
+
+    if (size > CHUNK_CACHE_BYTES || chunk_cache_find(manager, chunk_x, chunk_y) != CHUNK_CACHE_NONE) {
+        return;
+    }
+    while (manager->cache_bytes + size > CHUNK_CACHE_BYTES) {
+        chunk_cache_evict_oldest(manager);
+    }
+
+    uint32_t index = manager->cache_free;
+    if (index != CHUNK_CACHE_NONE) {
+        manager->cache_free = chunk_cache_entry(manager, index)->bucket_next;
+    } else {
+        index = (uint32_t)raw_vector_size(&manager->cache_ChunkCacheEntry);
+        raw_vector_push_back(&manager->cache_ChunkCacheEntry, &(struct ChunkCacheEntry) {0});
+    }
+    uint32_t *bucket = &manager->cache_grid[chunk_grid_index(chunk_x, chunk_y)];
+    struct ChunkCacheEntry *entry = chunk_cache_entry(manager, index);
+    *entry = (struct ChunkCacheEntry) {
+        .chunk_x = chunk_x,
+        .chunk_y = chunk_y,
+        .encoded = malloc(size > 0 ? size : 1),
+        .size = size,
+        .bucket_next = *bucket,
+        .prev = CHUNK_CACHE_NONE,
+        .next = CHUNK_CACHE_NONE,
+    };
+    if (entry->encoded == NULL) {
+        log_fatal("Could not malloc chunk cache entry\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(entry->encoded, encoded, size);
+    *bucket = index;
+    chunk_cache_lru_push_front(manager, index);
+    manager->cache_bytes += size;
+}
+
+//
+// Stream thread body: gets the tiles of job's chunk, from the mapping, by
+// decoding them, or by generating and encoding them, then builds its
+// instances. Each job has its own scratch memory and copy of its chunk's
+// coordinates, so jobs share nothing with the render thread but the
+// read-only mapping and the mutex guarding done.
+//
+static void chunk_manager_build_chunk(void *arg, uint32_t worker_index) {
+    struct ChunkStreamJob *job = arg;
+    struct ChunkManager *manager = job->manager;
+    uint64_t start_ns = clock_now_ns();
+
+    uint32_t x0 = job->chunk_x * CHUNK_SIZE;
+    uint32_t y0 = job->chunk_y * CHUNK_SIZE;
+    uint32_t x1 = MIN(x0 + CHUNK_SIZE, manager->width);
+    uint32_t y1 = MIN(y0 + CHUNK_SIZE, manager->height);
+    size_t tile_count = (size_t)CHUNK_TILES * manager->layer_count;
+
+    //
+    // Raw chunks are used straight from the mapping, encoded ones are
+    // decoded into the job's tiles first
+    //
+    const uint32_t *tiles = NULL;
+    if (manager->from_file) {
+        tiles = tilemap_file_chunk(&manager->map, job->chunk_x, job->chunk_y);
+        if (tiles == NULL && tilemap_file_read_chunk(&manager->map, job->chunk_x, job->chunk_y, job->tiles)) {
+            tiles = job->tiles;
+        }
+    } else if (job->cached) {
+        if (tile_codec_decode(job->encoded, job->encoded_size, job->tiles, tile_count)) {
+            tiles = job->tiles;
+        }
+    } else {
+        generate_chunk_tiles(manager->width, manager->height, manager->layer_count, job->chunk_x, job->chunk_y, job->tiles);
+        job->encoded_size = tile_codec_encode(job->tiles, tile_count, job->encoded);
+        tiles = job->tiles;
+    }
+    if (tiles == NULL) {
+        log_warn("Chunk %u,%u of the tilemap cannot be read, leaving it empty\n", job->chunk_x, job->chunk_y);
+    }
+
+    for (uint32_t layer = 0; layer < manager->layer_count; layer++) {
+        struct TileInstance *instances = &job->instances[layer * CHUNK_TILES];
+        uint32_t count = 0;
+        for (uint32_t y = y0; tiles != NULL && y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                uint32_t tile = tiles[layer * CHUNK_TILES + (y - y0) * CHUNK_SIZE + (x - x0)];
+                if (tile != TILEMAP_FILE_EMPTY_TILE) {
+                    instances[count++] = (struct TileInstance) {
+                        .position = { (float)x, (float)y },
+                        .layer = layer,
+                        .atlas_index = tile,
+                    };
+                }
+            }
+        }
+        job->layer_counts[layer] = count;
+    }
+    job->build_ns = clock_now_ns() - start_ns;
+
+    pthread_mutex_lock(&manager->mutex);
+    job->done = true;
+    pthread_mutex_unlock(&manager->mutex);
+}
+
+//
+// Hands slot's chunk to a free job and submits it. A generated chunk found
+// in the cache is copied into the job to be decoded.
+//
+static void chunk_manager_start_job(struct ChunkManager *manager, struct ChunkStreamJob *job, uint32_t slot) {
+    const struct ChunkSlot *s = &manager->slots[slot];
+    job->slot = slot;
+    job->generation = s->generation;
+    job->chunk_x = s->chunk_x;
+    job->chunk_y = s->chunk_y;
+    job->encoded_size = 0;
+    job->cached = false;
+    job->done = false;
+
+    uint32_t index = manager->from_file ? CHUNK_CACHE_NONE : chunk_cache_find(manager, s->chunk_x, s->chunk_y);
+    if (index != CHUNK_CACHE_NONE) {
+        struct ChunkCacheEntry *entry = chunk_cache_entry(manager, index);
+        memcpy(job->encoded, entry->encoded, entry->size);
+        job->encoded_size = entry->size;
+        job->cached = true;
+        chunk_cache_lru_unlink(manager, index);
+        chunk_cache_lru_push_front(manager, index);
+        manager->stats.cache_hits++;
+    }
+    thread_pool_submit(&manager->workers, chunk_manager_build_chunk, job);
+}
+
+//
+// Queues the upload of what job built, unless its slot has been given to
+// another chunk since. Each layer goes to its own fixed offset in the
+// slot, so only the instances a layer has are copied. A freshly generated
+// chunk's encoding goes into the cache. Frees the job; returns whether
+// anything was queued.
+//
+static bool chunk_manager_upload_chunk(
+    struct ChunkManager *manager, struct UploadContext *upload, struct ChunkStreamJob *job) {
+
+    struct ChunkSlot *s = &manager->slots[job->slot];
+    if (!manager->from_file && !job->cached) {
+        chunk_cache_store(manager, job->chunk_x, job->chunk_y, job->encoded, job->encoded_size);
+    }
+    if (!s->resident || !s->streaming || s->generation != job->generation) {
+        job->slot = CHUNK_SLOT_NONE;
+        return false;
+    }
+
+    for (uint32_t layer = 0; layer < manager->layer_count; layer++) {
+        uint32_t count = job->layer_counts[layer];
+        s->layer_counts[layer] = count;
+        if (count > 0) {
+            VkDeviceSize offset =
+                sizeof(struct TileInstance) * ((VkDeviceSize)job->slot * manager->slot_instances + layer * CHUNK_TILES);
+            upload_buffer(
+                upload,
+                manager->instance_buffer,
+                offset,
+                &job->instances[layer * CHUNK_TILES],
+                sizeof(struct TileInstance) * count,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        }
+    }
+    s->streaming = false;
+    job->slot = CHUNK_SLOT_NONE;
+    manager->stats.streamed++;
+    manager->stats.build_ns += job->build_ns;
+    return true;
+}
+
+//
+// Uploads every job whose chunk has been built since the last update.
+// Returns whether anything was queued.
+//
+static bool chunk_manager_collect_jobs(struct ChunkManager *manager, struct UploadContext *upload) {
+    bool uploaded = false;
+    for (uint32_t i = 0; i < CHUNK_STREAM_BUDGET; i++) {
+        struct ChunkStreamJob *job = &manager->jobs[i];
+        if (job->slot == CHUNK_SLOT_NONE) {
+            continue;
+        }
+        pthread_mutex_lock(&manager->mutex);
+        bool done = job->done;
+        pthread_mutex_unlock(&manager->mutex);
+        if (done) {
+            uploaded = chunk_manager_upload_chunk(manager, upload, job) || uploaded;
+        }
+    }
+    return uploaded;
+}
+
+static struct ChunkStreamJob *chunk_manager_free_job(struct ChunkManager *manager) {
+    for (uint32_t i = 0; i < CHUNK_STREAM_BUDGET; i++) {
+        if (manager->jobs[i].slot == CHUNK_SLOT_NONE) {
+            return &manager->jobs[i];
+        }
+    }
+    return NULL;
+}
+
+//
+// The chunks under camera, clamped to the map and to CHUNK_GRID_SIZE chunks
+// per side around its center. Returns false if none are.
+//
+static bool chunk_manager_visible_range(
+    const struct ChunkManager *manager,
+    const struct Camera *camera,
+    VkExtent2D extent,
+    uint32_t *first_x,
+    uint32_t *first_y,
+    uint32_t *last_x,
+    uint32_t *last_y) {
+
+    float aspect = extent.height > 0 ? (float)extent.width / (float)extent.height : 1.0f;
+    float half_height = camera->view_tiles / 2.0f;
+    float half_width = half_height * aspect;
+    float bounds[2][2] = {
+        { camera->center[0] - half_width, camera->center[0] + half_width },
+        { camera->center[1] - half_height, camera->center[1] + half_height },
+    };
+    uint32_t chunk_counts[2] = { manager->chunks_x, manager->chunks_y };
+    uint32_t first[2];
+    uint32_t last[2];
+
+    for (uint32_t axis = 0; axis < 2; axis++) {
+        float low = floorf(bounds[axis][0] / CHUNK_SIZE);
+        float high = floorf(bounds[axis][1] / CHUNK_SIZE);
+        if (high < 0.0f || low >= (float)chunk_counts[axis]) {
+            return false;
+        }
+        first[axis] = low < 0.0f ? 0 : (uint32_t)low;
+        last[axis] = MIN((uint32_t)high, chunk_counts[axis] - 1);
+        uint32_t span = last[axis] - first[axis] + 1;
+        if (span > CHUNK_GRID_SIZE) {
+            first[axis] += (span - CHUNK_GRID_SIZE) / 2;
+            last[axis] = first[axis] + CHUNK_GRID_SIZE - 1;
+        }
+    }
+
+    *first_x = first[0];
+    *first_y = first[1];
+    *last_x = last[0];
+    *last_y = last[1];
+    return true;
+}
+
+//
+// Opens the tilemap at map_path and takes the map's size and layers from
+// it. Exits if it cannot be used.
+//
+static void chunk_manager_open_map(struct ChunkManager *manager, const char *map_path) {
+    if (!tilemap_file_open(map_path, &manager->map)) {
+        log_fatal("Could not open tilemap %s\n", map_path);
+        exit(EXIT_FAILURE);
+    }
+    const struct TilemapFileHeader *header = manager->map.header;
+    if (header->chunk_size != CHUNK_SIZE || header->layer_count > MAX_TILE_LAYERS) {
+        log_fatal("Tilemap %s has chunks of %u tiles and %u layers, %u tiles and at most %u layers are supported\n",
+            map_path, header->chunk_size, header->layer_count, CHUNK_SIZE, MAX_TILE_LAYERS);
+        exit(EXIT_FAILURE);
+    }
+
+    manager->from_file = true;
+    manager->width = header->width;
+    manager->height = header->height;
+    manager->layer_count = header->layer_count;
+    for (uint32_t layer = 0; layer < header->layer_count; layer++) {
+        if (header->layer_modes[layer] >= TILE_LAYER_MODE_COUNT) {
+            log_fatal("Layer %u of tilemap %s has unknown mode %u\n", layer, map_path, header->layer_modes[layer]);
+            exit(EXIT_FAILURE);
+        }
+        manager->layers[layer] = (struct TileLayerRange) {
+            .mode = header->layer_modes[layer],
+            .fullscreen = false,
+        };
+    }
+}
+
+//
+// A width x height tile map, of which at most resident_chunks chunks are on
+// the GPU at once. With map_path set the map is read from that tilemap
+// file instead, and width and height are ignored.
+//
+void chunk_manager_init(
+    struct ChunkManager *manager,
+    struct MemoryAllocator *allocator,
+    struct FrameSync *sync,
+    const char *map_path,
+    uint32_t width,
+    uint32_t height,
+    uint32_t resident_chunks) {
+
+    if (resident_chunks == 0) {
+        log_fatal("At least one chunk must be resident\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *manager = (struct ChunkManager) {
+        .allocator = allocator,
+        .sync = sync,
+        .width = width,
+        .height = height,
+        .slot_count = resident_chunks,
+        .lru_head = CHUNK_SLOT_NONE,
+        .lru_tail = CHUNK_SLOT_NONE,
+        .cache_ChunkCacheEntry = raw_vector_create(sizeof(struct ChunkCacheEntry), 64),
+        .cache_lru_head = CHUNK_CACHE_NONE,
+        .cache_lru_tail = CHUNK_CACHE_NONE,
+        .cache_free = CHUNK_CACHE_NONE,
+        .visible_uint32 = raw_vector_create(sizeof(uint32_t), 256),
+        .draws_TileLayerRange = raw_vector_create(sizeof(struct TileLayerRange), 256),
+    };
+    if (map_path != NULL) {
+        chunk_manager_open_map(manager, map_path);
+    } else {
+        manager->layer_count = tile_grid_layers(manager->layers);
+    }
+    manager->chunks_x = (manager->width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    manager->chunks_y = (manager->height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    manager->slot_instances = CHUNK_TILES * MAX(manager->layer_count, 1);
+
+    manager->slots = malloc(sizeof(struct ChunkSlot) * resident_chunks);
+    manager->grid = malloc(sizeof(uint32_t) * CHUNK_GRID_SIZE * CHUNK_GRID_SIZE);
+    manager->cache_grid = malloc(sizeof(uint32_t) * CHUNK_GRID_SIZE * CHUNK_GRID_SIZE);
+    manager->instances_scratch = malloc(sizeof(struct TileInstance) * manager->slot_instances * CHUNK_STREAM_BUDGET);
+    manager->tiles_scratch = malloc(sizeof(uint32_t) * manager->slot_instances * CHUNK_STREAM_BUDGET);
+    manager->encoded_capacity = tile_codec_max_encoded_size(manager->slot_instances);
+    manager->encoded_scratch = malloc(manager->encoded_capacity * CHUNK_STREAM_BUDGET);
+    if (manager->slots == NULL || manager->grid == NULL || manager->cache_grid == NULL ||
+        manager->instances_scratch == NULL || manager->tiles_scratch == NULL || manager->encoded_scratch == NULL) {
+        log_fatal("Could not malloc chunk manager\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < CHUNK_STREAM_BUDGET; i++) {
+        manager->jobs[i] = (struct ChunkStreamJob) {
+            .manager = manager,
+            .slot = CHUNK_SLOT_NONE,
+            .instances = &manager->instances_scratch[i * manager->slot_instances],
+            .tiles = &manager->tiles_scratch[i * manager->slot_instances],
+            .encoded = &manager->encoded_scratch[i * manager->encoded_capacity],
+        };
+    }
+    pthread_mutex_init(&manager->mutex, NULL);
+    thread_pool_init(&manager->workers, MIN(thread_pool_default_thread_count(), CHUNK_STREAM_BUDGET));
+    for (uint32_t i = 0; i < resident_chunks; i++) {
+        manager->slots[i] = (struct ChunkSlot) {
+            .resident = false,
+            .streaming = false,
+            .generation = 0,
+            .prev = CHUNK_SLOT_NONE,
+            .next = CHUNK_SLOT_NONE,
+        };
+        chunk_lru_push_back(manager, i);
+    }
+    for (uint32_t i = 0; i < CHUNK_GRID_SIZE * CHUNK_GRID_SIZE; i++) {
+        manager->grid[i] = CHUNK_SLOT_NONE;
+        manager->cache_grid[i] = CHUNK_CACHE_NONE;
+    }
+
+    VkDeviceSize buffer_size = sizeof(struct TileInstance) * (VkDeviceSize)manager->slot_instances * resident_chunks;
+    manager->instance_buffer = create_device_local_buffer(
+        allocator,
+        buffer_size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        &manager->instance_allocation);
+
+    log_info("Streaming a %ux%u tile map%s in %ux%u chunks of %u tiles\n",
+        manager->width, manager->height, manager->from_file ? " from a file" : "",
+        manager->chunks_x, manager->chunks_y, CHUNK_SIZE);
+    log_info("  %u resident in %lu MiB\n", resident_chunks, (unsigned long)(buffer_size / (1024 * 1024)));
+}
+
+//
+// Waits for the stream jobs still running, whose chunks are dropped.
+//
+void chunk_manager_destroy(struct ChunkManager *manager) {
+    thread_pool_wait_idle(&manager->workers);
+    thread_pool_destroy(&manager->workers);
+    pthread_mutex_destroy(&manager->mutex);
+
+    struct ChunkManagerStats *stats = &manager->stats;
+    if (stats->updates > 0) {
+        log_info("Chunks: %lu streamed in, %.3f ms building each on average\n",
+            (unsigned long)stats->streamed,
+            stats->streamed > 0 ? clock_ns_to_ms(stats->build_ns) / stats->streamed : 0.0);
+        log_info("  %lu evicted, %lu deferred, at most %u visible of %u slots\n",
+            (unsigned long)stats->evicted,
+            (unsigned long)stats->deferred,
+            stats->peak_visible,
+            manager->slot_count);
+        if (!manager->from_file) {
+            log_info("  %lu decoded from the chunk cache, %lu dropped from it, %lu KiB cached at exit\n",
+                (unsigned long)stats->cache_hits,
+                (unsigned long)stats->cache_evicted,
+                (unsigned long)(manager->cache_bytes / 1024));
+        }
+    }
+    for (size_t i = 0; i < raw_vector_size(&manager->cache_ChunkCacheEntry); i++) {
+        free(chunk_cache_entry(manager, (uint32_t)i)->encoded);
+    }
+    raw_vector_destroy(&manager->cache_ChunkCacheEntry);
+    free(manager->cache_grid);
+    destroy_buffer_with_memory(manager->allocator, manager->instance_buffer, &manager->instance_allocation);
+    if (manager->from_file) {
+        tilemap_file_close(&manager->map);
+    }
+    free(manager->slots);
+    free(manager->grid);
+    free(manager->instances_scratch);
+    free(manager->tiles_scratch);
+    free(manager->encoded_scratch);
+    raw_vector_destroy(&manager->visible_uint32);
+    raw_vector_destroy(&manager->draws_TileLayerRange);
+}
+
+//
+// Uploads the chunks whose stream jobs have finished, finds the chunks
+// under camera on an extent sized viewport and starts jobs for those which
+// are missing, as long as fewer than CHUNK_STREAM_BUDGET are in flight,
+// then builds this frame's draws from the visible chunks which are
+// uploaded. Visible chunks are visited row by row, in the order the grid
+// is laid out in. Missing chunks are read, decoded and turned into
+// instances on the stream threads without this thread waiting for them;
+// only their uploads are queued from here. Call once per frame, before
+// recording it.
+//
+void chunk_manager_update(
+    struct ChunkManager *manager,
+    struct UploadContext *upload,
+    const struct Camera *camera,
+    VkExtent2D extent) {
+
+    manager->stats.updates++;
+    raw_vector_clear(&manager->visible_uint32);
+
+    if (chunk_manager_collect_jobs(manager, upload)) {
+        upload_context_flush(upload);
+    }
+
+    uint32_t first_x, first_y, last_x, last_y;
+    if (chunk_manager_visible_range(manager, camera, extent, &first_x, &first_y, &last_x, &last_y)) {
+        bool out_of_jobs = false;
+        bool out_of_slots = false;
+        for (uint32_t chunk_y = first_y; chunk_y <= last_y; chunk_y++) {
+            for (uint32_t chunk_x = first_x; chunk_x <= last_x; chunk_x++) {
+                uint32_t slot = chunk_manager_find(manager, chunk_x, chunk_y);
+                if (slot == CHUNK_SLOT_NONE) {
+                    struct ChunkStreamJob *job = out_of_jobs || out_of_slots ? NULL : chunk_manager_free_job(manager);
+                    out_of_jobs = out_of_jobs || job == NULL;
+                    slot = job != NULL ? chunk_manager_take_slot(manager) : CHUNK_SLOT_NONE;
+                    out_of_slots = out_of_slots || (job != NULL && slot == CHUNK_SLOT_NONE);
+                    if (slot == CHUNK_SLOT_NONE) {
+                        manager->stats.deferred++;
+                        continue;
+                    }
+                    chunk_manager_assign(manager, slot, chunk_x, chunk_y);
+                    chunk_manager_start_job(manager, job, slot);
+                }
+
+                manager->slots[slot].visible_update = manager->stats.updates;
+                chunk_lru_unlink(manager, slot);
+                chunk_lru_push_front(manager, slot);
+                raw_vector_push_back(&manager->visible_uint32, &slot);
+            }
+        }
+    }
+
+    uint32_t visible_count = raw_vector_size(&manager->visible_uint32);
+    manager->stats.peak_visible = MAX(manager->stats.peak_visible, visible_count);
+
+    raw_vector_clear(&manager->draws_TileLayerRange);
+    for (uint32_t layer = 0; layer < manager->layer_count; layer++) {
+        manager->first_draw[layer] = raw_vector_size(&manager->draws_TileLayerRange);
+        manager->layer_instance_count[layer] = 0;
+        for (uint32_t i = 0; i < visible_count; i++) {
+            uint32_t slot = *(uint32_t *)raw_vector_get_ptr(&manager->visible_uint32, i);
+            if (manager->slots[slot].streaming) {
+                continue;
+            }
+            uint32_t count = manager->slots[slot].layer_counts[layer];
+            if (count == 0) {
+                continue;
+            }
+            struct TileLayerRange draw = {
+                .first_instance = slot * manager->slot_instances + layer * CHUNK_TILES,
+                .instance_count = count,
+                .mode = manager->layers[layer].mode,
+                .fullscreen = false,
+            };
+            raw_vector_push_back(&manager->draws_TileLayerRange, &draw);
+            manager->layer_instance_count[layer] += count;
+        }
+        manager->draw_count[layer] = raw_vector_size(&manager->draws_TileLayerRange) - manager->first_draw[layer];
+    }
+}
+
+//
+// Records that the frame drawing this update's chunks signals value once
+// the GPU is done with it.
+//
+void chunk_manager_submitted(struct ChunkManager *manager, uint64_t value) {
+    for (uint32_t i = 0; i < raw_vector_size(&manager->visible_uint32); i++) {
+        uint32_t slot = *(uint32_t *)raw_vector_get_ptr(&manager->visible_uint32, i);
+        manager->slots[slot].last_used_value = value;
+    }
+}
+
+static void fill_generated_chunk(void *user, uint32_t chunk_x, uint32_t chunk_y, uint32_t *tiles) {
+    const struct TilemapFileHeader *header = user;
+    generate_chunk_tiles(header->width, header->height, header->layer_count, chunk_x, chunk_y, tiles);
+}
+
+//
+// Writes the width x height generated map to filename as a tilemap file
+// with CHUNK_SIZE chunks, one chunk at a time, stored with encoding (one
+// of TILEMAP_FILE_ENCODING_*).
+//
+bool chunk_manager_write_generated_map(const char *filename, uint32_t width, uint32_t height, uint32_t encoding) {
+    struct TileLayerRange layers[MAX_TILE_LAYERS];
+    struct TilemapFileHeader header = {
+        .width = width,
+        .height = height,
+        .chunk_size = CHUNK_SIZE,
+        .layer_count = tile_grid_layers(layers),
+    };
+    for (uint32_t layer = 0; layer < header.layer_count; layer++) {
+        header.layer_modes[layer] = layers[layer].mode;
+    }
+    return tilemap_file_write(filename, &header, encoding, fill_generated_chunk, &header);
+}
+
+//
+// Points draw_buffers at the resident chunks and this update's draws. They
+// stay valid until the next chunk_manager_update.
+//
+void chunk_manager_fill_draw_buffers(struct ChunkManager *manager, struct TileDrawBuffers *draw_buffers) {
+    uint32_t draw_count = raw_vector_size(&manager->draws_TileLayerRange);
+    draw_buffers->instance_buffer = manager->instance_buffer;
+    draw_buffers->instance_count = manager->slot_count * manager->slot_instances;
+    draw_buffers->layer_count = manager->layer_count;
+    draw_buffers->chunk_draws = draw_count > 0
+        ? (struct TileLayerRange *)raw_vector_get_ptr(&manager->draws_TileLayerRange, 0)
+        : NULL;
+    for (uint32_t layer = 0; layer < manager->layer_count; layer++) {
+        draw_buffers->layers[layer] = manager->layers[layer];
+        draw_buffers->layers[layer].instance_count = manager->layer_instance_count[layer];
+        draw_buffers->first_chunk_draw[layer] = manager->first_draw[layer];
+        draw_buffers->chunk_draw_count[layer] = manager->draw_count[layer];
+    }
+}
@@ -22,73 +22,233 @@ VkCommandPool create_command_pool(VkDevice device, uint32_t qf_idx) {
     return pool;
 }
 
-struct RawVector create_command_buffers(
-    VkDevice device, 
-    VkCommandPool pool, 
-    VkRenderPass renderpass, 
-    VkPipeline pipeline,
-    struct RawVector *rvec_VkFramebuffer, 
-    VkExtent2D extent,
-    VkBuffer vertex_buffer) {
+//
+// Creates a command pool whose command buffers can be individually reset
+// and re-recorded, for work which changes every submission.
+//
+VkCommandPool create_resettable_command_pool(VkDevice device, uint32_t qf_idx) {
 
-    //
-    // Allocation info to allocate each command buffer from
-    // the command buffer pool. We want to create primary 
-    //
-    VkCommandBufferAllocateInfo alloc_info = {};
-    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.commandPool = pool;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandBufferCount = raw_vector_size(rvec_VkFramebuffer);
-
-    VkCommandBuffer cbs[alloc_info.commandBufferCount];
-    if (vkAllocateCommandBuffers(device, &alloc_info, cbs) != VK_SUCCESS) {
-        log_fatal("Could not allocate command buffers\n");
+    VkCommandPoolCreateInfo pool_ci = {};
+    pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_ci.queueFamilyIndex = qf_idx;
+    pool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    VkCommandPool pool;
+    if (vkCreateCommandPool(device, &pool_ci, NULL, &pool) != VK_SUCCESS) {
+        log_fatal("Failed to create resettable command pool\n");
         exit(EXIT_FAILURE);
     }
-    struct RawVector rvec_VkCommandBuffer = raw_vector_create(sizeof(VkCommandBuffer), alloc_info.commandBufferCount);
-    raw_vector_extend_back(&rvec_VkCommandBuffer, cbs, alloc_info.commandBufferCount);
 
-    for (int i = 0; i < raw_vector_size(&rvec_VkCommandBuffer); i++) {
-        VkCommandBuffer current_command_buffer = *(VkCommandBuffer *)raw_vector_get_ptr(&rvec_VkCommandBuffer, i);
+    return pool;
+}
 
-        VkCommandBufferBeginInfo begin_info = {};
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        begin_info.flags = 0;
-        begin_info.pInheritanceInfo = NULL;
+//
+// Creates a command pool for short-lived command buffers which are recorded,
+// submitted once and then reset, such as buffer uploads.
+//
+VkCommandPool create_transient_command_pool(VkDevice device, uint32_t qf_idx) {
 
-        if (vkBeginCommandBuffer(current_command_buffer, &begin_info) != VK_SUCCESS) {
-            log_fatal("Could not begin command buffer\n");
-            exit(EXIT_FAILURE);
-        }
+    VkCommandPoolCreateInfo pool_ci = {};
+    pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_ci.queueFamilyIndex = qf_idx;
+    pool_ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-        VkRenderPassBeginInfo rpb_info = {};
-        rpb_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rpb_info.renderPass = renderpass;
-        rpb_info.framebuffer = *(VkFramebuffer *)raw_vector_get_ptr(rvec_VkFramebuffer, i);
-        rpb_info.renderArea.offset = (VkOffset2D){0,0};
-        rpb_info.renderArea.extent = extent;
+    VkCommandPool pool;
+    if (vkCreateCommandPool(device, &pool_ci, NULL, &pool) != VK_SUCCESS) {
+        log_fatal("Failed to create transient command pool\n");
+        exit(EXIT_FAILURE);
+    }
 
-        VkClearValue clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
-        rpb_info.clearValueCount = 1;
-        rpb_info.pClearValues = &clear_color;
+    return pool;
+}
 
-        vkCmdBeginRenderPass(current_command_buffer, &rpb_info, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(current_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+//
+// Begins the render pass which draws the scene into framebuffer, cleared
+// to black. contents says whether the subpass is recorded inline or by
+// secondary command buffers.
+//
+void begin_tile_render_pass(
+    VkCommandBuffer command_buffer,
+    VkRenderPass renderpass,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent,
+    VkSubpassContents contents) {
 
-        VkBuffer vertex_buffers[] = {vertex_buffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(current_command_buffer, 0, 1, vertex_buffers, offsets);
+    VkRenderPassBeginInfo rpb_info = {};
+    rpb_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpb_info.renderPass = renderpass;
+    rpb_info.framebuffer = framebuffer;
+    rpb_info.renderArea.offset = (VkOffset2D){0,0};
+    rpb_info.renderArea.extent = extent;
 
-        vkCmdDraw(current_command_buffer, NUM_QUAD_VERTICES, 1, 0, 0);
-        vkCmdEndRenderPass(current_command_buffer);
+    VkClearValue clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
+    rpb_info.clearValueCount = 1;
+    rpb_info.pClearValues = &clear_color;
 
-        if (vkEndCommandBuffer(current_command_buffer) != VK_SUCCESS) {
-            log_fatal("Failed to record command buffer\n");
-            exit(EXIT_FAILURE);
+    vkCmdBeginRenderPass(command_buffer, &rpb_info, contents);
+}
+
+//
+// Sets the dynamic viewport and scissor to cover extent, binds the quad and
+// instance buffers and the frame's uniforms, and pushes the camera.
+// Secondary command buffers inherit none of this, so each one has to record
+// it again.
+//
+void record_tile_draw_setup(
+    VkCommandBuffer command_buffer,
+    VkExtent2D extent,
+    const struct TileDrawBuffers *draw_buffers,
+    const struct TileDrawUniforms *uniforms) {
+
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)extent.width,
+        .height = (float)extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    VkRect2D scissor = {
+        .offset = {0, 0},
+        .extent = extent,
+    };
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    VkBuffer vertex_buffers[] = {draw_buffers->vertex_buffer, draw_buffers->instance_buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(command_buffer, VERTEX_BINDING, 2, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, draw_buffers->index_buffer, 0, QUAD_INDEX_TYPE);
+
+    VkDescriptorSet descriptor_sets[TILE_SET_COUNT] = {
+        [TILE_SET_FRAME] = uniforms->descriptor_set,
+        [TILE_SET_ATLAS] = uniforms->atlas_set,
+        [TILE_SET_TILEMAP] = uniforms->tilemap_set,
+    };
+    vkCmdBindDescriptorSets(
+        command_buffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        uniforms->layout,
+        0, TILE_SET_COUNT, descriptor_sets,
+        1, &uniforms->dynamic_offset);
+    vkCmdPushConstants(
+        command_buffer,
+        uniforms->layout,
+        VK_SHADER_STAGE_VERTEX_BIT,
+        0,
+        sizeof(uniforms->camera),
+        &uniforms->camera);
+}
+
+//
+// Draws instance_count instances of the tile quad starting at
+// first_instance or, for a fullscreen layer, the fullscreen triangle of
+// tilemap layer first_instance. The pipeline must already be bound.
+//
+void record_tile_layer_draw(VkCommandBuffer command_buffer, bool fullscreen, uint32_t first_instance, uint32_t instance_count) {
+    if (fullscreen) {
+        vkCmdDraw(command_buffer, 3, instance_count, 0, first_instance);
+    } else {
+        vkCmdDrawIndexed(command_buffer, NUM_QUAD_INDICES, instance_count, 0, 0, first_instance);
+    }
+}
+
+//
+// Records the render pass which draws the scene into framebuffer: each
+// layer of draw_buffers, bottom to top, as one instanced draw of the quad
+// (or one fullscreen triangle for fullscreen layers) with the pipeline
+// variant for that layer's mode. Variants which are still compiling are
+// drawn with their fallback, or skipped if they have none. The command
+// buffer must already be in the recording state.
+//
+void record_draw_commands(
+    VkCommandBuffer command_buffer,
+    VkRenderPass renderpass,
+    struct PipelineRegistry *pipelines,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent,
+    const struct TileDrawBuffers *draw_buffers,
+    const struct TileDrawUniforms *uniforms) {
+
+    begin_tile_render_pass(command_buffer, renderpass, framebuffer, extent, VK_SUBPASS_CONTENTS_INLINE);
+    record_tile_draw_setup(command_buffer, extent, draw_buffers, uniforms);
+
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < draw_buffers->layer_count; i++) {
+        const struct TileLayerRange *layer = &draw_buffers->layers[i];
+        if (layer->instance_count == 0) {
+            continue;
         }
 
-        log_trace("Recorded command buffer %i\n", i);
+        struct PipelineKey key = pipeline_key_for_layer_range(renderpass, layer);
+        VkPipeline pipeline = pipeline_registry_request(pipelines, &key);
+        if (pipeline == VK_NULL_HANDLE) {
+            continue;
+        }
+        if (pipeline != bound_pipeline) {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+        }
+        record_tile_layer_draw(command_buffer, layer->fullscreen, layer->first_instance, layer->instance_count);
     }
-    return rvec_VkCommandBuffer;
-}
\ No newline at end of file
+    vkCmdEndRenderPass(command_buffer);
+}
+
+//
+// Records a copy of image (left in TRANSFER_SRC_OPTIMAL by the render pass)
+// into buffer as tightly packed rows, followed by a barrier which makes the
+// copied bytes visible to the host once the submission's fence signals.
+//
+void record_image_readback(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, VkBuffer buffer) {
+
+    //
+    // The render pass transitions the image to TRANSFER_SRC_OPTIMAL when it ends.
+    // Make the color writes available to the transfer before copying.
+    //
+    VkImageMemoryBarrier to_transfer = {};
+    to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    to_transfer.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image = image;
+    to_transfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    to_transfer.subresourceRange.baseMipLevel = 0;
+    to_transfer.subresourceRange.levelCount = 1;
+    to_transfer.subresourceRange.baseArrayLayer = 0;
+    to_transfer.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &to_transfer);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = (VkOffset3D){0, 0, 0};
+    region.imageExtent = (VkExtent3D){extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    VkBufferMemoryBarrier to_host = {};
+    to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.buffer = buffer;
+    to_host.offset = 0;
+    to_host.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, NULL, 1, &to_host, 0, NULL);
+}
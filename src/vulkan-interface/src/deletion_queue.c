@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include "vulkan-interface/deletion_queue.h"
+#include "log.h"
+
+void deletion_queue_init(struct DeletionQueue *queue, VkDevice device, struct MemoryAllocator *allocator, struct FrameSync *sync) {
+    *queue = (struct DeletionQueue) {
+        .device = device,
+        .allocator = allocator,
+        .sync = sync,
+        .pending_DeferredDeletion = raw_vector_create(sizeof(struct DeferredDeletion), 64),
+    };
+}
+
+//
+// Waits for and destroys everything still pending.
+//
+void deletion_queue_destroy(struct DeletionQueue *queue) {
+    deletion_queue_flush(queue);
+    log_info("Deletion queue: %lu resources retired, %lu destroyed, at most %lu pending\n",
+        (unsigned long)queue->retired,
+        (unsigned long)queue->destroyed,
+        (unsigned long)queue->pending_peak);
+    raw_vector_destroy(&queue->pending_DeferredDeletion);
+}
+
+static void deletion_queue_push(struct DeletionQueue *queue, struct DeferredDeletion *deletion) {
+    raw_vector_push_back(&queue->pending_DeferredDeletion, deletion);
+    queue->retired++;
+    if (raw_vector_size(&queue->pending_DeferredDeletion) > queue->pending_peak) {
+        queue->pending_peak = raw_vector_size(&queue->pending_DeferredDeletion);
+    }
+}
+
+static void deferred_deletion_destroy(struct DeletionQueue *queue, struct DeferredDeletion *deletion) {
+    switch (deletion->type) {
+    case DEFERRED_DELETION_BUFFER:
+        destroy_buffer_with_memory(queue->allocator, deletion->buffer, &deletion->allocation);
+        break;
+    case DEFERRED_DELETION_IMAGE:
+        destroy_image_with_memory(queue->allocator, deletion->image, &deletion->allocation);
+        break;
+    case DEFERRED_DELETION_IMAGE_VIEW:
+        vkDestroyImageView(queue->device, deletion->image_view, NULL);
+        break;
+    case DEFERRED_DELETION_FRAMEBUFFER:
+        vkDestroyFramebuffer(queue->device, deletion->framebuffer, NULL);
+        break;
+    case DEFERRED_DELETION_PIPELINE:
+        vkDestroyPipeline(queue->device, deletion->pipeline, NULL);
+        break;
+    case DEFERRED_DELETION_RENDER_PASS:
+        vkDestroyRenderPass(queue->device, deletion->renderpass, NULL);
+        break;
+    case DEFERRED_DELETION_SWAPCHAIN:
+        vkDestroySwapchainKHR(queue->device, deletion->swapchain, NULL);
+        break;
+    }
+    queue->destroyed++;
+}
+
+//
+// Retires buffer and the memory backing it. The allocation is copied, so
+// the caller's may be reused straight away.
+//
+void deletion_queue_retire_buffer(struct DeletionQueue *queue, VkBuffer buffer, struct MemoryAllocation *allocation, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_BUFFER,
+        .last_use = last_use,
+        .buffer = buffer,
+        .allocation = *allocation,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+void deletion_queue_retire_image(struct DeletionQueue *queue, VkImage image, struct MemoryAllocation *allocation, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_IMAGE,
+        .last_use = last_use,
+        .image = image,
+        .allocation = *allocation,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+void deletion_queue_retire_image_view(struct DeletionQueue *queue, VkImageView image_view, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_IMAGE_VIEW,
+        .last_use = last_use,
+        .image_view = image_view,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+void deletion_queue_retire_framebuffer(struct DeletionQueue *queue, VkFramebuffer framebuffer, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_FRAMEBUFFER,
+        .last_use = last_use,
+        .framebuffer = framebuffer,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+void deletion_queue_retire_pipeline(struct DeletionQueue *queue, VkPipeline pipeline, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_PIPELINE,
+        .last_use = last_use,
+        .pipeline = pipeline,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+void deletion_queue_retire_renderpass(struct DeletionQueue *queue, VkRenderPass renderpass, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_RENDER_PASS,
+        .last_use = last_use,
+        .renderpass = renderpass,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+//
+// A retired swapchain must outlive the presents queued against it as well as
+// the frames which drew into its images. The timeline cannot tell when
+// presents are done, so swapchains only get here from retired_swapchains.h,
+// which holds them until then; last_use only has to cover the rendering.
+//
+void deletion_queue_retire_swapchain(struct DeletionQueue *queue, VkSwapchainKHR swapchain, uint64_t last_use) {
+    struct DeferredDeletion deletion = {
+        .type = DEFERRED_DELETION_SWAPCHAIN,
+        .last_use = last_use,
+        .swapchain = swapchain,
+    };
+    deletion_queue_push(queue, &deletion);
+}
+
+//
+// Destroys every pending resource the GPU has finished with, without
+// waiting. Returns how many were destroyed. Resources are usually retired
+// in timeline order, but nothing relies on it: survivors are compacted
+// to the front in a single pass.
+//
+uint32_t deletion_queue_collect(struct DeletionQueue *queue) {
+    size_t pending = raw_vector_size(&queue->pending_DeferredDeletion);
+    if (pending == 0) {
+        return 0;
+    }
+
+    struct DeferredDeletion *deletions = (struct DeferredDeletion *)raw_vector_get_ptr(&queue->pending_DeferredDeletion, 0);
+    size_t kept = 0;
+    for (size_t i = 0; i < pending; i++) {
+        if (frame_sync_is_complete(queue->sync, deletions[i].last_use)) {
+            deferred_deletion_destroy(queue, &deletions[i]);
+        } else {
+            deletions[kept++] = deletions[i];
+        }
+    }
+    while (raw_vector_size(&queue->pending_DeferredDeletion) > kept) {
+        raw_vector_pop_back(&queue->pending_DeferredDeletion);
+    }
+    return pending - kept;
+}
+
+//
+// Waits for the last use of every pending resource, then destroys them all.
+//
+void deletion_queue_flush(struct DeletionQueue *queue) {
+    uint64_t last_use = 0;
+    for (size_t i = 0; i < raw_vector_size(&queue->pending_DeferredDeletion); i++) {
+        struct DeferredDeletion *deletion = (struct DeferredDeletion *)raw_vector_get_ptr(&queue->pending_DeferredDeletion, i);
+        if (deletion->last_use > last_use) {
+            last_use = deletion->last_use;
+        }
+    }
+    frame_sync_wait(queue->sync, last_use);
+    deletion_queue_collect(queue);
+}
@@ -0,0 +1,452 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vulkan-interface/descriptor.h"
+#include "language/hash.h"
+#include "log.h"
+
+static void descriptor_pool_chain_init(struct DescriptorPoolChain *chain) {
+    chain->current = VK_NULL_HANDLE;
+    chain->used_VkDescriptorPool = raw_vector_create(sizeof(VkDescriptorPool), 4);
+}
+
+void descriptor_allocator_init(struct DescriptorAllocator *allocator, VkDevice device, uint32_t frame_count) {
+    *allocator = (struct DescriptorAllocator) {
+        .device = device,
+        .frame_count = frame_count,
+        .frame_index = 0,
+        .spare_VkDescriptorPool = raw_vector_create(sizeof(VkDescriptorPool), 4),
+        .layouts_DescriptorLayoutCacheEntry = raw_vector_create(sizeof(struct DescriptorLayoutCacheEntry), 8),
+        .sets_DescriptorSetCacheEntry = raw_vector_create(sizeof(struct DescriptorSetCacheEntry), 16),
+        .spare_DescriptorSetCacheEntry = raw_vector_create(sizeof(struct DescriptorSetCacheEntry), 4),
+    };
+    for (uint32_t i = 0; i < frame_count; i++) {
+        descriptor_pool_chain_init(&allocator->frames[i]);
+    }
+    descriptor_pool_chain_init(&allocator->persistent);
+}
+
+static bool descriptor_type_is_image(VkDescriptorType type) {
+    return type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+        || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+        || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+        || type == VK_DESCRIPTOR_TYPE_SAMPLER;
+}
+
+static void destroy_pools(VkDevice device, struct RawVector *pools) {
+    for (size_t i = 0; i < raw_vector_size(pools); i++) {
+        vkDestroyDescriptorPool(device, *(VkDescriptorPool *)raw_vector_get_ptr(pools, i), NULL);
+    }
+    raw_vector_destroy(pools);
+}
+
+//
+// Destroys every pool, which frees every set handed out, and every cached
+// layout. The caller must know the GPU is done with all of them.
+//
+void descriptor_allocator_destroy(struct DescriptorAllocator *allocator) {
+    struct DescriptorAllocatorStats *stats = &allocator->stats;
+    log_info("Descriptor allocator: %lu transient sets, %lu persistent sets\n",
+        (unsigned long)stats->transient_allocations,
+        (unsigned long)stats->persistent_allocations);
+    log_info("  %lu set cache hits, %lu sets evicted, %lu layout cache hits\n",
+        (unsigned long)stats->persistent_cache_hits,
+        (unsigned long)stats->persistent_evictions,
+        (unsigned long)stats->layout_cache_hits);
+    log_info("  %u pools created, %lu pool resets\n", stats->pools_created, (unsigned long)stats->pool_resets);
+
+    VkDevice device = allocator->device;
+    for (uint32_t i = 0; i < allocator->frame_count; i++) {
+        destroy_pools(device, &allocator->frames[i].used_VkDescriptorPool);
+    }
+    destroy_pools(device, &allocator->persistent.used_VkDescriptorPool);
+    destroy_pools(device, &allocator->spare_VkDescriptorPool);
+
+    for (size_t i = 0; i < raw_vector_size(&allocator->layouts_DescriptorLayoutCacheEntry); i++) {
+        struct DescriptorLayoutCacheEntry *entry =
+            (struct DescriptorLayoutCacheEntry *)raw_vector_get_ptr(&allocator->layouts_DescriptorLayoutCacheEntry, i);
+        vkDestroyDescriptorSetLayout(device, entry->layout, NULL);
+        free(entry->bindings);
+        free(entry->immutable_samplers);
+    }
+    raw_vector_destroy(&allocator->layouts_DescriptorLayoutCacheEntry);
+    for (size_t i = 0; i < raw_vector_size(&allocator->sets_DescriptorSetCacheEntry); i++) {
+        free(((struct DescriptorSetCacheEntry *)raw_vector_get_ptr(&allocator->sets_DescriptorSetCacheEntry, i))->bindings);
+    }
+    raw_vector_destroy(&allocator->sets_DescriptorSetCacheEntry);
+    raw_vector_destroy(&allocator->spare_DescriptorSetCacheEntry);
+}
+
+static bool descriptor_layout_bindings_equal(
+    const VkDescriptorSetLayoutBinding *a, const VkDescriptorSetLayoutBinding *b, uint32_t binding_count) {
+
+    for (uint32_t i = 0; i < binding_count; i++) {
+        if (a[i].binding != b[i].binding ||
+            a[i].descriptorType != b[i].descriptorType ||
+            a[i].descriptorCount != b[i].descriptorCount ||
+            a[i].stageFlags != b[i].stageFlags ||
+            (a[i].pImmutableSamplers == NULL) != (b[i].pImmutableSamplers == NULL)) {
+            return false;
+        }
+        if (a[i].pImmutableSamplers != NULL &&
+            memcmp(a[i].pImmutableSamplers, b[i].pImmutableSamplers, sizeof(VkSampler) * a[i].descriptorCount) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Copies bindings into entry, along with the immutable samplers they point
+// to, so the entry does not depend on the caller's arrays.
+//
+static void descriptor_layout_cache_entry_copy(
+    struct DescriptorLayoutCacheEntry *entry, const VkDescriptorSetLayoutBinding *bindings, uint32_t binding_count) {
+
+    uint32_t sampler_count = 0;
+    for (uint32_t i = 0; i < binding_count; i++) {
+        if (bindings[i].pImmutableSamplers != NULL) {
+            sampler_count += bindings[i].descriptorCount;
+        }
+    }
+
+    entry->binding_count = binding_count;
+    entry->bindings = malloc(sizeof(VkDescriptorSetLayoutBinding) * (binding_count > 0 ? binding_count : 1));
+    entry->immutable_samplers = malloc(sizeof(VkSampler) * (sampler_count > 0 ? sampler_count : 1));
+    if (entry->bindings == NULL || entry->immutable_samplers == NULL) {
+        log_fatal("Could not malloc descriptor set layout cache entry\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t first_sampler = 0;
+    for (uint32_t i = 0; i < binding_count; i++) {
+        entry->bindings[i] = bindings[i];
+        if (bindings[i].pImmutableSamplers != NULL) {
+            memcpy(
+                &entry->immutable_samplers[first_sampler],
+                bindings[i].pImmutableSamplers,
+                sizeof(VkSampler) * bindings[i].descriptorCount);
+            entry->bindings[i].pImmutableSamplers = &entry->immutable_samplers[first_sampler];
+            first_sampler += bindings[i].descriptorCount;
+        }
+    }
+}
+
+//
+// Returns a set layout with the given bindings, creating it the first time
+// they are asked for. Immutable samplers are hashed by handle.
+//
+VkDescriptorSetLayout descriptor_allocator_layout(
+    struct DescriptorAllocator *allocator, const VkDescriptorSetLayoutBinding *bindings, uint32_t binding_count) {
+
+    uint64_t hash = HASH_FNV1A_64_SEED;
+    for (uint32_t i = 0; i < binding_count; i++) {
+        hash = hash_fnv1a_64_extend(hash, &bindings[i].binding, sizeof(bindings[i].binding));
+        hash = hash_fnv1a_64_extend(hash, &bindings[i].descriptorType, sizeof(bindings[i].descriptorType));
+        hash = hash_fnv1a_64_extend(hash, &bindings[i].descriptorCount, sizeof(bindings[i].descriptorCount));
+        hash = hash_fnv1a_64_extend(hash, &bindings[i].stageFlags, sizeof(bindings[i].stageFlags));
+        if (bindings[i].pImmutableSamplers != NULL) {
+            hash = hash_fnv1a_64_extend(
+                hash, bindings[i].pImmutableSamplers, sizeof(VkSampler) * bindings[i].descriptorCount);
+        }
+    }
+
+    for (size_t i = 0; i < raw_vector_size(&allocator->layouts_DescriptorLayoutCacheEntry); i++) {
+        struct DescriptorLayoutCacheEntry *entry =
+            (struct DescriptorLayoutCacheEntry *)raw_vector_get_ptr(&allocator->layouts_DescriptorLayoutCacheEntry, i);
+        if (entry->hash == hash &&
+            entry->binding_count == binding_count &&
+            descriptor_layout_bindings_equal(entry->bindings, bindings, binding_count)) {
+            allocator->stats.layout_cache_hits++;
+            return entry->layout;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_ci = {};
+    layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_ci.bindingCount = binding_count;
+    layout_ci.pBindings = bindings;
+
+    struct DescriptorLayoutCacheEntry entry = { .hash = hash };
+    if (vkCreateDescriptorSetLayout(allocator->device, &layout_ci, NULL, &entry.layout) != VK_SUCCESS) {
+        log_fatal("Could not create descriptor set layout\n");
+        exit(EXIT_FAILURE);
+    }
+    descriptor_layout_cache_entry_copy(&entry, bindings, binding_count);
+    raw_vector_push_back(&allocator->layouts_DescriptorLayoutCacheEntry, &entry);
+    return entry.layout;
+}
+
+//
+// Takes a spare pool if there is one, otherwise creates a new one sized
+// for DESCRIPTOR_POOL_MAX_SETS sets of the descriptors the renderer uses.
+//
+static VkDescriptorPool descriptor_allocator_take_pool(struct DescriptorAllocator *allocator) {
+    size_t spare = raw_vector_size(&allocator->spare_VkDescriptorPool);
+    if (spare > 0) {
+        VkDescriptorPool pool = *(VkDescriptorPool *)raw_vector_get_ptr(&allocator->spare_VkDescriptorPool, spare - 1);
+        raw_vector_pop_back(&allocator->spare_VkDescriptorPool);
+        return pool;
+    }
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DESCRIPTOR_POOL_MAX_SETS * DESCRIPTOR_POOL_UNIFORM_BUFFERS_PER_SET },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, DESCRIPTOR_POOL_MAX_SETS * DESCRIPTOR_POOL_UNIFORM_BUFFERS_DYNAMIC_PER_SET },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_MAX_SETS * DESCRIPTOR_POOL_STORAGE_BUFFERS_PER_SET },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_POOL_MAX_SETS * DESCRIPTOR_POOL_COMBINED_IMAGE_SAMPLERS_PER_SET },
+    };
+
+    VkDescriptorPoolCreateInfo pool_ci = {};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.maxSets = DESCRIPTOR_POOL_MAX_SETS;
+    pool_ci.poolSizeCount = sizeof(pool_sizes) / sizeof(pool_sizes[0]);
+    pool_ci.pPoolSizes = pool_sizes;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(allocator->device, &pool_ci, NULL, &pool) != VK_SUCCESS) {
+        log_fatal("Could not create descriptor pool\n");
+        exit(EXIT_FAILURE);
+    }
+    allocator->stats.pools_created++;
+    return pool;
+}
+
+//
+// Allocates a set from chain's current pool, moving on to another pool
+// when the current one is out of sets or too fragmented to hold it.
+//
+static VkDescriptorSet descriptor_pool_chain_allocate(
+    struct DescriptorAllocator *allocator, struct DescriptorPoolChain *chain, VkDescriptorSetLayout layout) {
+
+    bool fresh_pool = false;
+    for (;;) {
+        if (chain->current == VK_NULL_HANDLE) {
+            chain->current = descriptor_allocator_take_pool(allocator);
+            raw_vector_push_back(&chain->used_VkDescriptorPool, &chain->current);
+            fresh_pool = true;
+        }
+
+        VkDescriptorSetAllocateInfo set_info = {};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = chain->current;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &layout;
+
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(allocator->device, &set_info, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            log_fatal("Could not allocate descriptor set\n");
+            exit(EXIT_FAILURE);
+        }
+        if (fresh_pool) {
+            log_fatal("Descriptor set layout does not fit in an empty descriptor pool\n");
+            exit(EXIT_FAILURE);
+        }
+        chain->current = VK_NULL_HANDLE;
+    }
+}
+
+//
+// Resets the pools frame_index's transient sets came from and returns them
+// to the spare list. The caller must know the GPU is done with
+// frame_index's previous submission.
+//
+void descriptor_allocator_begin_frame(struct DescriptorAllocator *allocator, uint32_t frame_index) {
+    struct DescriptorPoolChain *chain = &allocator->frames[frame_index % allocator->frame_count];
+    allocator->frame_index = frame_index % allocator->frame_count;
+
+    for (size_t i = 0; i < raw_vector_size(&chain->used_VkDescriptorPool); i++) {
+        VkDescriptorPool pool = *(VkDescriptorPool *)raw_vector_get_ptr(&chain->used_VkDescriptorPool, i);
+        vkResetDescriptorPool(allocator->device, pool, 0);
+        raw_vector_push_back(&allocator->spare_VkDescriptorPool, &pool);
+        allocator->stats.pool_resets++;
+    }
+    raw_vector_clear(&chain->used_VkDescriptorPool);
+    chain->current = VK_NULL_HANDLE;
+}
+
+//
+// Allocates a set which is only valid until the current frame comes round
+// again. It is not written; the caller fills it with descriptor_write.
+//
+VkDescriptorSet descriptor_allocator_transient(struct DescriptorAllocator *allocator, VkDescriptorSetLayout layout) {
+    allocator->stats.transient_allocations++;
+    return descriptor_pool_chain_allocate(allocator, &allocator->frames[allocator->frame_index], layout);
+}
+
+static bool descriptor_bindings_equal(
+    const struct DescriptorBinding *a, const struct DescriptorBinding *b, uint32_t binding_count) {
+
+    for (uint32_t i = 0; i < binding_count; i++) {
+        if (a[i].binding != b[i].binding ||
+            a[i].type != b[i].type ||
+            a[i].buffer != b[i].buffer ||
+            a[i].offset != b[i].offset ||
+            a[i].range != b[i].range ||
+            a[i].image_view != b[i].image_view ||
+            a[i].sampler != b[i].sampler ||
+            a[i].image_layout != b[i].image_layout) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Returns a set of layout with bindings written to it, allocating and
+// writing it the first time the combination is asked for. A set forgotten
+// with the same layout is rewritten before a new one is allocated. Sets are
+// never freed individually, so callers should not ask for one per frame;
+// descriptor_allocator_transient is for that.
+//
+VkDescriptorSet descriptor_allocator_persistent(
+    struct DescriptorAllocator *allocator,
+    VkDescriptorSetLayout layout,
+    const struct DescriptorBinding *bindings,
+    uint32_t binding_count) {
+
+    uint64_t hash = hash_fnv1a_64(&layout, sizeof(layout));
+    for (uint32_t i = 0; i < binding_count; i++) {
+        const struct DescriptorBinding *binding = &bindings[i];
+        hash = hash_fnv1a_64_extend(hash, &binding->binding, sizeof(binding->binding));
+        hash = hash_fnv1a_64_extend(hash, &binding->type, sizeof(binding->type));
+        hash = hash_fnv1a_64_extend(hash, &binding->buffer, sizeof(binding->buffer));
+        hash = hash_fnv1a_64_extend(hash, &binding->offset, sizeof(binding->offset));
+        hash = hash_fnv1a_64_extend(hash, &binding->range, sizeof(binding->range));
+        hash = hash_fnv1a_64_extend(hash, &binding->image_view, sizeof(binding->image_view));
+        hash = hash_fnv1a_64_extend(hash, &binding->sampler, sizeof(binding->sampler));
+        hash = hash_fnv1a_64_extend(hash, &binding->image_layout, sizeof(binding->image_layout));
+    }
+
+    for (size_t i = 0; i < raw_vector_size(&allocator->sets_DescriptorSetCacheEntry); i++) {
+        struct DescriptorSetCacheEntry *entry =
+            (struct DescriptorSetCacheEntry *)raw_vector_get_ptr(&allocator->sets_DescriptorSetCacheEntry, i);
+        if (entry->hash == hash &&
+            entry->layout == layout &&
+            entry->binding_count == binding_count &&
+            descriptor_bindings_equal(entry->bindings, bindings, binding_count)) {
+            allocator->stats.persistent_cache_hits++;
+            return entry->set;
+        }
+    }
+
+    struct DescriptorSetCacheEntry entry = {
+        .hash = hash,
+        .layout = layout,
+        .binding_count = binding_count,
+        .bindings = malloc(sizeof(struct DescriptorBinding) * (binding_count > 0 ? binding_count : 1)),
+        .set = VK_NULL_HANDLE,
+    };
+    if (entry.bindings == NULL) {
+        log_fatal("Could not malloc descriptor set cache entry\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(entry.bindings, bindings, sizeof(struct DescriptorBinding) * binding_count);
+
+    for (size_t i = 0; i < raw_vector_size(&allocator->spare_DescriptorSetCacheEntry); i++) {
+        struct DescriptorSetCacheEntry *spare =
+            (struct DescriptorSetCacheEntry *)raw_vector_get_ptr(&allocator->spare_DescriptorSetCacheEntry, i);
+        if (spare->layout == layout) {
+            entry.set = spare->set;
+            raw_vector_erase(&allocator->spare_DescriptorSetCacheEntry, i);
+            break;
+        }
+    }
+    if (entry.set == VK_NULL_HANDLE) {
+        entry.set = descriptor_pool_chain_allocate(allocator, &allocator->persistent, layout);
+        allocator->stats.persistent_allocations++;
+    }
+    descriptor_write(allocator->device, entry.set, bindings, binding_count);
+    raw_vector_push_back(&allocator->sets_DescriptorSetCacheEntry, &entry);
+    return entry.set;
+}
+
+//
+// Drops every cached set binding buffer or image_view, so a resource
+// created later with the same handle never gets a set written for the old
+// one. The sets are kept to be rewritten; the caller must know the GPU is
+// done with them, as it must before destroying what they bind.
+//
+static void descriptor_allocator_forget(struct DescriptorAllocator *allocator, VkBuffer buffer, VkImageView image_view) {
+    size_t i = 0;
+    while (i < raw_vector_size(&allocator->sets_DescriptorSetCacheEntry)) {
+        struct DescriptorSetCacheEntry *entry =
+            (struct DescriptorSetCacheEntry *)raw_vector_get_ptr(&allocator->sets_DescriptorSetCacheEntry, i);
+        bool binds = false;
+        for (uint32_t j = 0; j < entry->binding_count; j++) {
+            const struct DescriptorBinding *binding = &entry->bindings[j];
+            if (descriptor_type_is_image(binding->type)
+                    ? image_view != VK_NULL_HANDLE && binding->image_view == image_view
+                    : buffer != VK_NULL_HANDLE && binding->buffer == buffer) {
+                binds = true;
+            }
+        }
+        if (!binds) {
+            i++;
+            continue;
+        }
+
+        free(entry->bindings);
+        entry->bindings = NULL;
+        entry->binding_count = 0;
+        raw_vector_push_back(&allocator->spare_DescriptorSetCacheEntry, entry);
+        raw_vector_erase(&allocator->sets_DescriptorSetCacheEntry, i);
+        allocator->stats.persistent_evictions++;
+    }
+}
+
+//
+// Called before buffer is destroyed
+//
+void descriptor_allocator_forget_buffer(struct DescriptorAllocator *allocator, VkBuffer buffer) {
+    descriptor_allocator_forget(allocator, buffer, VK_NULL_HANDLE);
+}
+
+//
+// Called before image_view is destroyed
+//
+void descriptor_allocator_forget_image_view(struct DescriptorAllocator *allocator, VkImageView image_view) {
+    descriptor_allocator_forget(allocator, VK_NULL_HANDLE, image_view);
+}
+
+void descriptor_write(VkDevice device, VkDescriptorSet set, const struct DescriptorBinding *bindings, uint32_t binding_count) {
+    VkWriteDescriptorSet *writes = malloc(sizeof(VkWriteDescriptorSet) * binding_count);
+    VkDescriptorBufferInfo *buffer_infos = malloc(sizeof(VkDescriptorBufferInfo) * binding_count);
+    VkDescriptorImageInfo *image_infos = malloc(sizeof(VkDescriptorImageInfo) * binding_count);
+    if (writes == NULL || buffer_infos == NULL || image_infos == NULL) {
+        log_fatal("Could not allocate descriptor writes\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < binding_count; i++) {
+        const struct DescriptorBinding *binding = &bindings[i];
+        writes[i] = (VkWriteDescriptorSet) {};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = binding->binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = binding->type;
+
+        if (descriptor_type_is_image(binding->type)) {
+            image_infos[i] = (VkDescriptorImageInfo) {};
+            image_infos[i].sampler = binding->sampler;
+            image_infos[i].imageView = binding->image_view;
+            image_infos[i].imageLayout = binding->image_layout;
+            writes[i].pImageInfo = &image_infos[i];
+        } else {
+            buffer_infos[i] = (VkDescriptorBufferInfo) {};
+            buffer_infos[i].buffer = binding->buffer;
+            buffer_infos[i].offset = binding->offset;
+            buffer_infos[i].range = binding->range;
+            writes[i].pBufferInfo = &buffer_infos[i];
+        }
+    }
+    vkUpdateDescriptorSets(device, binding_count, writes, 0, NULL);
+
+    free(writes);
+    free(buffer_infos);
+    free(image_infos);
+}
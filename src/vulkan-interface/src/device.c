@@ -22,12 +22,18 @@ bool interface_physical_device_is_complete(struct InterfacePhysicalDevice *ipdev
 //
 // Get the indices of queue families which satisfy certain properties
 // within the list of queue families for this physical device. Populates
-// the *device with these indices. 
+// the *device with these indices. When surface is VK_NULL_HANDLE we are
+// running headless, nothing is ever presented, and the presentation
+// family is simply the graphics family. A family which can transfer but
+// not draw is recorded for streaming uploads, preferring one which cannot
+// compute either, since that is usually a dedicated DMA engine.
 //
 void interface_physical_device_fill_indices(struct InterfacePhysicalDevice *device, VkSurfaceKHR surface) {
 
     struct OptionalIndex graphics_family_index = optional_index_empty();
     struct OptionalIndex presentation_family_index = optional_index_empty();
+    struct OptionalIndex transfer_family_index = optional_index_empty();
+    bool transfer_family_dedicated = false;
 
     uint32_t queue_family_count;
     vkGetPhysicalDeviceQueueFamilyProperties(device->physical_device, &queue_family_count, NULL);
@@ -42,8 +48,17 @@ void interface_physical_device_fill_indices(struct InterfacePhysicalDevice *devi
             optional_index_set_value(&graphics_family_index, i);
         }
         //
+        // Check to see if this queue family is a transfer-only one
+        //
+        VkQueueFlags flags = queue_family_properties[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !transfer_family_dedicated) {
+            optional_index_set_value(&transfer_family_index, i);
+            transfer_family_dedicated = !(flags & VK_QUEUE_COMPUTE_BIT);
+        }
+        //
         // Check to see if this queue family can present to our surface
         //
+        if (surface == VK_NULL_HANDLE) continue;
         VkBool32 presentation_supported = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(device->physical_device, i, surface, &presentation_supported);
         if (presentation_supported) {
@@ -51,8 +66,24 @@ void interface_physical_device_fill_indices(struct InterfacePhysicalDevice *devi
         }
     }
 
+    if (surface == VK_NULL_HANDLE && optional_index_has_value(&graphics_family_index)) {
+        presentation_family_index = graphics_family_index;
+    }
+
     device->graphics_family_index = graphics_family_index;
     device->presentation_family_index = presentation_family_index;
+    device->transfer_family_index = transfer_family_index;
+}
+
+//
+// The family uploads are submitted to: the transfer-only family if there
+// is one, otherwise the graphics family.
+//
+uint32_t interface_physical_device_transfer_family(struct InterfacePhysicalDevice *pdev) {
+    if (optional_index_has_value(&pdev->transfer_family_index)) {
+        return optional_index_get_value(&pdev->transfer_family_index);
+    }
+    return optional_index_get_value(&pdev->graphics_family_index);
 }
 
 //
@@ -79,6 +110,38 @@ bool device_supports_required_extensions(struct InterfacePhysicalDevice *ipdev)
     return true;
 }
 
+//
+// Returns true if the device offers the extension called name
+//
+static bool device_supports_extension(VkPhysicalDevice device, const char *name) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &count, NULL);
+    VkExtensionProperties props[count];
+    vkEnumerateDeviceExtensionProperties(device, NULL, &count, props);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!strcmp(props[i].extensionName, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Frames and uploads are synchronized with a timeline semaphore, a core
+// feature since Vulkan 1.2.
+//
+static bool device_supports_timeline_semaphores(VkPhysicalDevice device) {
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features_12;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return features_12.timelineSemaphore == VK_TRUE;
+}
+
 //
 // Determines if this physical device is suitable by filling its indices
 // and checking if it is then complete.
@@ -91,11 +154,21 @@ bool interface_physical_device_is_device_suitable(struct InterfacePhysicalDevice
     // and presenting to our specified surface.
     //
     interface_physical_device_fill_indices(ipdev, surface);
+    if (!device_supports_timeline_semaphores(ipdev->physical_device)) {
+        log_trace("Device does not support timeline semaphores\n");
+        return false;
+    }
 
     //
     // We then need to make sure that our device has the swapchain extension
-    // enabled.
+    // enabled. Headless rendering never creates a swapchain, so it has no
+    // device extension or swapchain requirements.
     //
+    if (surface == VK_NULL_HANDLE) {
+        bool suitable = interface_physical_device_is_complete(ipdev);
+        log_trace("Device is%ssuitable for headless rendering!\n", suitable ? " " : " not ");
+        return suitable;
+    }
     bool device_has_exts = device_supports_required_extensions(ipdev);
 
     //
@@ -113,12 +186,15 @@ bool interface_physical_device_is_device_suitable(struct InterfacePhysicalDevice
 }
 
 //
-// Lists the physical devices available to this instance. Selects the
-// first physical device with the required queue families and features.
+// Lists the physical devices available to this instance and selects the
+// best ranked one with the required queue families and features, or the
+// one selection overrides to. Every candidate and its score is logged.
 //
-struct InterfacePhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR surface) {
-    VkResult int_result;
+struct InterfacePhysicalDevice pick_physical_device(
+    VkInstance instance, VkSurfaceKHR surface, const struct DeviceSelection *selection) {
+
     struct InterfacePhysicalDevice physical_device = {};
+    struct DeviceScore best_score = {};
     bool found = false;
 
     //
@@ -139,33 +215,63 @@ struct InterfacePhysicalDevice pick_physical_device(VkInstance instance, VkSurfa
             .physical_device = devices[i],
             .graphics_family_index = optional_index_empty(),
             .presentation_family_index = optional_index_empty(),
+            .transfer_family_index = optional_index_empty(),
         };
-        if (interface_physical_device_is_device_suitable(&dev, surface)) {
-            //
-            // For now, we just choose the first physical device which matches
-            //
+        if (selection->override != NULL && !physical_device_matches(devices[i], selection->override)) {
+            continue;
+        }
+        if (!interface_physical_device_is_device_suitable(&dev, surface)) {
+            continue;
+        }
+
+        struct DeviceScore score = physical_device_score(devices[i]);
+        if (selection->benchmark) {
+            score.copy_gb_per_s = physical_device_benchmark(
+                devices[i], optional_index_get_value(&dev.graphics_family_index), selection->benchmark_path);
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(devices[i], &properties);
+        log_info("Candidate device %s: type rank %u, %lu MiB device local, max 2D image %u, %.2f GB/s\n",
+            properties.deviceName,
+            score.type_rank,
+            (unsigned long)(score.device_local_bytes / (1024 * 1024)),
+            score.max_image_dimension_2d,
+            score.copy_gb_per_s);
+
+        if (!found || device_score_compare(&score, &best_score) > 0) {
             physical_device = dev;
+            best_score = score;
             found = true;
-            break;
         }
     }
     if (!found) {
-        log_fatal("No device matches requirements. Aborting...\n");
+        if (selection->override != NULL) {
+            log_fatal("No suitable device matches %s. Aborting...\n", selection->override);
+        } else {
+            log_fatal("No device matches requirements. Aborting...\n");
+        }
         exit(EXIT_FAILURE);
     }
 
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device.physical_device, &properties);
+    log_info("Selected device %s\n", properties.deviceName);
+
     return physical_device;
 }
 
 //
 // Create a logical device from a physical device. Creates queue
 // create infos for all required queues for the required queue families.
+// A headless device does not enable the swapchain extension. Records in
+// pdev which optional features and extensions were enabled.
 //
-VkDevice create_logical_device(struct InterfacePhysicalDevice *pdev) {
+VkDevice create_logical_device(struct InterfacePhysicalDevice *pdev, bool headless, bool surface_maintenance1) {
 
     float queue_priorities[1] = { 1.0f };
 
-    struct RawVector queue_create_info_list = raw_vector_create(sizeof(VkDeviceQueueCreateInfo), 2);
+    struct RawVector queue_create_info_list = raw_vector_create(sizeof(VkDeviceQueueCreateInfo), 3);
 
     raw_vector_push_back(&queue_create_info_list, &(VkDeviceQueueCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
@@ -181,14 +287,124 @@ VkDevice create_logical_device(struct InterfacePhysicalDevice *pdev) {
             .queueCount = 1,
         });
     }
+    //
+    // A transfer-only family never matches the graphics family, but may
+    // still be the one which presents.
+    //
+    if (optional_index_has_value(&pdev->transfer_family_index) &&
+        optional_index_get_value(&pdev->transfer_family_index) != optional_index_get_value(&pdev->presentation_family_index)) {
+        raw_vector_push_back(&queue_create_info_list, &(VkDeviceQueueCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .pQueuePriorities = queue_priorities,
+            .queueFamilyIndex = optional_index_get_value(&pdev->transfer_family_index),
+            .queueCount = 1,
+        });
+    }
+
+    //
+    // Features of optional extensions are only queried where the device
+    // has the extensions; the swapchain ones need a swapchain anyway.
+    //
+    bool has_present_wait = !headless &&
+        device_supports_extension(pdev->physical_device, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        device_supports_extension(pdev->physical_device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    bool has_maintenance1 = !headless && surface_maintenance1 &&
+        device_supports_extension(pdev->physical_device, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+
+    //
+    // Indirect draws of many chunks at once are optional: without them the
+    // chunks are not culled at all. Every chunk starts at its own instance,
+    // so they also need drawIndirectFirstInstance.
+    //
+    VkPhysicalDeviceVulkan12Features supported_12 = {};
+    supported_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDevicePresentIdFeaturesKHR supported_present_id = {};
+    supported_present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR supported_present_wait = {};
+    supported_present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT supported_maintenance1 = {};
+    supported_maintenance1.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    void **supported_next = &supported_12.pNext;
+    if (has_present_wait) {
+        *supported_next = &supported_present_id;
+        supported_present_id.pNext = &supported_present_wait;
+        supported_next = &supported_present_wait.pNext;
+    }
+    if (has_maintenance1) {
+        *supported_next = &supported_maintenance1;
+    }
+    VkPhysicalDeviceFeatures2 supported = {};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported.pNext = &supported_12;
+    vkGetPhysicalDeviceFeatures2(pdev->physical_device, &supported);
+    pdev->multi_draw_indirect =
+        supported.features.multiDrawIndirect == VK_TRUE && supported.features.drawIndirectFirstInstance == VK_TRUE;
+    pdev->draw_indirect_count = pdev->multi_draw_indirect && supported_12.drawIndirectCount == VK_TRUE;
+
+    //
+    // Present IDs and waiting on them let main_loop measure when frames are
+    // actually shown. Both are optional, and only mean anything with a
+    // swapchain.
+    //
+    const char *extensions[NUM_DEVICE_EXTENSIONS + 3];
+    uint32_t extension_count = 0;
+    if (!headless) {
+        for (uint32_t i = 0; i < NUM_DEVICE_EXTENSIONS; i++) {
+            extensions[extension_count++] = required_device_extensions[i];
+        }
+    }
+    pdev->present_wait = has_present_wait &&
+        supported_present_id.presentId == VK_TRUE &&
+        supported_present_wait.presentWait == VK_TRUE;
+    if (pdev->present_wait) {
+        extensions[extension_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        extensions[extension_count++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+    }
+
+    //
+    // Present fences let a recreated swapchain's predecessor be destroyed as
+    // soon as its presents are done. The instance must have enabled
+    // VK_EXT_surface_maintenance1 for them.
+    //
+    pdev->swapchain_maintenance1 = has_maintenance1 && supported_maintenance1.swapchainMaintenance1 == VK_TRUE;
+    if (pdev->swapchain_maintenance1) {
+        extensions[extension_count++] = VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME;
+    }
 
     VkPhysicalDeviceFeatures features = {};
+    features.multiDrawIndirect = pdev->multi_draw_indirect ? VK_TRUE : VK_FALSE;
+    features.drawIndirectFirstInstance = pdev->multi_draw_indirect ? VK_TRUE : VK_FALSE;
+
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features_12.timelineSemaphore = VK_TRUE;
+    features_12.drawIndirectCount = pdev->draw_indirect_count ? VK_TRUE : VK_FALSE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR features_present_wait = {};
+    features_present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    features_present_wait.presentWait = VK_TRUE;
+    VkPhysicalDevicePresentIdFeaturesKHR features_present_id = {};
+    features_present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    features_present_id.pNext = &features_present_wait;
+    features_present_id.presentId = VK_TRUE;
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT features_maintenance1 = {};
+    features_maintenance1.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    features_maintenance1.swapchainMaintenance1 = VK_TRUE;
+    void **features_next = &features_12.pNext;
+    if (pdev->present_wait) {
+        *features_next = &features_present_id;
+        features_next = &features_present_wait.pNext;
+    }
+    if (pdev->swapchain_maintenance1) {
+        *features_next = &features_maintenance1;
+    }
 
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = &features_12,
         .pEnabledFeatures = &features,
 #ifdef NDEBUG
-        .enabledLayerCount = 0;
+        .enabledLayerCount = 0,
 #else
         .ppEnabledLayerNames = debug_requested_validation_layers,
         .enabledLayerCount = NUM_VALIDATION_LAYERS,
@@ -196,8 +412,8 @@ VkDevice create_logical_device(struct InterfacePhysicalDevice *pdev) {
         .queueCreateInfoCount = raw_vector_size(&queue_create_info_list),
         .pQueueCreateInfos = (VkDeviceQueueCreateInfo *)raw_vector_get_ptr(&queue_create_info_list, 0),
 
-        .enabledExtensionCount = NUM_DEVICE_EXTENSIONS,
-        .ppEnabledExtensionNames = required_device_extensions,
+        .enabledExtensionCount = extension_count,
+        .ppEnabledExtensionNames = extension_count > 0 ? extensions : NULL,
     };
 
     VkDevice logical_device;
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vulkan-interface/device_select.h"
+#include "vulkan-interface/command.h"
+#include "vulkan-interface/memory.h"
+#include "language/clock.h"
+#include "language/fileops.h"
+#include "log.h"
+
+static uint32_t physical_device_type_rank(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:            return 1;
+    default:                                     return 0;
+    }
+}
+
+//
+// Scores a device from its properties alone. copy_gb_per_s is left at 0
+// for the caller to fill in if it benchmarks the device.
+//
+struct DeviceScore physical_device_score(VkPhysicalDevice physical_device) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+    struct DeviceScore score = {
+        .type_rank = physical_device_type_rank(properties.deviceType),
+        .copy_gb_per_s = 0.0,
+        .device_local_bytes = 0,
+        .max_image_dimension_2d = properties.limits.maxImageDimension2D,
+    };
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            score.device_local_bytes += memory_properties.memoryHeaps[i].size;
+        }
+    }
+    return score;
+}
+
+static void physical_device_uuid(VkPhysicalDevice physical_device, uint8_t uuid[VK_UUID_SIZE]) {
+    VkPhysicalDeviceIDProperties id_properties = {};
+    id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &id_properties;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+    memcpy(uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+}
+
+//
+// Returns true if the device's name contains name_or_uuid, or if
+// name_or_uuid is the device's UUID.
+//
+bool physical_device_matches(VkPhysicalDevice physical_device, const char *name_or_uuid) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    if (strstr(properties.deviceName, name_or_uuid) != NULL) {
+        return true;
+    }
+
+    uint8_t wanted[VK_UUID_SIZE];
+    if (!device_uuid_parse(name_or_uuid, wanted)) {
+        return false;
+    }
+    uint8_t uuid[VK_UUID_SIZE];
+    physical_device_uuid(physical_device, uuid);
+    return memcmp(uuid, wanted, VK_UUID_SIZE) == 0;
+}
+
+//
+// Copies DEVICE_BENCHMARK_BYTES between two device local buffers
+// DEVICE_BENCHMARK_COPIES times on a throwaway logical device and returns
+// the rate achieved. A copy is a crude but quick proxy for memory
+// bandwidth, which is what drawing large tile maps is bound by. Returns 0
+// if the buffers cannot be allocated.
+//
+static double measure_copy_gb_per_s(VkPhysicalDevice physical_device, uint32_t queue_family_index) {
+    float queue_priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_ci = {};
+    queue_ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_ci.queueFamilyIndex = queue_family_index;
+    queue_ci.queueCount = 1;
+    queue_ci.pQueuePriorities = &queue_priority;
+
+    VkDeviceCreateInfo device_ci = {};
+    device_ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_ci.queueCreateInfoCount = 1;
+    device_ci.pQueueCreateInfos = &queue_ci;
+
+    VkDevice device;
+    if (vkCreateDevice(physical_device, &device_ci, NULL, &device) != VK_SUCCESS) {
+        log_error("Could not create a device to benchmark\n");
+        return 0.0;
+    }
+    VkQueue queue;
+    vkGetDeviceQueue(device, queue_family_index, 0, &queue);
+
+    VkBuffer buffers[2] = {
+        create_buffer(device, DEVICE_BENCHMARK_BYTES, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+        create_buffer(device, DEVICE_BENCHMARK_BYTES, VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+    };
+    VkDeviceMemory memory[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+    bool allocated = true;
+    for (int i = 0; i < 2; i++) {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device, buffers[i], &requirements);
+
+        uint32_t memory_type_index;
+        if (!try_find_memory_type_index(
+                physical_device, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory_type_index)) {
+            allocated = false;
+            break;
+        }
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = requirements.size;
+        alloc_info.memoryTypeIndex = memory_type_index;
+        if (vkAllocateMemory(device, &alloc_info, NULL, &memory[i]) != VK_SUCCESS) {
+            allocated = false;
+            break;
+        }
+        vkBindBufferMemory(device, buffers[i], memory[i], 0);
+    }
+
+    double gb_per_s = 0.0;
+    VkCommandPool pool = create_transient_command_pool(device, queue_family_index);
+    if (allocated) {
+        VkCommandBufferAllocateInfo cb_info = {};
+        cb_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cb_info.commandPool = pool;
+        cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cb_info.commandBufferCount = 2;
+
+        VkCommandBuffer command_buffers[2];
+        VkFenceCreateInfo fence_ci = {};
+        fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkAllocateCommandBuffers(device, &cb_info, command_buffers) != VK_SUCCESS ||
+            vkCreateFence(device, &fence_ci, NULL, &fence) != VK_SUCCESS) {
+            log_fatal("Could not set up the device benchmark\n");
+            exit(EXIT_FAILURE);
+        }
+
+        VkBufferCopy region = {};
+        region.size = DEVICE_BENCHMARK_BYTES;
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        //
+        // The first command buffer fills the source and warms up with one
+        // copy; only the second, which copies back to back, is timed.
+        //
+        for (int i = 0; i < 2; i++) {
+            VkCommandBufferBeginInfo begin_info = {};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (vkBeginCommandBuffer(command_buffers[i], &begin_info) != VK_SUCCESS) {
+                log_fatal("Could not begin device benchmark command buffer\n");
+                exit(EXIT_FAILURE);
+            }
+            if (i == 0) {
+                vkCmdFillBuffer(command_buffers[i], buffers[0], 0, VK_WHOLE_SIZE, 0x5a5a5a5au);
+            }
+            uint32_t copies = i == 0 ? 1 : DEVICE_BENCHMARK_COPIES;
+            for (uint32_t c = 0; c < copies; c++) {
+                vkCmdPipelineBarrier(
+                    command_buffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0, 1, &barrier, 0, NULL, 0, NULL);
+                vkCmdCopyBuffer(command_buffers[i], buffers[0], buffers[1], 1, &region);
+            }
+            if (vkEndCommandBuffer(command_buffers[i]) != VK_SUCCESS) {
+                log_fatal("Failed to record device benchmark command buffer\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        uint64_t elapsed_ns = 0;
+        for (int i = 0; i < 2; i++) {
+            VkSubmitInfo submit_info = {};
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &command_buffers[i];
+
+            uint64_t start_ns = clock_now_ns();
+            if (vkQueueSubmit(queue, 1, &submit_info, fence) != VK_SUCCESS) {
+                log_fatal("Failed to submit the device benchmark\n");
+                exit(EXIT_FAILURE);
+            }
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+            if (i == 1) {
+                elapsed_ns = clock_now_ns() - start_ns;
+            }
+        }
+        double seconds = clock_ns_to_seconds(elapsed_ns);
+        if (seconds > 0.0) {
+            gb_per_s = (double)DEVICE_BENCHMARK_BYTES * DEVICE_BENCHMARK_COPIES / seconds / 1e9;
+        }
+        vkDestroyFence(device, fence, NULL);
+    } else {
+        log_error("Could not allocate device local memory to benchmark\n");
+    }
+
+    vkDestroyCommandPool(device, pool, NULL);
+    for (int i = 0; i < 2; i++) {
+        vkDestroyBuffer(device, buffers[i], NULL);
+        if (memory[i] != VK_NULL_HANDLE) {
+            vkFreeMemory(device, memory[i], NULL);
+        }
+    }
+    vkDestroyDevice(device, NULL);
+    return gb_per_s;
+}
+
+//
+// Returns the device's copy rate, from cache_path if it was measured before
+// for this device and driver, otherwise measured now and added to the cache.
+// A missing or corrupt cache is not an error; it is rebuilt.
+//
+double physical_device_benchmark(VkPhysicalDevice physical_device, uint32_t queue_family_index, const char *cache_path) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    struct DeviceBenchmarkRecord record = {
+        .driver_version = properties.driverVersion,
+    };
+    physical_device_uuid(physical_device, record.device_uuid);
+
+    size_t size = 0;
+    uint8_t *data = cache_path != NULL ? try_read_binary_file_FREE(cache_path, &size) : NULL;
+    struct DeviceBenchmarkFileHeader header = { .magic = DEVICE_BENCHMARK_MAGIC, .record_count = 0 };
+    if (data != NULL && size >= sizeof(header)) {
+        memcpy(&header, data, sizeof(header));
+        if (header.magic != DEVICE_BENCHMARK_MAGIC ||
+            size != sizeof(header) + (size_t)header.record_count * sizeof(struct DeviceBenchmarkRecord)) {
+            log_info("Device benchmark cache %s is corrupt, discarding it\n", cache_path);
+            header = (struct DeviceBenchmarkFileHeader) { .magic = DEVICE_BENCHMARK_MAGIC, .record_count = 0 };
+        }
+    }
+
+    for (uint32_t i = 0; i < header.record_count; i++) {
+        struct DeviceBenchmarkRecord cached;
+        memcpy(&cached, data + sizeof(header) + i * sizeof(cached), sizeof(cached));
+        if (cached.driver_version == record.driver_version &&
+            memcmp(cached.device_uuid, record.device_uuid, VK_UUID_SIZE) == 0) {
+            log_info("%s: %.2f GB/s (cached)\n", properties.deviceName, cached.copy_gb_per_s);
+            free(data);
+            return cached.copy_gb_per_s;
+        }
+    }
+
+    record.copy_gb_per_s = measure_copy_gb_per_s(physical_device, queue_family_index);
+    log_info("%s: %.2f GB/s (measured)\n", properties.deviceName, record.copy_gb_per_s);
+
+    if (cache_path != NULL && record.copy_gb_per_s > 0.0) {
+        size_t old_records_size = (size_t)header.record_count * sizeof(record);
+        size_t new_size = sizeof(header) + old_records_size + sizeof(record);
+        uint8_t *file = malloc(new_size);
+        if (file == NULL) {
+            log_fatal("Could not malloc device benchmark cache\n");
+            exit(EXIT_FAILURE);
+        }
+        if (old_records_size > 0) {
+            memcpy(file + sizeof(header), data + sizeof(header), old_records_size);
+        }
+        header.record_count++;
+        memcpy(file, &header, sizeof(header));
+        memcpy(file + sizeof(header) + old_records_size, &record, sizeof(record));
+        write_binary_file_atomic(cache_path, file, new_size);
+        free(file);
+    }
+    free(data);
+    return record.copy_gb_per_s;
+}
@@ -49,15 +49,21 @@ void DestroyDebugUtilsMessengerEXT(
 //
 // Get extensions required by the program. This includes the GLFW
 // required extensions along with the debug utils extension if
-// validation layers are to be enabled.
+// validation layers are to be enabled. Headless instances never
+// create a surface, so GLFW is not consulted (or even initialized).
 //
-struct RawVector get_required_extension_names_FREE() {
+struct RawVector get_required_extension_names_FREE(bool headless) {
 
-    uint32_t count;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&count);
+    uint32_t count = 0;
+    const char** glfwExtensions = NULL;
+    if (!headless) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&count);
+    }
 
     struct RawVector extension_names = raw_vector_create(sizeof(char *), (size_t) count);
-    raw_vector_extend_back(&extension_names, glfwExtensions, count);
+    if (count > 0) {
+        raw_vector_extend_back(&extension_names, glfwExtensions, count);
+    }
 
 #ifndef NDEBUG
     const char *debug_ext = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
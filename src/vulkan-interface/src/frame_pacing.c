@@ -0,0 +1,62 @@
+#include <string.h>
+#include "vulkan-interface/frame_pacing.h"
+
+static const struct FramePacing frame_pacing_profiles[FRAME_PACING_PROFILE_COUNT] = {
+    //
+    // One frame in flight and the fewest images: the CPU never queues work
+    // behind a frame the GPU has not finished, and presents replace rather
+    // than queue behind one another.
+    //
+    [FRAME_PACING_LOW_LATENCY] = {
+        .name = "low-latency",
+        .frames_in_flight = 1,
+        .extra_swapchain_images = 0,
+        .preferred_present_mode_count = 2,
+        .preferred_present_modes = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR },
+    },
+    [FRAME_PACING_BALANCED] = {
+        .name = "balanced",
+        .frames_in_flight = 2,
+        .extra_swapchain_images = 1,
+        .preferred_present_mode_count = 1,
+        .preferred_present_modes = { VK_PRESENT_MODE_MAILBOX_KHR },
+    },
+    //
+    // Keep the GPU fed: the CPU may record up to three frames ahead and
+    // present never blocks on vertical blank.
+    //
+    [FRAME_PACING_MAX_THROUGHPUT] = {
+        .name = "max-throughput",
+        .frames_in_flight = 3,
+        .extra_swapchain_images = 2,
+        .preferred_present_mode_count = 2,
+        .preferred_present_modes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR },
+    },
+};
+
+const struct FramePacing *frame_pacing_profile(enum FramePacingProfile profile) {
+    return &frame_pacing_profiles[profile];
+}
+
+//
+// Looks a profile up by its name, as given on the command line.
+//
+bool frame_pacing_profile_from_name(const char *name, enum FramePacingProfile *profile) {
+    for (int i = 0; i < FRAME_PACING_PROFILE_COUNT; i++) {
+        if (!strcmp(frame_pacing_profiles[i].name, name)) {
+            *profile = (enum FramePacingProfile)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *present_mode_name(VkPresentModeKHR present_mode) {
+    switch (present_mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include "language/clock.h"
+#include "language/math.h"
+#include "vulkan-interface/command.h"
+#include "vulkan-interface/frame_recorder.h"
+#include "log.h"
+
+//
+// Everything a recording thread needs to record one chunk into a secondary
+// command buffer that continues frame's render pass.
+//
+struct ChunkRecordJob {
+    struct FrameRecorder *recorder;
+    struct FrameRecorderFrame *frame;
+    uint32_t frame_index;
+    uint32_t chunk_index;
+    VkRenderPass renderpass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    const struct TileDrawBuffers *draw_buffers;
+    const struct TileDrawUniforms *uniforms;
+    struct ChunkCuller *culler;
+};
+
+void frame_recorder_init(
+    struct FrameRecorder *recorder,
+    VkDevice device,
+    uint32_t qf_idx,
+    uint32_t frame_count,
+    uint32_t thread_count) {
+
+    if (thread_count == 0) {
+        thread_count = thread_pool_default_thread_count();
+    }
+
+    recorder->device = device;
+    recorder->frame_count = frame_count;
+    recorder->thread_count = thread_count;
+    recorder->chunks_TileChunk = raw_vector_create(sizeof(struct TileChunk), 64);
+    recorder->secondaries_VkCommandBuffer = raw_vector_create(sizeof(VkCommandBuffer), 64);
+    recorder->frames_recorded = 0;
+    recorder->chunks_recorded = 0;
+    recorder->record_ns = 0;
+
+    recorder->frames = malloc(sizeof(struct FrameRecorderFrame) * frame_count);
+    if (recorder->frames == NULL) {
+        log_fatal("Could not malloc frame recorder frames\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < frame_count; i++) {
+        struct FrameRecorderFrame *frame = &recorder->frames[i];
+        frame->pool = create_transient_command_pool(device, qf_idx);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = frame->pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &alloc_info, &frame->primary) != VK_SUCCESS) {
+            log_fatal("Could not allocate primary command buffer\n");
+            exit(EXIT_FAILURE);
+        }
+
+        frame->threads = malloc(sizeof(struct FrameRecorderThread) * thread_count);
+        if (frame->threads == NULL) {
+            log_fatal("Could not malloc frame recorder threads\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t t = 0; t < thread_count; t++) {
+            frame->threads[t] = (struct FrameRecorderThread) {
+                .pool = create_transient_command_pool(device, qf_idx),
+                .secondaries_VkCommandBuffer = raw_vector_create(sizeof(VkCommandBuffer), 4),
+                .used = 0,
+            };
+        }
+    }
+
+    thread_pool_init(&recorder->threads, thread_count);
+}
+
+void frame_recorder_destroy(struct FrameRecorder *recorder) {
+    thread_pool_destroy(&recorder->threads);
+
+    if (recorder->frames_recorded > 0) {
+        log_info("Recorded %lu frames on %u threads: %.3f ms avg recording, %.1f chunks per frame\n",
+            (unsigned long)recorder->frames_recorded,
+            recorder->thread_count,
+            clock_ns_to_ms(recorder->record_ns) / recorder->frames_recorded,
+            (double)recorder->chunks_recorded / recorder->frames_recorded);
+    }
+
+    for (uint32_t i = 0; i < recorder->frame_count; i++) {
+        struct FrameRecorderFrame *frame = &recorder->frames[i];
+        for (uint32_t t = 0; t < recorder->thread_count; t++) {
+            vkDestroyCommandPool(recorder->device, frame->threads[t].pool, NULL);
+            raw_vector_destroy(&frame->threads[t].secondaries_VkCommandBuffer);
+        }
+        free(frame->threads);
+        vkDestroyCommandPool(recorder->device, frame->pool, NULL);
+    }
+    free(recorder->frames);
+    raw_vector_destroy(&recorder->chunks_TileChunk);
+    raw_vector_destroy(&recorder->secondaries_VkCommandBuffer);
+}
+
+//
+// Hands out the next secondary command buffer of thread's pool, allocating
+// another one the first time a frame needs more than ever before.
+//
+static VkCommandBuffer frame_recorder_thread_next_secondary(VkDevice device, struct FrameRecorderThread *thread) {
+    if (thread->used == raw_vector_size(&thread->secondaries_VkCommandBuffer)) {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = thread->pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer secondary;
+        if (vkAllocateCommandBuffers(device, &alloc_info, &secondary) != VK_SUCCESS) {
+            log_fatal("Could not allocate secondary command buffer\n");
+            exit(EXIT_FAILURE);
+        }
+        raw_vector_push_back(&thread->secondaries_VkCommandBuffer, &secondary);
+    }
+    return *(VkCommandBuffer *)raw_vector_get_ptr(&thread->secondaries_VkCommandBuffer, thread->used++);
+}
+
+//
+// An indirect chunk is a whole layer whose draws culler wrote this frame;
+// a streamed chunk is a run of the layer's chunk draws.
+//
+static void frame_recorder_draw_chunk(
+    VkCommandBuffer command_buffer,
+    const struct TileChunk *chunk,
+    struct ChunkCuller *culler,
+    uint32_t frame_index) {
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, chunk->pipeline);
+    if (chunk->indirect) {
+        chunk_culler_draw_layer(culler, command_buffer, frame_index, chunk->layer_index);
+    } else if (chunk->draws != NULL) {
+        for (uint32_t i = 0; i < chunk->draw_count; i++) {
+            record_tile_layer_draw(command_buffer, false, chunk->draws[i].first_instance, chunk->draws[i].instance_count);
+        }
+    } else {
+        record_tile_layer_draw(command_buffer, chunk->fullscreen, chunk->first_instance, chunk->instance_count);
+    }
+}
+
+//
+// Recording thread body. Every thread has its own pool in each frame, so
+// recording needs no locks; the result goes into the chunk's own slot.
+//
+static void frame_recorder_record_chunk(void *arg, uint32_t worker_index) {
+    struct ChunkRecordJob *job = arg;
+    struct FrameRecorder *recorder = job->recorder;
+    const struct TileChunk *chunk = (struct TileChunk *)raw_vector_get_ptr(&recorder->chunks_TileChunk, job->chunk_index);
+
+    VkCommandBuffer secondary = frame_recorder_thread_next_secondary(recorder->device, &job->frame->threads[worker_index]);
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = job->renderpass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = job->framebuffer;
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(secondary, &begin_info) != VK_SUCCESS) {
+        log_fatal("Could not begin secondary command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    record_tile_draw_setup(secondary, job->extent, job->draw_buffers, job->uniforms);
+    frame_recorder_draw_chunk(secondary, chunk, job->culler, job->frame_index);
+
+    if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+        log_fatal("Failed to record secondary command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *(VkCommandBuffer *)raw_vector_get_ptr(&recorder->secondaries_VkCommandBuffer, job->chunk_index) = secondary;
+}
+
+//
+// Splits every layer of draw_buffers into chunks of at most
+// TILE_CHUNK_INSTANCES instances, bottom layer first. Pipelines are looked
+// up here, on the render thread, so layers whose variant is still compiling
+// use its fallback or are left out. With a culler every instanced layer is
+// a single indirect chunk instead, however many instances it has. The
+// chunk draws of a streamed map are grouped into runs of about
+// TILE_CHUNK_INSTANCES instances.
+//
+static void frame_recorder_build_chunks(
+    struct FrameRecorder *recorder,
+    VkRenderPass renderpass,
+    struct PipelineRegistry *pipelines,
+    const struct TileDrawBuffers *draw_buffers,
+    struct ChunkCuller *culler) {
+
+    raw_vector_clear(&recorder->chunks_TileChunk);
+    for (uint32_t i = 0; i < draw_buffers->layer_count; i++) {
+        const struct TileLayerRange *layer = &draw_buffers->layers[i];
+        if (layer->instance_count == 0) {
+            continue;
+        }
+
+        struct PipelineKey key = pipeline_key_for_layer_range(renderpass, layer);
+        VkPipeline pipeline = pipeline_registry_request(pipelines, &key);
+        if (pipeline == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        if (draw_buffers->chunk_draws != NULL && !layer->fullscreen) {
+            const struct TileLayerRange *draws = &draw_buffers->chunk_draws[draw_buffers->first_chunk_draw[i]];
+            struct TileChunk chunk = {};
+            for (uint32_t d = 0; d < draw_buffers->chunk_draw_count[i]; d++) {
+                if (chunk.draw_count == 0) {
+                    chunk = (struct TileChunk) {
+                        .pipeline = pipeline,
+                        .layer_index = i,
+                        .draws = &draws[d],
+                    };
+                }
+                chunk.draw_count++;
+                chunk.instance_count += draws[d].instance_count;
+                if (chunk.instance_count >= TILE_CHUNK_INSTANCES) {
+                    raw_vector_push_back(&recorder->chunks_TileChunk, &chunk);
+                    chunk.draw_count = 0;
+                }
+            }
+            if (chunk.draw_count > 0) {
+                raw_vector_push_back(&recorder->chunks_TileChunk, &chunk);
+            }
+            continue;
+        }
+
+        if (culler != NULL && !layer->fullscreen) {
+            struct TileChunk chunk = {
+                .first_instance = layer->first_instance,
+                .instance_count = layer->instance_count,
+                .pipeline = pipeline,
+                .fullscreen = false,
+                .indirect = true,
+                .layer_index = i,
+            };
+            raw_vector_push_back(&recorder->chunks_TileChunk, &chunk);
+            continue;
+        }
+
+        for (uint32_t first = 0; first < layer->instance_count; first += TILE_CHUNK_INSTANCES) {
+            struct TileChunk chunk = {
+                .first_instance = layer->first_instance + first,
+                .instance_count = MIN(TILE_CHUNK_INSTANCES, layer->instance_count - first),
+                .pipeline = pipeline,
+                .fullscreen = layer->fullscreen,
+                .indirect = false,
+                .layer_index = i,
+            };
+            raw_vector_push_back(&recorder->chunks_TileChunk, &chunk);
+        }
+    }
+}
+
+//
+// Resets frame_index's pools and records its primary command buffer to draw
+// draw_buffers into framebuffer, with uniforms bound. A map of more than
+// one chunk has its chunks recorded into secondary command buffers in
+// parallel, which the primary then executes in layer order; a single chunk
+// is recorded inline. When culler is not NULL its cull pass is recorded
+// ahead of the render pass and the instanced layers are drawn from what it
+// wrote. The caller must know the GPU is done with frame_index's previous
+// submission.
+//
+VkCommandBuffer frame_recorder_record(
+    struct FrameRecorder *recorder,
+    uint32_t frame_index,
+    VkRenderPass renderpass,
+    struct PipelineRegistry *pipelines,
+    VkFramebuffer framebuffer,
+    VkExtent2D extent,
+    const struct TileDrawBuffers *draw_buffers,
+    const struct TileDrawUniforms *uniforms,
+    struct ChunkCuller *culler) {
+
+    uint64_t start_ns = clock_now_ns();
+    struct FrameRecorderFrame *frame = &recorder->frames[frame_index];
+
+    vkResetCommandPool(recorder->device, frame->pool, 0);
+    for (uint32_t t = 0; t < recorder->thread_count; t++) {
+        vkResetCommandPool(recorder->device, frame->threads[t].pool, 0);
+        frame->threads[t].used = 0;
+    }
+
+    frame_recorder_build_chunks(recorder, renderpass, pipelines, draw_buffers, culler);
+    uint32_t chunk_count = raw_vector_size(&recorder->chunks_TileChunk);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(frame->primary, &begin_info) != VK_SUCCESS) {
+        log_fatal("Could not begin primary command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (culler != NULL) {
+        chunk_culler_record(culler, frame->primary, frame_index, &uniforms->camera);
+    }
+
+    if (chunk_count <= 1) {
+        begin_tile_render_pass(frame->primary, renderpass, framebuffer, extent, VK_SUBPASS_CONTENTS_INLINE);
+        if (chunk_count == 1) {
+            const struct TileChunk *chunk = (struct TileChunk *)raw_vector_get_ptr(&recorder->chunks_TileChunk, 0);
+            record_tile_draw_setup(frame->primary, extent, draw_buffers, uniforms);
+            frame_recorder_draw_chunk(frame->primary, chunk, culler, frame_index);
+        }
+    } else {
+        raw_vector_clear(&recorder->secondaries_VkCommandBuffer);
+        VkCommandBuffer no_command_buffer = VK_NULL_HANDLE;
+        for (uint32_t i = 0; i < chunk_count; i++) {
+            raw_vector_push_back(&recorder->secondaries_VkCommandBuffer, &no_command_buffer);
+        }
+
+        struct ChunkRecordJob jobs[chunk_count];
+        for (uint32_t i = 0; i < chunk_count; i++) {
+            jobs[i] = (struct ChunkRecordJob) {
+                .recorder = recorder,
+                .frame = frame,
+                .frame_index = frame_index,
+                .chunk_index = i,
+                .renderpass = renderpass,
+                .framebuffer = framebuffer,
+                .extent = extent,
+                .draw_buffers = draw_buffers,
+                .uniforms = uniforms,
+                .culler = culler,
+            };
+            thread_pool_submit(&recorder->threads, frame_recorder_record_chunk, &jobs[i]);
+        }
+        thread_pool_wait_idle(&recorder->threads);
+
+        begin_tile_render_pass(frame->primary, renderpass, framebuffer, extent, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(
+            frame->primary,
+            chunk_count,
+            (VkCommandBuffer *)raw_vector_get_ptr(&recorder->secondaries_VkCommandBuffer, 0));
+    }
+    vkCmdEndRenderPass(frame->primary);
+
+    if (vkEndCommandBuffer(frame->primary) != VK_SUCCESS) {
+        log_fatal("Failed to record primary command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    recorder->frames_recorded++;
+    recorder->chunks_recorded += chunk_count;
+    recorder->record_ns += clock_now_ns() - start_ns;
+    return frame->primary;
+}
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include "vulkan-interface/frame_sync.h"
+#include "log.h"
+
+void frame_sync_init(struct FrameSync *sync, VkDevice device, uint32_t frames_in_flight, uint32_t image_count) {
+    VkSemaphoreTypeCreateInfo type_ci = {};
+    type_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_ci.initialValue = 0;
+
+    VkSemaphoreCreateInfo timeline_ci = {};
+    timeline_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timeline_ci.pNext = &type_ci;
+
+    *sync = (struct FrameSync) {
+        .device = device,
+        .last_signalled = 0,
+        .completed = 0,
+        .frames_in_flight = frames_in_flight,
+        .image_values_uint64 = raw_vector_create(sizeof(uint64_t), image_count),
+    };
+    if (vkCreateSemaphore(device, &timeline_ci, NULL, &sync->timeline) != VK_SUCCESS) {
+        log_fatal("Could not create timeline semaphore\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkSemaphoreCreateInfo binary_ci = {};
+    binary_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        if (vkCreateSemaphore(device, &binary_ci, NULL, &sync->image_available[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &binary_ci, NULL, &sync->render_finished[i]) != VK_SUCCESS) {
+            log_fatal("Could not create sempahores\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    frame_sync_reset_images(sync, image_count);
+}
+
+void frame_sync_destroy(struct FrameSync *sync) {
+    log_info("Frame sync: %lu submissions, %lu counter queries, %lu blocking waits\n",
+        (unsigned long)sync->last_signalled,
+        (unsigned long)sync->queries,
+        (unsigned long)sync->waits);
+
+    for (uint32_t i = 0; i < sync->frames_in_flight; i++) {
+        vkDestroySemaphore(sync->device, sync->image_available[i], NULL);
+        vkDestroySemaphore(sync->device, sync->render_finished[i], NULL);
+    }
+    vkDestroySemaphore(sync->device, sync->timeline, NULL);
+    raw_vector_destroy(&sync->image_values_uint64);
+}
+
+//
+// Returns the value the next submission must signal on the timeline.
+//
+uint64_t frame_sync_next_value(struct FrameSync *sync) {
+    return ++sync->last_signalled;
+}
+
+//
+// Returns true once the GPU has finished the submission which signals
+// value. Only asks the driver if the cached completed value is too old.
+//
+bool frame_sync_is_complete(struct FrameSync *sync, uint64_t value) {
+    if (value <= sync->completed) {
+        return true;
+    }
+    sync->queries++;
+    if (vkGetSemaphoreCounterValue(sync->device, sync->timeline, &sync->completed) != VK_SUCCESS) {
+        log_fatal("Could not read timeline semaphore\n");
+        exit(EXIT_FAILURE);
+    }
+    return value <= sync->completed;
+}
+
+//
+// Blocks until the GPU has finished the submission which signals value.
+//
+void frame_sync_wait(struct FrameSync *sync, uint64_t value) {
+    if (frame_sync_is_complete(sync, value)) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &sync->timeline;
+    wait_info.pValues = &value;
+
+    sync->waits++;
+    if (vkWaitSemaphores(sync->device, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+        log_fatal("Failed waiting on timeline semaphore\n");
+        exit(EXIT_FAILURE);
+    }
+    sync->completed = value;
+}
+
+//
+// Records that frame_index drew into image_index with a submission which
+// signals value, so neither is reused before the GPU gets there.
+//
+void frame_sync_submitted(struct FrameSync *sync, uint32_t frame_index, uint32_t image_index, uint64_t value) {
+    sync->frame_values[frame_index] = value;
+    *(uint64_t *)raw_vector_get_ptr(&sync->image_values_uint64, image_index) = value;
+}
+
+//
+// Forgets which submissions used which images, e.g. after the swapchain
+// was recreated with image_count images. Value 0 is always complete.
+//
+void frame_sync_reset_images(struct FrameSync *sync, uint32_t image_count) {
+    raw_vector_clear(&sync->image_values_uint64);
+    uint64_t none = 0;
+    for (uint32_t i = 0; i < image_count; i++) {
+        raw_vector_push_back(&sync->image_values_uint64, &none);
+    }
+}
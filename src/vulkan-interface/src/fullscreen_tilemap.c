@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vulkan-interface/fullscreen_tilemap.h"
+#include "log.h"
+
+//
+// The layout of the tilemap's set. Layouts are cached by the descriptor
+// allocator, so this can be called before the tilemap exists, e.g. to build
+// the pipeline layout, and returns the same layout the tilemap binds.
+//
+VkDescriptorSetLayout fullscreen_tilemap_set_layout(struct DescriptorAllocator *descriptors) {
+    VkDescriptorSetLayoutBinding layout_binding = {};
+    layout_binding.binding = FULLSCREEN_TILEMAP_BINDING;
+    layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layout_binding.descriptorCount = 1;
+    layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    return descriptor_allocator_layout(descriptors, &layout_binding, 1);
+}
+
+//
+// Whether the count instances put exactly one tile on every cell of the
+// width x height map, each at a whole cell inside it. covered is scratch
+// of at least one bit per cell.
+//
+static bool instances_cover_map(
+    const struct TileInstance *instances, size_t count, uint32_t width, uint32_t height, uint8_t *covered) {
+
+    size_t tile_count = (size_t)width * height;
+    if (count != tile_count) {
+        return false;
+    }
+    memset(covered, 0, (tile_count + 7) / 8);
+    for (size_t i = 0; i < count; i++) {
+        float x = instances[i].position[0];
+        float y = instances[i].position[1];
+        if (!(x >= 0.0f && x < (float)width && y >= 0.0f && y < (float)height) ||
+            x != (float)(uint32_t)x || y != (float)(uint32_t)y) {
+            return false;
+        }
+        size_t cell = (size_t)(uint32_t)y * width + (uint32_t)x;
+        if (covered[cell / 8] & (1u << (cell % 8))) {
+            return false;
+        }
+        covered[cell / 8] |= (uint8_t)(1u << (cell % 8));
+    }
+    return true;
+}
+
+//
+// Moves every opaque layer whose instances put one tile on each cell of the
+// width x height map out of rvec_TileInstance and into tiles_uint32, as a
+// grid of atlas indices. Those layers become fullscreen layers; the
+// instances of the rest are compacted down and their ranges moved to match.
+// Returns how many layers became fullscreen.
+//
+uint32_t fullscreen_tilemap_extract_dense_layers(
+    struct RawVector *rvec_TileInstance,
+    struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t layer_count,
+    uint32_t width,
+    uint32_t height,
+    struct RawVector *tiles_uint32) {
+
+    size_t tile_count = (size_t)width * height;
+    struct TileInstance *instances = (struct TileInstance *)raw_vector_get_ptr(rvec_TileInstance, 0);
+    uint32_t dense_count = 0;
+    uint32_t kept = 0;
+
+    uint8_t *covered = malloc(tile_count / 8 + 1);
+    if (covered == NULL) {
+        log_fatal("Could not malloc tile coverage\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < layer_count; i++) {
+        struct TileLayerRange *layer = &layers[i];
+        if (layer->mode == TILE_LAYER_MODE_OVERLAY ||
+            !instances_cover_map(&instances[layer->first_instance], layer->instance_count, width, height, covered)) {
+            for (uint32_t j = 0; j < layer->instance_count; j++) {
+                instances[kept + j] = instances[layer->first_instance + j];
+            }
+            layer->first_instance = kept;
+            kept += layer->instance_count;
+            continue;
+        }
+
+        size_t base = raw_vector_size(tiles_uint32);
+        uint32_t zero = 0;
+        for (size_t j = 0; j < tile_count; j++) {
+            raw_vector_push_back(tiles_uint32, &zero);
+        }
+        uint32_t *tiles = (uint32_t *)raw_vector_get_ptr(tiles_uint32, base);
+        for (uint32_t j = 0; j < layer->instance_count; j++) {
+            const struct TileInstance *instance = &instances[layer->first_instance + j];
+            uint32_t x = (uint32_t)instance->position[0];
+            uint32_t y = (uint32_t)instance->position[1];
+            tiles[(size_t)y * width + x] = instance->atlas_index;
+        }
+
+        layer->first_instance = dense_count++;
+        layer->instance_count = 1;
+        layer->fullscreen = true;
+    }
+    free(covered);
+
+    while (raw_vector_size(rvec_TileInstance) > kept) {
+        raw_vector_pop_back(rvec_TileInstance);
+    }
+    return dense_count;
+}
+
+//
+// Uploads the header and the grids of tiles_uint32 through upload; the
+// caller flushes it. The buffer always exists so the set can be bound even
+// when no layer is fullscreen, in which case it holds just the header.
+//
+void fullscreen_tilemap_init(
+    struct FullscreenTilemap *tilemap,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    struct UploadContext *upload,
+    uint32_t width,
+    uint32_t height,
+    struct RawVector *tiles_uint32) {
+
+    size_t tile_count = raw_vector_size(tiles_uint32);
+    struct FullscreenTilemapHeader header = {
+        .width = width,
+        .height = height,
+        .layer_count = tile_count > 0 ? (uint32_t)(tile_count / ((size_t)width * height)) : 0,
+    };
+    VkDeviceSize tiles_size = sizeof(uint32_t) * (VkDeviceSize)tile_count;
+
+    *tilemap = (struct FullscreenTilemap) {
+        .allocator = allocator,
+        .descriptors = descriptors,
+        .width = width,
+        .height = height,
+        .layer_count = header.layer_count,
+        .set_layout = fullscreen_tilemap_set_layout(descriptors),
+    };
+    tilemap->buffer = create_device_local_buffer(
+        allocator,
+        sizeof(header) + tiles_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        &tilemap->allocation);
+    upload_buffer(
+        upload, tilemap->buffer, 0, &header, sizeof(header),
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    if (tile_count > 0) {
+        upload_buffer(
+            upload, tilemap->buffer, sizeof(header), raw_vector_get_ptr(tiles_uint32, 0), tiles_size,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    struct DescriptorBinding binding = {
+        .binding = FULLSCREEN_TILEMAP_BINDING,
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .buffer = tilemap->buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+    };
+    tilemap->descriptor_set = descriptor_allocator_persistent(descriptors, tilemap->set_layout, &binding, 1);
+
+    if (tilemap->layer_count > 0) {
+        log_info("Drawing %u dense layers of %ux%u tiles fullscreen from %lu KiB of tile IDs\n",
+            tilemap->layer_count, width, height, (unsigned long)(tiles_size / 1024));
+    }
+}
+
+void fullscreen_tilemap_destroy(struct FullscreenTilemap *tilemap) {
+    descriptor_allocator_forget_buffer(tilemap->descriptors, tilemap->buffer);
+    destroy_buffer_with_memory(tilemap->allocator, tilemap->buffer, &tilemap->allocation);
+}
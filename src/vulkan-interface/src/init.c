@@ -14,19 +14,30 @@ GLFWwindow *init_window() {
     return glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_NAME, NULL, NULL);
 }
 
+static bool instance_extension_available(VkExtensionProperties *extensions, uint32_t count, const char *name) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (!strcmp(extensions[i].extensionName, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 //
 // Initializes Vulkan and creates an instance object. Queries the extension.h
 // module for the required extensions. Queries the debug.h module for the required
 // validation layers. Then it creates the Vulkan instance and returns it.
+// surface_maintenance1 is set when VK_EXT_surface_maintenance1 was enabled,
+// which the device needs for VK_EXT_swapchain_maintenance1.
 //
-VkInstance init_vulkan() {
+VkInstance init_vulkan(bool headless, bool *surface_maintenance1) {
 
     VkResult intResult;
 
     //
     // Checking for extensions
     //
-    struct RawVector requiredExtensions = get_required_extension_names_FREE();
+    struct RawVector requiredExtensions = get_required_extension_names_FREE(headless);
 
     uint32_t totalExtensionCount;
     vkEnumerateInstanceExtensionProperties(NULL, &totalExtensionCount, NULL);
@@ -37,6 +48,20 @@ VkInstance init_vulkan() {
     for (int i = 0; i < totalExtensionCount; i++) {
         printf("\t%s\n", extensions[i].extensionName);
     }
+
+    //
+    // Surface maintenance is optional, and only matters with a surface
+    //
+    *surface_maintenance1 = !headless &&
+        instance_extension_available(extensions, totalExtensionCount, VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) &&
+        instance_extension_available(extensions, totalExtensionCount, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+    if (*surface_maintenance1) {
+        const char *surface_extensions[] = {
+            VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME,
+            VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME,
+        };
+        raw_vector_extend_back(&requiredExtensions, surface_extensions, 2);
+    }
     log_trace("\nGLFW Requested extensions:");
     for (int i = 0; i < raw_vector_size(&requiredExtensions); i++) {
         printf("\t%s\n", *(char **)raw_vector_get_ptr(&requiredExtensions, i));
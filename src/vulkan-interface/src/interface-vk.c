@@ -1,121 +1,368 @@
+#include <limits.h>
+#include <string.h>
 #include "vulkan-interface/interface-vk.h"
 #include "vulkan-interface/pipeline.h"
+#include "vulkan-interface/pipeline_cache.h"
+#include "vulkan-interface/pipeline_registry.h"
+#include "vulkan-interface/shaders.h"
+#include "language/clock.h"
+#include "language/fileops.h"
+#include "language/math.h"
+#include "language/stats.h"
 
-#define MAX_FRAMES_IN_FLIGHT 2
+#define HEADLESS_IMAGE_COUNT 3
+#define HEADLESS_FRAME_LIMIT 1000
+
+#define DEFAULT_MAP_WIDTH  16
+#define DEFAULT_MAP_HEIGHT 16
+
+//
+// Written next to the executable by the assets target, and looked up there
+//
+#define ASSET_PACK_FILE "assets.pak"
+
+//
+// Window sizes the resize stress benchmark cycles through
+//
+#define RESIZE_STRESS_SIZE_COUNT 4
+static const int resize_stress_sizes[RESIZE_STRESS_SIZE_COUNT][2] = {
+    {WINDOW_WIDTH, WINDOW_HEIGHT},
+    {WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2},
+    {WINDOW_WIDTH + 320, WINDOW_HEIGHT + 180},
+    {WINDOW_WIDTH - 160, WINDOW_HEIGHT + 90},
+};
+
+//
+// Viewports panned per second while an arrow or WASD key is held, and how
+// much = and - zoom per second
+//
+#define CAMERA_PAN_SPEED  1.0f
+#define CAMERA_ZOOM_SPEED 2.0f
 
 static bool glfw_window_resized = false;
 static void framebuffer_resize_callback(GLFWwindow *window, int width, int height) {
     glfw_window_resized = true;
 }
 
-void main_loop(struct VulkanState *state) {
-    //
-    // Create synchronization primitives
-    //
-    VkSemaphore imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
-    VkSemaphore renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
-    VkFence     frameFences             [MAX_FRAMES_IN_FLIGHT];
-    VkFence     imageFences             [raw_vector_size(&state->swapchain_images_VkImage)];
-    memset(imageFences, 0, sizeof(VkFence) * raw_vector_size(&state->swapchain_images_VkImage));
+static bool key_held(GLFWwindow *window, int key) {
+    return glfwGetKey(window, key) == GLFW_PRESS;
+}
 
-    VkSemaphoreCreateInfo semaphoreInfo = {};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+//
+// Pans and zooms the camera from the keys held during the last dt_seconds
+//
+static void update_camera_from_keys(struct VulkanState *state, float dt_seconds) {
+    float pan = CAMERA_PAN_SPEED * dt_seconds;
+    float dx = 0.0f, dy = 0.0f;
+    if (key_held(state->window, GLFW_KEY_LEFT)  || key_held(state->window, GLFW_KEY_A)) dx -= pan;
+    if (key_held(state->window, GLFW_KEY_RIGHT) || key_held(state->window, GLFW_KEY_D)) dx += pan;
+    if (key_held(state->window, GLFW_KEY_UP)    || key_held(state->window, GLFW_KEY_W)) dy -= pan;
+    if (key_held(state->window, GLFW_KEY_DOWN)  || key_held(state->window, GLFW_KEY_S)) dy += pan;
+    camera_pan(&state->camera, dx, dy);
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    float zoom = 1.0f + (CAMERA_ZOOM_SPEED - 1.0f) * dt_seconds;
+    if (key_held(state->window, GLFW_KEY_MINUS)) camera_zoom(&state->camera, zoom);
+    if (key_held(state->window, GLFW_KEY_EQUAL)) camera_zoom(&state->camera, 1.0f / zoom);
+}
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(state->logical_device, &semaphoreInfo, NULL, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(state->logical_device, &semaphoreInfo, NULL, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(state->logical_device, &fenceInfo, NULL, &frameFences[i]) != VK_SUCCESS) {
-            log_fatal("Could not create sempahores\n");
-            exit(EXIT_FAILURE);
+//
+// A windowed loop runs until the window is closed. A headless loop has
+// nobody to close it, so it runs for a fixed number of frames.
+//
+static bool main_loop_should_exit(struct VulkanState *state, uint64_t frames_rendered, struct RawVector *resize_ms_double) {
+    if (state->headless) {
+        return frames_rendered >= state->headless_frame_limit;
+    }
+    if (state->resize_stress_count > 0 && raw_vector_size(resize_ms_double) >= state->resize_stress_count) {
+        return true;
+    }
+    return glfwWindowShouldClose(state->window);
+}
+
+//
+// Recreates the swapchain, recording how long it took in resize_ms_double.
+//
+static void recreate_swapchain_timed(struct VulkanState *state, struct RawVector *resize_ms_double) {
+    uint64_t start_ns = clock_now_ns();
+    vulkan_swapchain_recreate(state);
+    double elapsed_ms = clock_ns_to_ms(clock_now_ns() - start_ns);
+    raw_vector_push_back(resize_ms_double, &elapsed_ms);
+}
+
+static void log_resize_stats(struct VulkanState *state, struct RawVector *resize_ms_double) {
+    size_t count = raw_vector_size(resize_ms_double);
+    if (count == 0) {
+        return;
+    }
+    double *samples = (double *)raw_vector_get_ptr(resize_ms_double, 0);
+    log_info("%lu swapchain recreations: %.3f ms avg, %.3f ms p50, %.3f ms p99, %.3f ms worst\n",
+        (unsigned long)count,
+        stats_mean(samples, count),
+        stats_percentile(samples, count, 50.0),
+        stats_percentile(samples, count, 99.0),
+        stats_max(samples, count));
+    memory_allocator_log_stats(state->allocator);
+}
+
+//
+// Records the GPU completion latency of every frame whose submission has
+// completed since the last call: the time from the CPU starting the frame
+// (before polling input) to its timeline value being seen as complete.
+// This is the fallback for when presents cannot be timed. It stops short
+// of the present, and since the timeline is only polled, never waited on,
+// each sample may overshoot by up to one frame's time.
+//
+static void collect_gpu_latencies(struct VulkanState *state, uint64_t *frame_start_ns, struct RawVector *latency_ms_double) {
+    for (uint32_t i = 0; i < state->pacing->frames_in_flight; i++) {
+        if (frame_start_ns[i] == 0 || !frame_sync_is_complete(state->sync, state->sync->frame_values[i])) {
+            continue;
         }
+        double latency_ms = clock_ns_to_ms(clock_now_ns() - frame_start_ns[i]);
+        raw_vector_push_back(latency_ms_double, &latency_ms);
+        frame_start_ns[i] = 0;
+    }
+}
+
+//
+// Records the latency of the frames measured since the last call: up to
+// the present from the present timer when there is one, otherwise up to
+// GPU completion.
+//
+static void collect_frame_latencies(struct VulkanState *state, uint64_t *frame_start_ns, struct RawVector *latency_ms_double) {
+    if (state->present_timer != NULL) {
+        present_timer_collect(state->present_timer, latency_ms_double);
+    } else {
+        collect_gpu_latencies(state, frame_start_ns, latency_ms_double);
     }
+}
+
+static void log_frame_pacing_stats(struct VulkanState *state, double frames_per_second, struct RawVector *latency_ms_double) {
+    size_t count = raw_vector_size(latency_ms_double);
+    if (count == 0) {
+        return;
+    }
+    double *samples = (double *)raw_vector_get_ptr(latency_ms_double, 0);
+    log_info("Frame pacing %s (%u frames in flight, %lu images, %s): %.1f frames/s, "
+        "%s latency %.3f ms avg, %.3f ms p50, %.3f ms p99\n",
+        state->pacing->name,
+        state->pacing->frames_in_flight,
+        (unsigned long)raw_vector_size(&state->swapchain_images_VkImage),
+        state->headless ? "offscreen" : present_mode_name(state->present_mode),
+        frames_per_second,
+        state->present_timer != NULL ? "present" : "GPU completion",
+        stats_mean(samples, count),
+        stats_percentile(samples, count, 50.0),
+        stats_percentile(samples, count, 99.0));
+}
+
+void main_loop(struct VulkanState *state) {
+    struct FrameSync *sync = state->sync;
+    uint32_t frames_in_flight = state->pacing->frames_in_flight;
+    struct RawVector resize_ms_double = raw_vector_create(sizeof(double), 16);
+
+    //
+    // When each frame in flight started on the CPU, or 0 once its GPU
+    // completion latency has been recorded
+    //
+    uint64_t frame_start_ns[MAX_FRAMES_IN_FLIGHT] = {0};
+    struct RawVector latency_ms_double = raw_vector_create(sizeof(double), 1024);
 
     size_t current_frame = 0;
-    while (!glfwWindowShouldClose(state->window)) {
-        glfwPollEvents();
-        
-        vkWaitForFences(state->logical_device, 1, &frameFences[current_frame], VK_TRUE, UINT64_MAX);
+    uint64_t frames_rendered = 0;
+    uint64_t loop_start_ns = clock_now_ns();
+    uint64_t last_frame_ns = loop_start_ns;
+    uint64_t max_frame_ns = 0;
+    while (!main_loop_should_exit(state, frames_rendered, &resize_ms_double)) {
+        uint64_t frame_begin_ns = clock_now_ns();
+        collect_frame_latencies(state, frame_start_ns, &latency_ms_double);
+
+        if (!state->headless) {
+            //
+            // The resize stress benchmark asks for a new window size every
+            // frame, so each frame goes through a swapchain recreation.
+            //
+            if (state->resize_stress_count > 0) {
+                const int *size = resize_stress_sizes[frames_rendered % RESIZE_STRESS_SIZE_COUNT];
+                glfwSetWindowSize(state->window, size[0], size[1]);
+            }
+            glfwPollEvents();
+            update_camera_from_keys(state, (float)clock_ns_to_seconds(frame_begin_ns - last_frame_ns));
+        }
 
         //
-        // Acquire swapchain image. Signal imageAvailableSemaphore when done
+        // Wait until the GPU is done with this frame's last submission, so its
+        // command pools and acquire semaphore can be reused
         //
+        frame_sync_wait(sync, sync->frame_values[current_frame]);
+        retired_swapchains_collect(state->retired_swapchains);
+        deletion_queue_collect(state->deletions);
+        descriptor_allocator_begin_frame(state->descriptors, current_frame);
+
         uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(
-            state->logical_device, 
-            state->swapchain, 
-            UINT64_MAX, 
-            imageAvailableSemaphores[current_frame], 
-            VK_NULL_HANDLE, 
-            &imageIndex);
+        VkResult result;
+        if (state->headless) {
+            //
+            // There is no presentation engine to hand us an image, so we
+            // just walk the offscreen ring in order.
+            //
+            imageIndex = frames_rendered % raw_vector_size(&state->swapchain_images_VkImage);
+        } else {
+            //
+            // Acquire swapchain image. Signal image_available when done
+            //
+            result = vkAcquireNextImageKHR(
+                state->logical_device, 
+                state->swapchain, 
+                UINT64_MAX, 
+                sync->image_available[current_frame], 
+                VK_NULL_HANDLE, 
+                &imageIndex);
+
+            //
+            // Check to see if current swapchain is out of date. If so, recreate
+            // it and try again; nothing was acquired, so there is nothing to draw.
+            // A suboptimal image is still drawn and presented, and the swapchain
+            // recreated after presenting.
+            //
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreate_swapchain_timed(state, &resize_ms_double);
+                continue;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                log_fatal("failed to acquire swapchain image!\n");
+                exit(EXIT_FAILURE);
+            }
+        }
 
         //
-        // Check to see if current swapchain is out of date.
-        // If so, recreate it.
+        // The image may have been acquired out of order, while an older frame
+        // which drew into it is still on the GPU. Wait for that frame so the
+        // two never render into the same image at once. With the timeline this
+        // is usually already complete and costs nothing.
         //
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || glfw_window_resized) {
-            glfw_window_resized = false;
-            vulkan_swapchain_recreate(state);
-        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            log_fatal("failed to acquire swapchain image!\n");
-            exit(EXIT_FAILURE);
-        }
+        frame_sync_wait(sync, *(uint64_t *)raw_vector_get_ptr(&sync->image_values_uint64, imageIndex));
 
         //
-        // We want to prevent the following situation: two frames simultaneously
-        // in flight grab the same image. Then, one submits the draw command to
-        // the image's queue. Before this draw command is finished, the next one also
-        // submits its draw command to the queue. Even though there is the imageAvailableSemaphore
-        // that this subsequent draw command must wait for, it is still not good to have
-        // those two commands in the queue for the same image at the same time. The command
-        // buffer is (probably) not marked for simultaneous use, so this will error.
+        // The frame's previous submission has finished, so its command
+        // pools can be reset and the scene recorded again. A streamed map
+        // first brings in the chunks the camera now sees.
         //
-        if (imageFences[imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(state->logical_device, 1, &imageFences[imageIndex], VK_TRUE, UINT64_MAX);
+        if (state->world != NULL) {
+            chunk_manager_update(state->world, &state->upload, &state->camera, state->swapchain_extent);
         }
-        imageFences[imageIndex] = frameFences[current_frame];
+        struct TileDrawBuffers draw_buffers = vulkan_state_draw_buffers(state);
+        struct TileDrawUniforms uniforms = vulkan_state_frame_uniforms(
+            state, current_frame, &state->camera, (float)clock_ns_to_seconds(frame_begin_ns - loop_start_ns));
+        VkCommandBuffer command_buffer = frame_recorder_record(
+            state->recorder,
+            current_frame,
+            state->renderpass,
+            state->pipelines,
+            *(VkFramebuffer *)raw_vector_get_ptr(&state->framebuffers_VkFramebuffer, imageIndex),
+            state->swapchain_extent,
+            &draw_buffers,
+            &uniforms,
+            state->culler);
 
         //
         // Submit draw command buffer. Wait to output to color attachment
-        // until imageAvailable semaphore is signaled. Signal renderFinishedSemaphore
-        // when done
+        // until image_available is signaled. Signal the next timeline value,
+        // and render_finished for presentation. Headless frames are never
+        // acquired or presented, so they only signal the timeline.
         //
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[current_frame]};
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[current_frame]};
+        uint64_t signal_value = frame_sync_next_value(sync);
+        VkSemaphore waitSemaphores[] = {sync->image_available[current_frame]};
+        VkSemaphore signalSemaphores[] = {sync->timeline, sync->render_finished[current_frame]};
+        uint64_t signalValues[] = {signal_value, 0};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
+        VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = state->headless ? 1 : 2;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = state->headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = (VkCommandBuffer *)raw_vector_get_ptr(&state->command_buffers, imageIndex);
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pCommandBuffers = &command_buffer;
+        submitInfo.signalSemaphoreCount = state->headless ? 1 : 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(state->logical_device, 1, &frameFences[current_frame]);
-        if (vkQueueSubmit(state->graphics_queue, 1, &submitInfo, frameFences[current_frame]) != VK_SUCCESS) {
+        if (vkQueueSubmit(state->graphics_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
             log_fatal("failed to submit draw command buffer!\n");
             exit(EXIT_FAILURE);
         }
+        frame_sync_submitted(sync, current_frame, imageIndex, signal_value);
+        if (state->world != NULL) {
+            chunk_manager_submitted(state->world, signal_value);
+        }
+        frame_start_ns[current_frame] = frame_begin_ns;
+
+        uint64_t now_ns = clock_now_ns();
+        max_frame_ns = MAX(max_frame_ns, now_ns - last_frame_ns);
+        last_frame_ns = now_ns;
+        frames_rendered++;
+
+        if (state->headless) {
+            current_frame = (current_frame + 1) % frames_in_flight;
+            continue;
+        }
 
         //
         // Submit presentation command to presentation queue. Wait on
-        // renderFinishedSemaphore to be signaled before proceeding
+        // render_finished to be signaled before proceeding
         //
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &sync->render_finished[current_frame];
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = &state->swapchain;
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = NULL; // Optional
+
+        //
+        // With a present timer, the present is tagged with an ID the timer
+        // thread waits on to see when the frame was shown
+        //
+        uint64_t present_id = 0;
+        VkPresentIdKHR presentIdInfo = {};
+        if (state->present_timer != NULL) {
+            present_id = present_timer_next_id(state->present_timer);
+            presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentIdInfo.swapchainCount = 1;
+            presentIdInfo.pPresentIds = &present_id;
+            presentInfo.pNext = &presentIdInfo;
+        }
+
+        //
+        // With present fences, the present also signals a fence, which says
+        // when a swapchain replaced after this present can be destroyed.
+        // Without them, presents to the current swapchain are counted instead.
+        //
+        struct RetiredSwapchains *retired = state->retired_swapchains;
+        VkFence present_fence = VK_NULL_HANDLE;
+        VkSwapchainPresentFenceInfoEXT presentFenceInfo = {};
+        if (retired->present_fences) {
+            present_fence = retired_swapchains_present_fence(retired, state->swapchain);
+            presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+            presentFenceInfo.pNext = presentInfo.pNext;
+            presentFenceInfo.swapchainCount = 1;
+            presentFenceInfo.pFences = &present_fence;
+            presentInfo.pNext = &presentFenceInfo;
+        }
         result = vkQueuePresentKHR(state->presentation_queue, &presentInfo);
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            if (state->present_timer != NULL) {
+                present_timer_presented(state->present_timer, state->swapchain, present_id, frame_begin_ns);
+            }
+            if (!retired->present_fences) {
+                retired_swapchains_presented(retired);
+            }
+        }
 
         //
         // Check to see if the current swapchain is out of date or suboptimal. 
@@ -123,59 +370,86 @@ void main_loop(struct VulkanState *state) {
         //
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || glfw_window_resized) {
             glfw_window_resized = false;
-            vulkan_swapchain_recreate(state);
+            recreate_swapchain_timed(state, &resize_ms_double);
         } else if (result != VK_SUCCESS) {
             log_fatal("failed to present swapchain image!\n");
             exit(EXIT_FAILURE);
         }
 
-        current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        current_frame = (current_frame + 1) % frames_in_flight;
     }
 
-    vkDeviceWaitIdle(state->logical_device);
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(state->logical_device, imageAvailableSemaphores[i], NULL);
-        vkDestroySemaphore(state->logical_device, renderFinishedSemaphores[i], NULL);
-        vkDestroyFence(state->logical_device, frameFences[i], NULL);
+    //
+    // Wait for the last frame, and for its present which waits on it
+    //
+    frame_sync_wait(sync, sync->last_signalled);
+    if (!state->headless) {
+        vkQueueWaitIdle(state->presentation_queue);
     }
+    collect_frame_latencies(state, frame_start_ns, &latency_ms_double);
+
+    uint64_t elapsed_ns = clock_now_ns() - loop_start_ns;
+    if (frames_rendered > 0) {
+        log_info("Rendered %lu frames in %.3f s: %.1f frames/s, %.3f ms avg frame, %.3f ms worst frame\n",
+            frames_rendered,
+            clock_ns_to_seconds(elapsed_ns),
+            frames_rendered / clock_ns_to_seconds(elapsed_ns),
+            clock_ns_to_ms(elapsed_ns) / frames_rendered,
+            clock_ns_to_ms(max_frame_ns));
+        log_frame_pacing_stats(state, frames_rendered / clock_ns_to_seconds(elapsed_ns), &latency_ms_double);
+    }
+    raw_vector_destroy(&latency_ms_double);
+
+    log_resize_stats(state, &resize_ms_double);
+    raw_vector_destroy(&resize_ms_double);
 }
 
+//
+// Rebuilds the swapchain and everything sized to it after a resize. The
+// old swapchain is handed to the new one so presentation can carry on
+// without a full teardown. Nothing is waited on: the old swapchain is kept
+// until its presents are done (see retired_swapchains.h).
+// The render pass and pipelines only depend on the image format (viewport
+// and scissor are dynamic), so they are kept unless the format changed.
+//
 void vulkan_swapchain_recreate(struct VulkanState *state) {
 
     //
-    // Wait until we are not using any swapchain resources
+    // A minimized window has a zero sized framebuffer, which no swapchain
+    // can be created for. Wait until it is visible again.
     //
-    vkDeviceWaitIdle(state->logical_device);
+    int width, height;
+    glfwGetFramebufferSize(state->window, &width, &height);
+    while (width == 0 || height == 0) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(state->window, &width, &height);
+    }
 
     //
-    // Free all resources dependent on the swapchain
+    // Frames still in flight may be using the resources sized to the
+    // swapchain images, so they are retired rather than destroyed. They are
+    // freed once the GPU passes the last submitted frame.
     //
-    vkFreeCommandBuffers(
-        state->logical_device,
-        state->command_pool,
-        raw_vector_size(&state->command_buffers),
-        (VkCommandBuffer *)raw_vector_get_ptr(&state->command_buffers, 0));
-    vkDestroyPipeline(state->logical_device, state->pipeline, NULL);
-    vkDestroyPipelineLayout(state->logical_device, state->pipeline_layout, NULL);
-    vkDestroyRenderPass(state->logical_device, state->renderpass, NULL);
+    uint64_t last_use = state->sync->last_signalled;
     for (int i = 0; i < raw_vector_size(&state->swapchain_images_VkImage); i++) {
-        vkDestroyFramebuffer(
-            state->logical_device, 
-            *(VkFramebuffer *)raw_vector_get_ptr(&state->framebuffers_VkFramebuffer, i), 
-            NULL);
-        vkDestroyImageView(
-            state->logical_device, 
-            *(VkImageView *)raw_vector_get_ptr(&state->swapchain_image_views_VkImageView, i), 
-            NULL);
+        deletion_queue_retire_framebuffer(
+            state->deletions,
+            *(VkFramebuffer *)raw_vector_get_ptr(&state->framebuffers_VkFramebuffer, i),
+            last_use);
+        deletion_queue_retire_image_view(
+            state->deletions,
+            *(VkImageView *)raw_vector_get_ptr(&state->swapchain_image_views_VkImageView, i),
+            last_use);
     }
-    vkDestroySwapchainKHR(state->logical_device, state->swapchain, NULL);
-
+    raw_vector_destroy(&state->framebuffers_VkFramebuffer);
+    raw_vector_destroy(&state->swapchain_image_views_VkImageView);
+    raw_vector_destroy(&state->swapchain_images_VkImage);
 
     //
-    // Generate a new swapchain and all resources that depend on it
+    // Generate a new swapchain from the old one, then retire the old one
     //
-    int width, height;
-    glfwGetFramebufferSize(state->window, &width, &height);
+    VkFormat old_format = state->swapchain_format;
+    VkSwapchainKHR old_swapchain = state->swapchain;
     state->swapchain = create_swapchain(
         state->logical_device, 
         state->physical_device.physical_device,
@@ -184,27 +458,39 @@ void vulkan_swapchain_recreate(struct VulkanState *state) {
         height,
         optional_index_get_value(&state->physical_device.graphics_family_index),
         optional_index_get_value(&state->physical_device.presentation_family_index),
+        old_swapchain,
+        state->pacing,
         &state->swapchain_format,
-        &state->swapchain_extent
+        &state->swapchain_extent,
+        &state->present_mode
         );
 
+    retired_swapchains_add(state->retired_swapchains, old_swapchain);
+
     uint32_t image_count;
     vkGetSwapchainImagesKHR(state->logical_device, state->swapchain, &image_count, NULL);
     VkImage images[image_count];
     vkGetSwapchainImagesKHR(state->logical_device, state->swapchain, &image_count, images);
     state->swapchain_images_VkImage = raw_vector_create(sizeof(VkImage), image_count);
     raw_vector_extend_back(&state->swapchain_images_VkImage, images, image_count);
+    frame_sync_reset_images(state->sync, image_count);
 
     state->swapchain_image_views_VkImageView = create_swapchain_image_views(
         state->logical_device, state->swapchain_images_VkImage, state->swapchain_format);
 
-    state->renderpass = create_render_pass(state->logical_device, state->swapchain_format);
+    if (state->swapchain_format != old_format) {
+        log_info("Swapchain format changed, rebuilding render pass and pipelines\n");
+        pipeline_registry_forget_renderpass(state->pipelines, state->renderpass, state->deletions, last_use);
+        deletion_queue_retire_renderpass(state->deletions, state->renderpass, last_use);
 
-    state->pipeline = create_graphics_pipeline(
-        state->logical_device, 
-        state->swapchain_extent, 
-        state->renderpass, 
-        &state->pipeline_layout);
+        state->renderpass = create_render_pass(state->logical_device, state->swapchain_format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        struct PipelineKey fallback_key = pipeline_key_for_layer(state->renderpass, TILE_LAYER_MODE_ATLAS);
+        pipeline_registry_get(state->pipelines, &fallback_key);
+        if (state->tilemap.layer_count > 0) {
+            struct PipelineKey tilemap_key = pipeline_key_for_tilemap(state->renderpass);
+            pipeline_registry_get(state->pipelines, &tilemap_key);
+        }
+    }
 
     state->framebuffers_VkFramebuffer = create_framebuffers(
         state->logical_device, 
@@ -212,88 +498,466 @@ void vulkan_swapchain_recreate(struct VulkanState *state) {
         state->swapchain_extent, 
         &state->swapchain_image_views_VkImageView);
 
-    struct RawVector command_buffers = create_command_buffers(
-        state->logical_device,
-        state->command_pool,
-        state->renderpass,
-        state->pipeline,
-        &state->framebuffers_VkFramebuffer,
-        state->swapchain_extent,
-        state->vertex_buffer);
+    log_trace("Recreated swapchain at %ux%u\n", state->swapchain_extent.width, state->swapchain_extent.height);
+}
+
+//
+// Returns the buffers every tile draw binds: the quad and the instance
+// buffer holding one TileInstance per tile of the map, with its layers.
+//
+struct TileDrawBuffers vulkan_state_draw_buffers(struct VulkanState *state) {
+    struct TileDrawBuffers draw_buffers = {
+        .vertex_buffer = state->vertex_buffer,
+        .index_buffer = state->index_buffer,
+        .instance_buffer = state->instance_buffer,
+        .instance_count = state->instance_count,
+        .layer_count = state->layer_count,
+    };
+    memcpy(draw_buffers.layers, state->layers, sizeof(draw_buffers.layers));
+    if (state->world != NULL) {
+        chunk_manager_fill_draw_buffers(state->world, &draw_buffers);
+    }
+    return draw_buffers;
+}
+
+//
+// Starts frame_index's region of the uniform ring and writes this frame's
+// TileFrameParams into it. Returns what a tile draw of the frame binds,
+// viewed through camera. The caller must know the GPU is done with
+// frame_index's previous submission.
+//
+struct TileDrawUniforms vulkan_state_frame_uniforms(
+    struct VulkanState *state, uint32_t frame_index, const struct Camera *camera, float time_seconds) {
+
+    uniform_ring_begin_frame(&state->uniforms, frame_index);
+
+    uint32_t dynamic_offset;
+    struct TileFrameParams *params = uniform_ring_push(&state->uniforms, sizeof(struct TileFrameParams), &dynamic_offset);
+    *params = (struct TileFrameParams) {
+        .overlay_color = { 1.0f, 1.0f, 1.0f, 0.6f },
+        .atlas_mix = 0.75f,
+        .time_seconds = time_seconds,
+    };
+
+    return (struct TileDrawUniforms) {
+        .layout = state->pipelines->layout,
+        .descriptor_set = state->uniforms.descriptor_set,
+        .dynamic_offset = dynamic_offset,
+        .atlas_set = state->atlas.descriptor_set,
+        .tilemap_set = state->tilemap.descriptor_set,
+        .camera = camera_push_constants(camera, state->swapchain_extent),
+    };
+}
+
+//
+// How many pipeline variants are still compiling in the background, and how
+// long the finished ones took from first request to ready.
+//
+struct PipelineCompileStats vulkan_state_pipeline_compile_stats(struct VulkanState *state) {
+    return pipeline_registry_compile_stats(state->pipelines);
+}
+
+//
+// Returns the default configuration: a window of WINDOW_WIDTH x WINDOW_HEIGHT.
+// The headless fields only take effect once headless is set.
+//
+struct VulkanConfig vulkan_config_default() {
+    static char asset_pack_path[PATH_MAX];
+    executable_relative_path(ASSET_PACK_FILE, asset_pack_path, sizeof(asset_pack_path));
+
+    return (struct VulkanConfig) {
+        .headless = false,
+        .map_width = DEFAULT_MAP_WIDTH,
+        .map_height = DEFAULT_MAP_HEIGHT,
+        .headless_width = WINDOW_WIDTH,
+        .headless_height = WINDOW_HEIGHT,
+        .headless_image_count = HEADLESS_IMAGE_COUNT,
+        .headless_frame_limit = HEADLESS_FRAME_LIMIT,
+        .resize_stress_count = 0,
+        .pipeline_cache_path = PIPELINE_CACHE_FILE,
+        .record_thread_count = 0,
+        .frame_pacing = FRAME_PACING_BALANCED,
+        .device_override = NULL,
+        .device_benchmark = false,
+        .device_benchmark_path = DEVICE_BENCHMARK_FILE,
+        .tile_sheet_path = NULL,
+        .fullscreen_dense_layers = true,
+        .gpu_culling = true,
+        .stream_chunks = false,
+        .map_path = NULL,
+        .resident_chunks = CHUNK_DEFAULT_RESIDENT,
+        .asset_pack_path = asset_pack_path,
+    };
 }
 
 //
 // Initializes all Vulkan state
 //
-struct VulkanState vulkan_state_create() {
+struct VulkanState vulkan_state_create(struct VulkanConfig *config) {
+    uint64_t startup_start_ns = clock_now_ns();
+
+    //
+    // Every packed asset is mapped at once, here; everything after only
+    // looks entries up in the mapping
+    //
+    struct AssetPack *assets = NULL;
+    if (config->asset_pack_path != NULL) {
+        assets = malloc(sizeof(struct AssetPack));
+        if (assets == NULL) {
+            log_fatal("Could not malloc asset pack\n");
+            exit(EXIT_FAILURE);
+        }
+        if (asset_pack_open(config->asset_pack_path, asset_build_id, assets)) {
+            log_info("Loaded %u assets from %s\n", assets->header->entry_count, config->asset_pack_path);
+        } else {
+            log_info("No usable asset pack at %s, using the embedded shaders\n", config->asset_pack_path);
+            free(assets);
+            assets = NULL;
+        }
+    }
 
-    GLFWwindow *window = init_window();
-    glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
+    GLFWwindow *window = NULL;
+    if (!config->headless) {
+        window = init_window();
+        glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
+    }
 
-    VkInstance instance = init_vulkan();
+    bool surface_maintenance1;
+    VkInstance instance = init_vulkan(config->headless, &surface_maintenance1);
 #ifndef NDEBUG
     VkDebugUtilsMessengerEXT debug_messenger = init_vulkan_debug_messenger(instance);
 #endif
-    VkSurfaceKHR surface = create_surface(instance, window);
-    struct InterfacePhysicalDevice physical_device = pick_physical_device(instance, surface);
-    VkDevice logical_device = create_logical_device(&physical_device);
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (!config->headless) {
+        surface = create_surface(instance, window);
+    }
+    struct DeviceSelection device_selection = {
+        .override = config->device_override,
+        .benchmark = config->device_benchmark,
+        .benchmark_path = config->device_benchmark_path,
+    };
+    struct InterfacePhysicalDevice physical_device = pick_physical_device(instance, surface, &device_selection);
+    VkDevice logical_device = create_logical_device(&physical_device, config->headless, surface_maintenance1);
 
-    VkQueue graphics_queue, presentation_queue; 
+    VkQueue graphics_queue, presentation_queue, transfer_queue; 
     vkGetDeviceQueue(logical_device, optional_index_get_value(&physical_device.graphics_family_index), 0, &graphics_queue);
     vkGetDeviceQueue(logical_device, optional_index_get_value(&physical_device.presentation_family_index), 0, &presentation_queue);
+    vkGetDeviceQueue(logical_device, interface_physical_device_transfer_family(&physical_device), 0, &transfer_queue);
+
+    struct PresentTimer *present_timer = NULL;
+    if (physical_device.present_wait) {
+        present_timer = malloc(sizeof(struct PresentTimer));
+        if (present_timer == NULL) {
+            log_fatal("Could not malloc present timer\n");
+            exit(EXIT_FAILURE);
+        }
+        present_timer_init(present_timer, logical_device);
+    }
 
+    //
+    // Every buffer and image the state owns is placed by this allocator.
+    // It is heap allocated since it must not move once initialised.
+    //
+    struct MemoryAllocator *allocator = malloc(sizeof(struct MemoryAllocator));
+    if (allocator == NULL) {
+        log_fatal("Could not malloc memory allocator\n");
+        exit(EXIT_FAILURE);
+    }
+    memory_allocator_init(allocator, physical_device.physical_device, logical_device);
+
+    const struct FramePacing *pacing = frame_pacing_profile(config->frame_pacing);
     VkFormat swapchain_format;
     VkExtent2D swapchain_extent;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    struct RawVector swapchain_images_VkImage;
+    struct RawVector offscreen_allocations_MemoryAllocation = {};
 
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    VkSwapchainKHR swapchain = create_swapchain(
-        logical_device, 
-        physical_device.physical_device,
-        surface,
-        width,
-        height,
-        optional_index_get_value(&physical_device.graphics_family_index),
-        optional_index_get_value(&physical_device.presentation_family_index),
-        &swapchain_format,
-        &swapchain_extent
-        );
+    if (config->headless) {
+        //
+        // Stand in for the swapchain with a ring of offscreen images. Everything
+        // downstream (views, framebuffers, command buffers) is built the same way.
+        //
+        swapchain_format = OFFSCREEN_FORMAT;
+        swapchain_extent = (VkExtent2D){ config->headless_width, config->headless_height };
+        swapchain_images_VkImage = create_offscreen_images(
+            allocator,
+            swapchain_extent,
+            swapchain_format,
+            config->headless_image_count,
+            &offscreen_allocations_MemoryAllocation);
+    } else {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        swapchain = create_swapchain(
+            logical_device, 
+            physical_device.physical_device,
+            surface,
+            width,
+            height,
+            optional_index_get_value(&physical_device.graphics_family_index),
+            optional_index_get_value(&physical_device.presentation_family_index),
+            VK_NULL_HANDLE,
+            pacing,
+            &swapchain_format,
+            &swapchain_extent,
+            &present_mode
+            );
 
-    uint32_t image_count;
-    vkGetSwapchainImagesKHR(logical_device, swapchain, &image_count, NULL);
-    VkImage images[image_count];
-    vkGetSwapchainImagesKHR(logical_device, swapchain, &image_count, images);
-    struct RawVector swapchain_images_VkImage = raw_vector_create(sizeof(VkImage), image_count);
-    raw_vector_extend_back(&swapchain_images_VkImage, images, image_count);
+        uint32_t image_count;
+        vkGetSwapchainImagesKHR(logical_device, swapchain, &image_count, NULL);
+        VkImage images[image_count];
+        vkGetSwapchainImagesKHR(logical_device, swapchain, &image_count, images);
+        swapchain_images_VkImage = raw_vector_create(sizeof(VkImage), image_count);
+        raw_vector_extend_back(&swapchain_images_VkImage, images, image_count);
+    }
 
     struct RawVector swapchain_image_views_VkImageView = create_swapchain_image_views(
         logical_device, swapchain_images_VkImage, swapchain_format);
 
-    VkRenderPass renderpass = create_render_pass(logical_device, swapchain_format);
+    //
+    // Every submission, from uploads to frames, signals the next value of
+    // one timeline semaphore.
+    //
+    struct FrameSync *sync = malloc(sizeof(struct FrameSync));
+    if (sync == NULL) {
+        log_fatal("Could not malloc frame sync\n");
+        exit(EXIT_FAILURE);
+    }
+    frame_sync_init(sync, logical_device, pacing->frames_in_flight, raw_vector_size(&swapchain_images_VkImage));
+    struct DeletionQueue *deletions = malloc(sizeof(struct DeletionQueue));
+    if (deletions == NULL) {
+        log_fatal("Could not malloc deletion queue\n");
+        exit(EXIT_FAILURE);
+    }
+    deletion_queue_init(deletions, logical_device, allocator, sync);
+    struct RetiredSwapchains *retired_swapchains = malloc(sizeof(struct RetiredSwapchains));
+    if (retired_swapchains == NULL) {
+        log_fatal("Could not malloc retired swapchains\n");
+        exit(EXIT_FAILURE);
+    }
+    retired_swapchains_init(
+        retired_swapchains, logical_device, sync, deletions, present_timer, physical_device.swapchain_maintenance1);
+
+    //
+    // Descriptor sets come from recycled pools: transient sets from pools
+    // reset once per frame in flight, persistent sets cached by what they bind
+    //
+    struct DescriptorAllocator *descriptors = malloc(sizeof(struct DescriptorAllocator));
+    if (descriptors == NULL) {
+        log_fatal("Could not malloc descriptor allocator\n");
+        exit(EXIT_FAILURE);
+    }
+    descriptor_allocator_init(descriptors, logical_device, pacing->frames_in_flight);
 
-    VkPipelineLayout pipeline_layout;
-    VkPipeline pipeline = create_graphics_pipeline(logical_device, swapchain_extent, renderpass, &pipeline_layout);
+    //
+    // Per-frame uniforms are bump allocated from a persistently mapped ring
+    // with one region per frame in flight
+    //
+    struct UniformRing uniforms;
+    uniform_ring_init(&uniforms, allocator, descriptors, pacing->frames_in_flight, UNIFORM_RING_FRAME_SIZE);
+
+    //
+    // Every tile type is a layer of one texture array, bound once per frame
+    //
+    struct TileAtlas atlas;
+    tile_atlas_init(
+        &atlas,
+        allocator,
+        descriptors,
+        deletions,
+        sync,
+        graphics_queue,
+        optional_index_get_value(&physical_device.graphics_family_index),
+        assets,
+        config->tile_sheet_path);
+
+    VkRenderPass renderpass = create_render_pass(
+        logical_device,
+        swapchain_format,
+        config->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    //
+    // Pipelines are compiled through a cache loaded from the previous run.
+    // Only the fallback variant is built before the first frame; the variant
+    // each other layer needs is compiled in the background the first time
+    // the layer is recorded.
+    //
+    bool pipeline_cache_warm;
+    VkPipelineCache pipeline_cache = pipeline_cache_load(
+        physical_device.physical_device, logical_device, config->pipeline_cache_path, &pipeline_cache_warm);
+    struct PipelineRegistry *pipelines = malloc(sizeof(struct PipelineRegistry));
+    if (pipelines == NULL) {
+        log_fatal("Could not malloc pipeline registry\n");
+        exit(EXIT_FAILURE);
+    }
+    VkDescriptorSetLayout set_layouts[TILE_SET_COUNT] = {
+        [TILE_SET_FRAME] = uniforms.set_layout,
+        [TILE_SET_ATLAS] = atlas.set_layout,
+        [TILE_SET_TILEMAP] = fullscreen_tilemap_set_layout(descriptors),
+    };
+    pipeline_registry_init(pipelines, logical_device, pipeline_cache, set_layouts, assets, PIPELINE_COMPILE_THREADS);
+    struct PipelineKey fallback_key = pipeline_key_for_layer(renderpass, TILE_LAYER_MODE_ATLAS);
+    pipeline_registry_get(pipelines, &fallback_key);
 
     struct RawVector framebuffers = create_framebuffers(logical_device, renderpass, swapchain_extent, &swapchain_image_views_VkImageView);
 
-    VkBuffer vertex_buffer = create_vertex_buffer(logical_device);
-    VkDeviceMemory vertex_buffer_memory = allocate_and_bind_and_fill_vertex_buffer_memory(
-        physical_device.physical_device, 
-        logical_device, 
-        vertex_buffer);
+    //
+    // The quad, its indices and one instance per tile of the map all live in
+    // device local memory and are filled through the upload context's staging
+    // buffers, on the transfer queue if there is one. Each layer of the map is
+    // a single instanced draw of the quad.
+    //
+    if (config->map_width == 0 || config->map_height == 0) {
+        log_fatal("The tile map must be at least 1x1\n");
+        exit(EXIT_FAILURE);
+    }
+    struct UploadContext upload = upload_context_create(
+        allocator,
+        sync,
+        graphics_queue,
+        optional_index_get_value(&physical_device.graphics_family_index),
+        transfer_queue,
+        interface_physical_device_transfer_family(&physical_device),
+        UPLOAD_STAGING_SIZE);
+
+    struct MemoryAllocation vertex_buffer_allocation;
+    VkBuffer vertex_buffer = create_device_local_buffer(
+        allocator,
+        sizeof(quad_vertices),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        &vertex_buffer_allocation);
+    upload_buffer(
+        &upload, vertex_buffer, 0, quad_vertices, sizeof(quad_vertices),
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+    struct MemoryAllocation index_buffer_allocation;
+    VkBuffer index_buffer = create_device_local_buffer(
+        allocator,
+        sizeof(quad_indices),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        &index_buffer_allocation);
+    upload_buffer(
+        &upload, index_buffer, 0, quad_indices, sizeof(quad_indices),
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    //
+    // A streamed map is only ever generated a chunk at a time, near the
+    // camera, so nothing of it is built here and none of its layers can be
+    // drawn from a whole-map grid or culled from whole-map chunks
+    //
+    struct TileLayerRange layers[MAX_TILE_LAYERS];
+    uint32_t layer_count;
+    struct RawVector rvec_TileInstance;
+    struct ChunkManager *world = NULL;
+    if (config->stream_chunks) {
+        world = malloc(sizeof(struct ChunkManager));
+        if (world == NULL) {
+            log_fatal("Could not malloc chunk manager\n");
+            exit(EXIT_FAILURE);
+        }
+        chunk_manager_init(
+            world, allocator, sync, config->map_path, config->map_width, config->map_height, config->resident_chunks);
+        layer_count = world->layer_count;
+        memcpy(layers, world->layers, sizeof(layers));
+        rvec_TileInstance = raw_vector_create(sizeof(struct TileInstance), 1);
+    } else {
+        rvec_TileInstance = create_tile_instance_grid(config->map_width, config->map_height, layers, &layer_count);
+    }
+
+    //
+    // Layers covering the whole map are drawn fullscreen from a grid of tile
+    // IDs instead of from their instances
+    //
+    struct RawVector tiles_uint32 = raw_vector_create(sizeof(uint32_t), 1);
+    if (config->fullscreen_dense_layers && world == NULL) {
+        fullscreen_tilemap_extract_dense_layers(
+            &rvec_TileInstance, layers, layer_count, config->map_width, config->map_height, &tiles_uint32);
+    }
+    struct FullscreenTilemap tilemap;
+    fullscreen_tilemap_init(
+        &tilemap, allocator, descriptors, &upload, config->map_width, config->map_height, &tiles_uint32);
+    raw_vector_destroy(&tiles_uint32);
+    if (tilemap.layer_count > 0) {
+        struct PipelineKey tilemap_key = pipeline_key_for_tilemap(renderpass);
+        pipeline_registry_get(pipelines, &tilemap_key);
+    }
+    uint32_t instance_count = raw_vector_size(&rvec_TileInstance);
+    VkDeviceSize instance_bytes = sizeof(struct TileInstance) * (VkDeviceSize)instance_count;
+    struct MemoryAllocation instance_buffer_allocation = {};
+    VkBuffer instance_buffer = VK_NULL_HANDLE;
+    if (instance_count > 0) {
+        instance_buffer = create_device_local_buffer(
+            allocator,
+            instance_bytes,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            &instance_buffer_allocation);
+        upload_buffer(
+            &upload, instance_buffer, 0, raw_vector_get_ptr(&rvec_TileInstance, 0), instance_bytes,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    }
 
-    VkCommandPool pool = create_command_pool(logical_device, optional_index_get_value(&physical_device.graphics_family_index));
-    struct RawVector command_buffers = create_command_buffers(
+    //
+    // The instanced layers are culled chunk by chunk on the GPU and drawn
+    // with indirect draws, when the device can
+    //
+    struct ChunkCuller *culler = NULL;
+    if (config->gpu_culling && world == NULL && physical_device.multi_draw_indirect) {
+        culler = malloc(sizeof(struct ChunkCuller));
+        if (culler == NULL) {
+            log_fatal("Could not malloc chunk culler\n");
+            exit(EXIT_FAILURE);
+        }
+        chunk_culler_init(
+            culler,
+            allocator,
+            descriptors,
+            &upload,
+            pipeline_cache,
+            assets,
+            pacing->frames_in_flight,
+            physical_device.draw_indirect_count,
+            &rvec_TileInstance,
+            layers,
+            layer_count);
+    } else if (config->gpu_culling && world == NULL) {
+        log_warn("Device does not support multiDrawIndirect, chunks are not culled\n");
+    }
+    raw_vector_destroy(&rvec_TileInstance);
+
+    upload_context_flush(&upload);
+    if (world == NULL) {
+        log_info("Drawing %u tile instances in %u layers per frame\n", instance_count, layer_count);
+    }
+    memory_allocator_log_stats(allocator);
+
+    //
+    // The scene is recorded afresh every frame, with the tile chunks of big
+    // maps spread over record_thread_count threads
+    //
+    struct FrameRecorder *recorder = malloc(sizeof(struct FrameRecorder));
+    if (recorder == NULL) {
+        log_fatal("Could not malloc frame recorder\n");
+        exit(EXIT_FAILURE);
+    }
+    frame_recorder_init(
+        recorder,
         logical_device,
-        pool,
-        renderpass,
-        pipeline,
-        &framebuffers,
-        swapchain_extent,
-        vertex_buffer);
+        optional_index_get_value(&physical_device.graphics_family_index),
+        pacing->frames_in_flight,
+        config->record_thread_count);
+
+
+    log_info("Startup with %s pipeline cache: %.3f ms total, %.3f ms creating pipelines\n",
+        pipeline_cache_warm ? "warm" : "cold",
+        clock_ns_to_ms(clock_now_ns() - startup_start_ns),
+        clock_ns_to_ms(pipelines->build_ns));
 
+    struct VulkanState state = {
+        .headless = config->headless,
+        .headless_frame_limit = config->headless_frame_limit,
+        .resize_stress_count = config->resize_stress_count,
 
-    return (struct VulkanState) {
         .window = window,
         .instance = instance,
 #ifndef NDEBUG
@@ -304,28 +968,58 @@ struct VulkanState vulkan_state_create() {
 
         .graphics_queue = graphics_queue,
         .presentation_queue = presentation_queue,
+        .transfer_queue = transfer_queue,
 
         .surface = surface,
 
+        .pacing = pacing,
+        .present_mode = present_mode,
+        .sync = sync,
+        .deletions = deletions,
+        .retired_swapchains = retired_swapchains,
+        .descriptors = descriptors,
+        .present_timer = present_timer,
+        .assets = assets,
+
         .swapchain = swapchain,
         .swapchain_format = swapchain_format,
         .swapchain_extent = swapchain_extent,
         .swapchain_images_VkImage = swapchain_images_VkImage,
         .swapchain_image_views_VkImageView = swapchain_image_views_VkImageView,
+        .offscreen_allocations_MemoryAllocation = offscreen_allocations_MemoryAllocation,
 
         .renderpass = renderpass,
         
-        .pipeline = pipeline,
-        .pipeline_layout = pipeline_layout, 
+        .pipelines = pipelines,
+        .pipeline_cache = pipeline_cache,
+        .pipeline_cache_path = config->pipeline_cache_path,
 
         .framebuffers_VkFramebuffer = framebuffers,
 
-        .command_pool = pool,
-        .command_buffers = command_buffers,
+        .recorder = recorder,
+        .culler = culler,
+        .world = world,
 
         .vertex_buffer = vertex_buffer,
-        .vertex_buffer_memory = vertex_buffer_memory,
+        .vertex_buffer_allocation = vertex_buffer_allocation,
+
+        .index_buffer = index_buffer,
+        .index_buffer_allocation = index_buffer_allocation,
+
+        .instance_buffer = instance_buffer,
+        .instance_buffer_allocation = instance_buffer_allocation,
+        .instance_count = instance_count,
+        .layer_count = layer_count,
+
+        .allocator = allocator,
+        .upload = upload,
+        .uniforms = uniforms,
+        .atlas = atlas,
+        .tilemap = tilemap,
+        .camera = camera_default(),
     };
+    memcpy(state.layers, layers, sizeof(state.layers));
+    return state;
 } 
 
 //
@@ -333,17 +1027,48 @@ struct VulkanState vulkan_state_create() {
 //
 void vulkan_state_destroy(struct VulkanState *state) {
 
-    vkDestroyBuffer(state->logical_device, state->vertex_buffer, NULL);
-    vkFreeMemory(state->logical_device, state->vertex_buffer_memory, NULL);
-    vkDestroyCommandPool(state->logical_device, state->command_pool, NULL);
+    retired_swapchains_destroy(state->retired_swapchains);
+    free(state->retired_swapchains);
+    if (state->present_timer != NULL) {
+        present_timer_destroy(state->present_timer);
+        free(state->present_timer);
+    }
+    deletion_queue_destroy(state->deletions);
+    free(state->deletions);
+    upload_context_destroy(&state->upload);
+    destroy_buffer_with_memory(state->allocator, state->vertex_buffer, &state->vertex_buffer_allocation);
+    destroy_buffer_with_memory(state->allocator, state->index_buffer, &state->index_buffer_allocation);
+    if (state->instance_buffer != VK_NULL_HANDLE) {
+        destroy_buffer_with_memory(state->allocator, state->instance_buffer, &state->instance_buffer_allocation);
+    }
+    if (state->world != NULL) {
+        chunk_manager_destroy(state->world);
+        free(state->world);
+    }
+    frame_recorder_destroy(state->recorder);
+    free(state->recorder);
+    frame_sync_destroy(state->sync);
+    free(state->sync);
+    uniform_ring_destroy(&state->uniforms);
+    tile_atlas_destroy(&state->atlas);
+    fullscreen_tilemap_destroy(&state->tilemap);
+    if (state->culler != NULL) {
+        chunk_culler_destroy(state->culler);
+        free(state->culler);
+    }
     for (int i = 0; i < raw_vector_size(&state->framebuffers_VkFramebuffer); i++) {
         vkDestroyFramebuffer(
             state->logical_device, 
             *(VkFramebuffer *)raw_vector_get_ptr(&state->framebuffers_VkFramebuffer, i), 
             NULL);
     }
-    vkDestroyPipelineLayout(state->logical_device, state->pipeline_layout, NULL);
-    vkDestroyPipeline(state->logical_device, state->pipeline, NULL);
+    pipeline_registry_destroy(state->pipelines);
+    free(state->pipelines);
+    descriptor_allocator_destroy(state->descriptors);
+    free(state->descriptors);
+    pipeline_cache_save(
+        state->physical_device.physical_device, state->logical_device, state->pipeline_cache, state->pipeline_cache_path);
+    vkDestroyPipelineCache(state->logical_device, state->pipeline_cache, NULL);
     vkDestroyRenderPass(state->logical_device, state->renderpass, NULL);
     for (int i = 0; i < raw_vector_size(&state->swapchain_image_views_VkImageView); i++) {
         vkDestroyImageView(
@@ -352,15 +1077,31 @@ void vulkan_state_destroy(struct VulkanState *state) {
             NULL);
     }
     raw_vector_destroy(&state->swapchain_image_views_VkImageView);
+    if (state->headless) {
+        //
+        // Offscreen images are owned by us rather than by a swapchain
+        //
+        destroy_offscreen_images(
+            state->allocator, &state->swapchain_images_VkImage, &state->offscreen_allocations_MemoryAllocation);
+    } else {
+        vkDestroySwapchainKHR(state->logical_device, state->swapchain, NULL);
+        vkDestroySurfaceKHR(state->instance, state->surface, NULL);
+    }
     raw_vector_destroy(&state->swapchain_images_VkImage);
-    vkDestroySwapchainKHR(state->logical_device, state->swapchain, NULL);
-    vkDestroySurfaceKHR(state->instance, state->surface, NULL);
+    if (state->assets != NULL) {
+        asset_pack_close(state->assets);
+        free(state->assets);
+    }
+    memory_allocator_destroy(state->allocator);
+    free(state->allocator);
     vkDestroyDevice(state->logical_device, NULL);
 #ifndef NDEBUG
     DestroyDebugUtilsMessengerEXT(state->instance, state->debug_messenger, NULL);
 #endif
     vkDestroyInstance(state->instance, NULL);
-    glfwDestroyWindow(state->window);
-    glfwTerminate();
+    if (!state->headless) {
+        glfwDestroyWindow(state->window);
+        glfwTerminate();
+    }
 
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include "vulkan-interface/memory.h"
+#include "log.h"
+
+#define BYTES_TO_MB(bytes) ((double)(bytes) / (1024.0 * 1024.0))
+
+//
+// The type_bits mask (from VkMemoryRequirements::memoryTypeBits) has bit i set
+// if mem_props.memoryTypes[i] is supported for the resource. Therefore, for our
+// desired properties, we must check that the given memory type includes our
+// desired properties AND that it is supported by the resource.
+// Returns false if no memory type qualifies.
+//
+bool try_find_memory_type_index(VkPhysicalDevice physical_device, uint32_t type_bits, VkMemoryPropertyFlags desired_properties, uint32_t *index) {
+    VkPhysicalDeviceMemoryProperties mem_props;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+        if (type_bits & (1 << i) && ((mem_props.memoryTypes[i].propertyFlags & desired_properties) == desired_properties)) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Like try_find_memory_type_index, but a missing memory type is fatal.
+//
+uint32_t find_memory_type_index(VkPhysicalDevice physical_device, uint32_t type_bits, VkMemoryPropertyFlags desired_properties) {
+    uint32_t index;
+    if (!try_find_memory_type_index(physical_device, type_bits, desired_properties, &index)) {
+        log_fatal("Failed to select memory type!\n");
+        exit(EXIT_FAILURE);
+    }
+    return index;
+}
+
+//
+// Picks a memory type with all of required_properties, preferring one which
+// also has preferred_properties.
+//
+static uint32_t choose_memory_type_index(
+    VkPhysicalDevice physical_device,
+    uint32_t type_bits,
+    VkMemoryPropertyFlags required_properties,
+    VkMemoryPropertyFlags preferred_properties) {
+
+    uint32_t index;
+    if (preferred_properties != 0 &&
+        try_find_memory_type_index(physical_device, type_bits, required_properties | preferred_properties, &index)) {
+        return index;
+    }
+    return find_memory_type_index(physical_device, type_bits, required_properties);
+}
+
+//
+// Allocates size bytes of the given memory type, mapping them if they are
+// host visible.
+//
+static VkDeviceMemory allocate_device_memory(
+    struct MemoryAllocator *allocator, uint32_t memory_type_index, VkDeviceSize size, uint8_t **mapped) {
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type_index;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(allocator->device, &alloc_info, NULL, &memory) != VK_SUCCESS) {
+        log_fatal("Failed to allocate %.1f MB of device memory!\n", BYTES_TO_MB(size));
+        exit(EXIT_FAILURE);
+    }
+
+    *mapped = NULL;
+    VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[memory_type_index].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void *pointer;
+        if (vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &pointer) != VK_SUCCESS) {
+            log_fatal("Failed to map device memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        *mapped = pointer;
+    }
+
+    return memory;
+}
+
+void memory_allocator_init(struct MemoryAllocator *allocator, VkPhysicalDevice physical_device, VkDevice device) {
+    allocator->physical_device = physical_device;
+    allocator->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator->memory_properties);
+
+    pthread_mutex_init(&allocator->mutex, NULL);
+    allocator->blocks_MemoryBlock = raw_vector_create(sizeof(struct MemoryBlock), 8);
+
+    allocator->dedicated_count = 0;
+    allocator->dedicated_bytes = 0;
+}
+
+//
+// Frees every block. All resources placed in them must already be destroyed.
+//
+void memory_allocator_destroy(struct MemoryAllocator *allocator) {
+    memory_allocator_log_stats(allocator);
+    if (allocator->dedicated_count > 0) {
+        log_error("%u dedicated allocations were never freed\n", allocator->dedicated_count);
+    }
+
+    for (size_t i = 0; i < raw_vector_size(&allocator->blocks_MemoryBlock); i++) {
+        struct MemoryBlock *block = (struct MemoryBlock *)raw_vector_get_ptr(&allocator->blocks_MemoryBlock, i);
+        if (block->ranges.allocation_count > 0) {
+            log_error("Memory block %lu still holds %u allocations\n", (unsigned long)i, block->ranges.allocation_count);
+        }
+        if (block->mapped != NULL) {
+            vkUnmapMemory(allocator->device, block->memory);
+        }
+        vkFreeMemory(allocator->device, block->memory, NULL);
+        range_allocator_destroy(&block->ranges);
+    }
+    raw_vector_destroy(&allocator->blocks_MemoryBlock);
+    pthread_mutex_destroy(&allocator->mutex);
+}
+
+//
+// Places a resource with the given requirements in memory with all of
+// required_properties (and preferably preferred_properties). linear is true
+// for buffers and linearly tiled images, false for optimally tiled images.
+// Large resources get a dedicated allocation; everything else is placed in
+// the first block of the right memory type with room, and a new block is
+// allocated when none has.
+//
+struct MemoryAllocation memory_allocate(
+    struct MemoryAllocator *allocator,
+    const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags required_properties,
+    VkMemoryPropertyFlags preferred_properties,
+    bool linear) {
+
+    uint32_t memory_type_index = choose_memory_type_index(
+        allocator->physical_device, requirements->memoryTypeBits, required_properties, preferred_properties);
+
+    struct MemoryAllocation allocation = {};
+    allocation.size = requirements->size;
+
+    pthread_mutex_lock(&allocator->mutex);
+
+    if (requirements->size >= MEMORY_DEDICATED_THRESHOLD) {
+        allocation.memory = allocate_device_memory(allocator, memory_type_index, requirements->size, &allocation.mapped);
+        allocation.offset = 0;
+        allocation.block_index = MEMORY_DEDICATED_BLOCK;
+        allocator->dedicated_count += 1;
+        allocator->dedicated_bytes += requirements->size;
+        pthread_mutex_unlock(&allocator->mutex);
+        return allocation;
+    }
+
+    size_t block_count = raw_vector_size(&allocator->blocks_MemoryBlock);
+    for (size_t i = 0; i < block_count; i++) {
+        struct MemoryBlock *block = (struct MemoryBlock *)raw_vector_get_ptr(&allocator->blocks_MemoryBlock, i);
+        if (block->memory_type_index != memory_type_index || block->linear != linear) {
+            continue;
+        }
+        if (range_allocator_alloc(&block->ranges, requirements->size, requirements->alignment, &allocation.offset)) {
+            allocation.memory = block->memory;
+            allocation.mapped = block->mapped != NULL ? block->mapped + allocation.offset : NULL;
+            allocation.block_index = i;
+            pthread_mutex_unlock(&allocator->mutex);
+            return allocation;
+        }
+    }
+
+    struct MemoryBlock block = {};
+    block.memory = allocate_device_memory(allocator, memory_type_index, MEMORY_BLOCK_SIZE, &block.mapped);
+    block.memory_type_index = memory_type_index;
+    block.linear = linear;
+    block.ranges = range_allocator_create(MEMORY_BLOCK_SIZE);
+    range_allocator_alloc(&block.ranges, requirements->size, requirements->alignment, &allocation.offset);
+    raw_vector_push_back(&allocator->blocks_MemoryBlock, &block);
+    log_trace("Allocated memory block %lu of memory type %u\n", (unsigned long)block_count, memory_type_index);
+
+    allocation.memory = block.memory;
+    allocation.mapped = block.mapped != NULL ? block.mapped + allocation.offset : NULL;
+    allocation.block_index = block_count;
+
+    pthread_mutex_unlock(&allocator->mutex);
+    return allocation;
+}
+
+//
+// Returns an allocation's range to its block. Empty blocks are kept for
+// later allocations and only freed with the allocator.
+//
+void memory_free(struct MemoryAllocator *allocator, struct MemoryAllocation *allocation) {
+    if (allocation->memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    pthread_mutex_lock(&allocator->mutex);
+    if (allocation->block_index == MEMORY_DEDICATED_BLOCK) {
+        vkFreeMemory(allocator->device, allocation->memory, NULL);
+        allocator->dedicated_count -= 1;
+        allocator->dedicated_bytes -= allocation->size;
+    } else {
+        struct MemoryBlock *block = (struct MemoryBlock *)raw_vector_get_ptr(&allocator->blocks_MemoryBlock, allocation->block_index);
+        range_allocator_free(&block->ranges, allocation->offset, allocation->size);
+    }
+    pthread_mutex_unlock(&allocator->mutex);
+
+    *allocation = (struct MemoryAllocation){};
+}
+
+//
+// Creates an exclusive buffer of the given size and usage with no memory bound.
+//
+VkBuffer create_buffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage) {
+    VkBufferCreateInfo ci = {};
+    ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    ci.size = size;
+    ci.usage = usage;
+    ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer;
+    if (vkCreateBuffer(device, &ci, NULL, &buffer) != VK_SUCCESS) {
+        log_fatal("Failed to create buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return buffer;
+}
+
+//
+// Creates a buffer and binds it to memory placed by the allocator.
+//
+VkBuffer create_buffer_with_memory(
+    struct MemoryAllocator *allocator,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags required_properties,
+    VkMemoryPropertyFlags preferred_properties,
+    struct MemoryAllocation *allocation) {
+
+    VkBuffer buffer = create_buffer(allocator->device, size, usage);
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(allocator->device, buffer, &mem_reqs);
+
+    *allocation = memory_allocate(allocator, &mem_reqs, required_properties, preferred_properties, true);
+    vkBindBufferMemory(allocator->device, buffer, allocation->memory, allocation->offset);
+
+    return buffer;
+}
+
+void destroy_buffer_with_memory(struct MemoryAllocator *allocator, VkBuffer buffer, struct MemoryAllocation *allocation) {
+    vkDestroyBuffer(allocator->device, buffer, NULL);
+    memory_free(allocator, allocation);
+}
+
+//
+// Creates an image from image_ci and binds it to memory placed by the allocator.
+//
+VkImage create_image_with_memory(
+    struct MemoryAllocator *allocator,
+    const VkImageCreateInfo *image_ci,
+    VkMemoryPropertyFlags required_properties,
+    struct MemoryAllocation *allocation) {
+
+    VkImage image;
+    if (vkCreateImage(allocator->device, image_ci, NULL, &image) != VK_SUCCESS) {
+        log_fatal("Failed to create image\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkMemoryRequirements mem_reqs;
+    vkGetImageMemoryRequirements(allocator->device, image, &mem_reqs);
+
+    *allocation = memory_allocate(
+        allocator, &mem_reqs, required_properties, 0, image_ci->tiling == VK_IMAGE_TILING_LINEAR);
+    vkBindImageMemory(allocator->device, image, allocation->memory, allocation->offset);
+
+    return image;
+}
+
+void destroy_image_with_memory(struct MemoryAllocator *allocator, VkImage image, struct MemoryAllocation *allocation) {
+    vkDestroyImage(allocator->device, image, NULL);
+    memory_free(allocator, allocation);
+}
+
+struct MemoryAllocatorStats memory_allocator_stats(struct MemoryAllocator *allocator) {
+    struct MemoryAllocatorStats stats = {};
+
+    pthread_mutex_lock(&allocator->mutex);
+    stats.block_count = raw_vector_size(&allocator->blocks_MemoryBlock);
+    stats.dedicated_count = allocator->dedicated_count;
+    stats.allocation_count = allocator->dedicated_count;
+    stats.bytes_reserved = allocator->dedicated_bytes;
+    stats.bytes_used = allocator->dedicated_bytes;
+
+    for (size_t i = 0; i < stats.block_count; i++) {
+        struct MemoryBlock *block = (struct MemoryBlock *)raw_vector_get_ptr(&allocator->blocks_MemoryBlock, i);
+        VkDeviceSize largest = range_allocator_largest_free(&block->ranges);
+
+        stats.allocation_count += block->ranges.allocation_count;
+        stats.bytes_reserved += block->ranges.size;
+        stats.bytes_used += block->ranges.used;
+        stats.bytes_free += block->ranges.size - block->ranges.used;
+        stats.free_range_count += range_allocator_free_range_count(&block->ranges);
+        if (largest > stats.largest_free_range) {
+            stats.largest_free_range = largest;
+        }
+    }
+    pthread_mutex_unlock(&allocator->mutex);
+
+    stats.fragmentation = stats.bytes_free > 0
+        ? 1.0 - (double)stats.largest_free_range / (double)stats.bytes_free
+        : 0.0;
+    return stats;
+}
+
+void memory_allocator_log_stats(struct MemoryAllocator *allocator) {
+    struct MemoryAllocatorStats stats = memory_allocator_stats(allocator);
+    log_info(
+        "Device memory: %u allocations in %u blocks + %u dedicated, %.1f MB used of %.1f MB reserved, "
+        "%lu free ranges, largest %.1f MB, fragmentation %.2f\n",
+        stats.allocation_count,
+        stats.block_count,
+        stats.dedicated_count,
+        BYTES_TO_MB(stats.bytes_used),
+        BYTES_TO_MB(stats.bytes_reserved),
+        (unsigned long)stats.free_range_count,
+        BYTES_TO_MB(stats.largest_free_range),
+        stats.fragmentation);
+}
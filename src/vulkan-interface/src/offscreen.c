@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include "vulkan-interface/offscreen.h"
+#include "log.h"
+
+//
+// Creates a ring of count color images which stand in for the swapchain
+// images when running headless. They can be rendered to and then copied
+// out, which is all a benchmark or batch renderer needs. Their device local
+// memory is placed by allocator and returned in rvec_MemoryAllocation, in
+// the same order as the images.
+//
+struct RawVector create_offscreen_images(
+    struct MemoryAllocator *allocator,
+    VkExtent2D extent,
+    VkFormat format,
+    uint32_t count,
+    struct RawVector *rvec_MemoryAllocation) {
+
+    struct RawVector rvec_VkImage = raw_vector_create(sizeof(VkImage), count);
+    *rvec_MemoryAllocation = raw_vector_create(sizeof(struct MemoryAllocation), count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        VkImageCreateInfo ci = {};
+        ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        ci.imageType = VK_IMAGE_TYPE_2D;
+        ci.format = format;
+        ci.extent = (VkExtent3D){ extent.width, extent.height, 1 };
+        ci.mipLevels = 1;
+        ci.arrayLayers = 1;
+        ci.samples = VK_SAMPLE_COUNT_1_BIT;
+        ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ci.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        struct MemoryAllocation allocation;
+        VkImage image = create_image_with_memory(allocator, &ci, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation);
+        raw_vector_push_back(&rvec_VkImage, &image);
+        raw_vector_push_back(rvec_MemoryAllocation, &allocation);
+    }
+
+    log_trace("Created %u offscreen images\n", count);
+    return rvec_VkImage;
+}
+
+void destroy_offscreen_images(
+    struct MemoryAllocator *allocator, struct RawVector *rvec_VkImage, struct RawVector *rvec_MemoryAllocation) {
+
+    for (size_t i = 0; i < raw_vector_size(rvec_VkImage); i++) {
+        destroy_image_with_memory(
+            allocator,
+            *(VkImage *)raw_vector_get_ptr(rvec_VkImage, i),
+            (struct MemoryAllocation *)raw_vector_get_ptr(rvec_MemoryAllocation, i));
+    }
+    raw_vector_destroy(rvec_MemoryAllocation);
+}
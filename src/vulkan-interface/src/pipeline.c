@@ -1,20 +1,17 @@
 #include <language/raw_vector.h>
-#include <language/fileops.h>
 #include "vulkan-interface/pipeline.h"
+#include "vulkan-interface/shaders.h"
 #include "log.h"
 #include "vulkan-interface/vertex.h"
 
-#define VERT_SHADER ("./src/vulkan-interface/shaders/spir-v/vert.spv")
-#define FRAG_SHADER ("./src/vulkan-interface/shaders/spir-v/frag.spv")
-
 //
-// Creates a shader module for the logical device from the given bytecode buffer
+// Creates a shader module for the logical device from code_size bytes of SPIR-V
 //
-VkShaderModule create_shader_module(VkDevice device, uint8_t *bytecode_buffer, size_t buffer_size) {
+VkShaderModule create_shader_module(VkDevice device, const uint32_t *code, size_t code_size) {
     VkShaderModuleCreateInfo ci = {};
     ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    ci.codeSize = buffer_size;
-    ci.pCode = (uint32_t *)bytecode_buffer;
+    ci.codeSize = code_size;
+    ci.pCode = code;
 
     VkShaderModule module;
     if (vkCreateShaderModule(device, &ci, NULL, &module) != VK_SUCCESS) {
@@ -25,6 +22,27 @@ VkShaderModule create_shader_module(VkDevice device, uint8_t *bytecode_buffer, s
     return module;
 }
 
+//
+// Creates a shader module from the SPIR-V entry name of assets, or from
+// the code_size bytes of embedded code if assets is NULL or has no such
+// entry. A pack only opens for the build it was packed with (see
+// shaders.h), so its entries are used as they are, straight from the
+// mapping.
+//
+VkShaderModule create_asset_shader_module(
+    VkDevice device, const struct AssetPack *assets, const char *name, const uint32_t *code, size_t code_size) {
+
+    if (assets != NULL) {
+        size_t size;
+        const uint8_t *packed = asset_pack_find(assets, name, &size);
+        if (packed != NULL) {
+            return create_shader_module(device, (const uint32_t *)packed, size);
+        }
+        log_warn("Asset pack has no %s, using the embedded shader\n", name);
+    }
+    return create_shader_module(device, code, code_size);
+}
+
 //
 // Creates a framebuffer for each image of the swapchain. Each framebuffer
 // is basically an array of image views compatible with the given renderpass.
@@ -61,9 +79,11 @@ struct RawVector create_framebuffers(VkDevice device, VkRenderPass renderpass, V
 // and references an array of attachment descriptions. Each attachment
 // description describes how a certain attachment to the pipeline
 // (an image view) will be laid out and used. Each subpass references
-// some number of these attachments.
+// some number of these attachments. The final_layout is the layout the
+// color attachment is left in: PRESENT_SRC for a swapchain image, or
+// TRANSFER_SRC for an offscreen image which is read back afterwards.
 //
-VkRenderPass create_render_pass(VkDevice device, VkFormat image_format) {
+VkRenderPass create_render_pass(VkDevice device, VkFormat image_format, VkImageLayout final_layout) {
     
     VkAttachmentDescription color_attachment = {};
     color_attachment.format = image_format;
@@ -73,7 +93,7 @@ VkRenderPass create_render_pass(VkDevice device, VkFormat image_format) {
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment.finalLayout = final_layout;
 
     VkAttachmentReference attach_ref = {};
     attach_ref.attachment = 0;
@@ -111,21 +131,60 @@ VkRenderPass create_render_pass(VkDevice device, VkFormat image_format) {
 }
 
 //
-// Creates a graphics pipeline for the given logical device
+// Returns true if both keys describe the same pipeline variant.
+//
+bool pipeline_key_equal(const struct PipelineKey *a, const struct PipelineKey *b) {
+    return a->renderpass == b->renderpass &&
+        a->program == b->program &&
+        a->topology == b->topology &&
+        a->blend_mode == b->blend_mode &&
+        a->layer_mode == b->layer_mode;
+}
+
+//
+// Creates the pipeline layout shared by every graphics pipeline variant.
+// This is how push constants and uniforms can be sent through to the shader:
+// the camera is a vertex stage push constant, set TILE_SET_FRAME is the
+// uniform ring's dynamic uniform buffer, set TILE_SET_ATLAS the tile atlas
+// and set TILE_SET_TILEMAP the fullscreen tilemap's tile IDs.
 //
-VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D sc_extent, VkRenderPass renderpass, VkPipelineLayout *layout) {
-    size_t vert_size, frag_size;
-    uint8_t *vert = read_binary_file_FREE(VERT_SHADER, &vert_size);
-    uint8_t *frag = read_binary_file_FREE(FRAG_SHADER, &frag_size);
+VkPipelineLayout create_pipeline_layout(VkDevice device, const VkDescriptorSetLayout set_layouts[TILE_SET_COUNT]) {
+    VkPushConstantRange camera_range = {};
+    camera_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    camera_range.offset = 0;
+    camera_range.size = sizeof(struct CameraPushConstants);
 
-    log_trace("Size of vertex buffer: %u\n", vert_size);
-    log_trace("Size of frag buffer: %u\n", frag_size);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = TILE_SET_COUNT;
+    pipelineLayoutInfo.pSetLayouts = set_layouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &camera_range;
 
-    VkShaderModule vertex_module = create_shader_module(device, vert, vert_size);
-    VkShaderModule fragment_module = create_shader_module(device, frag, frag_size);
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &layout) != VK_SUCCESS) {
+        log_fatal("Failed to create pipeline layout!\n");
+        exit(EXIT_FAILURE);
+    }
+    return layout;
+}
 
-    free(vert);
-    free(frag);
+//
+// Creates the graphics pipeline variant described by key. Viewport and
+// scissor are dynamic state, so the pipeline does not depend on the
+// swapchain extent and survives resizes. The key's layer mode is baked into
+// the fragment shader as specialization constant 0, so each mode compiles
+// to its own branch-free shader. The tilemap program has no vertex input;
+// its vertex shader makes a fullscreen triangle from the vertex index.
+// Compilation results are looked up in and added to cache.
+//
+VkPipeline create_graphics_pipeline(
+    VkDevice device,
+    VkPipelineCache cache,
+    VkPipelineLayout layout,
+    VkShaderModule vertex_module,
+    VkShaderModule fragment_module,
+    const struct PipelineKey *key) {
 
     //
     // Vertex shader programmable stage
@@ -135,36 +194,51 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D sc_extent, VkRen
     vertex_shader_stage_ci.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertex_shader_stage_ci.pName = "main";
     vertex_shader_stage_ci.module = vertex_module;
-    vertex_shader_stage_ci.pSpecializationInfo = VK_NULL_HANDLE; // TODO: This can be used to supply globals to shaders
+    vertex_shader_stage_ci.pSpecializationInfo = NULL;
 
     //
-    // Fragment shader programmable stage
+    // Fragment shader programmable stage, specialized for the layer mode
     //
+    VkSpecializationMapEntry layer_mode_entry = {
+        .constantID = SPECIALIZATION_LAYER_MODE,
+        .offset = 0,
+        .size = sizeof(uint32_t),
+    };
+    VkSpecializationInfo fragment_specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &layer_mode_entry,
+        .dataSize = sizeof(uint32_t),
+        .pData = &key->layer_mode,
+    };
+
     VkPipelineShaderStageCreateInfo fragment_shader_stage_ci = {};
     fragment_shader_stage_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragment_shader_stage_ci.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragment_shader_stage_ci.pName = "main";
     fragment_shader_stage_ci.module = fragment_module;
+    fragment_shader_stage_ci.pSpecializationInfo = &fragment_specialization;
 
     //
     // Vertex input data specification 
     //
-    VkVertexInputBindingDescription binding_description = get_binding_description();
+    struct RawVector binding_descriptions = get_binding_description();
     struct RawVector attr_descriptions = get_attribute_description();
 
     VkPipelineVertexInputStateCreateInfo vertex_input_ci = {};
     vertex_input_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_ci.vertexBindingDescriptionCount = 1;
-    vertex_input_ci.pVertexBindingDescriptions = &binding_description;
-    vertex_input_ci.vertexAttributeDescriptionCount = raw_vector_size(&attr_descriptions);;
-    vertex_input_ci.pVertexAttributeDescriptions = (VkVertexInputAttributeDescription *)raw_vector_get_ptr(&attr_descriptions, 0);
+    if (key->program == PIPELINE_PROGRAM_TILES) {
+        vertex_input_ci.vertexBindingDescriptionCount = raw_vector_size(&binding_descriptions);
+        vertex_input_ci.pVertexBindingDescriptions = (VkVertexInputBindingDescription *)raw_vector_get_ptr(&binding_descriptions, 0);
+        vertex_input_ci.vertexAttributeDescriptionCount = raw_vector_size(&attr_descriptions);;
+        vertex_input_ci.pVertexAttributeDescriptions = (VkVertexInputAttributeDescription *)raw_vector_get_ptr(&attr_descriptions, 0);
+    }
 
     //
     // Vertex input assembly fixed pipeline stage
     //
     VkPipelineInputAssemblyStateCreateInfo input_assembly_ci = {};
     input_assembly_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_ci.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_ci.topology = (VkPrimitiveTopology)key->topology;
     input_assembly_ci.primitiveRestartEnable = VK_FALSE;
 
     //
@@ -200,16 +274,19 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D sc_extent, VkRen
     //
 
     //
-    // Specify how to color blend our only color attachment (the framebuffer)
-    // For now, we will use __over__ operator blending (I think)
+    // Specify how to color blend our only color attachment (the framebuffer).
+    // Alpha blending is the __over__ operator, additive adds the weighted
+    // source on top, and opaque just overwrites.
     //
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
     colorBlendAttachment.colorWriteMask = 
           VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT ;
-    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.blendEnable = key->blend_mode == BLEND_MODE_OPAQUE ? VK_FALSE : VK_TRUE;
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = key->blend_mode == BLEND_MODE_ADDITIVE
+        ? VK_BLEND_FACTOR_ONE
+        : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
     colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -230,51 +307,20 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D sc_extent, VkRen
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
     //
-    // Create pipeline layout. This is how push constants and
-    // uniforms can be sent through to the shader
-    //
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0; // Optional
-    pipelineLayoutInfo.pSetLayouts = NULL; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = NULL; // Optional
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, layout) != VK_SUCCESS) {
-        log_fatal("Failed to create pipeline layout!\n");
-        exit(EXIT_FAILURE);
-    }
-
-
-    //
-    // Specify the viewport
-    //
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = (float)sc_extent.width,
-        .height = (float)sc_extent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
-    };
-
-    //
-    // Specify the scissor
-    //
-    VkRect2D scissor = {
-        .offset = {0, 0},
-        .extent = sc_extent
-    };
-
-    //
-    // Create the viewport 
+    // One viewport and scissor, both set when the command buffer is recorded
     //
     VkPipelineViewportStateCreateInfo viewport_ci = {};
     viewport_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_ci.viewportCount = 1;
-    viewport_ci.pViewports = &viewport;
+    viewport_ci.pViewports = NULL;
     viewport_ci.scissorCount = 1;
-    viewport_ci.pScissors = &scissor;
+    viewport_ci.pScissors = NULL;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_ci = {};
+    dynamic_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_ci.dynamicStateCount = 2;
+    dynamic_ci.pDynamicStates = dynamic_states;
 
     //
     // Put all of this together to create the pipeline!
@@ -290,25 +336,22 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D sc_extent, VkRen
     pipeline_ci.pMultisampleState = &ms_ci;
     pipeline_ci.pDepthStencilState = NULL;
     pipeline_ci.pColorBlendState = &colorBlending;
-    pipeline_ci.pDynamicState = NULL;
-    pipeline_ci.layout = *layout;
-    pipeline_ci.renderPass = renderpass;
+    pipeline_ci.pDynamicState = &dynamic_ci;
+    pipeline_ci.layout = layout;
+    pipeline_ci.renderPass = key->renderpass;
     pipeline_ci.subpass = 0;
     pipeline_ci.basePipelineHandle = VK_NULL_HANDLE; // TODO: if you want to use this feature, enable the flag 
     pipeline_ci.basePipelineIndex = -1;
 
     VkPipeline pipeline;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, &pipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(device, cache, 1, &pipeline_ci, NULL, &pipeline) != VK_SUCCESS) {
         log_fatal("Failed to create pipeline!\n");
         exit(EXIT_FAILURE);
     }
 
-    //
-    // We no longer need the shader modules
-    //
-    vkDestroyShaderModule(device, vertex_module, NULL);
-    vkDestroyShaderModule(device, fragment_module, NULL);
+    raw_vector_destroy(&binding_descriptions);
+    raw_vector_destroy(&attr_descriptions);
 
-    log_trace("Created graphics pipeline!\n");
+    log_trace("Created graphics pipeline (blend %u, layer mode %u)!\n", key->blend_mode, key->layer_mode);
     return pipeline;
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vulkan-interface/pipeline_cache.h"
+#include "language/fileops.h"
+#include "log.h"
+
+//
+// Returns true if data (read from a cache file) was written for this
+// physical device and driver, and holds a well formed driver cache.
+//
+static bool pipeline_cache_file_is_valid(VkPhysicalDevice physical_device, const uint8_t *data, size_t size) {
+    if (size < sizeof(struct PipelineCacheFileHeader)) {
+        log_info("Pipeline cache file is truncated\n");
+        return false;
+    }
+
+    struct PipelineCacheFileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    if (header.magic != PIPELINE_CACHE_MAGIC || header.data_size != size - sizeof(header)) {
+        log_info("Pipeline cache file is corrupt\n");
+        return false;
+    }
+    if (header.vendor_id != properties.vendorID ||
+        header.device_id != properties.deviceID ||
+        header.driver_version != properties.driverVersion ||
+        memcmp(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        log_info("Pipeline cache file was written by a different device or driver\n");
+        return false;
+    }
+
+    //
+    // The driver's data starts with its own header, which must agree too
+    //
+    VkPipelineCacheHeaderVersionOne vk_header;
+    if (header.data_size < sizeof(vk_header)) {
+        log_info("Pipeline cache data is truncated\n");
+        return false;
+    }
+    memcpy(&vk_header, data + sizeof(header), sizeof(vk_header));
+    if (vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vk_header.vendorID != properties.vendorID ||
+        vk_header.deviceID != properties.deviceID ||
+        memcmp(vk_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        log_info("Pipeline cache data does not match this device\n");
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Creates a pipeline cache, seeded from filename if it holds a cache written
+// for this device and driver. warm is set to whether it was. A missing or
+// stale file is not an error; the cache just starts empty. filename may be
+// NULL to always start cold.
+//
+VkPipelineCache pipeline_cache_load(VkPhysicalDevice physical_device, VkDevice device, const char *filename, bool *warm) {
+    size_t size = 0;
+    uint8_t *data = filename != NULL ? try_read_binary_file_FREE(filename, &size) : NULL;
+
+    *warm = data != NULL && pipeline_cache_file_is_valid(physical_device, data, size);
+
+    VkPipelineCacheCreateInfo ci = {};
+    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    ci.initialDataSize = *warm ? size - sizeof(struct PipelineCacheFileHeader) : 0;
+    ci.pInitialData = *warm ? data + sizeof(struct PipelineCacheFileHeader) : NULL;
+
+    VkPipelineCache cache;
+    if (vkCreatePipelineCache(device, &ci, NULL, &cache) != VK_SUCCESS) {
+        log_fatal("Failed to create pipeline cache\n");
+        exit(EXIT_FAILURE);
+    }
+    free(data);
+
+    log_trace("Created %s pipeline cache\n", *warm ? "warm" : "cold");
+    return cache;
+}
+
+//
+// Writes the contents of cache to filename, replacing it atomically so a
+// crash mid-write never leaves a half written cache behind. Failing to save
+// is logged but not fatal.
+//
+void pipeline_cache_save(VkPhysicalDevice physical_device, VkDevice device, VkPipelineCache cache, const char *filename) {
+    if (filename == NULL) {
+        return;
+    }
+
+    size_t data_size = 0;
+    if (vkGetPipelineCacheData(device, cache, &data_size, NULL) != VK_SUCCESS) {
+        log_error("Could not query pipeline cache size\n");
+        return;
+    }
+
+    uint8_t *file = malloc(sizeof(struct PipelineCacheFileHeader) + data_size);
+    if (file == NULL) {
+        log_fatal("Could not malloc pipeline cache data\n");
+        exit(EXIT_FAILURE);
+    }
+    if (vkGetPipelineCacheData(device, cache, &data_size, file + sizeof(struct PipelineCacheFileHeader)) != VK_SUCCESS) {
+        log_error("Could not read pipeline cache data\n");
+        free(file);
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    struct PipelineCacheFileHeader header = {
+        .magic = PIPELINE_CACHE_MAGIC,
+        .vendor_id = properties.vendorID,
+        .device_id = properties.deviceID,
+        .driver_version = properties.driverVersion,
+        .data_size = data_size,
+    };
+    memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    memcpy(file, &header, sizeof(header));
+
+    if (write_binary_file_atomic(filename, file, sizeof(header) + data_size)) {
+        log_info("Saved %lu bytes of pipeline cache to %s\n", (unsigned long)data_size, filename);
+    }
+    free(file);
+}
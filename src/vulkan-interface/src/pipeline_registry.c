@@ -0,0 +1,314 @@
+#include <stdlib.h>
+#include "language/clock.h"
+#include "language/math.h"
+#include "vulkan-interface/pipeline_registry.h"
+#include "vulkan-interface/shaders.h"
+#include "vulkan-interface/vertex.h"
+#include "log.h"
+
+//
+// A variant queued for a compile thread
+//
+struct PipelineCompileJob {
+    struct PipelineRegistry *registry;
+    struct PipelineKey key;
+};
+
+//
+// Initializes an empty registry with thread_count compile threads. The
+// shader modules of every program are kept for the lifetime of the
+// registry, so that building a new variant never touches SPIR-V again.
+// Every variant shares a layout made of set_layouts, indexed by
+// TILE_SET_*. Shaders come from assets when it is not NULL and holds them.
+//
+void pipeline_registry_init(
+    struct PipelineRegistry *registry,
+    VkDevice device,
+    VkPipelineCache cache,
+    const VkDescriptorSetLayout set_layouts[TILE_SET_COUNT],
+    const struct AssetPack *assets,
+    uint32_t thread_count) {
+
+    *registry = (struct PipelineRegistry) {
+        .device = device,
+        .cache = cache,
+        .layout = create_pipeline_layout(device, set_layouts),
+        .vertex_module = create_asset_shader_module(
+            device, assets, SHADER_VERT_ASSET, shader_vert_spv, shader_vert_spv_size),
+        .fragment_module = create_asset_shader_module(
+            device, assets, SHADER_FRAG_ASSET, shader_frag_spv, shader_frag_spv_size),
+        .tilemap_vertex_module = create_asset_shader_module(
+            device, assets, TILEMAP_VERT_ASSET, tilemap_vert_spv, tilemap_vert_spv_size),
+        .tilemap_fragment_module = create_asset_shader_module(
+            device, assets, TILEMAP_FRAG_ASSET, tilemap_frag_spv, tilemap_frag_spv_size),
+        .entries_PipelineRegistryEntry = raw_vector_create(sizeof(struct PipelineRegistryEntry), TILE_LAYER_MODE_COUNT),
+    };
+    pthread_mutex_init(&registry->mutex, NULL);
+    thread_pool_init(&registry->compile_threads, thread_count);
+}
+
+//
+// Finishes any queued compiles, then destroys every variant, the shared
+// layout and the shader modules.
+//
+void pipeline_registry_destroy(struct PipelineRegistry *registry) {
+    thread_pool_destroy(&registry->compile_threads);
+
+    struct PipelineCompileStats stats = pipeline_registry_compile_stats(registry);
+    log_info("Pipeline registry: %lu variants, %u hits, %u misses, %.3f ms building in place, "
+        "%u background compiles (%.3f ms avg, %.3f ms worst latency)\n",
+        (unsigned long)raw_vector_size(&registry->entries_PipelineRegistryEntry),
+        registry->hits,
+        registry->misses,
+        clock_ns_to_ms(registry->build_ns),
+        stats.completed,
+        stats.mean_latency_ms,
+        stats.max_latency_ms);
+
+    for (size_t i = 0; i < raw_vector_size(&registry->entries_PipelineRegistryEntry); i++) {
+        struct PipelineRegistryEntry *entry = (struct PipelineRegistryEntry *)raw_vector_get_ptr(&registry->entries_PipelineRegistryEntry, i);
+        vkDestroyPipeline(registry->device, entry->pipeline, NULL);
+    }
+    raw_vector_destroy(&registry->entries_PipelineRegistryEntry);
+    pthread_mutex_destroy(&registry->mutex);
+    vkDestroyShaderModule(registry->device, registry->vertex_module, NULL);
+    vkDestroyShaderModule(registry->device, registry->fragment_module, NULL);
+    vkDestroyShaderModule(registry->device, registry->tilemap_vertex_module, NULL);
+    vkDestroyShaderModule(registry->device, registry->tilemap_fragment_module, NULL);
+    vkDestroyPipelineLayout(registry->device, registry->layout, NULL);
+}
+
+//
+// Returns the entry for key, or NULL. There are only ever a handful of
+// variants, so a linear scan is cheaper than hashing. Call with the mutex held.
+//
+static struct PipelineRegistryEntry *pipeline_registry_find(struct PipelineRegistry *registry, const struct PipelineKey *key) {
+    for (size_t i = 0; i < raw_vector_size(&registry->entries_PipelineRegistryEntry); i++) {
+        struct PipelineRegistryEntry *entry = (struct PipelineRegistryEntry *)raw_vector_get_ptr(&registry->entries_PipelineRegistryEntry, i);
+        if (pipeline_key_equal(&entry->key, key)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static VkPipeline pipeline_registry_build(struct PipelineRegistry *registry, const struct PipelineKey *key) {
+    bool tilemap = key->program == PIPELINE_PROGRAM_TILEMAP;
+    return create_graphics_pipeline(
+        registry->device,
+        registry->cache,
+        registry->layout,
+        tilemap ? registry->tilemap_vertex_module : registry->vertex_module,
+        tilemap ? registry->tilemap_fragment_module : registry->fragment_module,
+        key);
+}
+
+//
+// Compile thread body. vkCreateGraphicsPipelines is free-threaded with
+// respect to the pipeline cache, so only publishing the result needs the lock.
+//
+static void pipeline_registry_compile_job(void *arg, uint32_t worker_index) {
+    struct PipelineCompileJob *job = arg;
+    struct PipelineRegistry *registry = job->registry;
+
+    VkPipeline pipeline = pipeline_registry_build(registry, &job->key);
+
+    pthread_mutex_lock(&registry->mutex);
+    struct PipelineRegistryEntry *entry = pipeline_registry_find(registry, &job->key);
+    uint64_t latency_ns = clock_now_ns() - entry->request_ns;
+    entry->pipeline = pipeline;
+    registry->compile_queue_depth--;
+    registry->compiles_completed++;
+    registry->compile_latency_total_ns += latency_ns;
+    registry->compile_latency_max_ns = MAX(registry->compile_latency_max_ns, latency_ns);
+    pthread_mutex_unlock(&registry->mutex);
+
+    log_trace("Compiled pipeline variant in the background in %.3f ms\n", clock_ns_to_ms(latency_ns));
+    free(job);
+}
+
+//
+// Returns the pipeline for key, building it on the calling thread the first
+// time it is asked for. Blocks if the variant is being compiled in the
+// background.
+//
+VkPipeline pipeline_registry_get(struct PipelineRegistry *registry, const struct PipelineKey *key) {
+    pthread_mutex_lock(&registry->mutex);
+    struct PipelineRegistryEntry *entry = pipeline_registry_find(registry, key);
+    if (entry != NULL && entry->pipeline != VK_NULL_HANDLE) {
+        registry->hits++;
+        VkPipeline pipeline = entry->pipeline;
+        pthread_mutex_unlock(&registry->mutex);
+        return pipeline;
+    }
+    pthread_mutex_unlock(&registry->mutex);
+
+    if (entry != NULL) {
+        pipeline_registry_wait_idle(registry);
+        return pipeline_registry_get(registry, key);
+    }
+
+    uint64_t start_ns = clock_now_ns();
+    struct PipelineRegistryEntry new_entry = {
+        .key = *key,
+        .pipeline = pipeline_registry_build(registry, key),
+        .request_ns = start_ns,
+    };
+
+    pthread_mutex_lock(&registry->mutex);
+    registry->build_ns += clock_now_ns() - start_ns;
+    registry->misses++;
+    raw_vector_push_back(&registry->entries_PipelineRegistryEntry, &new_entry);
+    pthread_mutex_unlock(&registry->mutex);
+
+    return new_entry.pipeline;
+}
+
+//
+// Returns the pipeline for key without ever blocking on a compile. If the
+// variant is not built yet it is queued on a compile thread and the
+// variant's fallback is returned instead, or VK_NULL_HANDLE if it has none,
+// meaning whatever it would have drawn is skipped for now. Fallbacks are
+// built in place, so callers should build them up front with
+// pipeline_registry_get.
+//
+VkPipeline pipeline_registry_request(struct PipelineRegistry *registry, const struct PipelineKey *key) {
+    pthread_mutex_lock(&registry->mutex);
+    struct PipelineRegistryEntry *entry = pipeline_registry_find(registry, key);
+    if (entry != NULL && entry->pipeline != VK_NULL_HANDLE) {
+        registry->hits++;
+        VkPipeline pipeline = entry->pipeline;
+        pthread_mutex_unlock(&registry->mutex);
+        return pipeline;
+    }
+
+    if (entry == NULL) {
+        struct PipelineRegistryEntry pending = {
+            .key = *key,
+            .pipeline = VK_NULL_HANDLE,
+            .request_ns = clock_now_ns(),
+        };
+        raw_vector_push_back(&registry->entries_PipelineRegistryEntry, &pending);
+        registry->misses++;
+        registry->compile_queue_depth++;
+
+        struct PipelineCompileJob *job = malloc(sizeof(struct PipelineCompileJob));
+        if (job == NULL) {
+            log_fatal("Could not malloc pipeline compile job\n");
+            exit(EXIT_FAILURE);
+        }
+        job->registry = registry;
+        job->key = *key;
+        thread_pool_submit(&registry->compile_threads, pipeline_registry_compile_job, job);
+    }
+    pthread_mutex_unlock(&registry->mutex);
+
+    struct PipelineKey fallback;
+    if (!pipeline_key_fallback(key, &fallback)) {
+        return VK_NULL_HANDLE;
+    }
+    return pipeline_registry_get(registry, &fallback);
+}
+
+//
+// Blocks until every requested variant has been compiled.
+//
+void pipeline_registry_wait_idle(struct PipelineRegistry *registry) {
+    thread_pool_wait_idle(&registry->compile_threads);
+}
+
+struct PipelineCompileStats pipeline_registry_compile_stats(struct PipelineRegistry *registry) {
+    pthread_mutex_lock(&registry->mutex);
+    struct PipelineCompileStats stats = {
+        .queue_depth = registry->compile_queue_depth,
+        .completed = registry->compiles_completed,
+        .mean_latency_ms = registry->compiles_completed > 0
+            ? clock_ns_to_ms(registry->compile_latency_total_ns) / registry->compiles_completed
+            : 0.0,
+        .max_latency_ms = clock_ns_to_ms(registry->compile_latency_max_ns),
+    };
+    pthread_mutex_unlock(&registry->mutex);
+    return stats;
+}
+
+//
+// Drops every variant built against renderpass. Called when the render
+// pass is about to be destroyed, e.g. because the swapchain format changed.
+// Outstanding compiles may still reference it, so they are finished first.
+// Frames in flight may still be drawing with the pipelines, so they are
+// handed to deletions, retired at last_use.
+//
+void pipeline_registry_forget_renderpass(
+    struct PipelineRegistry *registry, VkRenderPass renderpass, struct DeletionQueue *deletions, uint64_t last_use) {
+    pipeline_registry_wait_idle(registry);
+
+    pthread_mutex_lock(&registry->mutex);
+    size_t i = 0;
+    while (i < raw_vector_size(&registry->entries_PipelineRegistryEntry)) {
+        struct PipelineRegistryEntry *entry = (struct PipelineRegistryEntry *)raw_vector_get_ptr(&registry->entries_PipelineRegistryEntry, i);
+        if (entry->key.renderpass == renderpass) {
+            deletion_queue_retire_pipeline(deletions, entry->pipeline, last_use);
+            raw_vector_erase(&registry->entries_PipelineRegistryEntry, i);
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&registry->mutex);
+}
+
+//
+// The key for drawing a tile layer of the given TileLayerMode. Overlays are
+// translucent and blend over the layers below them; everything else is opaque.
+//
+struct PipelineKey pipeline_key_for_layer(VkRenderPass renderpass, uint32_t layer_mode) {
+    struct PipelineKey key = {
+        .renderpass = renderpass,
+        .program = PIPELINE_PROGRAM_TILES,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .blend_mode = layer_mode == TILE_LAYER_MODE_OVERLAY ? BLEND_MODE_ALPHA : BLEND_MODE_OPAQUE,
+        .layer_mode = layer_mode,
+    };
+    return key;
+}
+
+//
+// The key for drawing a fullscreen layer of the tilemap, which is always
+// opaque. Its vertex shader covers the screen with one triangle.
+//
+struct PipelineKey pipeline_key_for_tilemap(VkRenderPass renderpass) {
+    struct PipelineKey key = {
+        .renderpass = renderpass,
+        .program = PIPELINE_PROGRAM_TILEMAP,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .blend_mode = BLEND_MODE_OPAQUE,
+        .layer_mode = TILE_LAYER_MODE_ATLAS,
+    };
+    return key;
+}
+
+//
+// The key a layer of draw buffers is drawn with, whichever way it is drawn.
+//
+struct PipelineKey pipeline_key_for_layer_range(VkRenderPass renderpass, const struct TileLayerRange *layer) {
+    if (layer->fullscreen) {
+        return pipeline_key_for_tilemap(renderpass);
+    }
+    return pipeline_key_for_layer(renderpass, layer->mode);
+}
+
+//
+// The variant to draw with while key is compiling. Opaque variants fall back
+// to the plain atlas variant on the same render pass. Translucent ones have
+// no fallback: drawing an overlay opaque would hide the layers beneath it,
+// so it is better left out for the few frames until it is ready. The
+// tilemap variant is built up front and has no fallback either.
+//
+bool pipeline_key_fallback(const struct PipelineKey *key, struct PipelineKey *fallback) {
+    if (key->program != PIPELINE_PROGRAM_TILES
+        || key->blend_mode != BLEND_MODE_OPAQUE
+        || key->layer_mode == TILE_LAYER_MODE_ATLAS) {
+        return false;
+    }
+    *fallback = pipeline_key_for_layer(key->renderpass, TILE_LAYER_MODE_ATLAS);
+    return true;
+}
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include "vulkan-interface/present_timer.h"
+#include "language/clock.h"
+#include "log.h"
+
+//
+// Timer thread body: waits for the oldest pending present in slices of
+// PRESENT_TIMER_WAIT_NS, and records its latency once it has been shown.
+// The mutex is released while waiting, so presents can be queued and
+// swapchains forgotten meanwhile; a present which was dropped or forgotten
+// during the wait is not recorded.
+//
+static void *present_timer_main(void *arg) {
+    struct PresentTimer *timer = (struct PresentTimer *)arg;
+
+    pthread_mutex_lock(&timer->mutex);
+    while (!timer->stopping) {
+        if (timer->pending_count == 0) {
+            pthread_cond_wait(&timer->changed, &timer->mutex);
+            continue;
+        }
+        struct PresentTimerEntry entry = timer->pending[timer->pending_head];
+        timer->waiting_on = entry.swapchain;
+        pthread_mutex_unlock(&timer->mutex);
+
+        VkResult result = timer->wait_for_present(timer->device, entry.swapchain, entry.present_id, PRESENT_TIMER_WAIT_NS);
+        uint64_t now_ns = clock_now_ns();
+
+        pthread_mutex_lock(&timer->mutex);
+        timer->waiting_on = VK_NULL_HANDLE;
+        pthread_cond_broadcast(&timer->changed);
+        if (result == VK_TIMEOUT) {
+            continue;
+        }
+        struct PresentTimerEntry *head = &timer->pending[timer->pending_head];
+        if (timer->pending_count == 0 || head->swapchain != entry.swapchain || head->present_id != entry.present_id) {
+            continue;
+        }
+        timer->pending_head = (timer->pending_head + 1) % PRESENT_TIMER_CAPACITY;
+        timer->pending_count--;
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            double latency_ms = clock_ns_to_ms(now_ns - entry.start_ns);
+            raw_vector_push_back(&timer->latency_ms_double, &latency_ms);
+            timer->timed++;
+        } else {
+            timer->dropped++;
+        }
+    }
+    pthread_mutex_unlock(&timer->mutex);
+    return NULL;
+}
+
+//
+// Starts the timer thread for device, which must have VK_KHR_present_id
+// and VK_KHR_present_wait enabled.
+//
+void present_timer_init(struct PresentTimer *timer, VkDevice device) {
+    *timer = (struct PresentTimer) {
+        .device = device,
+        .wait_for_present = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"),
+        .next_present_id = 1,
+        .waiting_on = VK_NULL_HANDLE,
+        .latency_ms_double = raw_vector_create(sizeof(double), 1024),
+    };
+    if (timer->wait_for_present == NULL) {
+        log_fatal("Could not find vkWaitForPresentKHR\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&timer->mutex, NULL);
+    pthread_cond_init(&timer->changed, NULL);
+    if (pthread_create(&timer->thread, NULL, present_timer_main, timer) != 0) {
+        log_fatal("Could not start the present timer thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+// Stops the timer thread. Presents not timed yet are dropped.
+//
+void present_timer_destroy(struct PresentTimer *timer) {
+    pthread_mutex_lock(&timer->mutex);
+    timer->stopping = true;
+    pthread_cond_broadcast(&timer->changed);
+    pthread_mutex_unlock(&timer->mutex);
+    pthread_join(timer->thread, NULL);
+
+    log_info("Present timer: %lu presents timed, %lu dropped\n",
+        (unsigned long)timer->timed,
+        (unsigned long)(timer->dropped + timer->pending_count));
+    pthread_cond_destroy(&timer->changed);
+    pthread_mutex_destroy(&timer->mutex);
+    raw_vector_destroy(&timer->latency_ms_double);
+}
+
+//
+// The ID to chain to the next present with VkPresentIdKHR. IDs only ever
+// increase, across every swapchain. Render thread only.
+//
+uint64_t present_timer_next_id(struct PresentTimer *timer) {
+    return timer->next_present_id++;
+}
+
+//
+// Queues the present of present_id to swapchain, for a frame the CPU
+// started at start_ns, to be timed. Only presents which were queued, i.e.
+// which returned VK_SUCCESS or VK_SUBOPTIMAL_KHR, may be passed here.
+//
+void present_timer_presented(struct PresentTimer *timer, VkSwapchainKHR swapchain, uint64_t present_id, uint64_t start_ns) {
+    pthread_mutex_lock(&timer->mutex);
+    if (timer->pending_count == PRESENT_TIMER_CAPACITY) {
+        timer->pending_head = (timer->pending_head + 1) % PRESENT_TIMER_CAPACITY;
+        timer->pending_count--;
+        timer->dropped++;
+    }
+    timer->pending[(timer->pending_head + timer->pending_count) % PRESENT_TIMER_CAPACITY] = (struct PresentTimerEntry) {
+        .swapchain = swapchain,
+        .present_id = present_id,
+        .start_ns = start_ns,
+    };
+    timer->pending_count++;
+    pthread_cond_broadcast(&timer->changed);
+    pthread_mutex_unlock(&timer->mutex);
+}
+
+//
+// Drops every pending present to swapchain, and returns once the timer
+// thread is no longer waiting on it, so it can be destroyed. This blocks
+// for at most PRESENT_TIMER_WAIT_NS.
+//
+void present_timer_forget_swapchain(struct PresentTimer *timer, VkSwapchainKHR swapchain) {
+    pthread_mutex_lock(&timer->mutex);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < timer->pending_count; i++) {
+        struct PresentTimerEntry entry = timer->pending[(timer->pending_head + i) % PRESENT_TIMER_CAPACITY];
+        if (entry.swapchain == swapchain) {
+            timer->dropped++;
+        } else {
+            timer->pending[(timer->pending_head + kept++) % PRESENT_TIMER_CAPACITY] = entry;
+        }
+    }
+    timer->pending_count = kept;
+    while (timer->waiting_on == swapchain) {
+        pthread_cond_wait(&timer->changed, &timer->mutex);
+    }
+    pthread_mutex_unlock(&timer->mutex);
+}
+
+//
+// Moves the latencies, in milliseconds, of the presents timed since the
+// last call onto the end of latency_ms_double.
+//
+void present_timer_collect(struct PresentTimer *timer, struct RawVector *latency_ms_double) {
+    pthread_mutex_lock(&timer->mutex);
+    size_t count = raw_vector_size(&timer->latency_ms_double);
+    if (count > 0) {
+        raw_vector_extend_back(latency_ms_double, raw_vector_get_ptr(&timer->latency_ms_double, 0), count);
+        raw_vector_clear(&timer->latency_ms_double);
+    }
+    pthread_mutex_unlock(&timer->mutex);
+}
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include "vulkan-interface/retired_swapchains.h"
+#include "log.h"
+
+//
+// present_fences says whether the device has VK_EXT_swapchain_maintenance1
+// enabled, so presents can be given fences.
+//
+void retired_swapchains_init(
+        struct RetiredSwapchains *retired,
+        VkDevice device,
+        struct FrameSync *sync,
+        struct DeletionQueue *deletions,
+        struct PresentTimer *present_timer,
+        bool present_fences) {
+    *retired = (struct RetiredSwapchains) {
+        .device = device,
+        .sync = sync,
+        .deletions = deletions,
+        .present_timer = present_timer,
+        .present_fences = present_fences,
+        .retired_RetiredSwapchain = raw_vector_create(sizeof(struct RetiredSwapchain), 4),
+        .pending_PresentFence = raw_vector_create(sizeof(struct PresentFence), 2 * MAX_FRAMES_IN_FLIGHT),
+        .free_VkFence = raw_vector_create(sizeof(VkFence), 2 * MAX_FRAMES_IN_FLIGHT),
+    };
+}
+
+//
+// Hands swapchain to the deletion queue. Its presents have been processed,
+// so the present timer can stop waiting on it straight away, and nothing
+// after the last submitted frame can use it.
+//
+static void retired_swapchains_release(struct RetiredSwapchains *retired, VkSwapchainKHR swapchain) {
+    if (retired->present_timer != NULL) {
+        present_timer_forget_swapchain(retired->present_timer, swapchain);
+    }
+    deletion_queue_retire_swapchain(retired->deletions, swapchain, retired->sync->last_signalled);
+}
+
+//
+// Waits for every present fence still pending, then hands every retired
+// swapchain to the deletion queue. Only called once presenting has
+// stopped, after main_loop has let the presentation queue drain.
+//
+void retired_swapchains_destroy(struct RetiredSwapchains *retired) {
+    size_t pending = raw_vector_size(&retired->pending_PresentFence);
+    for (size_t i = 0; i < pending; i++) {
+        struct PresentFence *present_fence = (struct PresentFence *)raw_vector_get_ptr(&retired->pending_PresentFence, i);
+        vkWaitForFences(retired->device, 1, &present_fence->fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(retired->device, present_fence->fence, NULL);
+    }
+    for (size_t i = 0; i < raw_vector_size(&retired->free_VkFence); i++) {
+        vkDestroyFence(retired->device, *(VkFence *)raw_vector_get_ptr(&retired->free_VkFence, i), NULL);
+    }
+    for (size_t i = 0; i < raw_vector_size(&retired->retired_RetiredSwapchain); i++) {
+        struct RetiredSwapchain *entry = (struct RetiredSwapchain *)raw_vector_get_ptr(&retired->retired_RetiredSwapchain, i);
+        retired_swapchains_release(retired, entry->swapchain);
+    }
+    log_info("Retired swapchains: %lu retired, %lu present fences created\n",
+        (unsigned long)retired->retired,
+        (unsigned long)retired->fences_created);
+    raw_vector_destroy(&retired->retired_RetiredSwapchain);
+    raw_vector_destroy(&retired->pending_PresentFence);
+    raw_vector_destroy(&retired->free_VkFence);
+}
+
+//
+// Takes swapchain, which has just been replaced, and holds it until its
+// presents have been processed.
+//
+void retired_swapchains_add(struct RetiredSwapchains *retired, VkSwapchainKHR swapchain) {
+    struct RetiredSwapchain entry = {
+        .swapchain = swapchain,
+        .presents_left = MAX_FRAMES_IN_FLIGHT,
+    };
+    raw_vector_push_back(&retired->retired_RetiredSwapchain, &entry);
+    retired->retired++;
+}
+
+//
+// Returns an unsignalled fence to chain to the next present to swapchain
+// with VkSwapchainPresentFenceInfoEXT. Fences are recycled by collect once
+// signalled. Only valid with present fences.
+//
+VkFence retired_swapchains_present_fence(struct RetiredSwapchains *retired, VkSwapchainKHR swapchain) {
+    struct PresentFence present_fence = {
+        .swapchain = swapchain,
+    };
+    if (raw_vector_size(&retired->free_VkFence) > 0) {
+        present_fence.fence = *(VkFence *)raw_vector_get_ptr(&retired->free_VkFence, raw_vector_size(&retired->free_VkFence) - 1);
+        raw_vector_pop_back(&retired->free_VkFence);
+    } else {
+        VkFenceCreateInfo fence_info = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        };
+        if (vkCreateFence(retired->device, &fence_info, NULL, &present_fence.fence) != VK_SUCCESS) {
+            log_fatal("Could not create present fence\n");
+            exit(EXIT_FAILURE);
+        }
+        retired->fences_created++;
+    }
+    raw_vector_push_back(&retired->pending_PresentFence, &present_fence);
+    return present_fence.fence;
+}
+
+//
+// Counts a present to the current swapchain towards letting go of the ones
+// it replaced. Only needed without present fences.
+//
+void retired_swapchains_presented(struct RetiredSwapchains *retired) {
+    for (size_t i = 0; i < raw_vector_size(&retired->retired_RetiredSwapchain); i++) {
+        struct RetiredSwapchain *entry = (struct RetiredSwapchain *)raw_vector_get_ptr(&retired->retired_RetiredSwapchain, i);
+        if (entry->presents_left > 0) {
+            entry->presents_left--;
+        }
+    }
+}
+
+static bool retired_swapchains_has_pending_present(struct RetiredSwapchains *retired, VkSwapchainKHR swapchain) {
+    for (size_t i = 0; i < raw_vector_size(&retired->pending_PresentFence); i++) {
+        struct PresentFence *present_fence = (struct PresentFence *)raw_vector_get_ptr(&retired->pending_PresentFence, i);
+        if (present_fence->swapchain == swapchain) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Recycles the present fences which have signalled, then hands every
+// retired swapchain whose presents are done to the deletion queue, without
+// waiting. Without present fences, a swapchain is done once enough frames
+// have been presented after it; it is retired with the timeline value of
+// the last of them, so it also outlives their rendering. Returns how many
+// swapchains were handed over.
+//
+uint32_t retired_swapchains_collect(struct RetiredSwapchains *retired) {
+    if (retired->present_fences) {
+        size_t pending = raw_vector_size(&retired->pending_PresentFence);
+        struct PresentFence *present_fences = pending > 0
+            ? (struct PresentFence *)raw_vector_get_ptr(&retired->pending_PresentFence, 0)
+            : NULL;
+        size_t kept = 0;
+        for (size_t i = 0; i < pending; i++) {
+            if (vkGetFenceStatus(retired->device, present_fences[i].fence) == VK_SUCCESS) {
+                vkResetFences(retired->device, 1, &present_fences[i].fence);
+                raw_vector_push_back(&retired->free_VkFence, &present_fences[i].fence);
+            } else {
+                present_fences[kept++] = present_fences[i];
+            }
+        }
+        while (raw_vector_size(&retired->pending_PresentFence) > kept) {
+            raw_vector_pop_back(&retired->pending_PresentFence);
+        }
+    }
+
+    size_t count = raw_vector_size(&retired->retired_RetiredSwapchain);
+    if (count == 0) {
+        return 0;
+    }
+    struct RetiredSwapchain *entries = (struct RetiredSwapchain *)raw_vector_get_ptr(&retired->retired_RetiredSwapchain, 0);
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool done = retired->present_fences
+            ? !retired_swapchains_has_pending_present(retired, entries[i].swapchain)
+            : entries[i].presents_left == 0;
+        if (done) {
+            retired_swapchains_release(retired, entries[i].swapchain);
+        } else {
+            entries[kept++] = entries[i];
+        }
+    }
+    while (raw_vector_size(&retired->retired_RetiredSwapchain) > kept) {
+        raw_vector_pop_back(&retired->retired_RetiredSwapchain);
+    }
+    return count - kept;
+}
@@ -24,7 +24,10 @@ bool is_swapchain_adequate(VkPhysicalDevice device, VkSurfaceKHR surface) {
 }
 
 //
-// Creates the swapchain from this device to this surface.
+// Creates the swapchain from this device to this surface. When resizing,
+// old_swapchain is the swapchain being replaced (otherwise VK_NULL_HANDLE)
+// so the driver can hand its resources over; the caller still destroys it.
+// The present mode and image count follow pacing.
 //
 VkSwapchainKHR create_swapchain(
     VkDevice logical_device,
@@ -34,8 +37,11 @@ VkSwapchainKHR create_swapchain(
     uint32_t window_height,
     uint32_t graphics_qfidx,
     uint32_t present_qfidx,
+    VkSwapchainKHR old_swapchain,
+    const struct FramePacing *pacing,
     VkFormat *fill_format,
-    VkExtent2D *fill_extent) {
+    VkExtent2D *fill_extent,
+    VkPresentModeKHR *fill_present_mode) {
 
     //
     // Choose surface format
@@ -55,7 +61,8 @@ VkSwapchainKHR create_swapchain(
     }
 
     //
-    // Choose surface presentation mode
+    // Choose surface presentation mode: the first of the profile's preferred
+    // modes the surface supports, or FIFO which every surface supports
     //
     VkPresentModeKHR present_mode;
     uint32_t present_mode_count;
@@ -64,10 +71,14 @@ VkSwapchainKHR create_swapchain(
     vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, present_modes);
 
     present_mode = VK_PRESENT_MODE_FIFO_KHR;
-    for (int i = 0; i < present_mode_count; i++) {
-        if (present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            present_mode = present_modes[i];
-            break;
+    bool present_mode_found = false;
+    for (int p = 0; p < pacing->preferred_present_mode_count && !present_mode_found; p++) {
+        for (int i = 0; i < present_mode_count; i++) {
+            if (present_modes[i] == pacing->preferred_present_modes[p]) {
+                present_mode = present_modes[i];
+                present_mode_found = true;
+                break;
+            }
         }
     }
 
@@ -84,7 +95,7 @@ VkSwapchainKHR create_swapchain(
     //
     // Choose number of images in the swapchain
     //
-    uint32_t image_count = capabilities.minImageCount + 1;
+    uint32_t image_count = capabilities.minImageCount + pacing->extra_swapchain_images;
     if (capabilities.maxImageCount > 0) {
         image_count = MIN(image_count, capabilities.maxImageCount);
     } 
@@ -114,7 +125,7 @@ VkSwapchainKHR create_swapchain(
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE; 
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    create_info.oldSwapchain = old_swapchain;
 
     //
     // Create the swapchain and return it
@@ -125,9 +136,10 @@ VkSwapchainKHR create_swapchain(
         exit(EXIT_FAILURE);
     }
 
-    log_trace("Created swapchain!\n");
+    log_trace("Created swapchain with %u images, %s present mode!\n", image_count, present_mode_name(present_mode));
     *fill_format = create_info.imageFormat;
     *fill_extent = create_info.imageExtent;
+    *fill_present_mode = present_mode;
     return swapchain;
 }
 
@@ -0,0 +1,399 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vulkan-interface/tile_atlas.h"
+#include "vulkan-interface/command.h"
+#include "language/fileops.h"
+#include "language/image.h"
+#include "language/math.h"
+#include "log.h"
+
+#define TILE_ATLAS_LAYER_SIZE ((VkDeviceSize)TILE_ATLAS_TILE_SIZE * TILE_ATLAS_TILE_SIZE * IMAGE_RGBA8_PIXEL_SIZE)
+
+//
+// Stand-in tiles: a flat colour per index, with a darker border so tile
+// edges are visible and one of four patterns picked by the index.
+//
+static void generate_tile(uint32_t index, uint8_t *pixels) {
+    uint8_t r = (uint8_t)((index * 37u) % 255u);
+    uint8_t g = (uint8_t)((index * 101u) % 255u);
+    uint8_t b = (uint8_t)((index * 173u) % 255u);
+    uint32_t pattern = (index / 7) % 4;
+
+    for (uint32_t y = 0; y < TILE_ATLAS_TILE_SIZE; y++) {
+        for (uint32_t x = 0; x < TILE_ATLAS_TILE_SIZE; x++) {
+            bool border = x == 0 || y == 0 || x == TILE_ATLAS_TILE_SIZE - 1 || y == TILE_ATLAS_TILE_SIZE - 1;
+            bool marked = false;
+            switch (pattern) {
+            case 1: marked = ((x / 8) + (y / 8)) % 2 == 0; break;
+            case 2: marked = (x + y) % 8 < 2; break;
+            case 3: marked = y % 8 < 2; break;
+            }
+            uint32_t shade = border ? 2 : marked ? 1 : 0;
+
+            uint8_t *pixel = pixels + ((size_t)y * TILE_ATLAS_TILE_SIZE + x) * IMAGE_RGBA8_PIXEL_SIZE;
+            pixel[0] = (uint8_t)(r >> shade);
+            pixel[1] = (uint8_t)(g >> shade);
+            pixel[2] = (uint8_t)(b >> shade);
+            pixel[3] = 255;
+        }
+    }
+}
+
+//
+// Decodes the size bytes of tile sheet at data, read from path. Returns
+// its RGBA8 pixels and how many tiles across and down it is.
+//
+static uint8_t *decode_tile_sheet_FREE(const char *path, const uint8_t *data, size_t size, uint32_t *columns, uint32_t *rows) {
+    uint32_t width, height;
+    uint8_t *pixels = image_decode_ppm_FREE(data, size, &width, &height);
+    if (pixels == NULL) {
+        log_fatal("Tile sheet %s is not a binary PPM\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (width % TILE_ATLAS_TILE_SIZE != 0 || height % TILE_ATLAS_TILE_SIZE != 0) {
+        log_fatal("Tile sheet %s is %ux%u, which is not a whole number of %u pixel tiles\n",
+            path, width, height, TILE_ATLAS_TILE_SIZE);
+        exit(EXIT_FAILURE);
+    }
+    *columns = width / TILE_ATLAS_TILE_SIZE;
+    *rows = height / TILE_ATLAS_TILE_SIZE;
+    return pixels;
+}
+
+static uint8_t *load_tile_sheet_FREE(const char *path, uint32_t *columns, uint32_t *rows) {
+    size_t size;
+    uint8_t *data = try_read_binary_file_FREE(path, &size);
+    if (data == NULL) {
+        log_fatal("Could not read tile sheet %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    uint8_t *pixels = decode_tile_sheet_FREE(path, data, size, columns, rows);
+    free(data);
+    return pixels;
+}
+
+//
+// Mips are generated by blitting each level into the next, which needs
+// linear filtering of the format. Without it the atlas has a single level.
+//
+static uint32_t tile_atlas_mip_levels(VkPhysicalDevice physical_device) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, TILE_ATLAS_FORMAT, &properties);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT
+        | VK_FORMAT_FEATURE_BLIT_DST_BIT
+        | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if ((properties.optimalTilingFeatures & needed) != needed) {
+        log_warn("Tile atlas format cannot be blitted with linear filtering, so it will have no mips\n");
+        return 1;
+    }
+
+    uint32_t levels = 1;
+    for (uint32_t size = TILE_ATLAS_TILE_SIZE; size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+static void atlas_image_barrier(
+    VkCommandBuffer command_buffer,
+    const struct TileAtlas *atlas,
+    uint32_t base_mip,
+    uint32_t mip_count,
+    VkImageLayout old_layout,
+    VkImageLayout new_layout,
+    VkAccessFlags src_access,
+    VkAccessFlags dst_access,
+    VkPipelineStageFlags src_stage,
+    VkPipelineStageFlags dst_stage) {
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = atlas->image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = base_mip;
+    barrier.subresourceRange.levelCount = mip_count;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = atlas->layer_count;
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+//
+// Copies every layer out of staging_buffer in one region, then fills each
+// mip level of every layer with one blit from the level above. Levels are
+// moved to SHADER_READ_ONLY_OPTIMAL as soon as nothing more is read from
+// them.
+//
+static void record_atlas_upload(VkCommandBuffer command_buffer, const struct TileAtlas *atlas, VkBuffer staging_buffer) {
+    atlas_image_barrier(
+        command_buffer, atlas, 0, atlas->mip_levels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = atlas->layer_count;
+    region.imageOffset = (VkOffset3D){0, 0, 0};
+    region.imageExtent = (VkExtent3D){TILE_ATLAS_TILE_SIZE, TILE_ATLAS_TILE_SIZE, 1};
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, atlas->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    int32_t size = TILE_ATLAS_TILE_SIZE;
+    for (uint32_t level = 1; level < atlas->mip_levels; level++) {
+        atlas_image_barrier(
+            command_buffer, atlas, level - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        int32_t next_size = MAX(size / 2, 1);
+        VkImageBlit blit = {};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = atlas->layer_count;
+        blit.srcOffsets[0] = (VkOffset3D){0, 0, 0};
+        blit.srcOffsets[1] = (VkOffset3D){size, size, 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = atlas->layer_count;
+        blit.dstOffsets[0] = (VkOffset3D){0, 0, 0};
+        blit.dstOffsets[1] = (VkOffset3D){next_size, next_size, 1};
+        vkCmdBlitImage(
+            command_buffer,
+            atlas->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            atlas->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR);
+
+        atlas_image_barrier(
+            command_buffer, atlas, level - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        size = next_size;
+    }
+
+    atlas_image_barrier(
+        command_buffer, atlas, atlas->mip_levels - 1, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+//
+// Builds the atlas from the tile sheet at tile_sheet_path, or if it is NULL
+// from the TILE_ATLAS_SHEET_ASSET of assets, or from
+// TILE_ATLAS_GENERATED_TILES generated tiles if there is neither. Tiles beyond
+// the device's array layer limit are dropped. The upload is submitted to
+// graphics_queue without waiting: draws submitted after it are ordered
+// behind its final barrier, and the staging buffer is retired to deletions
+// until the upload's timeline value.
+//
+void tile_atlas_init(
+    struct TileAtlas *atlas,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    struct DeletionQueue *deletions,
+    struct FrameSync *sync,
+    VkQueue graphics_queue,
+    uint32_t graphics_family_index,
+    const struct AssetPack *assets,
+    const char *tile_sheet_path) {
+
+    VkDevice device = allocator->device;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+
+    uint8_t *sheet = NULL;
+    uint32_t sheet_columns = 0;
+    uint32_t tile_count = TILE_ATLAS_GENERATED_TILES;
+    size_t packed_size;
+    const uint8_t *packed = assets != NULL ? asset_pack_find(assets, TILE_ATLAS_SHEET_ASSET, &packed_size) : NULL;
+    if (tile_sheet_path != NULL || packed != NULL) {
+        uint32_t sheet_rows;
+        sheet = tile_sheet_path != NULL
+            ? load_tile_sheet_FREE(tile_sheet_path, &sheet_columns, &sheet_rows)
+            : decode_tile_sheet_FREE(TILE_ATLAS_SHEET_ASSET, packed, packed_size, &sheet_columns, &sheet_rows);
+        tile_count = sheet_columns * sheet_rows;
+    }
+    if (tile_count > properties.limits.maxImageArrayLayers) {
+        log_warn("Only %u of %u tiles fit in the atlas\n", properties.limits.maxImageArrayLayers, tile_count);
+        tile_count = properties.limits.maxImageArrayLayers;
+    }
+
+    *atlas = (struct TileAtlas) {
+        .device = device,
+        .allocator = allocator,
+        .descriptors = descriptors,
+        .layer_count = tile_count,
+        .mip_levels = tile_atlas_mip_levels(allocator->physical_device),
+    };
+
+    //
+    // Pack every tile straight into the staging buffer, one layer after another
+    //
+    VkDeviceSize staging_size = TILE_ATLAS_LAYER_SIZE * tile_count;
+    struct MemoryAllocation staging_allocation;
+    VkBuffer staging_buffer = create_buffer_with_memory(
+        allocator,
+        staging_size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        0,
+        &staging_allocation);
+    for (uint32_t i = 0; i < tile_count; i++) {
+        uint8_t *layer = staging_allocation.mapped + TILE_ATLAS_LAYER_SIZE * i;
+        if (sheet != NULL) {
+            image_copy_rgba8_region(
+                sheet,
+                sheet_columns * TILE_ATLAS_TILE_SIZE,
+                (i % sheet_columns) * TILE_ATLAS_TILE_SIZE,
+                (i / sheet_columns) * TILE_ATLAS_TILE_SIZE,
+                TILE_ATLAS_TILE_SIZE,
+                TILE_ATLAS_TILE_SIZE,
+                layer);
+        } else {
+            generate_tile(i, layer);
+        }
+    }
+    free(sheet);
+
+    VkImageCreateInfo image_ci = {};
+    image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_ci.imageType = VK_IMAGE_TYPE_2D;
+    image_ci.format = TILE_ATLAS_FORMAT;
+    image_ci.extent = (VkExtent3D){TILE_ATLAS_TILE_SIZE, TILE_ATLAS_TILE_SIZE, 1};
+    image_ci.mipLevels = atlas->mip_levels;
+    image_ci.arrayLayers = tile_count;
+    image_ci.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_ci.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    atlas->image = create_image_with_memory(allocator, &image_ci, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &atlas->allocation);
+
+    VkImageViewCreateInfo view_ci = {};
+    view_ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_ci.image = atlas->image;
+    view_ci.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    view_ci.format = TILE_ATLAS_FORMAT;
+    view_ci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_ci.subresourceRange.baseMipLevel = 0;
+    view_ci.subresourceRange.levelCount = atlas->mip_levels;
+    view_ci.subresourceRange.baseArrayLayer = 0;
+    view_ci.subresourceRange.layerCount = tile_count;
+    if (vkCreateImageView(device, &view_ci, NULL, &atlas->view) != VK_SUCCESS) {
+        log_fatal("Could not create tile atlas image view\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //
+    // Tiles are pixel art, so magnified tiles stay crisp while minified ones
+    // blend between mips. Clamping keeps neighbouring texels of the same
+    // layer from bleeding over the tile's edge.
+    //
+    VkSamplerCreateInfo sampler_ci = {};
+    sampler_ci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_ci.magFilter = VK_FILTER_NEAREST;
+    sampler_ci.minFilter = VK_FILTER_LINEAR;
+    sampler_ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_ci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_ci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_ci.anisotropyEnable = VK_FALSE;
+    sampler_ci.minLod = 0.0f;
+    sampler_ci.maxLod = (float)atlas->mip_levels;
+    if (vkCreateSampler(device, &sampler_ci, NULL, &atlas->sampler) != VK_SUCCESS) {
+        log_fatal("Could not create tile atlas sampler\n");
+        exit(EXIT_FAILURE);
+    }
+
+    atlas->command_pool = create_transient_command_pool(device, graphics_family_index);
+    VkCommandBufferAllocateInfo command_buffer_info = {};
+    command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_info.commandPool = atlas->command_pool;
+    command_buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_info.commandBufferCount = 1;
+    VkCommandBuffer command_buffer;
+    if (vkAllocateCommandBuffers(device, &command_buffer_info, &command_buffer) != VK_SUCCESS) {
+        log_fatal("Could not allocate tile atlas command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        log_fatal("Could not begin tile atlas command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    record_atlas_upload(command_buffer, atlas, staging_buffer);
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        log_fatal("Failed to record tile atlas upload\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t upload_value = frame_sync_next_value(sync);
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &upload_value;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &sync->timeline;
+    if (vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        log_fatal("Failed to submit tile atlas upload\n");
+        exit(EXIT_FAILURE);
+    }
+    deletion_queue_retire_buffer(deletions, staging_buffer, &staging_allocation, upload_value);
+
+    VkDescriptorSetLayoutBinding layout_binding = {};
+    layout_binding.binding = TILE_ATLAS_BINDING;
+    layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    layout_binding.descriptorCount = 1;
+    layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    atlas->set_layout = descriptor_allocator_layout(descriptors, &layout_binding, 1);
+
+    struct DescriptorBinding binding = {
+        .binding = TILE_ATLAS_BINDING,
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .image_view = atlas->view,
+        .sampler = atlas->sampler,
+        .image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    atlas->descriptor_set = descriptor_allocator_persistent(descriptors, atlas->set_layout, &binding, 1);
+
+    log_info("Tile atlas: %u tiles of %ux%u with %u mips, %lu KiB uploaded in one copy\n",
+        tile_count,
+        TILE_ATLAS_TILE_SIZE,
+        TILE_ATLAS_TILE_SIZE,
+        atlas->mip_levels,
+        (unsigned long)(staging_size / 1024));
+}
+
+//
+// The caller must know the GPU is done with the atlas and its upload.
+//
+void tile_atlas_destroy(struct TileAtlas *atlas) {
+    vkDestroyCommandPool(atlas->device, atlas->command_pool, NULL);
+    vkDestroySampler(atlas->device, atlas->sampler, NULL);
+    descriptor_allocator_forget_image_view(atlas->descriptors, atlas->view);
+    vkDestroyImageView(atlas->device, atlas->view, NULL);
+    destroy_image_with_memory(atlas->allocator, atlas->image, &atlas->allocation);
+}
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "vulkan-interface/tile_batch.h"
+#include "vulkan-interface/memory.h"
+#include "language/clock.h"
+#include "language/math.h"
+#include "language/stats.h"
+#include "language/thread_pool.h"
+#include "log.h"
+
+//
+// One entry of the readback ring. Each slot renders into the offscreen
+// image with the same index and copies it into its own staging buffer.
+//
+struct TileReadbackSlot {
+    VkBuffer staging_buffer;
+    struct MemoryAllocation staging_allocation;
+
+    VkCommandBuffer command_buffer;
+    uint64_t timeline_value;
+
+    bool in_flight;
+    size_t tile_index;
+    uint64_t submit_ns;
+};
+
+//
+// Everything an encoder worker needs to write one tile. The pixels are
+// copied out of the staging buffer so the slot can be reused immediately.
+//
+struct TileEncodeJob {
+    uint8_t *pixels;
+    uint32_t width;
+    uint32_t height;
+    char path[TILE_BATCH_PATH_LENGTH];
+    uint64_t submit_ns;
+    double *latency_ms;
+};
+
+//
+// Reads a list of tiles, one "z x y" triple per line. Blank lines and
+// lines starting with '#' are skipped.
+//
+struct RawVector read_tile_list_FREE(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        log_fatal("Could not open tile list %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    struct RawVector rvec_TileCoord = raw_vector_create(sizeof(struct TileCoord), 1024);
+    char line[256];
+    size_t line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        char *start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\n' || *start == '\0' || *start == '#') continue;
+
+        struct TileCoord tile;
+        if (sscanf(start, "%u %u %u", &tile.z, &tile.x, &tile.y) != 3) {
+            log_fatal("Malformed tile on line %lu of %s\n", line_number, filename);
+            exit(EXIT_FAILURE);
+        }
+        raw_vector_push_back(&rvec_TileCoord, &tile);
+    }
+    fclose(file);
+
+    log_info("Read %lu tiles from %s\n", raw_vector_size(&rvec_TileCoord), filename);
+    return rvec_TileCoord;
+}
+
+//
+// Writes the RGBA pixels as a binary PPM. The alpha channel is dropped
+// by packing the pixels down to RGB in place.
+//
+static void write_ppm(const char *path, uint8_t *rgba, uint32_t width, uint32_t height) {
+    size_t pixel_count = (size_t)width * height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        rgba[i * 3 + 0] = rgba[i * 4 + 0];
+        rgba[i * 3 + 1] = rgba[i * 4 + 1];
+        rgba[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        log_error("Could not open %s for writing\n", path);
+        return;
+    }
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    if (fwrite(rgba, 3, pixel_count, file) != pixel_count) {
+        log_error("Could not write tile %s\n", path);
+    }
+    fclose(file);
+}
+
+//
+// Worker body: encode and write one tile, then record its latency from
+// submission to the file being written.
+//
+static void tile_encode_job(void *arg, uint32_t worker_index) {
+    struct TileEncodeJob *job = arg;
+
+    write_ppm(job->path, job->pixels, job->width, job->height);
+    *job->latency_ms = clock_ns_to_ms(clock_now_ns() - job->submit_ns);
+
+    free(job->pixels);
+    free(job);
+}
+
+//
+// The camera which frames tile: zoom level 0 is the top-left
+// CAMERA_DEFAULT_VIEW_TILES square of the map, and each level splits every
+// tile of the one above into four.
+//
+static struct Camera tile_camera(const struct TileCoord *tile) {
+    uint32_t z = MIN(tile->z, 31u);
+    float size = CAMERA_DEFAULT_VIEW_TILES / (float)(1u << z);
+    return camera_for_region(tile->x * size, tile->y * size, size);
+}
+
+//
+// Creates the staging buffer and command buffer of one ring slot.
+// Host cached memory is preferred since the CPU only ever reads it.
+//
+static struct TileReadbackSlot create_readback_slot(
+    struct VulkanState *state, VkCommandPool pool, VkDeviceSize size) {
+
+    struct TileReadbackSlot slot = {};
+
+    //
+    // The staging buffer stays mapped for the lifetime of the batch
+    //
+    slot.staging_buffer = create_buffer_with_memory(
+        state->allocator,
+        size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        &slot.staging_allocation);
+
+    VkCommandBufferAllocateInfo cb_info = {};
+    cb_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cb_info.commandPool = pool;
+    cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cb_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(state->logical_device, &cb_info, &slot.command_buffer) != VK_SUCCESS) {
+        log_fatal("Could not allocate tile command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return slot;
+}
+
+static void destroy_readback_slot(struct VulkanState *state, struct TileReadbackSlot *slot) {
+    destroy_buffer_with_memory(state->allocator, slot->staging_buffer, &slot->staging_allocation);
+}
+
+//
+// Waits for the slot's tile to finish on the GPU, copies the pixels out of
+// the staging buffer and hands them to an encoder. The slot is then free.
+//
+static void retire_readback_slot(
+    struct VulkanState *state,
+    struct TileReadbackSlot *slot,
+    struct ThreadPool *encoders,
+    struct RawVector *rvec_TileCoord,
+    const char *output_directory,
+    double *latencies_ms) {
+
+    frame_sync_wait(state->sync, slot->timeline_value);
+
+    struct TileCoord *tile = (struct TileCoord *)raw_vector_get_ptr(rvec_TileCoord, slot->tile_index);
+    size_t tile_bytes = (size_t)state->swapchain_extent.width * state->swapchain_extent.height * 4;
+
+    struct TileEncodeJob *job = malloc(sizeof(struct TileEncodeJob));
+    uint8_t *pixels = malloc(tile_bytes);
+    if (job == NULL || pixels == NULL) {
+        log_fatal("Could not malloc tile encode job\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(pixels, slot->staging_allocation.mapped, tile_bytes);
+
+    job->pixels = pixels;
+    job->width = state->swapchain_extent.width;
+    job->height = state->swapchain_extent.height;
+    job->submit_ns = slot->submit_ns;
+    job->latency_ms = &latencies_ms[slot->tile_index];
+    snprintf(job->path, sizeof(job->path), "%s/%u_%u_%u.ppm", output_directory, tile->z, tile->x, tile->y);
+
+    thread_pool_submit(encoders, tile_encode_job, job);
+    slot->in_flight = false;
+}
+
+//
+// Renders every tile of rvec_TileCoord into output_directory as <z>_<x>_<y>.ppm.
+// The state must be headless; its offscreen image ring doubles as the readback
+// ring, so up to image count tiles are in flight on the GPU at once and the CPU
+// only ever waits for the oldest one. Encoding runs on worker_count threads
+// (0 means one per core). Throughput and latency are logged and returned.
+//
+struct TileBatchStats render_tile_batch(
+    struct VulkanState *state,
+    struct RawVector *rvec_TileCoord,
+    const char *output_directory,
+    uint32_t worker_count) {
+
+    if (!state->headless) {
+        log_fatal("Tile batches can only be rendered by a headless state\n");
+        exit(EXIT_FAILURE);
+    }
+    if (state->world != NULL) {
+        log_fatal("Tile batches cannot be rendered from a streamed map\n");
+        exit(EXIT_FAILURE);
+    }
+    if (mkdir(output_directory, 0755) != 0 && errno != EEXIST) {
+        log_fatal("Could not create output directory %s\n", output_directory);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t tile_count = raw_vector_size(rvec_TileCoord);
+    uint32_t slot_count = raw_vector_size(&state->swapchain_images_VkImage);
+    VkDeviceSize tile_bytes = (VkDeviceSize)state->swapchain_extent.width * state->swapchain_extent.height * 4;
+
+    //
+    // Every tile is written to disk, so none may be drawn with a fallback
+    //
+    pipeline_registry_wait_idle(state->pipelines);
+
+    struct TileDrawBuffers draw_buffers = vulkan_state_draw_buffers(state);
+
+    //
+    // Every tile shares one TileFrameParams in the uniform ring and differs
+    // only in the camera it pushes
+    //
+    frame_sync_wait(state->sync, state->sync->last_signalled);
+    struct TileDrawUniforms uniforms = vulkan_state_frame_uniforms(state, 0, &state->camera, 0.0f);
+    VkCommandPool pool = create_resettable_command_pool(
+        state->logical_device, optional_index_get_value(&state->physical_device.graphics_family_index));
+
+    struct TileReadbackSlot slots[slot_count];
+    for (uint32_t i = 0; i < slot_count; i++) {
+        slots[i] = create_readback_slot(state, pool, tile_bytes);
+    }
+
+    struct ThreadPool encoders;
+    thread_pool_init(&encoders, worker_count);
+
+    double *latencies_ms = calloc(tile_count > 0 ? tile_count : 1, sizeof(double));
+    if (latencies_ms == NULL) {
+        log_fatal("Could not malloc tile latencies\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t start_ns = clock_now_ns();
+    for (size_t i = 0; i < tile_count; i++) {
+        uint32_t slot_index = i % slot_count;
+        struct TileReadbackSlot *slot = &slots[slot_index];
+        if (slot->in_flight) {
+            retire_readback_slot(state, slot, &encoders, rvec_TileCoord, output_directory, latencies_ms);
+        }
+
+        slot->tile_index = i;
+        slot->submit_ns = clock_now_ns();
+
+        vkResetCommandBuffer(slot->command_buffer, 0);
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(slot->command_buffer, &begin_info) != VK_SUCCESS) {
+            log_fatal("Could not begin tile command buffer\n");
+            exit(EXIT_FAILURE);
+        }
+
+        struct Camera camera = tile_camera((struct TileCoord *)raw_vector_get_ptr(rvec_TileCoord, i));
+        uniforms.camera = camera_push_constants(&camera, state->swapchain_extent);
+        record_draw_commands(
+            slot->command_buffer,
+            state->renderpass,
+            state->pipelines,
+            *(VkFramebuffer *)raw_vector_get_ptr(&state->framebuffers_VkFramebuffer, slot_index),
+            state->swapchain_extent,
+            &draw_buffers,
+            &uniforms);
+        record_image_readback(
+            slot->command_buffer,
+            *(VkImage *)raw_vector_get_ptr(&state->swapchain_images_VkImage, slot_index),
+            state->swapchain_extent,
+            slot->staging_buffer);
+
+        if (vkEndCommandBuffer(slot->command_buffer) != VK_SUCCESS) {
+            log_fatal("Failed to record tile command buffer\n");
+            exit(EXIT_FAILURE);
+        }
+
+        slot->timeline_value = frame_sync_next_value(state->sync);
+        VkTimelineSemaphoreSubmitInfo timeline_info = {};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &slot->timeline_value;
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &slot->command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &state->sync->timeline;
+
+        if (vkQueueSubmit(state->graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            log_fatal("Failed to submit tile %lu\n", i);
+            exit(EXIT_FAILURE);
+        }
+        slot->in_flight = true;
+    }
+
+    //
+    // Drain the ring oldest first, then wait for the encoders to catch up
+    //
+    for (size_t i = 0; i < slot_count; i++) {
+        struct TileReadbackSlot *slot = &slots[(tile_count + i) % slot_count];
+        if (slot->in_flight) {
+            retire_readback_slot(state, slot, &encoders, rvec_TileCoord, output_directory, latencies_ms);
+        }
+    }
+    thread_pool_wait_idle(&encoders);
+    uint64_t elapsed_ns = clock_now_ns() - start_ns;
+
+    struct TileBatchStats stats = {};
+    stats.tile_count = tile_count;
+    stats.seconds = clock_ns_to_seconds(elapsed_ns);
+    stats.tiles_per_second = stats.seconds > 0.0 ? tile_count / stats.seconds : 0.0;
+    stats.mean_latency_ms = stats_mean(latencies_ms, tile_count);
+    stats.max_latency_ms = stats_max(latencies_ms, tile_count);
+    stats.p50_latency_ms = stats_percentile(latencies_ms, tile_count, 50.0);
+    stats.p99_latency_ms = stats_percentile(latencies_ms, tile_count, 99.0);
+
+    log_info("Rendered %lu tiles in %.3f s: %.1f tiles/s\n", stats.tile_count, stats.seconds, stats.tiles_per_second);
+    log_info("Tile latency: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+        stats.mean_latency_ms, stats.p50_latency_ms, stats.p99_latency_ms, stats.max_latency_ms);
+
+    thread_pool_destroy(&encoders);
+    free(latencies_ms);
+    for (uint32_t i = 0; i < slot_count; i++) {
+        destroy_readback_slot(state, &slots[i]);
+    }
+    vkDestroyCommandPool(state->logical_device, pool, NULL);
+
+    return stats;
+}
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include "vulkan-interface/uniform_ring.h"
+#include "language/math.h"
+#include "log.h"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+//
+// Creates a ring of frame_count regions of frame_size bytes each, rounded
+// up to the device's uniform buffer offset alignment. Host visible, device
+// local memory is preferred so the GPU reads it without crossing the bus.
+// The ring's descriptor set is a persistent one from descriptors, written
+// once to a window the size of TileFrameParams; dynamic offsets slide that
+// window along the buffer.
+//
+void uniform_ring_init(
+    struct UniformRing *ring,
+    struct MemoryAllocator *allocator,
+    struct DescriptorAllocator *descriptors,
+    uint32_t frame_count,
+    VkDeviceSize frame_size) {
+
+    VkDevice device = allocator->device;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(allocator->physical_device, &properties);
+    VkDeviceSize alignment = MAX(properties.limits.minUniformBufferOffsetAlignment, 16);
+
+    *ring = (struct UniformRing) {
+        .device = device,
+        .allocator = allocator,
+        .descriptors = descriptors,
+        .frame_size = align_up(frame_size, alignment),
+        .alignment = alignment,
+        .frame_count = frame_count,
+        .frame_offset = 0,
+        .used = 0,
+        .peak_used = 0,
+    };
+    ring->buffer = create_buffer_with_memory(
+        allocator,
+        ring->frame_size * frame_count,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &ring->allocation);
+
+    VkDescriptorSetLayoutBinding layout_binding = {};
+    layout_binding.binding = UNIFORM_RING_BINDING;
+    layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    layout_binding.descriptorCount = 1;
+    layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    ring->set_layout = descriptor_allocator_layout(descriptors, &layout_binding, 1);
+
+    struct DescriptorBinding binding = {
+        .binding = UNIFORM_RING_BINDING,
+        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .buffer = ring->buffer,
+        .offset = 0,
+        .range = sizeof(struct TileFrameParams),
+    };
+    ring->descriptor_set = descriptor_allocator_persistent(descriptors, ring->set_layout, &binding, 1);
+}
+
+void uniform_ring_destroy(struct UniformRing *ring) {
+    log_info("Uniform ring: %u frames of %lu bytes, at most %lu used by a frame\n",
+        ring->frame_count,
+        (unsigned long)ring->frame_size,
+        (unsigned long)ring->peak_used);
+
+    descriptor_allocator_forget_buffer(ring->descriptors, ring->buffer);
+    destroy_buffer_with_memory(ring->allocator, ring->buffer, &ring->allocation);
+}
+
+//
+// Makes frame_index's region current and empties it. The caller must know
+// the GPU is done with frame_index's previous submission.
+//
+void uniform_ring_begin_frame(struct UniformRing *ring, uint32_t frame_index) {
+    ring->frame_offset = ring->frame_size * (frame_index % ring->frame_count);
+    ring->used = 0;
+}
+
+//
+// Hands out size bytes of the current frame's region to write uniform data
+// into. dynamic_offset is set to what must be passed when binding the
+// ring's descriptor set to read them. The memory is coherent, so nothing
+// needs flushing.
+//
+void *uniform_ring_push(struct UniformRing *ring, VkDeviceSize size, uint32_t *dynamic_offset) {
+    VkDeviceSize aligned_size = align_up(size, ring->alignment);
+    if (ring->used + aligned_size > ring->frame_size) {
+        log_fatal("Uniform ring frame of %lu bytes is full\n", (unsigned long)ring->frame_size);
+        exit(EXIT_FAILURE);
+    }
+
+    VkDeviceSize offset = ring->frame_offset + ring->used;
+    ring->used += aligned_size;
+    if (ring->used > ring->peak_used) {
+        ring->peak_used = ring->used;
+    }
+
+    *dynamic_offset = (uint32_t)offset;
+    return ring->allocation.mapped + offset;
+}
@@ -0,0 +1,372 @@
+#include <string.h>
+#include "vulkan-interface/upload.h"
+#include "vulkan-interface/command.h"
+#include "vulkan-interface/memory.h"
+#include "log.h"
+
+static VkCommandBuffer allocate_upload_command_buffer(VkDevice device, VkCommandPool pool) {
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer;
+    if (vkAllocateCommandBuffers(device, &alloc_info, &command_buffer) != VK_SUCCESS) {
+        log_fatal("Could not allocate upload command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    return command_buffer;
+}
+
+//
+// Creates an upload context which copies on transfer_queue. Completion is
+// always reported on sync's timeline, which only the graphics queue
+// signals: with a separate transfer family the copies signal a timeline
+// of their own, and the graphics queue waits on it before acquiring the
+// destinations and signalling sync. Each staging buffer is host visible
+// and coherent, and its memory stays mapped.
+//
+struct UploadContext upload_context_create(
+    struct MemoryAllocator *allocator,
+    struct FrameSync *sync,
+    VkQueue graphics_queue,
+    uint32_t graphics_family_index,
+    VkQueue transfer_queue,
+    uint32_t transfer_family_index,
+    VkDeviceSize staging_size) {
+
+    VkDevice device = allocator->device;
+
+    struct UploadContext context = {
+        .device = device,
+        .allocator = allocator,
+        .sync = sync,
+
+        .queue = transfer_queue,
+        .queue_family_index = transfer_family_index,
+        .graphics_queue = graphics_queue,
+        .graphics_family_index = graphics_family_index,
+        .ownership_transfer = transfer_family_index != graphics_family_index,
+
+        .transfer_timeline = VK_NULL_HANDLE,
+        .transfer_value = 0,
+
+        .command_pool = create_transient_command_pool(device, transfer_family_index),
+        .acquire_command_pool = VK_NULL_HANDLE,
+        .slot_index = 0,
+        .submitted_value = 0,
+
+        .staging_size = staging_size,
+        .staging_used = 0,
+
+        .pending_UploadCopy = raw_vector_create(sizeof(struct UploadCopy), 16),
+        .pending_dst_stages = 0,
+        .pending_dst_access = 0,
+    };
+
+    if (context.ownership_transfer) {
+        VkSemaphoreTypeCreateInfo type_ci = {};
+        type_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_ci.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_ci = {};
+        semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_ci.pNext = &type_ci;
+        if (vkCreateSemaphore(device, &semaphore_ci, NULL, &context.transfer_timeline) != VK_SUCCESS) {
+            log_fatal("Could not create transfer timeline semaphore\n");
+            exit(EXIT_FAILURE);
+        }
+        context.acquire_command_pool = create_transient_command_pool(device, graphics_family_index);
+    }
+
+    for (uint32_t i = 0; i < UPLOAD_SLOT_COUNT; i++) {
+        struct UploadSlot *slot = &context.slots[i];
+        slot->staging_buffer = create_buffer_with_memory(
+            allocator,
+            staging_size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            0,
+            &slot->staging_allocation);
+        slot->transfer_command_buffer = allocate_upload_command_buffer(device, context.command_pool);
+        slot->acquire_command_buffer = context.ownership_transfer
+            ? allocate_upload_command_buffer(device, context.acquire_command_pool)
+            : VK_NULL_HANDLE;
+        slot->timeline_value = 0;
+    }
+
+    log_info("Uploading on queue family %u%s\n",
+        transfer_family_index, context.ownership_transfer ? ", transferring ownership to graphics" : "");
+    return context;
+}
+
+//
+// Flushes anything still pending, waits for every copy and releases the context.
+//
+void upload_context_destroy(struct UploadContext *context) {
+    upload_context_flush(context);
+    upload_context_wait(context);
+
+    log_info("Uploads: %lu bytes in %lu flushes, %lu waited for a staging buffer\n",
+        (unsigned long)context->bytes_uploaded,
+        (unsigned long)context->flushes,
+        (unsigned long)context->stalls);
+
+    for (uint32_t i = 0; i < UPLOAD_SLOT_COUNT; i++) {
+        destroy_buffer_with_memory(context->allocator, context->slots[i].staging_buffer, &context->slots[i].staging_allocation);
+    }
+    vkDestroyCommandPool(context->device, context->command_pool, NULL);
+    if (context->ownership_transfer) {
+        vkDestroyCommandPool(context->device, context->acquire_command_pool, NULL);
+        vkDestroySemaphore(context->device, context->transfer_timeline, NULL);
+    }
+    raw_vector_destroy(&context->pending_UploadCopy);
+}
+
+//
+// Creates a buffer in device local memory which can be the destination
+// of an upload.
+//
+VkBuffer create_device_local_buffer(
+    struct MemoryAllocator *allocator,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    struct MemoryAllocation *allocation) {
+
+    return create_buffer_with_memory(
+        allocator,
+        size,
+        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        0,
+        allocation);
+}
+
+//
+// Copies size bytes of data into the staging buffer and queues a copy of
+// them to dst_buffer at dst_offset, to be read at dst_stage with
+// dst_access. Nothing is submitted until the context is flushed, unless
+// the staging buffer fills up first; uploads larger than the staging
+// buffer are split across several flushes.
+//
+void upload_buffer(
+    struct UploadContext *context,
+    VkBuffer dst_buffer,
+    VkDeviceSize dst_offset,
+    const void *data,
+    VkDeviceSize size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags dst_access) {
+
+    const uint8_t *src = data;
+
+    while (size > 0) {
+        if (context->staging_used == context->staging_size) {
+            upload_context_flush(context);
+        }
+
+        VkDeviceSize available = context->staging_size - context->staging_used;
+        VkDeviceSize chunk = size < available ? size : available;
+
+        struct UploadSlot *slot = &context->slots[context->slot_index];
+        memcpy(slot->staging_allocation.mapped + context->staging_used, src, chunk);
+
+        struct UploadCopy copy = {
+            .dst_buffer = dst_buffer,
+            .dst_offset = dst_offset,
+            .staging_offset = context->staging_used,
+            .size = chunk,
+            .dst_stage = dst_stage,
+            .dst_access = dst_access,
+        };
+        raw_vector_push_back(&context->pending_UploadCopy, &copy);
+        context->pending_dst_stages |= dst_stage;
+        context->pending_dst_access |= dst_access;
+
+        context->staging_used += chunk;
+        dst_offset += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+}
+
+static void begin_upload_command_buffer(VkCommandBuffer command_buffer) {
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        log_fatal("Could not begin upload command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void end_upload_command_buffer(VkCommandBuffer command_buffer) {
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        log_fatal("Failed to record upload command buffer\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+// Records one queue family ownership transfer barrier per pending copy,
+// which is the release half on the transfer queue and the acquire half on
+// the graphics queue. Both halves must describe the same buffer ranges.
+//
+static void record_ownership_barriers(
+    struct UploadContext *context,
+    VkCommandBuffer command_buffer,
+    bool release,
+    VkPipelineStageFlags src_stage,
+    VkPipelineStageFlags dst_stage) {
+
+    size_t copy_count = raw_vector_size(&context->pending_UploadCopy);
+    VkBufferMemoryBarrier barriers[copy_count];
+    for (size_t i = 0; i < copy_count; i++) {
+        struct UploadCopy *copy = (struct UploadCopy *)raw_vector_get_ptr(&context->pending_UploadCopy, i);
+
+        barriers[i] = (VkBufferMemoryBarrier) {};
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+        barriers[i].dstAccessMask = release ? 0 : copy->dst_access;
+        barriers[i].srcQueueFamilyIndex = context->queue_family_index;
+        barriers[i].dstQueueFamilyIndex = context->graphics_family_index;
+        barriers[i].buffer = copy->dst_buffer;
+        barriers[i].offset = copy->dst_offset;
+        barriers[i].size = copy->size;
+    }
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, copy_count, barriers, 0, NULL);
+}
+
+static void submit_upload(
+    VkQueue queue,
+    VkCommandBuffer command_buffer,
+    VkSemaphore wait_semaphore,
+    uint64_t wait_value,
+    VkPipelineStageFlags wait_stage,
+    VkSemaphore signal_semaphore,
+    uint64_t signal_value) {
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = wait_semaphore != VK_NULL_HANDLE ? 1 : 0;
+    timeline_info.pWaitSemaphoreValues = &wait_value;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &signal_value;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = wait_semaphore != VK_NULL_HANDLE ? 1 : 0;
+    submit_info.pWaitSemaphores = &wait_semaphore;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &signal_semaphore;
+
+    if (vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        log_fatal("Failed to submit uploads\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+// Records every pending copy out of the current staging buffer and submits
+// them without waiting. Later graphics submissions are ordered after the
+// copies, either by the barrier following them on the graphics queue or by
+// the acquire submission which waits for the transfer queue. The next
+// staging buffer is then made current, waiting only if its own copies from
+// UPLOAD_SLOT_COUNT flushes ago are somehow still running.
+//
+void upload_context_flush(struct UploadContext *context) {
+    size_t copy_count = raw_vector_size(&context->pending_UploadCopy);
+    if (copy_count == 0) {
+        return;
+    }
+
+    struct UploadSlot *slot = &context->slots[context->slot_index];
+    begin_upload_command_buffer(slot->transfer_command_buffer);
+
+    for (size_t i = 0; i < copy_count; i++) {
+        struct UploadCopy *copy = (struct UploadCopy *)raw_vector_get_ptr(&context->pending_UploadCopy, i);
+
+        VkBufferCopy region = {};
+        region.srcOffset = copy->staging_offset;
+        region.dstOffset = copy->dst_offset;
+        region.size = copy->size;
+        vkCmdCopyBuffer(slot->transfer_command_buffer, slot->staging_buffer, copy->dst_buffer, 1, &region);
+    }
+
+    if (context->ownership_transfer) {
+        record_ownership_barriers(
+            context, slot->transfer_command_buffer, true, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        end_upload_command_buffer(slot->transfer_command_buffer);
+
+        //
+        // The acquire waits at the stages which first read the buffers, and
+        // its barrier chains off those same stages.
+        //
+        begin_upload_command_buffer(slot->acquire_command_buffer);
+        record_ownership_barriers(
+            context, slot->acquire_command_buffer, false, context->pending_dst_stages, context->pending_dst_stages);
+        end_upload_command_buffer(slot->acquire_command_buffer);
+
+        context->transfer_value++;
+        submit_upload(
+            context->queue, slot->transfer_command_buffer,
+            VK_NULL_HANDLE, 0, 0,
+            context->transfer_timeline, context->transfer_value);
+
+        slot->timeline_value = frame_sync_next_value(context->sync);
+        submit_upload(
+            context->graphics_queue, slot->acquire_command_buffer,
+            context->transfer_timeline, context->transfer_value, context->pending_dst_stages,
+            context->sync->timeline, slot->timeline_value);
+    } else {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = context->pending_dst_access;
+        vkCmdPipelineBarrier(
+            slot->transfer_command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            context->pending_dst_stages,
+            0, 1, &barrier, 0, NULL, 0, NULL);
+        end_upload_command_buffer(slot->transfer_command_buffer);
+
+        slot->timeline_value = frame_sync_next_value(context->sync);
+        submit_upload(
+            context->queue, slot->transfer_command_buffer,
+            VK_NULL_HANDLE, 0, 0,
+            context->sync->timeline, slot->timeline_value);
+    }
+    context->submitted_value = slot->timeline_value;
+
+    log_trace("Uploaded %lu bytes in %lu copies\n", (unsigned long)context->staging_used, (unsigned long)copy_count);
+    context->flushes++;
+    context->bytes_uploaded += context->staging_used;
+
+    raw_vector_clear(&context->pending_UploadCopy);
+    context->pending_dst_stages = 0;
+    context->pending_dst_access = 0;
+    context->staging_used = 0;
+
+    context->slot_index = (context->slot_index + 1) % UPLOAD_SLOT_COUNT;
+    struct UploadSlot *next = &context->slots[context->slot_index];
+    if (!frame_sync_is_complete(context->sync, next->timeline_value)) {
+        context->stalls++;
+        frame_sync_wait(context->sync, next->timeline_value);
+    }
+}
+
+//
+// Blocks until every flushed copy has completed, e.g. before the CPU reuses
+// or frees what was uploaded.
+//
+void upload_context_wait(struct UploadContext *context) {
+    frame_sync_wait(context->sync, context->submitted_value);
+}
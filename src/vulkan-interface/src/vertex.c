@@ -1,112 +1,155 @@
-#include <string.h>
 #include "vulkan-interface/vertex.h"
 
+//
+// A unit quad drawn as two clockwise triangles. Tiles are placed by
+// offsetting it with their TileInstance::position.
+//
 struct Vertex quad_vertices[NUM_QUAD_VERTICES] = {
-    {{0.0f, -0.5f, 0.0f}, {0.3f, 0.3f, 0.0f}},
-    {{0.5f, 0.5f, 0.0f}, {0.0f, 0.4f, 0.4f}},
-    {{-0.5f, 0.5f, 0.0f}, {0.7f, 0.1f, 0.3f}}
+    {{0.0f, 0.0f, 0.0f}, {0.3f, 0.3f, 0.0f}},
+    {{1.0f, 0.0f, 0.0f}, {0.0f, 0.4f, 0.4f}},
+    {{1.0f, 1.0f, 0.0f}, {0.7f, 0.1f, 0.3f}},
+    {{0.0f, 1.0f, 0.0f}, {0.0f, 0.4f, 0.4f}},
 };
 
-VkBuffer create_vertex_buffer(VkDevice device) {
-    VkBufferCreateInfo ci = {};
-    ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    ci.size = sizeof(struct Vertex) * NUM_QUAD_VERTICES;
-    ci.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VkBuffer buffer;
-    if (vkCreateBuffer(device, &ci, NULL, &buffer) != VK_SUCCESS) {
-        log_fatal("Failed to create vertex buffer\n");
-        exit(EXIT_FAILURE);
-    }
+uint16_t quad_indices[NUM_QUAD_INDICES] = {
+    0, 1, 2,
+    0, 2, 3,
+};
 
-    return buffer;
-}
+//
+// Binding 0 advances once per vertex of the quad, binding 1 once per tile.
+//
+struct RawVector get_binding_description() {
+    struct RawVector binding_dscrps = raw_vector_create(sizeof(VkVertexInputBindingDescription), 2);
 
-VkVertexInputBindingDescription get_binding_description() {
     VkVertexInputBindingDescription bd = {};
-    bd.binding = 0;
+    bd.binding = VERTEX_BINDING;
     bd.stride = sizeof(struct Vertex);
     bd.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    raw_vector_push_back(&binding_dscrps, &bd);
 
-    return bd;
+    bd.binding = INSTANCE_BINDING;
+    bd.stride = sizeof(struct TileInstance);
+    bd.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    raw_vector_push_back(&binding_dscrps, &bd);
+
+    return binding_dscrps;
 }
 
 struct RawVector get_attribute_description() {
-    struct RawVector attr_dscrps = raw_vector_create(sizeof(VkVertexInputAttributeDescription), 2);
+    struct RawVector attr_dscrps = raw_vector_create(sizeof(VkVertexInputAttributeDescription), 5);
 
     VkVertexInputAttributeDescription ad = {};
-    ad.binding = 0;
+    ad.binding = VERTEX_BINDING;
     ad.location = 0;
     ad.format = VK_FORMAT_R32G32B32_SFLOAT;
     ad.offset = offsetof(struct Vertex, position);
     raw_vector_push_back(&attr_dscrps, &ad);
 
-    ad.binding = 0;
+    ad.binding = VERTEX_BINDING;
     ad.location = 1;
     ad.format = VK_FORMAT_R32G32B32_SFLOAT;
     ad.offset = offsetof(struct Vertex, color);
     raw_vector_push_back(&attr_dscrps, &ad);
+
+    ad.binding = INSTANCE_BINDING;
+    ad.location = 2;
+    ad.format = VK_FORMAT_R32G32_SFLOAT;
+    ad.offset = offsetof(struct TileInstance, position);
+    raw_vector_push_back(&attr_dscrps, &ad);
+
+    ad.binding = INSTANCE_BINDING;
+    ad.location = 3;
+    ad.format = VK_FORMAT_R32_UINT;
+    ad.offset = offsetof(struct TileInstance, layer);
+    raw_vector_push_back(&attr_dscrps, &ad);
+
+    ad.binding = INSTANCE_BINDING;
+    ad.location = 4;
+    ad.format = VK_FORMAT_R32_UINT;
+    ad.offset = offsetof(struct TileInstance, atlas_index);
+    raw_vector_push_back(&attr_dscrps, &ad);
+
     return attr_dscrps;
 }
 
-VkDeviceMemory allocate_and_bind_and_fill_vertex_buffer_memory(VkPhysicalDevice physical_device, VkDevice device, VkBuffer vertex_buffer) {
-
-    //
-    // The mem_reqs.memoryTypeBits has bit i set if mem_props.memoryTypes[i] is supported for
-    // the device. Therefore, for our desired properties, we must check that the given
-    // memory type includes our desired properties AND that it is supported by our
-    // logical device.
-    //
-    VkMemoryRequirements mem_reqs;
-    vkGetBufferMemoryRequirements(device, vertex_buffer, &mem_reqs);
-
-    VkPhysicalDeviceMemoryProperties mem_props;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
-
-    //
-    // Select a memory type to allocate for our buffer
-    //
-    uint32_t desired_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    uint32_t selected_memory_type_index = UINT32_MAX;
-
-    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
-        if (mem_reqs.memoryTypeBits & (1 << i) && ((mem_props.memoryTypes[i].propertyFlags & desired_properties) == desired_properties)) {
-            selected_memory_type_index = i;
-            break;
-        }
-    }
-    if (selected_memory_type_index == UINT32_MAX) {
-        log_fatal("Failed to select memory type!\n");
-        exit(EXIT_FAILURE);
+//
+// The layers of the generated map, bottom to top: opaque ground tiles
+// covering the whole map and a sparse translucent overlay on top.
+//
+static const enum TileLayerMode tile_grid_layer_modes[] = {
+    TILE_LAYER_MODE_ATLAS,
+    TILE_LAYER_MODE_OVERLAY,
+};
+#define TILE_GRID_LAYER_COUNT (sizeof(tile_grid_layer_modes) / sizeof(tile_grid_layer_modes[0]))
+
+//
+// The layers of the generated map with no instances yet, returning how many
+// there are. Layer 0 covers every tile, layer 1 marks every fourth diagonal.
+//
+uint32_t tile_grid_layers(struct TileLayerRange layers[MAX_TILE_LAYERS]) {
+    for (uint32_t layer = 0; layer < TILE_GRID_LAYER_COUNT; layer++) {
+        layers[layer] = (struct TileLayerRange) {
+            .first_instance = 0,
+            .instance_count = 0,
+            .mode = tile_grid_layer_modes[layer],
+            .fullscreen = false,
+        };
     }
+    return TILE_GRID_LAYER_COUNT;
+}
 
-    //
-    // Allocate the memory
-    //
-    VkMemoryAllocateInfo alloc_info = {0};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_reqs.size;
-    alloc_info.memoryTypeIndex = selected_memory_type_index;
-
-    VkDeviceMemory memory;
-    if (vkAllocateMemory(device, &alloc_info, NULL, &memory) != VK_SUCCESS) {
-        log_fatal("Failed to allocate memory!\n");
-        exit(EXIT_FAILURE);
+//
+// The tile of the generated map at (x, y) on layer, with atlas indices
+// scattered so neighbouring tiles look different. Returns false if layer
+// has no tile there. Any tile can be generated on its own, so the map can
+// be built a chunk at a time.
+//
+bool tile_grid_instance(uint32_t x, uint32_t y, uint32_t layer, struct TileInstance *instance) {
+    if (layer > 0 && (x + y) % 4 != 0) {
+        return false;
     }
+    *instance = (struct TileInstance) {
+        .position = { (float)x, (float)y },
+        .layer = layer,
+        .atlas_index = (x * 7 + y * 13) % 64,
+    };
+    return true;
+}
 
-    //
-    // Now bind this memory to the vertex buffer and return it
-    //
-    vkBindBufferMemory(device, vertex_buffer, memory, 0);
+//
+// Builds the whole width x height map. Instances are written sorted by
+// layer and, within a layer, block by TILE_BLOCK_SIZE block so runs of
+// consecutive instances are close together on the map. The range of each
+// layer is returned through layers and layer_count.
+//
+struct RawVector create_tile_instance_grid(
+    uint32_t width,
+    uint32_t height,
+    struct TileLayerRange layers[MAX_TILE_LAYERS],
+    uint32_t *layer_count) {
+
+    struct RawVector rvec_TileInstance = raw_vector_create(sizeof(struct TileInstance), (size_t)width * height);
+    *layer_count = tile_grid_layers(layers);
+
+    for (uint32_t layer = 0; layer < *layer_count; layer++) {
+        layers[layer].first_instance = raw_vector_size(&rvec_TileInstance);
+
+        for (uint32_t block_y = 0; block_y < height; block_y += TILE_BLOCK_SIZE) {
+            for (uint32_t block_x = 0; block_x < width; block_x += TILE_BLOCK_SIZE) {
+                for (uint32_t y = block_y; y < height && y < block_y + TILE_BLOCK_SIZE; y++) {
+                    for (uint32_t x = block_x; x < width && x < block_x + TILE_BLOCK_SIZE; x++) {
+                        struct TileInstance instance;
+                        if (tile_grid_instance(x, y, layer, &instance)) {
+                            raw_vector_push_back(&rvec_TileInstance, &instance);
+                        }
+                    }
+                }
+            }
+        }
 
-    //
-    // Write data to the newly allocated memory
-    //
-    void *data;
-    vkMapMemory(device, memory, 0, sizeof(struct Vertex) * NUM_QUAD_VERTICES, 0, &data);
-    memcpy(data, quad_vertices, sizeof(struct Vertex) * NUM_QUAD_VERTICES);
-    vkUnmapMemory(device, memory);
+        layers[layer].instance_count = raw_vector_size(&rvec_TileInstance) - layers[layer].first_instance;
+    }
 
-    return memory;
+    return rvec_TileInstance;
 }